@@ -41,6 +41,7 @@ extern opl_driver_t opl_openbsd_driver;
 extern opl_driver_t opl_win32_driver;
 #endif
 extern opl_driver_t opl_sdl_driver;
+extern opl_driver_t opl_render_driver;
 
 static opl_driver_t *drivers[] =
 {
@@ -54,10 +55,12 @@ static opl_driver_t *drivers[] =
     &opl_win32_driver,
 #endif
     &opl_sdl_driver,
+    &opl_render_driver,
     NULL
 };
 
 static opl_driver_t *driver = NULL;
+static char *selected_driver = NULL;
 static int init_stage_reg_writes = 1;
 
 unsigned int opl_sample_rate = 22050;
@@ -115,6 +118,14 @@ static opl_init_result_t AutoSelectDriver(unsigned int port_base)
 
     for (i=0; drivers[i] != NULL; ++i)
     {
+        // The offline renderer doesn't make any sound, so it is only
+        // used when asked for by name.
+
+        if (drivers[i] == &opl_render_driver)
+        {
+            continue;
+        }
+
         result = InitDriver(drivers[i], port_base);
         if (result != OPL_INIT_NONE)
         {
@@ -136,7 +147,12 @@ opl_init_result_t OPL_Init(unsigned int port_base)
     int i;
     int result;
 
-    driver_name = getenv("OPL_DRIVER");
+    driver_name = selected_driver;
+
+    if (driver_name == NULL)
+    {
+        driver_name = getenv("OPL_DRIVER");
+    }
 
     if (driver_name != NULL)
     {
@@ -170,6 +186,13 @@ opl_init_result_t OPL_Init(unsigned int port_base)
     }
 }
 
+// Use the named driver from now on, or pick one again if name is NULL.
+
+void OPL_SelectDriver(char *name)
+{
+    selected_driver = name;
+}
+
 // Shut down the OPL library.
 
 void OPL_Shutdown(void)
@@ -483,6 +506,14 @@ void OPL_Delay(uint64_t us)
         return;
     }
 
+    // When rendering offline, time doesn't pass outside of OPL_Render,
+    // so there is nothing to wait for.
+
+    if (driver == &opl_render_driver)
+    {
+        return;
+    }
+
     // Create a callback that will signal this thread after the
     // specified time.
 
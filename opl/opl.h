@@ -25,6 +25,12 @@
 
 typedef void (*opl_callback_t)(void *data);
 
+// Function called by the "Render" driver for each register written,
+// with the time in us since the driver was initialized.
+
+typedef void (*opl_trace_callback_t)(uint64_t us, unsigned int reg_num,
+                                     unsigned int value);
+
 // Result from OPL_Init(), indicating what type of OPL chip was detected,
 // if any.
 typedef enum
@@ -79,6 +85,11 @@ typedef enum
 
 opl_init_result_t OPL_Init(unsigned int port_base);
 
+// Make OPL_Init use the named driver, as the OPL_DRIVER environment
+// variable does (NULL = pick one automatically).
+
+void OPL_SelectDriver(char *name);
+
 // Shut down the OPL subsystem.
 
 void OPL_Shutdown(void);
@@ -151,5 +162,18 @@ void OPL_Delay(uint64_t us);
 
 void OPL_SetPaused(int paused);
 
+// With the offline "Render" driver (see OPL_SelectDriver), generate the
+// next nsamples stereo samples of output into buffer, invoking the
+// callbacks as they fall due.  Returns how many of the samples came
+// before the last callback left none behind it: nsamples while the
+// music plays, less once it has finished.
+
+unsigned int OPL_Render(int16_t *buffer, unsigned int nsamples);
+
+// Set a function to be called for each register written with the
+// "Render" driver, or NULL for none.
+
+void OPL_SetRenderTrace(opl_trace_callback_t callback);
+
 #endif
 
@@ -201,9 +201,6 @@ static const Bit8u ch_slot[18] = {
 // Envelope generator
 //
 
-typedef Bit16s(*envelope_sinfunc)(Bit16u phase, Bit16u envelope);
-typedef void(*envelope_genfunc)(opl3_slot *slott);
-
 static Bit16s OPL3_EnvelopeCalcExp(Bit32u level)
 {
     if (level > 0x1fff)
@@ -350,31 +347,6 @@ static Bit16s OPL3_EnvelopeCalcSin7(Bit16u phase, Bit16u envelope)
     return OPL3_EnvelopeCalcExp(out + (envelope << 3)) ^ neg;
 }
 
-static const envelope_sinfunc envelope_sin[8] = {
-    OPL3_EnvelopeCalcSin0,
-    OPL3_EnvelopeCalcSin1,
-    OPL3_EnvelopeCalcSin2,
-    OPL3_EnvelopeCalcSin3,
-    OPL3_EnvelopeCalcSin4,
-    OPL3_EnvelopeCalcSin5,
-    OPL3_EnvelopeCalcSin6,
-    OPL3_EnvelopeCalcSin7
-};
-
-static void OPL3_EnvelopeGenOff(opl3_slot *slot);
-static void OPL3_EnvelopeGenAttack(opl3_slot *slot);
-static void OPL3_EnvelopeGenDecay(opl3_slot *slot);
-static void OPL3_EnvelopeGenSustain(opl3_slot *slot);
-static void OPL3_EnvelopeGenRelease(opl3_slot *slot);
-
-envelope_genfunc envelope_gen[5] = {
-    OPL3_EnvelopeGenOff,
-    OPL3_EnvelopeGenAttack,
-    OPL3_EnvelopeGenDecay,
-    OPL3_EnvelopeGenSustain,
-    OPL3_EnvelopeGenRelease
-};
-
 enum envelope_gen_num
 {
     envelope_gen_num_off = 0,
@@ -409,115 +381,182 @@ static void OPL3_EnvelopeUpdateKSL(opl3_slot *slot)
         ksl = 0;
     }
     slot->eg_ksl = (Bit8u)ksl;
+    slot->chip->lanes.eg_tl[slot->slot_num] = (slot->reg_tl << 2)
+                                 + (slot->eg_ksl >> kslshift[slot->reg_ksl]);
 }
 
 static void OPL3_EnvelopeUpdateRate(opl3_slot *slot)
 {
-    switch (slot->eg_gen)
+    opl3_lanes *lanes = &slot->chip->lanes;
+    Bit8u n = slot->slot_num;
+
+    switch (lanes->eg_gen[n])
     {
     case envelope_gen_num_off:
     case envelope_gen_num_attack:
-        slot->eg_rate = OPL3_EnvelopeCalcRate(slot, slot->reg_ar);
+        lanes->eg_rate[n] = OPL3_EnvelopeCalcRate(slot, slot->reg_ar);
         break;
     case envelope_gen_num_decay:
-        slot->eg_rate = OPL3_EnvelopeCalcRate(slot, slot->reg_dr);
+        lanes->eg_rate[n] = OPL3_EnvelopeCalcRate(slot, slot->reg_dr);
         break;
     case envelope_gen_num_sustain:
     case envelope_gen_num_release:
-        slot->eg_rate = OPL3_EnvelopeCalcRate(slot, slot->reg_rr);
+        lanes->eg_rate[n] = OPL3_EnvelopeCalcRate(slot, slot->reg_rr);
         break;
     }
 }
 
-static void OPL3_EnvelopeGenOff(opl3_slot *slot)
-{
-    slot->eg_rout = 0x1ff;
-}
+// Move the envelope of a slot on to its next stage, once
+// OPL3_EnvelopeCalc has found that the current one is over.
 
-static void OPL3_EnvelopeGenAttack(opl3_slot *slot)
+static void OPL3_EnvelopeNextStage(opl3_slot *slot)
 {
-    if (slot->eg_rout == 0x00)
-    {
-        slot->eg_gen = envelope_gen_num_decay;
-        OPL3_EnvelopeUpdateRate(slot);
-        return;
-    }
-    slot->eg_rout += ((~slot->eg_rout) * slot->eg_inc) >> 3;
-    if (slot->eg_rout < 0x00)
+    opl3_lanes *lanes = &slot->chip->lanes;
+    Bit8u n = slot->slot_num;
+
+    switch (lanes->eg_gen[n])
     {
-        slot->eg_rout = 0x00;
+    case envelope_gen_num_attack:
+        lanes->eg_gen[n] = envelope_gen_num_decay;
+        break;
+    case envelope_gen_num_decay:
+        lanes->eg_gen[n] = envelope_gen_num_sustain;
+        break;
+    case envelope_gen_num_sustain:
+    case envelope_gen_num_release:
+        lanes->eg_gen[n] = envelope_gen_num_off;
+        break;
     }
+    OPL3_EnvelopeUpdateRate(slot);
 }
 
-static void OPL3_EnvelopeGenDecay(opl3_slot *slot)
+// The increment only depends on the rate and the timer, so rather
+// than working it out for each slot, fill in a table for all rates.
+
+static void OPL3_EnvelopeCalcInc(Bit16u timer, Bit16s *inc)
 {
-    if (slot->eg_rout >= slot->reg_sl << 4)
+    Bit8u rate_h, rate_l;
+    Bit8u step;
+    Bit8u shift;
+
+    memset(inc, 0, 64 * sizeof(*inc));
+    for (rate_h = 1; rate_h < 16; rate_h++)
     {
-        slot->eg_gen = envelope_gen_num_sustain;
-        OPL3_EnvelopeUpdateRate(slot);
-        return;
+        if (eg_incsh[rate_h] > 0)
+        {
+            if ((timer & ((1 << eg_incsh[rate_h]) - 1)) != 0)
+            {
+                continue;
+            }
+            step = (timer >> eg_incsh[rate_h]) & 0x07;
+            shift = 0;
+        }
+        else
+        {
+            step = timer & 0x07;
+            shift = -eg_incsh[rate_h];
+        }
+        for (rate_l = 0; rate_l < 4; rate_l++)
+        {
+            inc[(rate_h << 2) | rate_l] =
+                eg_incstep[eg_incdesc[rate_h]][rate_l][step] << shift;
+        }
     }
-    slot->eg_rout += slot->eg_inc;
 }
 
-static void OPL3_EnvelopeGenSustain(opl3_slot *slot)
+static void OPL3_EnvelopeCalc(opl3_chip *chip)
 {
-    if (!slot->reg_type)
+    opl3_lanes *lanes = &chip->lanes;
+    Bit16s inc_by_rate[64];
+    Bit16u tremolo = chip->tremolo;
+    Bit16u next = 0;
+    Bit8u i;
+
+    // Looking up the increment doesn't vectorize, so it gets a loop
+    // of its own.
+
+    OPL3_EnvelopeCalcInc(chip->timer, inc_by_rate);
+
+    for (i = 0; i < OPL_LANES; i++)
     {
-        OPL3_EnvelopeGenRelease(slot);
+        lanes->eg_inc[i] = inc_by_rate[lanes->eg_rate[i]];
     }
-}
 
-static void OPL3_EnvelopeGenRelease(opl3_slot *slot)
-{
-    if (slot->eg_rout >= 0x1ff)
+    for (i = 0; i < OPL_LANES; i++)
     {
-        slot->eg_gen = envelope_gen_num_off;
-        slot->eg_rout = 0x1ff;
-        OPL3_EnvelopeUpdateRate(slot);
-        return;
+        Bit16s rout = lanes->eg_rout[i];
+        Bit16s inc = lanes->eg_inc[i];
+        Bit16u gen = lanes->eg_gen[i];
+        Bit16s attack;
+        Bit16s linear;
+        Bit16u off, attacking, decaying, releasing;
+        Bit16u done, grow, stop;
+
+        lanes->eg_out[i] = rout + lanes->eg_tl[i]
+                         + (tremolo & lanes->eg_trem[i]);
+
+        // Work out every stage and keep the one the slot is in, using
+        // masks rather than branches.  Sustain behaves as release
+        // unless the envelope is sustaining.
+
+        off = -(gen == envelope_gen_num_off);
+        attacking = -(gen == envelope_gen_num_attack);
+        decaying = -(gen == envelope_gen_num_decay);
+        releasing = -((gen == envelope_gen_num_release)
+                    | ((gen == envelope_gen_num_sustain)
+                     & (lanes->eg_type[i] == 0)));
+
+        attack = rout + ((Bit16s)(~rout * inc) >> 3);
+        attack &= ~(attack >> 15);
+        linear = rout + inc;
+
+        done = (attacking & -(rout == 0x00))
+             | (decaying & -(rout >= lanes->eg_sl[i]))
+             | (releasing & -(rout >= 0x1ff));
+        grow = (decaying | releasing) & ~done;
+
+        stop = off | (releasing & done);
+
+        rout = (rout & ~grow) | (linear & grow);
+        rout = (rout & ~attacking) | (attack & attacking);
+        rout = (rout & ~stop) | (0x1ff & stop);
+
+        lanes->eg_rout[i] = rout;
+        lanes->eg_next[i] = done;
+        next |= done;
     }
-    slot->eg_rout += slot->eg_inc;
-}
 
-static void OPL3_EnvelopeCalc(opl3_slot *slot)
-{
-    Bit8u rate_h, rate_l;
-    Bit8u inc = 0;
-    rate_h = slot->eg_rate >> 2;
-    rate_l = slot->eg_rate & 3;
-    if (eg_incsh[rate_h] > 0)
+    // Changing stage means a new rate, which is rare enough to be
+    // left to the scalar code.
+
+    if (next)
     {
-        if ((slot->chip->timer & ((1 << eg_incsh[rate_h]) - 1)) == 0)
+        for (i = 0; i < 36; i++)
         {
-            inc = eg_incstep[eg_incdesc[rate_h]][rate_l]
-                            [((slot->chip->timer)>> eg_incsh[rate_h]) & 0x07];
+            if (lanes->eg_next[i])
+            {
+                OPL3_EnvelopeNextStage(&chip->slot[i]);
+            }
         }
     }
-    else
-    {
-        inc = eg_incstep[eg_incdesc[rate_h]][rate_l]
-                        [slot->chip->timer & 0x07] << (-eg_incsh[rate_h]);
-    }
-    slot->eg_inc = inc;
-    slot->eg_out = slot->eg_rout + (slot->reg_tl << 2)
-                 + (slot->eg_ksl >> kslshift[slot->reg_ksl]) + *slot->trem;
-    envelope_gen[slot->eg_gen](slot);
 }
 
 static void OPL3_EnvelopeKeyOn(opl3_slot *slot, Bit8u type)
 {
+    opl3_lanes *lanes = &slot->chip->lanes;
+    Bit8u n = slot->slot_num;
+
     if (!slot->key)
     {
-        slot->eg_gen = envelope_gen_num_attack;
+        lanes->eg_gen[n] = envelope_gen_num_attack;
         OPL3_EnvelopeUpdateRate(slot);
-        if ((slot->eg_rate >> 2) == 0x0f)
+        if ((lanes->eg_rate[n] >> 2) == 0x0f)
         {
-            slot->eg_gen = envelope_gen_num_decay;
+            lanes->eg_gen[n] = envelope_gen_num_decay;
             OPL3_EnvelopeUpdateRate(slot);
-            slot->eg_rout = 0x00;
+            lanes->eg_rout[n] = 0x00;
         }
-        slot->pg_phase = 0x00;
+        lanes->pg_phase[n] = 0x00;
     }
     slot->key |= type;
 }
@@ -529,7 +568,7 @@ static void OPL3_EnvelopeKeyOff(opl3_slot *slot, Bit8u type)
         slot->key &= (~type);
         if (!slot->key)
         {
-            slot->eg_gen = envelope_gen_num_release;
+            slot->chip->lanes.eg_gen[slot->slot_num] = envelope_gen_num_release;
             OPL3_EnvelopeUpdateRate(slot);
         }
     }
@@ -539,38 +578,40 @@ static void OPL3_EnvelopeKeyOff(opl3_slot *slot, Bit8u type)
 // Phase Generator
 //
 
-static void OPL3_PhaseGenerate(opl3_slot *slot)
+static void OPL3_PhaseUpdateFreq(opl3_slot *slot)
 {
-    Bit16u f_num;
-    Bit32u basefreq;
+    opl3_lanes *lanes = &slot->chip->lanes;
 
-    f_num = slot->channel->f_num;
-    if (slot->reg_vib)
-    {
-        Bit8s range;
-        Bit8u vibpos;
+    lanes->pg_fnum[slot->slot_num] = slot->channel->f_num;
+    lanes->pg_block[slot->slot_num] = 1 << slot->channel->block;
+}
 
-        range = (f_num >> 7) & 7;
-        vibpos = slot->chip->vibpos;
+static void OPL3_PhaseGenerate(opl3_chip *chip)
+{
+    opl3_lanes *lanes = &chip->lanes;
+    Bit32u vibmask;
+    Bit32u vibshift;
+    Bit32u vibneg;
+    Bit8u i;
 
-        if (!(vibpos & 3))
-        {
-            range = 0;
-        }
-        else if (vibpos & 1)
-        {
-            range >>= 1;
-        }
-        range >>= slot->chip->vibshift;
+    // The vibrato position is the same for every slot.
 
-        if (vibpos & 4)
-        {
-            range = -range;
-        }
-        f_num += range;
+    vibmask = (chip->vibpos & 3) ? 7 : 0;
+    vibshift = (chip->vibpos & 1) + chip->vibshift;
+    vibneg = (chip->vibpos & 4) ? ~0 : 0;
+
+    for (i = 0; i < OPL_LANES; i++)
+    {
+        Bit32u f_num;
+        Bit32u range;
+        Bit32u basefreq;
+
+        f_num = lanes->pg_fnum[i];
+        range = (((f_num >> 7) & vibmask) >> vibshift) & lanes->pg_vib[i];
+        f_num += (range ^ vibneg) - vibneg;
+        basefreq = (f_num * lanes->pg_block[i]) >> 1;
+        lanes->pg_phase[i] += (basefreq * lanes->pg_mult[i]) >> 1;
     }
-    basefreq = (f_num << slot->channel->block) >> 1;
-    slot->pg_phase += (basefreq * mt[slot->reg_mult]) >> 1;
 }
 
 //
@@ -592,18 +633,24 @@ static void OPL3_NoiseGenerate(opl3_chip *chip)
 
 static void OPL3_SlotWrite20(opl3_slot *slot, Bit8u data)
 {
+    opl3_lanes *lanes = &slot->chip->lanes;
+    Bit8u n = slot->slot_num;
+
     if ((data >> 7) & 0x01)
     {
-        slot->trem = &slot->chip->tremolo;
+        lanes->eg_trem[n] = 0xff;
     }
     else
     {
-        slot->trem = (Bit8u*)&slot->chip->zeromod;
+        lanes->eg_trem[n] = 0x00;
     }
     slot->reg_vib = (data >> 6) & 0x01;
     slot->reg_type = (data >> 5) & 0x01;
     slot->reg_ksr = (data >> 4) & 0x01;
     slot->reg_mult = data & 0x0f;
+    lanes->pg_vib[n] = slot->reg_vib ? ~0 : 0;
+    lanes->pg_mult[n] = mt[slot->reg_mult];
+    lanes->eg_type[n] = slot->reg_type;
     OPL3_EnvelopeUpdateRate(slot);
 }
 
@@ -628,6 +675,7 @@ static void OPL3_SlotWrite80(opl3_slot *slot, Bit8u data)
     {
         slot->reg_sl = 0x1f;
     }
+    slot->chip->lanes.eg_sl[slot->slot_num] = slot->reg_sl << 4;
     slot->reg_rr = data & 0x0f;
     OPL3_EnvelopeUpdateRate(slot);
 }
@@ -643,17 +691,49 @@ static void OPL3_SlotWriteE0(opl3_slot *slot, Bit8u data)
 
 static void OPL3_SlotGeneratePhase(opl3_slot *slot, Bit16u phase)
 {
-    slot->out = envelope_sin[slot->reg_wf](phase, slot->eg_out);
+    Bit16u envelope = slot->chip->lanes.eg_out[slot->slot_num];
+
+    switch (slot->reg_wf)
+    {
+    case 0:
+        slot->out = OPL3_EnvelopeCalcSin0(phase, envelope);
+        break;
+    case 1:
+        slot->out = OPL3_EnvelopeCalcSin1(phase, envelope);
+        break;
+    case 2:
+        slot->out = OPL3_EnvelopeCalcSin2(phase, envelope);
+        break;
+    case 3:
+        slot->out = OPL3_EnvelopeCalcSin3(phase, envelope);
+        break;
+    case 4:
+        slot->out = OPL3_EnvelopeCalcSin4(phase, envelope);
+        break;
+    case 5:
+        slot->out = OPL3_EnvelopeCalcSin5(phase, envelope);
+        break;
+    case 6:
+        slot->out = OPL3_EnvelopeCalcSin6(phase, envelope);
+        break;
+    case 7:
+        slot->out = OPL3_EnvelopeCalcSin7(phase, envelope);
+        break;
+    }
 }
 
 static void OPL3_SlotGenerate(opl3_slot *slot)
 {
-    OPL3_SlotGeneratePhase(slot, (Bit16u)(slot->pg_phase >> 9) + *slot->mod);
+    Bit32u pg_phase = slot->chip->lanes.pg_phase[slot->slot_num];
+
+    OPL3_SlotGeneratePhase(slot, (Bit16u)(pg_phase >> 9) + *slot->mod);
 }
 
 static void OPL3_SlotGenerateZM(opl3_slot *slot)
 {
-    OPL3_SlotGeneratePhase(slot, (Bit16u)(slot->pg_phase >> 9));
+    Bit32u pg_phase = slot->chip->lanes.pg_phase[slot->slot_num];
+
+    OPL3_SlotGeneratePhase(slot, (Bit16u)(pg_phase >> 9));
 }
 
 static void OPL3_SlotCalcFB(opl3_slot *slot)
@@ -778,6 +858,8 @@ static void OPL3_ChannelWriteA0(opl3_channel *channel, Bit8u data)
     OPL3_EnvelopeUpdateKSL(channel->slots[1]);
     OPL3_EnvelopeUpdateRate(channel->slots[0]);
     OPL3_EnvelopeUpdateRate(channel->slots[1]);
+    OPL3_PhaseUpdateFreq(channel->slots[0]);
+    OPL3_PhaseUpdateFreq(channel->slots[1]);
     if (channel->chip->newm && channel->chtype == ch_4op)
     {
         channel->pair->f_num = channel->f_num;
@@ -786,6 +868,8 @@ static void OPL3_ChannelWriteA0(opl3_channel *channel, Bit8u data)
         OPL3_EnvelopeUpdateKSL(channel->pair->slots[1]);
         OPL3_EnvelopeUpdateRate(channel->pair->slots[0]);
         OPL3_EnvelopeUpdateRate(channel->pair->slots[1]);
+        OPL3_PhaseUpdateFreq(channel->pair->slots[0]);
+        OPL3_PhaseUpdateFreq(channel->pair->slots[1]);
     }
 }
 
@@ -803,6 +887,8 @@ static void OPL3_ChannelWriteB0(opl3_channel *channel, Bit8u data)
     OPL3_EnvelopeUpdateKSL(channel->slots[1]);
     OPL3_EnvelopeUpdateRate(channel->slots[0]);
     OPL3_EnvelopeUpdateRate(channel->slots[1]);
+    OPL3_PhaseUpdateFreq(channel->slots[0]);
+    OPL3_PhaseUpdateFreq(channel->slots[1]);
     if (channel->chip->newm && channel->chtype == ch_4op)
     {
         channel->pair->f_num = channel->f_num;
@@ -812,6 +898,8 @@ static void OPL3_ChannelWriteB0(opl3_channel *channel, Bit8u data)
         OPL3_EnvelopeUpdateKSL(channel->pair->slots[1]);
         OPL3_EnvelopeUpdateRate(channel->pair->slots[0]);
         OPL3_EnvelopeUpdateRate(channel->pair->slots[1]);
+        OPL3_PhaseUpdateFreq(channel->pair->slots[0]);
+        OPL3_PhaseUpdateFreq(channel->pair->slots[1]);
     }
 }
 
@@ -1034,7 +1122,7 @@ static Bit16s OPL3_ClipSample(Bit32s sample)
     return (Bit16s)sample;
 }
 
-static void OPL3_GenerateRhythm1(opl3_chip *chip)
+static void OPL3_GenerateRhythm1(opl3_chip *chip, Bit32u pg_phase17)
 {
     opl3_channel *channel6;
     opl3_channel *channel7;
@@ -1048,8 +1136,8 @@ static void OPL3_GenerateRhythm1(opl3_chip *chip)
     channel7 = &chip->channel[7];
     channel8 = &chip->channel[8];
     OPL3_SlotGenerate(channel6->slots[0]);
-    phase14 = (channel7->slots[0]->pg_phase >> 9) & 0x3ff;
-    phase17 = (channel8->slots[1]->pg_phase >> 9) & 0x3ff;
+    phase14 = (chip->lanes.pg_phase[channel7->slots[0]->slot_num] >> 9) & 0x3ff;
+    phase17 = (pg_phase17 >> 9) & 0x3ff;
     phase = 0x00;
     //hh tc phase bit
     phasebit = ((phase14 & 0x08) | (((phase14 >> 5) ^ phase14) & 0x04)
@@ -1076,8 +1164,8 @@ static void OPL3_GenerateRhythm2(opl3_chip *chip)
     channel7 = &chip->channel[7];
     channel8 = &chip->channel[8];
     OPL3_SlotGenerate(channel6->slots[1]);
-    phase14 = (channel7->slots[0]->pg_phase >> 9) & 0x3ff;
-    phase17 = (channel8->slots[1]->pg_phase >> 9) & 0x3ff;
+    phase14 = (chip->lanes.pg_phase[channel7->slots[0]->slot_num] >> 9) & 0x3ff;
+    phase17 = (chip->lanes.pg_phase[channel8->slots[1]->slot_num] >> 9) & 0x3ff;
     phase = 0x00;
     //hh tc phase bit
     phasebit = ((phase14 & 0x08) | (((phase14 >> 5) ^ phase14) & 0x04)
@@ -1095,27 +1183,33 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
     Bit8u ii;
     Bit8u jj;
     Bit16s accm;
+    Bit32u pg_phase17;
 
     buf[1] = OPL3_ClipSample(chip->mixbuff[1]);
 
+    // The phase and envelope generators of every slot only depend on
+    // the slot itself, so they are run for all slots up front.  The
+    // hi-hat is generated before the phase of slot 17 is advanced,
+    // though, so it gets the old value.
+
+    pg_phase17 = chip->lanes.pg_phase[17];
+    OPL3_PhaseGenerate(chip);
+    OPL3_EnvelopeCalc(chip);
+
     for (ii = 0; ii < 12; ii++)
     {
         OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
         OPL3_SlotGenerate(&chip->slot[ii]);
     }
 
     for (ii = 12; ii < 15; ii++)
     {
         OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
     }
 
     if (chip->rhy & 0x20)
     {
-        OPL3_GenerateRhythm1(chip);
+        OPL3_GenerateRhythm1(chip, pg_phase17);
     }
     else
     {
@@ -1138,8 +1232,6 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
     for (ii = 15; ii < 18; ii++)
     {
         OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
     }
 
     if (chip->rhy & 0x20)
@@ -1158,8 +1250,6 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
     for (ii = 18; ii < 33; ii++)
     {
         OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
         OPL3_SlotGenerate(&chip->slot[ii]);
     }
 
@@ -1177,8 +1267,6 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
     for (ii = 33; ii < 36; ii++)
     {
         OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
         OPL3_SlotGenerate(&chip->slot[ii]);
     }
 
@@ -1238,16 +1326,22 @@ void OPL3_Reset(opl3_chip *chip, Bit32u samplerate)
 {
     Bit8u slotnum;
     Bit8u channum;
+    Bit8u lane;
 
     memset(chip, 0, sizeof(opl3_chip));
+    for (lane = 0; lane < OPL_LANES; lane++)
+    {
+        chip->lanes.pg_block[lane] = 1;
+        chip->lanes.pg_mult[lane] = mt[0];
+        chip->lanes.eg_rout[lane] = 0x1ff;
+        chip->lanes.eg_out[lane] = 0x1ff;
+        chip->lanes.eg_gen[lane] = envelope_gen_num_off;
+    }
     for (slotnum = 0; slotnum < 36; slotnum++)
     {
         chip->slot[slotnum].chip = chip;
+        chip->slot[slotnum].slot_num = slotnum;
         chip->slot[slotnum].mod = &chip->zeromod;
-        chip->slot[slotnum].eg_rout = 0x1ff;
-        chip->slot[slotnum].eg_out = 0x1ff;
-        chip->slot[slotnum].eg_gen = envelope_gen_num_off;
-        chip->slot[slotnum].trem = (Bit8u*)&chip->zeromod;
     }
     for (channum = 0; channum < 18; channum++)
     {
@@ -50,20 +50,42 @@ typedef struct _opl3_slot opl3_slot;
 typedef struct _opl3_channel opl3_channel;
 typedef struct _opl3_chip opl3_chip;
 
+// Envelope and phase generator state of the slots.  Unlike the
+// operator output, these don't depend on any other slot, so they are
+// kept as arrays with one lane per slot and worked out for all slots
+// at once, which the compiler can turn into SSE2/NEON code.  The
+// arrays are padded to a whole number of 128-bit vectors; the padding
+// lanes are never keyed on.
+
+#define OPL_LANES 40
+
+typedef struct _opl3_lanes {
+    Bit32u pg_phase[OPL_LANES];
+    Bit32u pg_fnum[OPL_LANES];
+    Bit32u pg_block[OPL_LANES];     // 1 << block
+    Bit32u pg_mult[OPL_LANES];      // Frequency multiplier times 2
+    Bit32u pg_vib[OPL_LANES];       // ~0 if vibrato is on
+    Bit16s eg_rout[OPL_LANES];
+    Bit16s eg_out[OPL_LANES];
+    Bit16s eg_inc[OPL_LANES];
+    Bit16s eg_tl[OPL_LANES];        // Total level plus key scale level
+    Bit16s eg_sl[OPL_LANES];        // Sustain level
+    Bit16u eg_trem[OPL_LANES];      // 0xff if tremolo is on
+    Bit16u eg_type[OPL_LANES];      // Sustaining envelope
+    Bit16u eg_gen[OPL_LANES];
+    Bit16u eg_rate[OPL_LANES];
+    Bit16u eg_next[OPL_LANES];      // Envelope moves to the next stage
+} opl3_lanes;
+
 struct _opl3_slot {
     opl3_channel *channel;
     opl3_chip *chip;
+    Bit8u slot_num;
     Bit16s out;
     Bit16s fbmod;
     Bit16s *mod;
     Bit16s prout;
-    Bit16s eg_rout;
-    Bit16s eg_out;
-    Bit8u eg_inc;
-    Bit8u eg_gen;
-    Bit8u eg_rate;
     Bit8u eg_ksl;
-    Bit8u *trem;
     Bit8u reg_vib;
     Bit8u reg_type;
     Bit8u reg_ksr;
@@ -76,7 +98,6 @@ struct _opl3_slot {
     Bit8u reg_rr;
     Bit8u reg_wf;
     Bit8u key;
-    Bit32u pg_phase;
     Bit32u timer;
 };
 
@@ -104,6 +125,7 @@ typedef struct _opl3_writebuf {
 struct _opl3_chip {
     opl3_channel channel[18];
     opl3_slot slot[36];
+    opl3_lanes lanes;
     Bit16u timer;
     Bit8u newm;
     Bit8u nts;
@@ -0,0 +1,313 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     OPL offline rendering interface.  The emulator output is not
+//     played, but generated on request by OPL_Render, on the calling
+//     thread and as fast as it will go, e.g. to write music to a file.
+//     Time only passes while rendering, and callbacks are invoked
+//     from OPL_Render, so no locking is needed.
+//
+
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "opl3.h"
+
+#include "opl.h"
+#include "opl_internal.h"
+
+#include "opl_queue.h"
+
+static int render_initialized = 0;
+
+// Queue of callbacks waiting to be invoked.
+
+static opl_callback_queue_t *callback_queue;
+
+// Current time, in us since startup:
+
+static uint64_t current_time;
+
+// If non-zero, playback is currently paused.
+
+static int render_paused;
+
+// Time offset (in us) due to the fact that callbacks
+// were previously paused.
+
+static uint64_t pause_offset;
+
+// OPL software emulator structure.
+
+static opl3_chip opl_chip;
+static unsigned int render_freq;
+
+// Register number that was written.
+
+static int register_num = 0;
+
+// Timers.  They are only used to detect the chip, and as no time
+// passes outside of OPL_Render, they expire as soon as they are
+// started.
+
+static int timer1_enabled, timer2_enabled;
+
+// Function called for each register write, if set.
+
+static opl_trace_callback_t render_trace = NULL;
+
+static int OPL_Render_Init(unsigned int port_base)
+{
+    callback_queue = OPL_Queue_Create();
+    current_time = 0;
+    render_paused = 0;
+    pause_offset = 0;
+
+    render_freq = opl_sample_rate;
+    OPL3_Reset(&opl_chip, render_freq);
+
+    timer1_enabled = 0;
+    timer2_enabled = 0;
+
+    render_initialized = 1;
+
+    return 1;
+}
+
+static void OPL_Render_Shutdown(void)
+{
+    if (render_initialized)
+    {
+        OPL_Queue_Destroy(callback_queue);
+        render_initialized = 0;
+    }
+}
+
+static unsigned int OPL_Render_PortRead(opl_port_t port)
+{
+    unsigned int result = 0;
+
+    if (port == OPL_REGISTER_PORT_OPL3)
+    {
+        return 0xff;
+    }
+
+    if (timer1_enabled)
+    {
+        result |= 0x80;   // Either have expired
+        result |= 0x40;   // Timer 1 has expired
+    }
+
+    if (timer2_enabled)
+    {
+        result |= 0x80;   // Either have expired
+        result |= 0x20;   // Timer 2 has expired
+    }
+
+    return result;
+}
+
+static void WriteRegister(unsigned int reg_num, unsigned int value)
+{
+    if (render_trace != NULL)
+    {
+        render_trace(current_time, reg_num, value);
+    }
+
+    switch (reg_num)
+    {
+        case OPL_REG_TIMER1:
+        case OPL_REG_TIMER2:
+            break;
+
+        case OPL_REG_TIMER_CTRL:
+            if (value & 0x80)
+            {
+                timer1_enabled = 0;
+                timer2_enabled = 0;
+            }
+            else
+            {
+                if ((value & 0x40) == 0)
+                {
+                    timer1_enabled = (value & 0x01) != 0;
+                }
+
+                if ((value & 0x20) == 0)
+                {
+                    timer2_enabled = (value & 0x02) != 0;
+                }
+            }
+
+            break;
+
+        default:
+            OPL3_WriteRegBuffered(&opl_chip, reg_num, value);
+            break;
+    }
+}
+
+static void OPL_Render_PortWrite(opl_port_t port, unsigned int value)
+{
+    if (port == OPL_REGISTER_PORT)
+    {
+        register_num = value;
+    }
+    else if (port == OPL_REGISTER_PORT_OPL3)
+    {
+        register_num = value | 0x100;
+    }
+    else if (port == OPL_DATA_PORT)
+    {
+        WriteRegister(register_num, value);
+    }
+}
+
+static void OPL_Render_SetCallback(uint64_t us, opl_callback_t callback,
+                                   void *data)
+{
+    OPL_Queue_Push(callback_queue, callback, data,
+                   current_time - pause_offset + us);
+}
+
+static void OPL_Render_ClearCallbacks(void)
+{
+    OPL_Queue_Clear(callback_queue);
+}
+
+static void OPL_Render_Lock(void)
+{
+}
+
+static void OPL_Render_Unlock(void)
+{
+}
+
+static void OPL_Render_SetPaused(int paused)
+{
+    render_paused = paused;
+}
+
+static void OPL_Render_AdjustCallbacks(float factor)
+{
+    OPL_Queue_AdjustCallbacks(callback_queue, current_time, factor);
+}
+
+// Advance time by the specified number of samples, invoking any
+// callback functions as appropriate.
+
+static void AdvanceTime(unsigned int nsamples)
+{
+    opl_callback_t callback;
+    void *callback_data;
+    uint64_t us;
+
+    us = ((uint64_t) nsamples * OPL_SECOND) / render_freq;
+    current_time += us;
+
+    if (render_paused)
+    {
+        pause_offset += us;
+    }
+
+    while (!OPL_Queue_IsEmpty(callback_queue)
+        && current_time >= OPL_Queue_Peek(callback_queue) + pause_offset)
+    {
+        if (!OPL_Queue_Pop(callback_queue, &callback, &callback_data))
+        {
+            break;
+        }
+
+        callback(callback_data);
+    }
+}
+
+unsigned int OPL_Render(int16_t *buffer, unsigned int nsamples)
+{
+    unsigned int filled = 0;
+    unsigned int played = 0;
+    int finished;
+
+    if (!render_initialized)
+    {
+        return 0;
+    }
+
+    finished = OPL_Queue_IsEmpty(callback_queue);
+
+    // Generate up to each callback in turn, as the SDL driver does
+    // with its mixing buffer.
+
+    while (filled < nsamples)
+    {
+        uint64_t next_callback_time;
+        uint64_t n;
+
+        if (render_paused || OPL_Queue_IsEmpty(callback_queue))
+        {
+            n = nsamples - filled;
+        }
+        else
+        {
+            next_callback_time = OPL_Queue_Peek(callback_queue) + pause_offset;
+
+            n = (next_callback_time - current_time) * render_freq;
+            n = (n + OPL_SECOND - 1) / OPL_SECOND;
+
+            if (n > nsamples - filled)
+            {
+                n = nsamples - filled;
+            }
+        }
+
+        OPL3_GenerateStream(&opl_chip, buffer + filled * 2, n);
+        filled += n;
+
+        AdvanceTime(n);
+
+        // Note where the last callback was invoked.
+
+        if (!finished && OPL_Queue_IsEmpty(callback_queue))
+        {
+            finished = 1;
+            played = filled;
+        }
+    }
+
+    return finished ? played : nsamples;
+}
+
+void OPL_SetRenderTrace(opl_trace_callback_t callback)
+{
+    render_trace = callback;
+}
+
+opl_driver_t opl_render_driver =
+{
+    "Render",
+    OPL_Render_Init,
+    OPL_Render_Shutdown,
+    OPL_Render_PortRead,
+    OPL_Render_PortWrite,
+    OPL_Render_SetCallback,
+    OPL_Render_ClearCallbacks,
+    OPL_Render_Lock,
+    OPL_Render_Unlock,
+    OPL_Render_SetPaused,
+    OPL_Render_AdjustCallbacks,
+};
+
@@ -45,19 +45,53 @@ typedef struct
     uint64_t expire_time;     // Calculated time that timer will expire.
 } opl_timer_t;
 
+// Register writes and callback changes made by the thread driving the
+// music are passed to the mixer thread through a ring of commands, so
+// that the mixer never has to wait for that thread.  There is a single
+// producer and a single consumer: the producer only moves the tail and
+// the mixer only moves the head.  The callbacks themselves run on the
+// mixer thread, and act directly.
+
+typedef enum
+{
+    COMMAND_WRITE_REGISTER,
+    COMMAND_SET_CALLBACK,
+    COMMAND_CLEAR_CALLBACKS,
+    COMMAND_ADJUST_CALLBACKS,
+} opl_command_type_t;
+
+typedef struct
+{
+    opl_command_type_t type;
+    unsigned int reg_num;
+    unsigned int value;
+    uint64_t us;
+    opl_callback_t callback;
+    void *data;
+    float factor;
+} opl_command_t;
+
+#define COMMAND_QUEUE_SIZE 4096
+
+static opl_command_t command_queue[COMMAND_QUEUE_SIZE];
+static SDL_atomic_t command_head, command_tail;
+
+// Thread the mix callback runs on.
+
+static SDL_threadID mixer_thread;
+
 // When the callback mutex is locked using OPL_Lock, callback functions
-// are not invoked.
+// are not invoked.  The mixer does not wait for it, but leaves the
+// callbacks that are due until after the rest of the buffer.
 
 static SDL_mutex *callback_mutex = NULL;
+static int callbacks_blocked;
 
-// Queue of callbacks waiting to be invoked.
+// Queue of callbacks waiting to be invoked.  Only used by the mixer
+// thread.
 
 static opl_callback_queue_t *callback_queue;
 
-// Mutex used to control access to the callback queue.
-
-static SDL_mutex *callback_queue_mutex = NULL;
-
 // Current time, in us since startup:
 
 static uint64_t current_time;
@@ -80,9 +114,11 @@ static int opl_opl3mode;
 
 static int32_t *mix_buffer = NULL;
 
-// Register number that was written.
+// Register number that was written, by the mixer thread and by the
+// thread driving the music.
 
 static int register_num = 0;
+static int mixer_register_num = 0;
 
 // Timers; DBOPL does not do timer stuff itself.
 
@@ -103,6 +139,74 @@ static int SDLIsInitialized(void)
     return Mix_QuerySpec(&freq, &format, &channels);
 }
 
+static int InMixerThread(void)
+{
+    return SDL_ThreadID() == mixer_thread;
+}
+
+// Called by the thread driving the music to pass a command to the mixer.
+
+static void PushCommand(opl_command_t *command)
+{
+    int tail, new_tail;
+
+    tail = SDL_AtomicAdd(&command_tail, 0);
+    new_tail = (tail + 1) % COMMAND_QUEUE_SIZE;
+
+    // The mixer empties the queue every slice, so if it is full,
+    // just wait for it.
+
+    while (new_tail == SDL_AtomicAdd(&command_head, 0))
+    {
+        SDL_Delay(1);
+    }
+
+    command_queue[tail] = *command;
+    SDL_AtomicSet(&command_tail, new_tail);
+}
+
+static void RunCommand(opl_command_t *command)
+{
+    switch (command->type)
+    {
+        case COMMAND_WRITE_REGISTER:
+            OPL3_WriteRegBuffered(&opl_chip, command->reg_num,
+                                  command->value);
+            break;
+
+        case COMMAND_SET_CALLBACK:
+            OPL_Queue_Push(callback_queue, command->callback, command->data,
+                           current_time - pause_offset + command->us);
+            break;
+
+        case COMMAND_CLEAR_CALLBACKS:
+            OPL_Queue_Clear(callback_queue);
+            break;
+
+        case COMMAND_ADJUST_CALLBACKS:
+            OPL_Queue_AdjustCallbacks(callback_queue, current_time,
+                                      command->factor);
+            break;
+    }
+}
+
+// Run the commands that have been queued for the mixer thread.
+
+static void RunCommands(void)
+{
+    int head;
+
+    head = SDL_AtomicAdd(&command_head, 0);
+
+    while (head != SDL_AtomicAdd(&command_tail, 0))
+    {
+        RunCommand(&command_queue[head]);
+
+        head = (head + 1) % COMMAND_QUEUE_SIZE;
+        SDL_AtomicSet(&command_head, head);
+    }
+}
+
 // Advance time by the specified number of samples, invoking any
 // callback functions as appropriate.
 
@@ -112,8 +216,6 @@ static void AdvanceTime(unsigned int nsamples)
     void *callback_data;
     uint64_t us;
 
-    SDL_LockMutex(callback_queue_mutex);
-
     // Advance time.
 
     us = ((uint64_t) nsamples * OPL_SECOND) / mixing_freq;
@@ -130,30 +232,33 @@ static void AdvanceTime(unsigned int nsamples)
     while (!OPL_Queue_IsEmpty(callback_queue)
         && current_time >= OPL_Queue_Peek(callback_queue) + pause_offset)
     {
-        // Pop the callback from the queue to invoke it.
+        // We must hold callback_mutex when we invoke the callback, so
+        // that the control thread can use OPL_Lock() to prevent
+        // callbacks from being invoked.  If it is holding it, don't
+        // wait, but try again after the next slice.
 
-        if (!OPL_Queue_Pop(callback_queue, &callback, &callback_data))
+        if (SDL_TryLockMutex(callback_mutex) != 0)
         {
+            callbacks_blocked = 1;
             break;
         }
 
-        // The mutex stuff here is a bit complicated.  We must
-        // hold callback_mutex when we invoke the callback (so that
-        // the control thread can use OPL_Lock() to prevent callbacks
-        // from being invoked), but we must not be holding
-        // callback_queue_mutex, as the callback must be able to
-        // call OPL_SetCallback to schedule new callbacks.
+        // Whatever was queued while the lock was held comes first:
+        // stopping a song clears its callbacks.
+
+        RunCommands();
 
-        SDL_UnlockMutex(callback_queue_mutex);
+        if (OPL_Queue_IsEmpty(callback_queue)
+         || current_time < OPL_Queue_Peek(callback_queue) + pause_offset
+         || !OPL_Queue_Pop(callback_queue, &callback, &callback_data))
+        {
+            SDL_UnlockMutex(callback_mutex);
+            break;
+        }
 
-        SDL_LockMutex(callback_mutex);
         callback(callback_data);
         SDL_UnlockMutex(callback_mutex);
-
-        SDL_LockMutex(callback_queue_mutex);
     }
-
-    SDL_UnlockMutex(callback_queue_mutex);
 }
 
 // Call the OPL emulator code to fill the specified buffer.
@@ -184,6 +289,9 @@ static void OPL_Mix_Callback(void *udata,
     buffer = (int16_t *) byte_buffer;
     buffer_len = buffer_bytes / 4;
 
+    mixer_thread = SDL_ThreadID();
+    callbacks_blocked = 0;
+
     // Repeatedly call the OPL emulator update function until the buffer is
     // full.
 
@@ -192,13 +300,17 @@ static void OPL_Mix_Callback(void *udata,
         uint64_t next_callback_time;
         uint64_t nsamples;
 
-        SDL_LockMutex(callback_queue_mutex);
+        // Pick up any register writes and callbacks from the thread
+        // driving the music.
+
+        RunCommands();
 
         // Work out the time until the next callback waiting in
         // the callback queue must be invoked.  We can then fill the
         // buffer with this many samples.
 
-        if (opl_sdl_paused || OPL_Queue_IsEmpty(callback_queue))
+        if (opl_sdl_paused || callbacks_blocked
+         || OPL_Queue_IsEmpty(callback_queue))
         {
             nsamples = buffer_len - filled;
         }
@@ -215,8 +327,6 @@ static void OPL_Mix_Callback(void *udata,
             }
         }
 
-        SDL_UnlockMutex(callback_queue_mutex);
-
         // Add emulator output to buffer.
 
         FillBuffer(buffer + filled * 2, nsamples);
@@ -255,11 +365,10 @@ static void OPL_SDL_Shutdown(void)
         callback_mutex = NULL;
     }
 
-    if (callback_queue_mutex != NULL)
-    {
-        SDL_DestroyMutex(callback_queue_mutex);
-        callback_queue_mutex = NULL;
-    }
+    // Forget anything the mixer did not get to.
+
+    SDL_AtomicSet(&command_head, 0);
+    SDL_AtomicSet(&command_tail, 0);
 }
 
 static unsigned int GetSliceSize(void)
@@ -353,7 +462,6 @@ static int OPL_SDL_Init(unsigned int port_base)
     opl_opl3mode = 0;
 
     callback_mutex = SDL_CreateMutex();
-    callback_queue_mutex = SDL_CreateMutex();
 
     // TODO: This should be music callback? or-?
     Mix_HookMusic(OPL_Mix_Callback, NULL);
@@ -400,6 +508,27 @@ static void OPLTimer_CalculateEndTime(opl_timer_t *timer)
     }
 }
 
+// The chip itself is only written by the mixer thread; the timers are
+// just used for detecting the chip, and are handled here.
+
+static void WriteChipRegister(unsigned int reg_num, unsigned int value)
+{
+    opl_command_t command;
+
+    command.type = COMMAND_WRITE_REGISTER;
+    command.reg_num = reg_num;
+    command.value = value;
+
+    if (InMixerThread())
+    {
+        RunCommand(&command);
+    }
+    else
+    {
+        PushCommand(&command);
+    }
+}
+
 static void WriteRegister(unsigned int reg_num, unsigned int value)
 {
     switch (reg_num)
@@ -441,41 +570,65 @@ static void WriteRegister(unsigned int reg_num, unsigned int value)
             opl_opl3mode = value & 0x01;
 
         default:
-            OPL3_WriteRegBuffered(&opl_chip, reg_num, value);
+            WriteChipRegister(reg_num, value);
             break;
     }
 }
 
 static void OPL_SDL_PortWrite(opl_port_t port, unsigned int value)
 {
+    int *reg_num;
+
+    reg_num = InMixerThread() ? &mixer_register_num : &register_num;
+
     if (port == OPL_REGISTER_PORT)
     {
-        register_num = value;
+        *reg_num = value;
     }
     else if (port == OPL_REGISTER_PORT_OPL3)
     {
-        register_num = value | 0x100;
+        *reg_num = value | 0x100;
     }
     else if (port == OPL_DATA_PORT)
     {
-        WriteRegister(register_num, value);
+        WriteRegister(*reg_num, value);
     }
 }
 
 static void OPL_SDL_SetCallback(uint64_t us, opl_callback_t callback,
                                 void *data)
 {
-    SDL_LockMutex(callback_queue_mutex);
-    OPL_Queue_Push(callback_queue, callback, data,
-                   current_time - pause_offset + us);
-    SDL_UnlockMutex(callback_queue_mutex);
+    opl_command_t command;
+
+    command.type = COMMAND_SET_CALLBACK;
+    command.us = us;
+    command.callback = callback;
+    command.data = data;
+
+    if (InMixerThread())
+    {
+        RunCommand(&command);
+    }
+    else
+    {
+        PushCommand(&command);
+    }
 }
 
 static void OPL_SDL_ClearCallbacks(void)
 {
-    SDL_LockMutex(callback_queue_mutex);
-    OPL_Queue_Clear(callback_queue);
-    SDL_UnlockMutex(callback_queue_mutex);
+    opl_command_t command;
+
+    command.type = COMMAND_CLEAR_CALLBACKS;
+
+    if (InMixerThread())
+    {
+        RunCommand(&command);
+    }
+    else
+    {
+        PushCommand(&command);
+    }
 }
 
 static void OPL_SDL_Lock(void)
@@ -495,9 +648,19 @@ static void OPL_SDL_SetPaused(int paused)
 
 static void OPL_SDL_AdjustCallbacks(float factor)
 {
-    SDL_LockMutex(callback_queue_mutex);
-    OPL_Queue_AdjustCallbacks(callback_queue, current_time, factor);
-    SDL_UnlockMutex(callback_queue_mutex);
+    opl_command_t command;
+
+    command.type = COMMAND_ADJUST_CALLBACKS;
+    command.factor = factor;
+
+    if (InMixerThread())
+    {
+        RunCommand(&command);
+    }
+    else
+    {
+        PushCommand(&command);
+    }
 }
 
 opl_driver_t opl_sdl_driver =
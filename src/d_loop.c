@@ -475,6 +475,19 @@ boolean D_InitNetGame(net_connect_data_t *connect_data)
         NET_SV_AddModule(&net_sdl_module);
         NET_SV_RegisterWithMaster();
 
+        //!
+        // @category net
+        //
+        // When running a server, run it on a thread of its own, so
+        // that it keeps serving the other players while the game is
+        // busy drawing or loading.
+        //
+
+        if (M_CheckParm("-serverthread") > 0)
+        {
+            NET_SV_StartThread();
+        }
+
         net_loop_client_module.InitClient();
         addr = net_loop_client_module.ResolveAddress(NULL);
     }
@@ -530,6 +543,15 @@ boolean D_InitNetGame(net_connect_data_t *connect_data)
             connect_data->drone = true;
         }
 
+        //!
+        // @category net
+        //
+        // Send and receive game data in the older, unpacked encoding,
+        // one tic per packet from the server.
+        //
+
+        connect_data->packed_tics = !M_ParmExists("-nopackedtics");
+
         if (!NET_CL_Connect(addr, connect_data))
         {
 			// "D_InitNetGame: Failed to connect to %s\n"
@@ -574,10 +596,27 @@ static int GetLowTic(void)
 #ifdef FEATURE_MULTIPLAYER
     if (net_client_connected)
     {
+        int playtic;
+
         if (drone || recvtic < lowtic)
         {
             lowtic = recvtic;
         }
+
+        // Keep the jitter buffer filled, but never hold back tics
+        // that have already been run.
+
+        playtic = recvtic - NET_CL_JitterTics();
+
+        if (playtic < gametic / ticdup)
+        {
+            playtic = gametic / ticdup;
+        }
+
+        if (playtic < lowtic)
+        {
+            lowtic = playtic;
+        }
     }
 #endif
 
@@ -828,6 +867,31 @@ void D_RegisterLoopCallbacks(loop_interface_t *i)
     loop_interface = i;
 }
 
+// Copy the local player's ticcmds that have been made but not yet run,
+// oldest first, into cmds.  Each is copied ticdup times, as it will be
+// run.  Returns the number of ticcmds copied.
+
+int D_GetPendingTics(ticcmd_t *cmds, int max_cmds)
+{
+    int num_cmds = 0;
+    int tic, i;
+
+    if (drone)
+    {
+        return 0;
+    }
+
+    for (tic = gametic / ticdup; tic < maketic; ++tic)
+    {
+        for (i = 0; i < ticdup && num_cmds < max_cmds; ++i)
+        {
+            cmds[num_cmds++] = ticdata[tic % BACKUPTICS].cmds[localplayer];
+        }
+    }
+
+    return num_cmds;
+}
+
 // TODO: Move nonvanilla demo functions into a dedicated file.
 #include "m_misc.h"
 #include "w_wad.h"
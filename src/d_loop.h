@@ -77,6 +77,9 @@ boolean D_InitNetGame(net_connect_data_t *connect_data);
 void D_StartNetGame(net_gamesettings_t *settings,
                     netgame_startup_callback_t callback);
 
+// Copy the local player's ticcmds that have not been run yet.
+int D_GetPendingTics(ticcmd_t *cmds, int max_cmds);
+
 extern boolean singletics;
 extern int gametic, ticdup;
 
@@ -20,6 +20,8 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "deh_main.h"
 
@@ -30,6 +32,7 @@
 #include "p_local.h"
 #include "w_wad.h"
 
+#include "m_bbox.h"
 #include "m_cheat.h"
 #include "m_controls.h"
 #include "m_misc.h"
@@ -140,6 +143,13 @@ typedef struct
     fixed_t slp, islp;
 } islope_t;
 
+// A linedef clipped to the automap window, in frame buffer coords.
+typedef struct
+{
+    int     line;
+    fline_t fl;
+} amline_t;
+
 
 //
 // The vector graphics for the automap.
@@ -201,8 +211,8 @@ static int grid = 0;
 static int leveljuststarted = 1; // kluge until AM_LevelInit() is called
 
 boolean automapactive = false;
-static int finit_width = SCREENWIDTH;
-static int finit_height = SCREENHEIGHT - (ST_HEIGHT << hires);
+static int finit_width;
+static int finit_height;
 
 // location of window on screen
 static int f_x;
@@ -270,6 +280,34 @@ cheatseq_t cheat_amap = CHEAT("iddt", 0);
 
 static boolean stopped = true;
 
+//
+// Spatial grid of linedefs, built once per level, so that only the
+// lines near the automap window have to be clipped. Same layout as the
+// blockmap: amgrid_offsets[cell] indexes into amgrid_lines, and the
+// lines of a cell run up to the offset of the next cell.
+//
+#define AMGRIDSHIFT (FRACBITS+9)  // 512 map units per cell
+
+static int     amgrid_numlines = -1;
+static int     amgrid_w;
+static int     amgrid_h;
+static fixed_t amgrid_x;
+static fixed_t amgrid_y;
+static int*    amgrid_offsets;
+static int*    amgrid_lines;
+
+//
+// Lines clipped to the current window. They are only recalculated when
+// the window moves or zooms; visibility and colors are still decided
+// every frame, since lines get mapped and sectors move.
+//
+static amline_t* amlines;
+static int       numamlines;
+static boolean   amlines_valid;
+static fixed_t   amlines_x;
+static fixed_t   amlines_y;
+static fixed_t   amlines_scale;
+
 // Calculates the slope and slope according to the x-axis of a line
 // segment in map coordinates (with the upright y-axis n' all) so
 // that it can be used with the brain-dead drawing stuff.
@@ -393,6 +431,111 @@ void AM_findMinMaxBoundaries(void)
 }
 
 
+//
+// Grid cell of a map coordinate, clamped to the grid. Computed unsigned,
+// as the extent of a big map does not fit in a signed fixed_t.
+//
+static int AM_gridCoord (fixed_t v, fixed_t origin, int size)
+{
+    unsigned int cell;
+
+    if (v <= origin)
+    return 0;
+
+    cell = ((unsigned int) v - (unsigned int) origin) >> AMGRIDSHIFT;
+
+    return cell < (unsigned int) size ? (int) cell : size - 1;
+}
+
+static void AM_gridCells (line_t* ld, int* x1, int* y1, int* x2, int* y2)
+{
+    *x1 = AM_gridCoord(ld->bbox[BOXLEFT], amgrid_x, amgrid_w);
+    *x2 = AM_gridCoord(ld->bbox[BOXRIGHT], amgrid_x, amgrid_w);
+    *y1 = AM_gridCoord(ld->bbox[BOXBOTTOM], amgrid_y, amgrid_h);
+    *y2 = AM_gridCoord(ld->bbox[BOXTOP], amgrid_y, amgrid_h);
+}
+
+//
+// Sorts all linedefs into the automap grid, by their bounding boxes.
+//
+void AM_buildLineGrid(void)
+{
+    int i;
+    int x, y;
+    int x1, y1, x2, y2;
+    int numcells;
+    int* fill;
+    fixed_t bbox[4];
+
+    if (amgrid_offsets)
+    {
+        Z_Free(amgrid_offsets);
+        Z_Free(amgrid_lines);
+        Z_Free(amlines);
+    }
+
+    M_ClearBox(bbox);
+
+    for (i=0;i<numlines;i++)
+    {
+        M_AddToBox(bbox, lines[i].bbox[BOXLEFT], lines[i].bbox[BOXBOTTOM]);
+        M_AddToBox(bbox, lines[i].bbox[BOXRIGHT], lines[i].bbox[BOXTOP]);
+    }
+
+    amgrid_x = bbox[BOXLEFT];
+    amgrid_y = bbox[BOXBOTTOM];
+    amgrid_w = (((unsigned int) bbox[BOXRIGHT] - (unsigned int) amgrid_x)
+                >> AMGRIDSHIFT) + 1;
+    amgrid_h = (((unsigned int) bbox[BOXTOP] - (unsigned int) amgrid_y)
+                >> AMGRIDSHIFT) + 1;
+
+    if (numlines == 0)
+    amgrid_w = amgrid_h = 1;
+
+    numcells = amgrid_w * amgrid_h;
+
+    amgrid_offsets = Z_Malloc((numcells + 1) * sizeof(*amgrid_offsets),
+                              PU_STATIC, 0);
+    fill = Z_Malloc(numcells * sizeof(*fill), PU_STATIC, 0);
+    memset(fill, 0, numcells * sizeof(*fill));
+
+    // count the lines of each cell
+    for (i=0;i<numlines;i++)
+    {
+        AM_gridCells(&lines[i], &x1, &y1, &x2, &y2);
+
+        for (y=y1;y<=y2;y++)
+            for (x=x1;x<=x2;x++)
+                fill[y*amgrid_w+x]++;
+    }
+
+    amgrid_offsets[0] = 0;
+    for (i=0;i<numcells;i++)
+    {
+        amgrid_offsets[i+1] = amgrid_offsets[i] + fill[i];
+        fill[i] = amgrid_offsets[i];
+    }
+
+    amgrid_lines = Z_Malloc((amgrid_offsets[numcells] + 1)
+                            * sizeof(*amgrid_lines), PU_STATIC, 0);
+
+    for (i=0;i<numlines;i++)
+    {
+        AM_gridCells(&lines[i], &x1, &y1, &x2, &y2);
+
+        for (y=y1;y<=y2;y++)
+            for (x=x1;x<=x2;x++)
+                amgrid_lines[fill[y*amgrid_w+x]++] = i;
+    }
+
+    Z_Free(fill);
+
+    amlines = Z_Malloc((numlines + 1) * sizeof(*amlines), PU_STATIC, 0);
+    amgrid_numlines = numlines;
+    amlines_valid = false;
+}
+
+
 //
 //
 //
@@ -525,6 +668,10 @@ void AM_LevelInit(void)
 {
     leveljuststarted = 0;
 
+    // Window size depends on the rendering resolution chosen at startup.
+    finit_width = SCREENWIDTH;
+    finit_height = SCREENHEIGHT - (ST_HEIGHT << hires);
+
     f_x = f_y = 0;
     f_w = finit_width;
     f_h = finit_height;
@@ -532,6 +679,7 @@ void AM_LevelInit(void)
     AM_clearMarks();
 
     AM_findMinMaxBoundaries();
+    AM_buildLineGrid();
     scale_mtof = FixedDiv(min_scale_mtof, (int) (0.7*FRACUNIT));
 
     if (scale_mtof > max_scale_mtof)
@@ -998,7 +1146,9 @@ boolean AM_clipMline (mline_t* ml, fline_t* fl)
 
 
 //
-// Classic Bresenham w/ whatever optimizations needed for speed
+// Classic Bresenham w/ whatever optimizations needed for speed.
+// Horizontal runs of pixels are written as spans, which covers
+// the many axis-aligned and shallow lines of typical maps.
 //
 void AM_drawFline (fline_t* fl, int color)
 {
@@ -1011,6 +1161,7 @@ void AM_drawFline (fline_t* fl, int color)
     register int ax;
     register int ay;
     register int d;
+    int runstart;
 
     static int fuck = 0;
 
@@ -1025,6 +1176,9 @@ void AM_drawFline (fline_t* fl, int color)
     }
 
 #define PUTDOT(xx,yy,cc) fb[(yy)*f_w+(xx)]=(cc)
+#define PUTSPAN(x1,x2,yy,cc) \
+    memset(fb + (yy)*f_w + ((x1) < (x2) ? (x1) : (x2)), (cc), \
+           ((x1) < (x2) ? (x2)-(x1) : (x1)-(x2)) + 1)
 
     dx = fl->b.x - fl->a.x;
     ax = 2 * (dx<0 ? -dx : dx);
@@ -1040,12 +1194,18 @@ void AM_drawFline (fline_t* fl, int color)
     if (ax > ay)
     {
         d = ay - ax/2;
+        runstart = x;
         while (1)
         {
-            PUTDOT(x,y,color);
-            if (x == fl->b.x) return;
+            if (x == fl->b.x)
+            {
+                PUTSPAN(runstart, x, y, color);
+                return;
+            }
             if (d>=0)
             {
+                PUTSPAN(runstart, x, y, color);
+                runstart = x + sx;
                 y += sy;
                 d -= ax;
             }
@@ -1131,6 +1291,79 @@ void AM_drawGrid(int color)
 }
 
 
+static int AM_compareLines (const void* a, const void* b)
+{
+    return ((const amline_t*) a)->line - ((const amline_t*) b)->line;
+}
+
+
+//
+// Collects the linedefs of the grid cells under the window and clips
+// them to it. Only needed when the window has moved or zoomed.
+//
+void AM_clipWalls(void)
+{
+    int x, y;
+    int x1, y1, x2, y2;
+    int* list;
+    int* end;
+    line_t* ld;
+    mline_t l;
+
+    if (amgrid_numlines != numlines)
+    AM_buildLineGrid();
+
+    numamlines = 0;
+
+    x1 = AM_gridCoord(m_x, amgrid_x, amgrid_w);
+    x2 = AM_gridCoord(m_x2, amgrid_x, amgrid_w);
+    y1 = AM_gridCoord(m_y, amgrid_y, amgrid_h);
+    y2 = AM_gridCoord(m_y2, amgrid_y, amgrid_h);
+
+    // lines may be listed in several cells
+    validcount++;
+
+    for (y=y1;y<=y2;y++)
+    {
+        for (x=x1;x<=x2;x++)
+        {
+            list = amgrid_lines + amgrid_offsets[y*amgrid_w+x];
+            end = amgrid_lines + amgrid_offsets[y*amgrid_w+x+1];
+
+            for ( ; list<end ; list++)
+            {
+                ld = &lines[*list];
+
+                if (ld->validcount == validcount)
+                continue;
+
+                ld->validcount = validcount;
+
+                l.a.x = ld->v1->x;
+                l.a.y = ld->v1->y;
+                l.b.x = ld->v2->x;
+                l.b.y = ld->v2->y;
+
+                if (AM_clipMline(&l, &amlines[numamlines].fl))
+                {
+                    amlines[numamlines].line = *list;
+                    numamlines++;
+                }
+            }
+        }
+    }
+
+    // Draw in linedef order like before, so overlapping lines keep
+    // the same color.
+    qsort(amlines, numamlines, sizeof(*amlines), AM_compareLines);
+
+    amlines_x = m_x;
+    amlines_y = m_y;
+    amlines_scale = scale_mtof;
+    amlines_valid = true;
+}
+
+
 //
 // Determines visible lines, draws them.
 // This is LineDef based, not LineSeg based.
@@ -1138,51 +1371,57 @@ void AM_drawGrid(int color)
 void AM_drawWalls(void)
 {
     int i;
-    static mline_t l;
+    line_t* ld;
+    fline_t* fl;
 
-    for (i=0;i<numlines;i++)
+    if (!amlines_valid || amgrid_numlines != numlines
+     || amlines_x != m_x || amlines_y != m_y || amlines_scale != scale_mtof)
+    {
+        AM_clipWalls();
+    }
+
+    for (i=0;i<numamlines;i++)
     {
-        l.a.x = lines[i].v1->x;
-        l.a.y = lines[i].v1->y;
-        l.b.x = lines[i].v2->x;
-        l.b.y = lines[i].v2->y;
-        if (cheating || (lines[i].flags & ML_MAPPED))
+        ld = &lines[amlines[i].line];
+        fl = &amlines[i].fl;
+
+        if (cheating || (ld->flags & ML_MAPPED))
         {
-            if ((lines[i].flags & LINE_NEVERSEE) && !cheating)
+            if ((ld->flags & LINE_NEVERSEE) && !cheating)
             continue;
 
-            if (!lines[i].backsector)
+            if (!ld->backsector)
             {
-                AM_drawMline(&l, WALLCOLORS+lightlev);
+                AM_drawFline(fl, WALLCOLORS+lightlev);
             }
             else
             {
-                if (lines[i].special == 39)
+                if (ld->special == 39)
                 { // teleporters
-                    AM_drawMline(&l, WALLCOLORS+WALLRANGE/2);
+                    AM_drawFline(fl, WALLCOLORS+WALLRANGE/2);
                 }
-                else if (lines[i].flags & ML_SECRET) // secret door
+                else if (ld->flags & ML_SECRET) // secret door
                 {
-                    if (cheating) AM_drawMline(&l, SECRETWALLCOLORS + lightlev);
-                    else AM_drawMline(&l, WALLCOLORS+lightlev);
+                    if (cheating) AM_drawFline(fl, SECRETWALLCOLORS + lightlev);
+                    else AM_drawFline(fl, WALLCOLORS+lightlev);
                 }
-                else if (lines[i].backsector->floorheight != lines[i].frontsector->floorheight) 
+                else if (ld->backsector->floorheight != ld->frontsector->floorheight) 
                 {
-                    AM_drawMline(&l, FDWALLCOLORS + lightlev); // floor level change
+                    AM_drawFline(fl, FDWALLCOLORS + lightlev); // floor level change
                 }
-                else if (lines[i].backsector->ceilingheight != lines[i].frontsector->ceilingheight) 
+                else if (ld->backsector->ceilingheight != ld->frontsector->ceilingheight) 
                 {
-                    AM_drawMline(&l, CDWALLCOLORS+lightlev); // ceiling level change
+                    AM_drawFline(fl, CDWALLCOLORS+lightlev); // ceiling level change
                 }
                 else if (cheating)
                 {
-                    AM_drawMline(&l, TSWALLCOLORS+lightlev);
+                    AM_drawFline(fl, TSWALLCOLORS+lightlev);
                 }
             }
         }
         else if (plr->powers[pw_allmap])
         {
-            if (!(lines[i].flags & LINE_NEVERSEE)) AM_drawMline(&l, GRAYS+3);
+            if (!(ld->flags & LINE_NEVERSEE)) AM_drawFline(fl, GRAYS+3);
         }
     }
 }
@@ -54,6 +54,7 @@
 #include "m_controls.h"
 #include "m_misc.h"
 #include "m_menu.h"
+#include "p_predict.h"
 #include "p_saveg.h"
 
 #include "i_endoom.h"
@@ -76,6 +77,7 @@
 #include "p_setup.h"
 #include "r_local.h"
 #include "statdump.h"
+#include "demotest.h"
 
 #include "d_main.h"
 
@@ -218,6 +220,10 @@ void D_Display (void)
     if (gamestate == GS_LEVEL && gametic)
     HU_Erase();
 
+    // draw the local player from where its pending ticcmds will take it
+    if (gamestate == GS_LEVEL && gametic)
+    P_PredictPlayerView(&players[displayplayer]);
+
     // do buffered drawing
     switch (gamestate)
     {
@@ -270,6 +276,8 @@ void D_Display (void)
     if (gamestate == GS_LEVEL && gametic)
     HU_Drawer ();
 
+    P_RestorePrediction();
+
     // clean up border stuff
     if (gamestate != oldgamestate && gamestate != GS_LEVEL)
     {
@@ -334,19 +342,27 @@ void D_Display (void)
 
     // wipe update
     wipe_EndScreen(0, 0, SCREENWIDTH, SCREENHEIGHT);
-    wipestart = I_GetTime () - 1;
+
+    // The wipe is driven by the millisecond timer rather than by whole
+    // tics, so that it advances smoothly with every displayed frame.
+    wipestart = I_GetTimeMS () - 1000 / TICRATE;
 
     do
     {
         do
         {
-            nowtime = I_GetTime ();
+            nowtime = I_GetTimeMS ();
             tics = nowtime - wipestart;
             I_Sleep(1);
         } while (tics <= 0);
 
+    // keep the fixed point conversion below from overflowing after a stall
+    if (tics > 250)
+        tics = 250;
+
     wipestart = nowtime;
-    done = wipe_ScreenWipe(wipe_Melt, 0, 0, SCREENWIDTH, SCREENHEIGHT, tics);
+    done = wipe_ScreenWipe(wipe_Melt, 0, 0, SCREENWIDTH, SCREENHEIGHT,
+                           ((int64_t) tics * TICRATE << FRACBITS) / 1000);
     I_UpdateNoBlit ();
     M_Drawer ();        // menu is drawn even on top of wipes
     I_FinishUpdate ();  // page flip or blit buffer
@@ -407,6 +423,8 @@ void D_BindVariables(void)
     M_BindIntVariable("show_messages",          &showMessages);
     M_BindIntVariable("screenblocks",           &screenblocks);
     M_BindIntVariable("detaillevel",            &detailLevel);
+    M_BindIntVariable("auto_detail",            &auto_detail);
+    M_BindIntVariable("auto_detail_budget",     &auto_detail_budget);
     M_BindIntVariable("snd_channels",           &snd_channels);
     M_BindIntVariable("show_endoom",            &show_endoom);
 
@@ -1790,6 +1808,7 @@ void D_DoomMain (void)
     M_SetConfigFilenames(PROGRAM_PREFIX "doom.cfg");
     D_BindVariables();
     M_LoadDefaults();
+    I_CheckHiresParm();
 
     // Save configuration at exit.
     I_AtExit(M_SaveDefaults, false);
@@ -2030,8 +2049,14 @@ void D_DoomMain (void)
     I_CheckIsScreensaver();
     I_InitTimer();
     I_InitJoystick();
-    I_InitSound(true);
-    I_InitMusic();
+
+    // The demo regression runner is headless and silent.
+
+    if (!M_ParmExists("-demotest"))
+    {
+        I_InitSound(true);
+        I_InitMusic();
+    }
 
 #ifdef FEATURE_MULTIPLAYER
     printf ("NET_Init: Инициализация сетевой подсистемы.\n");
@@ -2212,6 +2237,23 @@ void D_DoomMain (void)
         DEH_printf("Регистрация внешней статистики.\n");
     }
 
+    //!
+    // @arg <manifest>
+    // @category demo
+    //
+    // Play back every demo listed in the manifest file without
+    // rendering, and compare a checksum of the final game state of
+    // each with the one stored in the manifest.  Exits with a non-zero
+    // status if any demo has gone out of sync.
+    //
+
+    p = M_CheckParmWithArgs("-demotest", 1);
+
+    if (p)
+    {
+        DemoTestRun(myargv[p + 1]);     // never returns
+    }
+
     //!
     // @arg <x>
     // @category demo
@@ -32,6 +32,7 @@
 #include "i_timer.h"
 #include "i_video.h"
 #include "g_game.h"
+#include "p_predict.h"
 #include "doomdef.h"
 #include "doomstat.h"
 #include "w_checksum.h"
@@ -254,6 +255,16 @@ void D_CheckNetGame (void)
     D_StartNetGame(&settings, NULL);
     LoadGameSettings(&settings);
 
+    //!
+    // @category net
+    //
+    // In a netgame, draw the view from where the local player's
+    // movement will take them, without waiting for the server to
+    // return their ticcmds.
+    //
+
+    predict_movement = netgame && M_ParmExists("-predict");
+
     DEH_printf("сложность: %i  дефматч: %i  уровень: %i  эпизод: %i\n",
                startskill, deathmatch, startmap, startepisode);
 
@@ -0,0 +1,560 @@
+ /*
+
+ Copyright(C) 2005-2014 Simon Howard
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ --
+
+ Headless demo regression runner.  Each demo listed in a manifest is
+ played back as fast as possible without any rendering, and a SHA-1
+ checksum of the final game state is compared against the one stored
+ in the manifest.  On systems with fork() the demos are played in
+ parallel, one child process per demo.
+
+ Manifest lines have the form:
+
+   <demo file or lump> [<sha1>]
+
+ Empty lines and lines beginning with '#' are ignored.  A demo with no
+ stored checksum is reported as NEW together with its checksum, so a
+ manifest can be created by pasting the runner's output.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "doomstat.h"
+#include "d_loop.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "p_local.h"
+#include "sha1.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "demotest.h"
+
+#define DIGEST_LEN (sizeof(sha1_digest_t) * 2)
+
+typedef enum
+{
+    DEMOTEST_PENDING,
+    DEMOTEST_DONE,
+    DEMOTEST_ERROR,
+} demoteststatus_t;
+
+typedef struct
+{
+    char *filename;
+    char expected[DIGEST_LEN + 1];
+    char result[DIGEST_LEN + 1];
+    int tics;
+    demoteststatus_t status;
+} demotest_t;
+
+boolean demotest = false;
+
+extern int prndindex;
+
+static demotest_t *tests = NULL;
+static int num_tests = 0;
+
+// Digest of the state captured when the demo being played ended.
+
+static char captured_digest[DIGEST_LEN + 1];
+static boolean captured = false;
+
+// Called from G_CheckDemoStatus when the demo ends, before the player
+// and game flags are reset for the next demo.
+
+void DemoTestCapture(void)
+{
+    sha1_context_t context;
+    sha1_digest_t digest;
+    thinker_t *th;
+    mobj_t *mo;
+    player_t *player;
+    int i;
+
+    SHA1_Init(&context);
+
+    SHA1_UpdateInt32(&context, gameskill);
+    SHA1_UpdateInt32(&context, gameepisode);
+    SHA1_UpdateInt32(&context, gamemap);
+    SHA1_UpdateInt32(&context, gamestate);
+    SHA1_UpdateInt32(&context, leveltime);
+    SHA1_UpdateInt32(&context, prndindex);
+    SHA1_UpdateInt32(&context, totalkills);
+    SHA1_UpdateInt32(&context, totalitems);
+    SHA1_UpdateInt32(&context, totalsecret);
+
+    for (i = 0; i < MAXPLAYERS; ++i)
+    {
+        if (!playeringame[i])
+        {
+            continue;
+        }
+
+        player = &players[i];
+
+        SHA1_UpdateInt32(&context, i);
+        SHA1_UpdateInt32(&context, player->playerstate);
+        SHA1_UpdateInt32(&context, player->health);
+        SHA1_UpdateInt32(&context, player->armorpoints);
+        SHA1_UpdateInt32(&context, player->armortype);
+        SHA1_UpdateInt32(&context, player->readyweapon);
+        SHA1_UpdateInt32(&context, player->killcount);
+        SHA1_UpdateInt32(&context, player->itemcount);
+        SHA1_UpdateInt32(&context, player->secretcount);
+
+        if (player->mo != NULL)
+        {
+            SHA1_UpdateInt32(&context, player->mo->x);
+            SHA1_UpdateInt32(&context, player->mo->y);
+            SHA1_UpdateInt32(&context, player->mo->z);
+            SHA1_UpdateInt32(&context, player->mo->angle);
+        }
+    }
+
+    // Every map object, in thinker order.  This catches monsters that
+    // drift out of sync long before the players are affected.
+
+    if (gamestate == GS_LEVEL && thinkercap.next != NULL)
+    {
+        for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        {
+            if (th->function.acp1 != (actionf_p1) P_MobjThinker)
+            {
+                continue;
+            }
+
+            mo = (mobj_t *) th;
+
+            SHA1_UpdateInt32(&context, mo->type);
+            SHA1_UpdateInt32(&context, mo->x);
+            SHA1_UpdateInt32(&context, mo->y);
+            SHA1_UpdateInt32(&context, mo->z);
+            SHA1_UpdateInt32(&context, mo->angle);
+            SHA1_UpdateInt32(&context, mo->health);
+        }
+    }
+
+    SHA1_Final(digest, &context);
+
+    for (i = 0; i < (int) sizeof(sha1_digest_t); ++i)
+    {
+        M_snprintf(captured_digest + i * 2, 3, "%02x", digest[i]);
+    }
+
+    captured = true;
+}
+
+// Load the demo and play it back without rendering until it ends.
+// Returns false if the demo did not finish.
+
+static boolean PlayDemo(demotest_t *test)
+{
+    static char lumpname[9];
+    ticcmd_t cmds[MAXPLAYERS];
+    int lumpnum;
+    int maxtics;
+
+    // As with -playdemo, a file is added as a lump of its own and a
+    // name that is not a file is taken as the name of a lump.
+
+    if (M_FileExists(test->filename))
+    {
+        if (W_AddFile(test->filename) == NULL)
+        {
+            return false;
+        }
+
+        W_GenerateHashTable();
+        M_StringCopy(lumpname, lumpinfo[numlumps - 1]->name, sizeof(lumpname));
+    }
+    else
+    {
+        M_StringCopy(lumpname, test->filename, sizeof(lumpname));
+    }
+
+    lumpnum = W_CheckNumForName(lumpname);
+
+    if (lumpnum < 0)
+    {
+        return false;
+    }
+
+    // Every tic takes at least four bytes, so a demo that runs longer
+    // than its length has lost its end marker.
+
+    maxtics = W_LumpLength(lumpnum) + TICRATE;
+
+    memset(cmds, 0, sizeof(cmds));
+    netcmds = cmds;
+    captured = false;
+    gametic = 0;
+
+    G_DeferedPlayDemo(lumpname);
+
+    while (!captured && gametic < maxtics)
+    {
+        G_Ticker();
+        ++gametic;
+    }
+
+    test->tics = gametic;
+
+    if (!captured)
+    {
+        return false;
+    }
+
+    M_StringCopy(test->result, captured_digest, sizeof(test->result));
+
+    return true;
+}
+
+static void ParseManifest(char *manifest)
+{
+    char line[512];
+    char *name, *digest, *p;
+    int tests_alloced;
+    FILE *fstream;
+
+    fstream = fopen(manifest, "r");
+
+    if (fstream == NULL)
+    {
+        I_Error("DemoTest: невозможно открыть %s", manifest);
+    }
+
+    tests_alloced = 0;
+
+    while (fgets(line, sizeof(line), fstream) != NULL)
+    {
+        name = line;
+
+        while (isspace(*name))
+        {
+            ++name;
+        }
+
+        if (*name == '\0' || *name == '#')
+        {
+            continue;
+        }
+
+        p = name;
+
+        while (*p != '\0' && !isspace(*p))
+        {
+            ++p;
+        }
+
+        digest = p;
+
+        while (isspace(*digest))
+        {
+            ++digest;
+        }
+
+        *p = '\0';
+
+        for (p = digest; *p != '\0' && !isspace(*p); ++p)
+        {
+            *p = tolower(*p);
+        }
+
+        *p = '\0';
+
+        if (num_tests >= tests_alloced)
+        {
+            tests_alloced = tests_alloced ? tests_alloced * 2 : 64;
+            tests = realloc(tests, tests_alloced * sizeof(demotest_t));
+
+            if (tests == NULL)
+            {
+                I_Error("DemoTest: недостаточно памяти");
+            }
+        }
+
+        memset(&tests[num_tests], 0, sizeof(demotest_t));
+        tests[num_tests].filename = M_StringDuplicate(name);
+        M_StringCopy(tests[num_tests].expected, digest,
+                     sizeof(tests[num_tests].expected));
+        ++num_tests;
+    }
+
+    fclose(fstream);
+}
+
+#ifndef _WIN32
+
+typedef struct
+{
+    pid_t pid;
+    int fd;
+    int test;
+} demochild_t;
+
+// Collect the result written by a finished child.
+
+static void ReadChildResult(demochild_t *child, int status)
+{
+    demotest_t *test = &tests[child->test];
+    char buf[64];
+    int len;
+
+    len = read(child->fd, buf, sizeof(buf) - 1);
+    close(child->fd);
+
+    test->status = DEMOTEST_ERROR;
+
+    if (len > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+        buf[len] = '\0';
+
+        if (sscanf(buf, "%40s %i", test->result, &test->tics) == 2
+         && strlen(test->result) == DIGEST_LEN)
+        {
+            test->status = DEMOTEST_DONE;
+        }
+    }
+}
+
+// Play each demo in a child process of its own.  The game has been
+// fully initialized at this point, so every child starts from the
+// same state and only has to load and play its demo.
+
+static void RunParallel(int jobs)
+{
+    demochild_t *children;
+    int running, next;
+    int status;
+    int fds[2];
+    char buf[64];
+    pid_t pid;
+    int i;
+
+    children = calloc(jobs, sizeof(demochild_t));
+    running = 0;
+    next = 0;
+
+    while (next < num_tests || running > 0)
+    {
+        if (next < num_tests && running < jobs)
+        {
+            if (pipe(fds) != 0)
+            {
+                I_Error("DemoTest: ошибка pipe()");
+            }
+
+            fflush(stdout);
+            fflush(stderr);
+
+            pid = fork();
+
+            if (pid < 0)
+            {
+                I_Error("DemoTest: ошибка fork()");
+            }
+
+            if (pid == 0)
+            {
+                int exit_status = 0;
+                size_t len;
+
+                close(fds[0]);
+
+                if (PlayDemo(&tests[next]))
+                {
+                    M_snprintf(buf, sizeof(buf), "%s %i\n",
+                               tests[next].result, tests[next].tics);
+                    len = strlen(buf);
+
+                    // A failed write shows as an error in the parent,
+                    // through the exit status.
+
+                    if (write(fds[1], buf, len) != (ssize_t) len)
+                    {
+                        fprintf(stderr, "DemoTest: %s: failed to pass on "
+                                        "the result\n", tests[next].filename);
+                        exit_status = 1;
+                    }
+                }
+
+                fflush(stdout);
+                fflush(stderr);
+                _exit(exit_status);
+            }
+
+            close(fds[1]);
+
+            children[running].pid = pid;
+            children[running].fd = fds[0];
+            children[running].test = next;
+            ++running;
+            ++next;
+
+            continue;
+        }
+
+        // The result is smaller than PIPE_BUF, so a child never blocks
+        // on its pipe and it is safe to wait for it first.
+
+        pid = waitpid(-1, &status, 0);
+
+        if (pid < 0)
+        {
+            break;
+        }
+
+        for (i = 0; i < running; ++i)
+        {
+            if (children[i].pid == pid)
+            {
+                ReadChildResult(&children[i], status);
+                children[i] = children[running - 1];
+                --running;
+                break;
+            }
+        }
+    }
+
+    free(children);
+}
+
+#endif
+
+static void RunSequential(void)
+{
+    int i;
+
+    for (i = 0; i < num_tests; ++i)
+    {
+        tests[i].status = PlayDemo(&tests[i]) ? DEMOTEST_DONE
+                                              : DEMOTEST_ERROR;
+    }
+}
+
+static int DefaultJobs(void)
+{
+#if !defined(_WIN32) && defined(_SC_NPROCESSORS_ONLN)
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cpus > 0)
+    {
+        return (int) cpus;
+    }
+#endif
+
+    return 1;
+}
+
+void DemoTestRun(char *manifest)
+{
+    int passed, failed, added;
+    int jobs;
+    int starttime;
+    int i, p;
+
+    ParseManifest(manifest);
+
+    //!
+    // @arg <n>
+    // @category demo
+    //
+    // Number of demos played at the same time by -demotest.  The
+    // default is the number of processors.
+    //
+
+    jobs = DefaultJobs();
+    p = M_CheckParmWithArgs("-demotestjobs", 1);
+
+    if (p)
+    {
+        jobs = atoi(myargv[p + 1]);
+
+        if (jobs < 1)
+        {
+            jobs = 1;
+        }
+    }
+
+    printf("DemoTest: проверка %i демозаписей, процессов: %i.\n",
+           num_tests, jobs);
+
+    demotest = true;
+    nodrawers = true;
+    starttime = I_GetTimeMS();
+
+#ifndef _WIN32
+    if (jobs > 1)
+    {
+        RunParallel(jobs);
+    }
+    else
+#endif
+    {
+        RunSequential();
+    }
+
+    passed = failed = added = 0;
+
+    for (i = 0; i < num_tests; ++i)
+    {
+        demotest_t *test = &tests[i];
+
+        if (test->status != DEMOTEST_DONE)
+        {
+            printf("ERROR %s\n", test->filename);
+            ++failed;
+        }
+        else if (test->expected[0] == '\0')
+        {
+            printf("NEW   %s %s (%i tics)\n",
+                   test->filename, test->result, test->tics);
+            ++added;
+        }
+        else if (strcmp(test->expected, test->result) != 0)
+        {
+            printf("FAIL  %s %s (%i tics), ожидалось %s\n",
+                   test->filename, test->result, test->tics,
+                   test->expected);
+            ++failed;
+        }
+        else
+        {
+            ++passed;
+        }
+    }
+
+    printf("DemoTest: успешно: %i, ошибок: %i, новых: %i (%i мс).\n",
+           passed, failed, added, I_GetTimeMS() - starttime);
+
+    // The configuration is deliberately not saved: the runner does
+    // not change any settings.
+
+    exit(failed > 0 ? 1 : 0);
+}
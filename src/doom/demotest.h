@@ -0,0 +1,28 @@
+ /*
+
+ Copyright(C) 2005-2014 Simon Howard
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ */
+
+#ifndef DOOM_DEMOTEST_H
+#define DOOM_DEMOTEST_H
+
+#include "doomtype.h"
+
+// True while the -demotest runner is playing back a demo.
+extern boolean demotest;
+
+void DemoTestCapture(void);
+void DemoTestRun(char *manifest);
+
+#endif /* #ifndef DOOM_DEMOTEST_H */
@@ -611,7 +611,7 @@ void F_DrawPatchCol (int x, patch_t* patch, int col)
     byte*       source;
     byte*       dest;
     byte*       desttop;
-    int         count, f;
+    int         count, f, r;
 
     column = (column_t *)((byte *)patch + LONG(patch->columnofs[col]));
     desttop = I_VideoBuffer + x;
@@ -619,15 +619,15 @@ void F_DrawPatchCol (int x, patch_t* patch, int col)
     // step through the posts in a column
     while (column->topdelta != 0xff )
     {
-        for (f = 0; f <= hires; f++)
+        for (f = 0; f < (1 << hires); f++)
         {
             source = (byte *)column + 3;
-            dest = desttop + column->topdelta*(SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta*(SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 		
             while (count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest = *source;
                     dest += SCREENWIDTH;
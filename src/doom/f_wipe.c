@@ -24,6 +24,7 @@
 #include "z_zone.h"
 #include "i_video.h"
 #include "v_video.h"
+#include "m_fixed.h"
 #include "m_random.h"
 
 #include "doomtype.h"
@@ -41,23 +42,11 @@ static byte*    wipe_scr_start;
 static byte*    wipe_scr_end;
 static byte*    wipe_scr;
 
-
-void wipe_shittyColMajorXform (short* array, int width, int height)
-{
-    int     x;
-    int     y;
-    short* dest;
-
-    dest = (short*) Z_Malloc(width*height*sizeof(*dest), PU_STATIC, 0);
-
-    for(y=0;y<height;y++)
-    for(x=0;x<width;x++)
-        dest[x*height+y] = array[y*width+x];
-
-    memcpy(array, dest, width*height*sizeof(*dest));
-
-    Z_Free(dest);
-}
+// Fraction of a wipe step that has elapsed since the last whole step.
+// The wipes advance in whole steps like the original tic-based code,
+// and the melt interpolates its columns by this amount in between, so
+// the wipe is smooth no matter how often the screen is updated.
+static fixed_t  wipe_frac;
 
 
 int wipe_initColorXForm (int width, int height, int ticks)
@@ -120,6 +109,7 @@ int wipe_exitColorXForm (int width, int height, int ticks)
 
 
 static int*	y;
+static int*	meltpos;
 
 
 int wipe_initMelt (int width, int height, int ticks)
@@ -129,14 +119,10 @@ int wipe_initMelt (int width, int height, int ticks)
     // copy start screen to main screen
     memcpy(wipe_scr, wipe_scr_start, width*height*sizeof(*wipe_scr));
 
-    // makes this wipe faster (in theory)
-    // to have stuff in column-major format
-    wipe_shittyColMajorXform((short*)wipe_scr_start, width/2, height);
-    wipe_shittyColMajorXform((short*)wipe_scr_end, width/2, height);
-
     // setup initial column positions
     // (y<0 => not ready to scroll yet)
     y = (int *) Z_Malloc(width*sizeof(int), PU_STATIC, 0);
+    meltpos = (int *) Z_Malloc(width*sizeof(int), PU_STATIC, 0);
     y[0] = -(M_Random()%16);
     for (i=1;i<width;i++)
     {
@@ -150,57 +136,96 @@ int wipe_initMelt (int width, int height, int ticks)
 }
 
 
+//
+// Distance a melt column starting at position pos moves in one step.
+//
+static int wipe_meltStep (int pos, int height)
+{
+    int dy;
+
+    if (pos < 0)
+    {
+        return 1;
+    }
+
+    dy = (pos < 16) ? pos+1 : 8;
+
+    if (pos+dy >= height)
+    dy = height - pos;
+
+    return dy;
+}
+
+
 int wipe_doMelt (int width, int height, int ticks)
 {
     int     i;
-    int     j;
-    int     dy;
-    int     idx;
+    int     row;
+    int     pos;
+    int     minpos;
 
     short*  s;
+    short*  e;
     short*  d;
     boolean done = true;
 
     width/=2;
 
+    // advance the columns by whole steps
     while (ticks--)
     {
         for (i=0;i<width;i++)
         {
-            if (y[i]<0)
+            if (y[i] < height)
             {
-                y[i]++; done = false;
+                y[i] += wipe_meltStep(y[i], height);
             }
-            else if (y[i] < height)
-            {
-                dy = (y[i] < 16) ? y[i]+1 : 8;
+        }
+    }
+
+    // where each column is drawn, interpolated towards the next step
+    minpos = height;
 
-                if (y[i]+dy >= height) 
-                dy = height - y[i];
+    for (i=0;i<width;i++)
+    {
+        if (y[i] < height)
+        {
+            done = false;
+        }
 
-                s = &((short *)wipe_scr_end)[i*height+y[i]];
-                d = &((short *)wipe_scr)[y[i]*width+i];
-                idx = 0;
+        pos = y[i] + FixedMul(wipe_meltStep(y[i], height), wipe_frac);
 
-                for (j=dy;j;j--)
-                {
-                    d[idx] = *(s++);
-                    idx += width;
-                }
+        if (pos < 0)
+        pos = 0;
+        else if (pos > height)
+        pos = height;
 
-                y[i] += dy;
-                s = &((short *)wipe_scr_start)[i*height];
-                d = &((short *)wipe_scr)[y[i]*width+i];
-                idx = 0;
+        meltpos[i] = pos;
 
-                for (j=height-y[i];j;j--)
-                {
-                    d[idx] = *(s++);
-                    idx += width;
-                }
+        if (pos < minpos)
+        minpos = pos;
+    }
 
-                done = false;
-            }
+    // Compose the screen row by row, so that the buffers are read and
+    // written sequentially instead of one column at a time. Rows above
+    // every column show the end screen only.
+    memcpy(wipe_scr, wipe_scr_end, minpos*width*sizeof(short));
+
+    s = (short *)wipe_scr_start;
+    e = (short *)wipe_scr_end;
+
+    for (row=minpos;row<height;row++)
+    {
+        d = &((short *)wipe_scr)[row*width];
+
+        for (i=0;i<width;i++)
+        {
+            pos = meltpos[i];
+
+            if (row < pos)
+            d[i] = e[row*width+i];
+            else
+            d[i] = s[(row-pos)*width+i];
         }
     }
 
@@ -210,6 +235,7 @@ int wipe_doMelt (int width, int height, int ticks)
 
 int wipe_exitMelt (int width, int height, int ticks)
 {
+    Z_Free(meltpos);
     Z_Free(y);
     Z_Free(wipe_scr_start);
     Z_Free(wipe_scr_end);
@@ -234,9 +260,10 @@ int wipe_EndScreen (int x, int y, int width, int height)
 }
 
 
-int wipe_ScreenWipe (int wipeno, int x, int y, int width, int height, int ticks)
+int wipe_ScreenWipe (int wipeno, int x, int y, int width, int height, fixed_t ticks)
 {
     int rc;
+    int steps;
 
     static int (*wipes[])(int, int, int) =
     {
@@ -244,27 +271,31 @@ int wipe_ScreenWipe (int wipeno, int x, int y, int width, int height, int ticks)
         wipe_initMelt, wipe_doMelt, wipe_exitMelt
     };
 
-    ticks <<= hires;
-
     // initial stuff
     if (!go)
     {
         go = 1;
+        wipe_frac = 0;
         // wipe_scr = (byte *) Z_Malloc(width*height, PU_STATIC, 0); // DEBUG
         wipe_scr = I_VideoBuffer;
-        (*wipes[wipeno*3])(width, height, ticks);
+        (*wipes[wipeno*3])(width, height, 0);
     }
 
+    // split the elapsed time into whole steps and a fraction
+    wipe_frac += ticks << hires;
+    steps = wipe_frac >> FRACBITS;
+    wipe_frac &= FRACUNIT - 1;
+
     // do a piece of wipe-in
     V_MarkRect(0, 0, width, height);
-    rc = (*wipes[wipeno*3+1])(width, height, ticks);
+    rc = (*wipes[wipeno*3+1])(width, height, steps);
     //  V_DrawBlock(x, y, 0, width, height, wipe_scr); // DEBUG
 
     // final stuff
     if (rc)
     {
         go = 0;
-        (*wipes[wipeno*3+2])(width, height, ticks);
+        (*wipes[wipeno*3+2])(width, height, steps);
     }
 
     return !go;
@@ -22,6 +22,8 @@
 #ifndef __F_WIPE_H__
 #define __F_WIPE_H__
 
+#include "m_fixed.h"
+
 //
 //                       SCREEN WIPE PACKAGE
 //
@@ -36,7 +38,8 @@ enum
 
 int wipe_StartScreen (int x, int y, int width, int height);
 int wipe_EndScreen (int x, int y, int width, int height);
-int wipe_ScreenWipe (int wipeno, int x, int y, int width, int height, int ticks);
+// ticks is the time elapsed since the last call, in fractional tics.
+int wipe_ScreenWipe (int wipeno, int x, int y, int width, int height, fixed_t ticks);
 
 
 #endif
@@ -52,6 +52,7 @@
 #include "st_stuff.h"
 #include "am_map.h"
 #include "statdump.h"
+#include "demotest.h"
 
 // Needs access to LFB.
 #include "v_video.h"
@@ -721,6 +722,7 @@ void G_DoLoadLevel (void)
     } 
 
     P_SetupLevel (gameepisode, gamemap, 0, gameskill);    
+    S_PrefetchLevelSounds ();
     displayplayer = consoleplayer;		// view the guy you are playing    
     gameaction = ga_nothing; 
     Z_CheckHeap ();
@@ -2416,6 +2418,11 @@ boolean G_CheckDemoStatus (void)
 
     if (demoplayback)
     { 
+        if (demotest)
+        {
+            DemoTestCapture();
+        }
+
         W_ReleaseLumpName(defdemoname);
         demoplayback = false; 
         netdemo = false;
@@ -2429,7 +2436,7 @@ boolean G_CheckDemoStatus (void)
 
         if (singledemo) 
             I_Quit (); 
-        else 
+        else if (!demotest)
             D_AdvanceDemo (); 
 
         return true; 
@@ -0,0 +1,504 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Prediction of the local player's movement in netgames.
+//
+//	A netgame tic can only be run once the ticcmds of every player
+//	have come back from the server, so the local player sees the
+//	result of their own input a full round trip late.  To hide
+//	this, the view is drawn from where the ticcmds already made but
+//	not yet run will take the player.
+//
+//	The prediction replays those ticcmds on a private copy of the
+//	player's position and momentum, following P_MovePlayer,
+//	P_XYMovement and P_ZMovement.  Nothing in the level is changed:
+//	clipping is done by a copy of P_CheckPosition that leaves the
+//	tm* globals, spechit and validcount alone and picks nothing up,
+//	and the real mobj only carries the predicted position while the
+//	frame is drawn.  It is redone from the last run tic every frame, so
+//	whenever the authoritative tics arrive the view snaps back onto
+//	the real simulation.
+//
+
+
+#include <stdlib.h>
+
+#include "doomdef.h"
+#include "d_loop.h"
+#include "m_bbox.h"
+
+#include "p_local.h"
+#include "p_predict.h"
+
+#include "doomstat.h"
+#include "r_state.h"
+
+#include "crispy.h"
+
+// Same as in p_mobj.c
+#define STOPSPEED		0x1000
+#define FRICTION		0xe800
+
+// Most ticcmds replayed.  More than this many pending ticcmds means
+// the link is stalled, and guessing further ahead only gets worse.
+#define MAXPREDICTTICS		35
+
+boolean		predict_movement;
+
+typedef struct
+{
+    fixed_t	x;
+    fixed_t	y;
+    fixed_t	z;
+    fixed_t	momx;
+    fixed_t	momy;
+    fixed_t	momz;
+    fixed_t	floorz;
+    fixed_t	ceilingz;
+    angle_t	angle;
+    int		reactiontime;
+    boolean	noclip;
+} predict_t;
+
+// Result of PredictCheckPosition, the prediction's own copy of
+// tmfloorz and tmceilingz.
+static fixed_t	predfloorz;
+static fixed_t	predceilingz;
+
+// Real values of the mobj and player being drawn from a predicted
+// view, put back by P_RestorePrediction.
+static player_t*	savedplayer;
+static predict_t	saved;
+static fixed_t		savedviewz;
+
+
+//
+// PredictCheckLine
+// Like PIT_CheckLine for a player, without recording special lines.
+//
+static boolean
+PredictCheckLine
+( line_t*	ld,
+  fixed_t*	bbox )
+{
+    fixed_t	opentop;
+    fixed_t	openbottom;
+
+    if (bbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
+     || bbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
+     || bbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
+     || bbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+	return true;
+
+    if (P_BoxOnLineSide (bbox, ld) != -1)
+	return true;
+
+    if (!ld->backsector)
+	return false;		// one sided line
+
+    if (ld->flags & ML_BLOCKING)
+	return false;		// explicitly blocking everything
+
+    // As P_LineOpening, without setting its globals.
+    if (ld->frontsector->ceilingheight < ld->backsector->ceilingheight)
+	opentop = ld->frontsector->ceilingheight;
+    else
+	opentop = ld->backsector->ceilingheight;
+
+    if (ld->frontsector->floorheight > ld->backsector->floorheight)
+	openbottom = ld->frontsector->floorheight;
+    else
+	openbottom = ld->backsector->floorheight;
+
+    if (opentop < predceilingz)
+	predceilingz = opentop;
+
+    if (openbottom > predfloorz)
+	predfloorz = openbottom;
+
+    return true;
+}
+
+
+//
+// PredictCheckPosition
+// Like P_CheckPosition for a player that picks nothing up, but only
+// sets predfloorz and predceilingz.  The blockmap is walked here
+// rather than with P_BlockLinesIterator, which marks lines with
+// validcount; a line met twice is just checked twice.
+//
+static boolean
+PredictCheckPosition
+( mobj_t*	mo,
+  boolean	noclip,
+  fixed_t	x,
+  fixed_t	y )
+{
+    fixed_t	bbox[4];
+    fixed_t	blockdist;
+    subsector_t*	newsubsec;
+    mobj_t*	thing;
+    long*	list;
+    int		offset;
+    int		xl;
+    int		xh;
+    int		yl;
+    int		yh;
+    int		bx;
+    int		by;
+
+    bbox[BOXTOP] = y + mo->radius;
+    bbox[BOXBOTTOM] = y - mo->radius;
+    bbox[BOXRIGHT] = x + mo->radius;
+    bbox[BOXLEFT] = x - mo->radius;
+
+    newsubsec = R_PointInSubsector (x,y);
+    predfloorz = newsubsec->sector->floorheight;
+    predceilingz = newsubsec->sector->ceilingheight;
+
+    if (noclip)
+	return true;
+
+    // Only solid things block a player that isn't flying as a
+    // skull or a missile; see PIT_CheckThing.
+    xl = (bbox[BOXLEFT] - bmaporgx - MAXRADIUS)>>MAPBLOCKSHIFT;
+    xh = (bbox[BOXRIGHT] - bmaporgx + MAXRADIUS)>>MAPBLOCKSHIFT;
+    yl = (bbox[BOXBOTTOM] - bmaporgy - MAXRADIUS)>>MAPBLOCKSHIFT;
+    yh = (bbox[BOXTOP] - bmaporgy + MAXRADIUS)>>MAPBLOCKSHIFT;
+
+    for (bx = xl ; bx <= xh ; bx++)
+    {
+	for (by = yl ; by <= yh ; by++)
+	{
+	    if (bx < 0 || by < 0 || bx >= bmapwidth || by >= bmapheight)
+		continue;
+
+	    for (thing = blocklinks[by*bmapwidth+bx] ;
+		 thing ;
+		 thing = thing->bnext)
+	    {
+		if (!(thing->flags & MF_SOLID) || thing == mo)
+		    continue;
+
+		blockdist = thing->radius + mo->radius;
+
+		if (abs(thing->x - x) < blockdist
+		 && abs(thing->y - y) < blockdist)
+		    return false;
+	    }
+	}
+    }
+
+    // check lines, as P_BlockLinesIterator
+    xl = (bbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
+    xh = (bbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
+    yl = (bbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
+    yh = (bbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
+
+    for (bx = xl ; bx <= xh ; bx++)
+    {
+	for (by = yl ; by <= yh ; by++)
+	{
+	    if (bx < 0 || by < 0 || bx >= bmapwidth || by >= bmapheight)
+		continue;
+
+	    offset = *(blockmap + by*bmapwidth+bx);
+
+	    if (singleplayer)
+		offset++;
+
+	    for (list = blockmaplump+offset ; *list != -1 ; list++)
+	    {
+		if (!PredictCheckLine (&lines[*list], bbox))
+		    return false;
+	    }
+	}
+    }
+
+    return true;
+}
+
+
+//
+// PredictTryMove
+// Like P_TryMove, but only moves the prediction.
+//
+static boolean
+PredictTryMove
+( mobj_t*	mo,
+  predict_t*	pr,
+  fixed_t	x,
+  fixed_t	y )
+{
+    if (!PredictCheckPosition (mo, pr->noclip, x, y))
+	return false;
+
+    if (!pr->noclip)
+    {
+	if (predceilingz - predfloorz < mo->height)
+	    return false;	// doesn't fit
+
+	if (predceilingz - pr->z < mo->height)
+	    return false;	// mobj must lower itself to fit
+
+	if (predfloorz - pr->z > 24*FRACUNIT)
+	    return false;	// too big a step up
+    }
+
+    pr->floorz = predfloorz;
+    pr->ceilingz = predceilingz;
+    pr->x = x;
+    pr->y = y;
+
+    return true;
+}
+
+
+//
+// PredictTic
+// Runs one ticcmd on the prediction.
+//
+static void
+PredictTic
+( player_t*	player,
+  predict_t*	pr,
+  ticcmd_t*	cmd )
+{
+    mobj_t*	mo = player->mo;
+    fixed_t	xmove;
+    fixed_t	ymove;
+    fixed_t	ptryx;
+    fixed_t	ptryy;
+    angle_t	an;
+
+    // P_MovePlayer
+    if (pr->reactiontime)
+    {
+	pr->reactiontime--;
+    }
+    else
+    {
+	pr->angle += cmd->angleturn << FRACBITS;
+
+	if (pr->z <= pr->floorz)
+	{
+	    an = pr->angle >> ANGLETOFINESHIFT;
+	    pr->momx += FixedMul (cmd->forwardmove*2048, finecosine[an]);
+	    pr->momy += FixedMul (cmd->forwardmove*2048, finesine[an]);
+
+	    an = (pr->angle - ANG90) >> ANGLETOFINESHIFT;
+	    pr->momx += FixedMul (cmd->sidemove*2048, finecosine[an]);
+	    pr->momy += FixedMul (cmd->sidemove*2048, finesine[an]);
+	}
+    }
+
+    // P_XYMovement
+    if (pr->momx || pr->momy)
+    {
+	if (pr->momx > MAXMOVE)
+	    pr->momx = MAXMOVE;
+	else if (pr->momx < -MAXMOVE)
+	    pr->momx = -MAXMOVE;
+
+	if (pr->momy > MAXMOVE)
+	    pr->momy = MAXMOVE;
+	else if (pr->momy < -MAXMOVE)
+	    pr->momy = -MAXMOVE;
+
+	xmove = pr->momx;
+	ymove = pr->momy;
+
+	do
+	{
+	    if ((xmove > MAXMOVE/2 || ymove > MAXMOVE/2)
+	     || (singleplayer && (xmove < -MAXMOVE/2 || ymove < -MAXMOVE/2)))
+	    {
+		ptryx = pr->x + xmove/2;
+		ptryy = pr->y + ymove/2;
+		xmove >>= 1;
+		ymove >>= 1;
+	    }
+	    else
+	    {
+		ptryx = pr->x + xmove;
+		ptryy = pr->y + ymove;
+		xmove = ymove = 0;
+	    }
+
+	    if (!PredictTryMove (mo, pr, ptryx, ptryy))
+	    {
+		// Instead of P_SlideMove, which traces along the
+		// blocking lines, only try the move along each axis.
+		if (PredictTryMove (mo, pr, ptryx, pr->y))
+		{
+		    pr->momy = 0;
+		}
+		else if (PredictTryMove (mo, pr, pr->x, ptryy))
+		{
+		    pr->momx = 0;
+		}
+		else
+		{
+		    pr->momx = pr->momy = 0;
+		}
+
+		xmove = ymove = 0;
+	    }
+	} while (xmove || ymove);
+
+	if (player->cheats & CF_NOMOMENTUM)
+	{
+	    pr->momx = pr->momy = 0;
+	}
+	else if (pr->z <= pr->floorz)
+	{
+	    if (pr->momx > -STOPSPEED
+	     && pr->momx < STOPSPEED
+	     && pr->momy > -STOPSPEED
+	     && pr->momy < STOPSPEED
+	     && cmd->forwardmove == 0
+	     && cmd->sidemove == 0)
+	    {
+		pr->momx = 0;
+		pr->momy = 0;
+	    }
+	    else
+	    {
+		pr->momx = FixedMul (pr->momx, FRICTION);
+		pr->momy = FixedMul (pr->momy, FRICTION);
+	    }
+	}
+    }
+
+    // P_ZMovement
+    if (pr->z != pr->floorz || pr->momz)
+    {
+	pr->z += pr->momz;
+
+	if (pr->z <= pr->floorz)
+	{
+	    if (pr->momz < 0)
+		pr->momz = 0;
+	    pr->z = pr->floorz;
+	}
+	else if (!(mo->flags & MF_NOGRAVITY))
+	{
+	    if (pr->momz == 0)
+		pr->momz = -GRAVITY*2;
+	    else
+		pr->momz -= GRAVITY;
+	}
+
+	if (pr->z + mo->height > pr->ceilingz)
+	{
+	    if (pr->momz > 0)
+		pr->momz = 0;
+	    pr->z = pr->ceilingz - mo->height;
+	}
+    }
+}
+
+
+//
+// P_PredictPlayerView
+//
+void P_PredictPlayerView (player_t* player)
+{
+    ticcmd_t	cmds[MAXPREDICTTICS];
+    ticcmd_t	cmd;
+    predict_t	pr;
+    mobj_t*	mo = player->mo;
+    int		numcmds;
+    int		i;
+
+    savedplayer = NULL;
+
+    if (!predict_movement || !netgame || demoplayback || paused
+     || player != &players[consoleplayer]
+     || player->playerstate != PST_LIVE || mo == NULL)
+    {
+	return;
+    }
+
+    numcmds = D_GetPendingTics(cmds, MAXPREDICTTICS);
+
+    if (numcmds == 0)
+	return;
+
+    pr.x = mo->x;
+    pr.y = mo->y;
+    pr.z = mo->z;
+    pr.momx = mo->momx;
+    pr.momy = mo->momy;
+    pr.momz = mo->momz;
+    pr.floorz = mo->floorz;
+    pr.ceilingz = mo->ceilingz;
+    pr.angle = mo->angle;
+    pr.reactiontime = mo->reactiontime;
+
+    // P_PlayerThink sets MF_NOCLIP from the cheat before moving.
+    pr.noclip = (player->cheats & CF_NOCLIP) != 0;
+
+    for (i = 0 ; i < numcmds ; i++)
+    {
+	cmd = cmds[i];
+
+	// chain saw run forward
+	if (i == 0 && (mo->flags & MF_JUSTATTACKED))
+	{
+	    cmd.angleturn = 0;
+	    cmd.forwardmove = 0xc800/512;
+	    cmd.sidemove = 0;
+	}
+
+	PredictTic (player, &pr, &cmd);
+    }
+
+    // Draw from the prediction.
+    savedplayer = player;
+    saved.x = mo->x;
+    saved.y = mo->y;
+    saved.z = mo->z;
+    saved.angle = mo->angle;
+    savedviewz = player->viewz;
+
+    player->viewz = pr.z + (player->viewz - mo->z);
+
+    if (player->viewz > pr.ceilingz - 4*FRACUNIT)
+	player->viewz = pr.ceilingz - 4*FRACUNIT;
+
+    mo->x = pr.x;
+    mo->y = pr.y;
+    mo->z = pr.z;
+    mo->angle = pr.angle;
+}
+
+
+//
+// P_RestorePrediction
+//
+void P_RestorePrediction (void)
+{
+    if (savedplayer == NULL)
+	return;
+
+    savedplayer->mo->x = saved.x;
+    savedplayer->mo->y = saved.y;
+    savedplayer->mo->z = saved.z;
+    savedplayer->mo->angle = saved.angle;
+    savedplayer->viewz = savedviewz;
+
+    savedplayer = NULL;
+}
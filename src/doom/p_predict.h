@@ -0,0 +1,35 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Prediction of the local player's movement in netgames,
+//	for rendering only.
+//
+
+
+#ifndef __P_PREDICT__
+#define __P_PREDICT__
+
+#include "d_player.h"
+
+// Set by -predict in netgames.
+extern boolean predict_movement;
+
+// Move the view of the given player to where its pending ticcmds
+// will take it.  Must be undone with P_RestorePrediction before
+// any game code runs.
+void P_PredictPlayerView (player_t* player);
+void P_RestorePrediction (void);
+
+#endif
@@ -88,7 +88,7 @@ typedef	struct
 
 // [JN] Увеличен лимит до 1280
 // Ранее: #define MAXSEGS (SCREENWIDTH / 2 + 1)
-#define MAXSEGS (SCREENWIDTH / 2 + 1)
+#define MAXSEGS (MAXWIDTH / 2 + 1)
 
 // newend is one past the last valid seg
 cliprange_t*	newend;
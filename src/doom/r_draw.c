@@ -37,13 +37,14 @@
 // State.
 #include "doomstat.h"
 
-// ?
-#define MAXWIDTH    1120
-#define MAXHEIGHT   832
-
 // status bar height at bottom of screen
 #define SBARHEIGHT  (32 << hires)
 
+// In hires mode the low detail drawers halve the vertical resolution as
+// well, drawing 2x2 blocks whatever the multiplier; this is the row shift
+// that goes with it.
+#define LOWDETAILSHIFT (hires != 0)
+
 //
 // All drawing to the view buffer is accomplished in this file.
 // The other refresh files only know about ccordinates,
@@ -62,7 +63,7 @@ int     viewwindowx;
 int     viewwindowy; 
 byte*   ylookup[MAXHEIGHT]; 
 int     columnofs[MAXWIDTH]; 
-int     linesize = SCREENWIDTH;
+int     linesize;
 
 
 // Color tables for different players,
@@ -279,10 +280,10 @@ void R_DrawColumnLow (void)
     // Blocky mode, need to multiply by 2.
     x = dc_x << 1;
 
-    dest = ylookup[(dc_yl << hires)] + columnofs[x];
-    dest2 = ylookup[(dc_yl << hires)] + columnofs[x+1];
-    dest3 = ylookup[(dc_yl << hires) + 1] + columnofs[x];
-    dest4 = ylookup[(dc_yl << hires) + 1] + columnofs[x+1];
+    dest = ylookup[(dc_yl << LOWDETAILSHIFT)] + columnofs[x];
+    dest2 = ylookup[(dc_yl << LOWDETAILSHIFT)] + columnofs[x+1];
+    dest3 = ylookup[(dc_yl << LOWDETAILSHIFT) + 1] + columnofs[x];
+    dest4 = ylookup[(dc_yl << LOWDETAILSHIFT) + 1] + columnofs[x+1];
 
     fracstep = dc_iscale; 
     frac = dc_texturemid + (dc_yl-centery)*fracstep;
@@ -303,14 +304,14 @@ void R_DrawColumnLow (void)
         {
             *dest2 = *dest = dc_colormap[dc_source[frac>>FRACBITS]];
 
-            dest += SCREENWIDTH << hires;
-            dest2 += SCREENWIDTH << hires;
+            dest += SCREENWIDTH << LOWDETAILSHIFT;
+            dest2 += SCREENWIDTH << LOWDETAILSHIFT;
 
-            if (hires)
+            if (LOWDETAILSHIFT)
             {
                 *dest4 = *dest3 = dc_colormap[dc_source[frac>>FRACBITS]];
-                dest3 += SCREENWIDTH << hires;
-                dest4 += SCREENWIDTH << hires;
+                dest3 += SCREENWIDTH << LOWDETAILSHIFT;
+                dest4 += SCREENWIDTH << LOWDETAILSHIFT;
             }
 
             if ((frac += fracstep) >= heightmask)
@@ -323,14 +324,14 @@ void R_DrawColumnLow (void)
         {
             // Hack. Does not work corretly.
             *dest2 = *dest = dc_colormap[dc_source[(frac>>FRACBITS)&heightmask]];
-            dest += SCREENWIDTH << hires;
-            dest2 += SCREENWIDTH << hires;
+            dest += SCREENWIDTH << LOWDETAILSHIFT;
+            dest2 += SCREENWIDTH << LOWDETAILSHIFT;
 
-            if (hires)
+            if (LOWDETAILSHIFT)
             {
                 *dest4 = *dest3 = dc_colormap[dc_source[(frac>>FRACBITS)&heightmask]];
-                dest3 += SCREENWIDTH << hires;
-                dest4 += SCREENWIDTH << hires;
+                dest3 += SCREENWIDTH << LOWDETAILSHIFT;
+                dest4 += SCREENWIDTH << LOWDETAILSHIFT;
             }
 
             frac += fracstep; 
@@ -344,7 +345,7 @@ void R_DrawColumnLow (void)
 // Spectre/Invisibility.
 //
 #define FUZZTABLE   50 
-#define FUZZOFF     (SCREENWIDTH)
+#define FUZZOFF     (1)
 
 int	fuzzoffset[FUZZTABLE] =
 {
@@ -415,7 +416,7 @@ void R_DrawFuzzColumn (void)
         //  a pixel that is either one column
         //  left or right of the current one.
         // Add index from colormap to index.
-        *dest = colormaps[6*256+dest[fuzzoffset[fuzzpos]]]; 
+        *dest = colormaps[6*256+dest[SCREENWIDTH*fuzzoffset[fuzzpos]]]; 
 
         // Clamp table lookup index.
         if (++fuzzpos == FUZZTABLE) 
@@ -430,7 +431,7 @@ void R_DrawFuzzColumn (void)
     // draw one extra line using only pixels of that line and the one above
     if (cutoff)
     {
-        *dest = colormaps[6*256+dest[(fuzzoffset[fuzzpos]-FUZZOFF)/2]];
+        *dest = colormaps[6*256+dest[SCREENWIDTH*(fuzzoffset[fuzzpos]-FUZZOFF)/2]];
     }
 } 
 
@@ -475,10 +476,10 @@ void R_DrawFuzzColumnLow (void)
     }
 #endif
 
-    dest  = ylookup[(dc_yl << hires)] + columnofs[x];
-    dest2 = ylookup[(dc_yl << hires)] + columnofs[x+1];
-    dest3 = ylookup[(dc_yl << hires) + 1] + columnofs[x];
-    dest4 = ylookup[(dc_yl << hires) + 1] + columnofs[x+1];
+    dest  = ylookup[(dc_yl << LOWDETAILSHIFT)] + columnofs[x];
+    dest2 = ylookup[(dc_yl << LOWDETAILSHIFT)] + columnofs[x+1];
+    dest3 = ylookup[(dc_yl << LOWDETAILSHIFT) + 1] + columnofs[x];
+    dest4 = ylookup[(dc_yl << LOWDETAILSHIFT) + 1] + columnofs[x+1];
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -493,22 +494,22 @@ void R_DrawFuzzColumnLow (void)
         //  a pixel that is either one column
         //  left or right of the current one.
         // Add index from colormap to index.
-        *dest = colormaps[6*256+dest[fuzzoffset[fuzzpos]]]; 
-        *dest2 = colormaps[6*256+dest2[fuzzoffset[fuzzpos]]]; 
-        if (hires)
+        *dest = colormaps[6*256+dest[SCREENWIDTH*fuzzoffset[fuzzpos]]]; 
+        *dest2 = colormaps[6*256+dest2[SCREENWIDTH*fuzzoffset[fuzzpos]]]; 
+        if (LOWDETAILSHIFT)
         {
-            *dest3 = colormaps[6*256+dest[fuzzoffset[fuzzpos]]];
-            *dest4 = colormaps[6*256+dest2[fuzzoffset[fuzzpos]]];
-            dest3 += SCREENWIDTH << hires;
-            dest4 += SCREENWIDTH << hires;
+            *dest3 = colormaps[6*256+dest[SCREENWIDTH*fuzzoffset[fuzzpos]]];
+            *dest4 = colormaps[6*256+dest2[SCREENWIDTH*fuzzoffset[fuzzpos]]];
+            dest3 += SCREENWIDTH << LOWDETAILSHIFT;
+            dest4 += SCREENWIDTH << LOWDETAILSHIFT;
         }
 
         // Clamp table lookup index.
         if (++fuzzpos == FUZZTABLE) 
         fuzzpos = 0;
 
-        dest += SCREENWIDTH << hires;
-        dest2 += SCREENWIDTH << hires;
+        dest += SCREENWIDTH << LOWDETAILSHIFT;
+        dest2 += SCREENWIDTH << LOWDETAILSHIFT;
 
         frac += fracstep; 
     } while (count--); 
@@ -517,9 +518,9 @@ void R_DrawFuzzColumnLow (void)
     // draw one extra line using only pixels of that line and the one above
     if (cutoff)
     {
-        *dest = colormaps[6*256+dest[(fuzzoffset[fuzzpos]-FUZZOFF)/2]];
-        *dest2 = colormaps[6*256+dest2[(fuzzoffset[fuzzpos]-FUZZOFF)/2]];
-        if (hires)
+        *dest = colormaps[6*256+dest[SCREENWIDTH*(fuzzoffset[fuzzpos]-FUZZOFF)/2]];
+        *dest2 = colormaps[6*256+dest2[SCREENWIDTH*(fuzzoffset[fuzzpos]-FUZZOFF)/2]];
+        if (LOWDETAILSHIFT)
         {
             *dest3 = *dest;
             *dest4 = *dest2;
@@ -605,10 +606,10 @@ void R_DrawTranslatedColumnLow (void)
     }
 #endif 
 
-    dest  = ylookup[(dc_yl << hires)] + columnofs[x];
-    dest2 = ylookup[(dc_yl << hires)] + columnofs[x+1];
-    dest3 = ylookup[(dc_yl << hires) + 1] + columnofs[x];
-    dest4 = ylookup[(dc_yl << hires) + 1] + columnofs[x+1];
+    dest  = ylookup[(dc_yl << LOWDETAILSHIFT)] + columnofs[x];
+    dest2 = ylookup[(dc_yl << LOWDETAILSHIFT)] + columnofs[x+1];
+    dest3 = ylookup[(dc_yl << LOWDETAILSHIFT) + 1] + columnofs[x];
+    dest4 = ylookup[(dc_yl << LOWDETAILSHIFT) + 1] + columnofs[x+1];
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -624,14 +625,14 @@ void R_DrawTranslatedColumnLow (void)
         //  is mapped to gray, red, black/indigo. 
         *dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
         *dest2 = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-        dest += SCREENWIDTH << hires;
-        dest2 += SCREENWIDTH << hires;
-        if (hires)
+        dest += SCREENWIDTH << LOWDETAILSHIFT;
+        dest2 += SCREENWIDTH << LOWDETAILSHIFT;
+        if (LOWDETAILSHIFT)
         {
             *dest3 = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
             *dest4 = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-            dest3 += SCREENWIDTH << hires;
-            dest4 += SCREENWIDTH << hires;
+            dest3 += SCREENWIDTH << LOWDETAILSHIFT;
+            dest4 += SCREENWIDTH << LOWDETAILSHIFT;
         }
 
         frac += fracstep; 
@@ -697,10 +698,10 @@ void R_DrawTLColumnLow (void)
     }
 #endif
 
-    dest  = ylookup[(dc_yl << hires)] + columnofs[x];
-    dest2 = ylookup[(dc_yl << hires)] + columnofs[x+1];
-    dest3 = ylookup[(dc_yl << hires) + 1] + columnofs[x];
-    dest4 = ylookup[(dc_yl << hires) + 1] + columnofs[x+1];
+    dest  = ylookup[(dc_yl << LOWDETAILSHIFT)] + columnofs[x];
+    dest2 = ylookup[(dc_yl << LOWDETAILSHIFT)] + columnofs[x+1];
+    dest3 = ylookup[(dc_yl << LOWDETAILSHIFT) + 1] + columnofs[x];
+    dest4 = ylookup[(dc_yl << LOWDETAILSHIFT) + 1] + columnofs[x+1];
 
     fracstep = dc_iscale;
     frac = dc_texturemid + (dc_yl-centery)*fracstep;
@@ -709,15 +710,15 @@ void R_DrawTLColumnLow (void)
     {
         *dest = tranmap[(*dest<<8)+dc_colormap[dc_source[frac>>FRACBITS]]];
         *dest2 = tranmap[(*dest2<<8)+dc_colormap[dc_source[frac>>FRACBITS]]];
-        dest += SCREENWIDTH << hires;
-        dest2 += SCREENWIDTH << hires;
+        dest += SCREENWIDTH << LOWDETAILSHIFT;
+        dest2 += SCREENWIDTH << LOWDETAILSHIFT;
 
-        if (hires)
+        if (LOWDETAILSHIFT)
         {
             *dest3 = tranmap[(*dest3<<8)+dc_colormap[dc_source[frac>>FRACBITS]]];
             *dest4 = tranmap[(*dest4<<8)+dc_colormap[dc_source[frac>>FRACBITS]]];
-            dest3 += SCREENWIDTH << hires;
-            dest4 += SCREENWIDTH << hires;
+            dest3 += SCREENWIDTH << LOWDETAILSHIFT;
+            dest4 += SCREENWIDTH << LOWDETAILSHIFT;
         }
 
         frac += fracstep;
@@ -947,8 +948,8 @@ void R_DrawSpanLow (void)
     ds_x1 <<= 1;
     ds_x2 <<= 1;
 
-    dest = ylookup[(ds_y << hires)] + columnofs[ds_x1];
-    dest2 = ylookup[(ds_y << hires) + 1] + columnofs[ds_x1];
+    dest = ylookup[(ds_y << LOWDETAILSHIFT)] + columnofs[ds_x1];
+    dest2 = ylookup[(ds_y << LOWDETAILSHIFT) + 1] + columnofs[ds_x1];
 
     do
     {
@@ -962,7 +963,7 @@ void R_DrawSpanLow (void)
         //  while scale is adjusted appropriately.
         *dest++ = ds_colormap[ds_source[spot]];
         *dest++ = ds_colormap[ds_source[spot]];
-        if (hires)
+        if (LOWDETAILSHIFT)
         {
             *dest2++ = ds_colormap[ds_source[spot]];
             *dest2++ = ds_colormap[ds_source[spot]];
@@ -987,6 +988,8 @@ void R_InitBuffer (int width, int height)
 { 
     int i; 
 
+    linesize = SCREENWIDTH;
+
     // Handle resize,
     //  e.g. smaller view windows
     //  with border and/or status bar.
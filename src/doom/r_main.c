@@ -27,6 +27,7 @@
 
 #include "doomdef.h"
 #include "d_loop.h"
+#include "i_timer.h"
 #include "m_bbox.h"
 #include "m_menu.h"
 #include "r_local.h"
@@ -86,7 +87,7 @@ int viewangletox[FINEANGLES/2];
 // The xtoviewangleangle[] table maps a screen pixel
 // to the lowest viewangle that maps back to x ranges
 // from clipangle to -clipangle.
-angle_t xtoviewangle[SCREENWIDTH+1];
+angle_t xtoviewangle[MAXWIDTH+1];
 
 lighttable_t* scalelight[LIGHTLEVELS][MAXLIGHTSCALE];
 lighttable_t* scalelightfixed[MAXLIGHTSCALE];
@@ -625,6 +626,23 @@ boolean setsizeneeded;
 int     setblocks;
 int     setdetail;
 
+//
+// Automatic detail level.
+// When enabled, the time spent in R_RenderPlayerView is measured every
+// frame. While the running average exceeds auto_detail_budget
+// milliseconds the view falls back to low detail, and high detail is
+// restored once there is enough headroom again.
+//
+int     auto_detail = 0;
+int     auto_detail_budget = 28;
+
+// Minimum number of frames between two automatic detail switches.
+#define AUTODETAIL_HOLD 35
+
+static int     autodetail_avg;      // running average, microseconds
+static int     autodetail_frames;   // frames since the last switch
+static boolean autodetail_low;      // currently forced to low detail
+
 
 void R_SetViewSize (int blocks, int detail)
 {
@@ -659,7 +677,7 @@ void R_ExecuteSetViewSize (void)
         scaledviewheight = ((setblocks*168/10)&~7)<<hires;
     }
 
-    detailshift = setdetail;
+    detailshift = setdetail || autodetail_low;
     viewwidth = scaledviewwidth>>detailshift;
     viewheight = scaledviewheight>>(detailshift && hires);
 
@@ -836,12 +854,66 @@ void R_SetupFrame (player_t* player)
 }
 
 
+//
+// R_UpdateAutoDetail
+// Feed the render time of the last frame, in microseconds, to the
+// automatic detail level and request a view size change if it has to
+// switch. A negative time means the frame gave no sample.
+//
+static void R_UpdateAutoDetail (int frametime)
+{
+    int budget;
+
+    if (!auto_detail || setdetail)
+    {
+        // Disabled, or low detail was chosen by the player anyway.
+        if (autodetail_low)
+        {
+            autodetail_low = false;
+            R_SetViewSize (setblocks, setdetail);
+        }
+        return;
+    }
+
+    if (frametime < 0)
+    {
+        return;
+    }
+
+    // Exponential moving average, weighting the newest frame by 1/8.
+    autodetail_avg += (frametime - autodetail_avg) >> 3;
+
+    if (++autodetail_frames < AUTODETAIL_HOLD)
+    {
+        return;
+    }
+
+    budget = auto_detail_budget * 1000;
+
+    // Low detail roughly halves the column work, so only go back up
+    // when the low detail frame time leaves room for that.
+    if ((!autodetail_low && autodetail_avg > budget)
+     || (autodetail_low && autodetail_avg < budget / 2))
+    {
+        autodetail_low = !autodetail_low;
+        autodetail_frames = 0;
+        R_SetViewSize (setblocks, setdetail);
+    }
+}
+
+
 //
 // R_RenderView
 //
 void R_RenderPlayerView (player_t* player)
 {	
     extern boolean automapactive;
+    uint64_t starttime;
+    int rendertime;
+
+    // Only the rendering is timed for the automatic detail level, not
+    // the NetUpdate calls in between.
+    starttime = I_GetTimeUS();
 
     R_SetupFrame (player);
 
@@ -851,28 +923,41 @@ void R_RenderPlayerView (player_t* player)
     if (automapactive)
     {
         R_RenderBSPNode (numnodes-1);
+
+        // Only the BSP is walked here, which says nothing about the
+        // cost of the full view.
+        R_UpdateAutoDetail (-1);
         return;
     }
     R_ClearPlanes ();
     R_ClearSprites ();
+    rendertime = I_GetTimeUS() - starttime;
 
     // check for new console commands.
     NetUpdate ();
 
     // The head node is the last node output.
+    starttime = I_GetTimeUS();
     R_RenderBSPNode (numnodes-1);
+    rendertime += I_GetTimeUS() - starttime;
 
     // Check for new console commands.
     NetUpdate ();
 
+    starttime = I_GetTimeUS();
     R_DrawPlanes ();
+    rendertime += I_GetTimeUS() - starttime;
 
     // Check for new console commands.
     NetUpdate ();
 
+    starttime = I_GetTimeUS();
     R_DrawMasked ();
+    rendertime += I_GetTimeUS() - starttime;
 
     // Check for new console commands.
     NetUpdate ();				
+
+    R_UpdateAutoDetail (rendertime);
 }
 
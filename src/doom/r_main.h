@@ -93,6 +93,10 @@ extern lighttable_t* fixedcolormap;
 //  0 = high, 1 = low
 extern int detailshift;	
 
+// Automatic detail level, see R_UpdateAutoDetail.
+extern int auto_detail;
+extern int auto_detail_budget;
+
 
 //
 // Function pointers to switch refresh/drawing functions.
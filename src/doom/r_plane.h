@@ -33,11 +33,11 @@ typedef void (*planefunction_t) (int top, int bottom);
 extern planefunction_t floorfunc;
 extern planefunction_t ceilingfunc_t;
 
-extern int floorclip[SCREENWIDTH];   // [crispy] 32-bit integer math
-extern int ceilingclip[SCREENWIDTH]; // [crispy] 32-bit integer math
+extern int floorclip[MAXWIDTH];   // [crispy] 32-bit integer math
+extern int ceilingclip[MAXWIDTH]; // [crispy] 32-bit integer math
 
-extern fixed_t yslope[SCREENHEIGHT];
-extern fixed_t distscale[SCREENWIDTH];
+extern fixed_t yslope[MAXHEIGHT];
+extern fixed_t distscale[MAXWIDTH];
 
 void R_InitPlanes (void);
 void R_ClearPlanes (void);
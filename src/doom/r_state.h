@@ -114,7 +114,7 @@ extern player_t* viewplayer;
 extern angle_t clipangle;
 
 extern int     viewangletox[FINEANGLES/2];
-extern angle_t xtoviewangle[SCREENWIDTH+1];
+extern angle_t xtoviewangle[MAXWIDTH+1];
 //extern fixed_t		finetangent[FINEANGLES/2];
 
 extern fixed_t rw_distance;
@@ -80,8 +80,8 @@ lighttable_t** fullbrights_dimmeditems;
 
 // constant arrays
 //  used for psprite clipping and initializing clipping
-int negonearray[SCREENWIDTH];
-int screenheightarray[SCREENWIDTH];
+int negonearray[MAXWIDTH];
+int screenheightarray[MAXWIDTH];
 
 
 //
@@ -973,8 +973,8 @@ void R_SortVisSprites (void)
 void R_DrawSprite (vissprite_t* spr)
 {
     drawseg_t*  ds;
-    int         clipbot[SCREENWIDTH];
-    int         cliptop[SCREENWIDTH];
+    int         clipbot[MAXWIDTH];
+    int         cliptop[MAXWIDTH];
     int         x;
     int         r1;
     int         r2;
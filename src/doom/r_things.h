@@ -32,8 +32,8 @@ extern vissprite_t  vsprsortedhead;
 
 // Constant arrays used for psprite clipping
 //  and initializing clipping.
-extern int negonearray[SCREENWIDTH];
-extern int screenheightarray[SCREENWIDTH];
+extern int negonearray[MAXWIDTH];
+extern int screenheightarray[MAXWIDTH];
 
 // vars for R_DrawMaskedColumn
 extern int* mfloorclip;
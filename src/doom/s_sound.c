@@ -20,6 +20,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "i_sound.h"
 #include "i_system.h"
@@ -80,12 +81,49 @@ typedef struct
 
     int pitch;
 
+    // volume of the sound, used to choose a channel to take over
+    int volume;
+
+    // next channel in the same origin_hash chain, or -1
+    int hashnext;
+
+    // positions and settings that the volume and separation were
+    //  last calculated for, so that they are not recalculated
+    //  while nothing has changed
+    fixed_t listener_x, listener_y;
+    angle_t listener_angle;
+    fixed_t origin_x, origin_y;
+    int sfx_volume;
+    boolean mono;
+
 } channel_t;
 
 // The set of channels available
 
 static channel_t *channels;
 
+// Channels not in use, taken from the top.
+
+static int *free_channels;
+static int num_free_channels;
+
+// Hash table of channels in use, by origin, so that the sound playing
+// for an origin is found without looking through all the channels.
+// Each origin plays one sound at a time.
+
+static int *origin_hash;
+static int origin_hash_bits;
+
+// Sound statistics, for -soundstats.
+
+static unsigned int stat_started;
+static unsigned int stat_culled;
+static unsigned int stat_taken_over;
+static unsigned int stat_dropped;
+static unsigned int stat_updated;
+static unsigned int stat_unchanged;
+static int stat_peak_channels;
+
 // Maximum volume of a sound effect.
 // Internal default is max out of 0-15.
 
@@ -111,6 +149,50 @@ static musicinfo_t *mus_playing = NULL;
 
 int snd_channels = 64;
 
+//
+// Write the statistics gathered for -soundstats.
+//
+
+static void S_DumpStats(void)
+{
+    FILE *stream;
+    int i;
+
+    i = M_CheckParmWithArgs("-soundstats", 1);
+
+    // Allow "-" as output file, for stdout.
+
+    if (strcmp(myargv[i + 1], "-") != 0)
+    {
+        stream = fopen(myargv[i + 1], "w");
+
+        if (stream == NULL)
+        {
+            fprintf(stderr, "S_DumpStats: Failed to open %s\n",
+                            myargv[i + 1]);
+            return;
+        }
+    }
+    else
+    {
+        stream = stdout;
+    }
+
+    fprintf(stream, "Sounds started: %u, culled as inaudible: %u\n",
+                    stat_started, stat_culled);
+    fprintf(stream, "Took over a channel: %u, no channel: %u\n",
+                    stat_taken_over, stat_dropped);
+    fprintf(stream, "Peak channels in use: %i of %i\n",
+                    stat_peak_channels, snd_channels);
+    fprintf(stream, "Channel updates: %u, unchanged: %u\n",
+                    stat_updated, stat_unchanged);
+
+    if (stream != stdout)
+    {
+        fclose(stream);
+    }
+}
+
 //
 // Initializes sound stuff, including volume
 // Sets channels, SFX and music volume,
@@ -147,10 +229,27 @@ void S_Init(int sfxVolume, int musicVolume)
     // simultaneously) within zone memory.
     channels = Z_Malloc(snd_channels*sizeof(channel_t), PU_STATIC, 0);
 
+    free_channels = Z_Malloc(snd_channels*sizeof(int), PU_STATIC, 0);
+
     // Free all channels for use
     for (i=0 ; i<snd_channels ; i++)
     {
         channels[i].sfxinfo = 0;
+        free_channels[i] = snd_channels - 1 - i;
+    }
+    num_free_channels = snd_channels;
+
+    // At least twice as many hash chains as channels.
+    for (origin_hash_bits = 1;
+         (1 << origin_hash_bits) < snd_channels * 2;
+         ++origin_hash_bits);
+
+    origin_hash = Z_Malloc((1 << origin_hash_bits) * sizeof(int),
+                           PU_STATIC, 0);
+
+    for (i=0 ; i<(1 << origin_hash_bits) ; i++)
+    {
+        origin_hash[i] = -1;
     }
 
     // no sounds are playing, and they are not mus_paused
@@ -168,6 +267,20 @@ void S_Init(int sfxVolume, int musicVolume)
         snd_pitchshift = 0;
     }
 
+    //!
+    // @arg <filename>
+    //
+    // Write sound effect statistics to the specified file on exit:
+    // how many sounds were started, culled as inaudible, or had no
+    // channel, and how often channel parameters were recalculated.
+    // Use "-" to write to stdout.
+    //
+
+    if (M_CheckParmWithArgs("-soundstats", 1))
+    {
+        I_AtExit(S_DumpStats, true);
+    }
+
     I_AtExit(S_Shutdown, true);
 }
 
@@ -177,9 +290,57 @@ void S_Shutdown(void)
     I_ShutdownMusic();
 }
 
+//
+// Origin hash table.
+//
+
+static int S_OriginHash(mobj_t *origin)
+{
+    unsigned int key = (unsigned int) ((uintptr_t) origin >> 3);
+
+    return (key * 2654435761u) >> (32 - origin_hash_bits);
+}
+
+// Find the channel playing a sound for the given origin, or -1.
+
+static int S_FindChannel(mobj_t *origin)
+{
+    int cnum;
+
+    for (cnum = origin_hash[S_OriginHash(origin)]; cnum >= 0;
+         cnum = channels[cnum].hashnext)
+    {
+        if (channels[cnum].origin == origin)
+        {
+            break;
+        }
+    }
+
+    return cnum;
+}
+
+static void S_HashChannel(int cnum)
+{
+    int h = S_OriginHash(channels[cnum].origin);
+
+    channels[cnum].hashnext = origin_hash[h];
+    origin_hash[h] = cnum;
+}
+
+static void S_UnhashChannel(int cnum)
+{
+    int *link = &origin_hash[S_OriginHash(channels[cnum].origin)];
+
+    while (*link != cnum)
+    {
+        link = &channels[*link].hashnext;
+    }
+
+    *link = channels[cnum].hashnext;
+}
+
 static void S_StopChannel(int cnum)
 {
-    int i;
     channel_t *c;
 
     c = &channels[cnum];
@@ -193,21 +354,14 @@ static void S_StopChannel(int cnum)
             I_StopSound(c->handle);
         }
 
-        // check to see if other channels are playing the sound
-
-        for (i=0; i<snd_channels; i++)
-        {
-            if (cnum != i && c->sfxinfo == channels[i].sfxinfo)
-            {
-                break;
-            }
-        }
-
         // degrade usefulness of sound data
 
         c->sfxinfo->usefulness--;
+
+        S_UnhashChannel(cnum);
         c->sfxinfo = NULL;
         c->origin = NULL;
+        free_channels[num_free_channels++] = cnum;
     }
 }
 
@@ -289,18 +443,76 @@ void S_Start(void)
     S_ChangeMusic(mnum, true);
 }
 
-void S_StopSound(mobj_t *origin)
+//
+// Tell the sound module which sound effects the things in the level
+// can make, so that it can prepare them before they are first heard.
+// Sounds made when monsters wake up come first.
+//
+
+static void S_AddPrefetchSound(int sfx_id, sfxinfo_t **sounds,
+                               boolean *added, int *num_sounds)
 {
-    int cnum;
+    if (sfx_id > sfx_None && sfx_id < NUMSFX && !added[sfx_id])
+    {
+        added[sfx_id] = true;
+        sounds[(*num_sounds)++] = &S_sfx[sfx_id];
+    }
+}
 
-    for (cnum=0 ; cnum<snd_channels ; cnum++)
+void S_PrefetchLevelSounds(void)
+{
+    static sfxinfo_t *sounds[NUMSFX];
+    boolean added[NUMSFX];
+    int num_sounds = 0;
+    thinker_t *th;
+    mobjinfo_t *info;
+    int pass;
+
+    memset(added, 0, sizeof(added));
+
+    for (pass = 0; pass < 2; ++pass)
     {
-        if (channels[cnum].sfxinfo && channels[cnum].origin == origin)
+        for (th = thinkercap.next; th != &thinkercap; th = th->next)
         {
-            S_StopChannel(cnum);
-            break;
+            if (th->function.acp1 != (actionf_p1) P_MobjThinker)
+            {
+                continue;
+            }
+
+            info = ((mobj_t *) th)->info;
+
+            if (pass == 0)
+            {
+                S_AddPrefetchSound(info->seesound, sounds, added,
+                                   &num_sounds);
+                S_AddPrefetchSound(info->activesound, sounds, added,
+                                   &num_sounds);
+            }
+            else
+            {
+                S_AddPrefetchSound(info->attacksound, sounds, added,
+                                   &num_sounds);
+                S_AddPrefetchSound(info->painsound, sounds, added,
+                                   &num_sounds);
+                S_AddPrefetchSound(info->deathsound, sounds, added,
+                                   &num_sounds);
+            }
         }
     }
+
+    I_PrefetchSounds(sounds, num_sounds);
+}
+
+void S_StopSound(mobj_t *origin)
+{
+    int cnum;
+
+    cnum = S_FindChannel(origin);
+
+    if (cnum >= 0)
+    {
+        S_StopChannel(cnum);
+    }
 }
 
 //
@@ -308,60 +520,103 @@ void S_StopSound(mobj_t *origin)
 //   If none available, return -1.  Otherwise channel #.
 //
 
-static int S_GetChannel(mobj_t *origin, sfxinfo_t *sfxinfo)
+static int S_GetChannel(mobj_t *origin, sfxinfo_t *sfxinfo, int volume)
 {
     // channel number to use
     int                cnum;
+    int                i;
 
     channel_t*        c;
 
-    // Find an open channel
-    for (cnum=0 ; cnum<snd_channels ; cnum++)
-    {
-        if (!channels[cnum].sfxinfo)
-        {
-            break;
-        }
-        else if (origin && channels[cnum].origin == origin)
-        {
-            S_StopChannel(cnum);
-            break;
-        }
-    }
-
     // None available
-    if (cnum == snd_channels)
+    if (num_free_channels == 0)
     {
-        // Look for lower priority
-        for (cnum=0 ; cnum<snd_channels ; cnum++)
+        // Look for the lowest priority, and of those the quietest,
+        // which may be no more important than the new sound.
+        cnum = -1;
+
+        for (i=0 ; i<snd_channels ; i++)
         {
-            if (channels[cnum].sfxinfo->priority >= sfxinfo->priority)
+            c = &channels[i];
+
+            if (c->sfxinfo->priority < sfxinfo->priority
+             || (c->sfxinfo->priority == sfxinfo->priority
+              && c->volume > volume))
+            {
+                continue;
+            }
+
+            if (cnum < 0
+             || c->sfxinfo->priority > channels[cnum].sfxinfo->priority
+             || (c->sfxinfo->priority == channels[cnum].sfxinfo->priority
+              && c->volume < channels[cnum].volume))
             {
-                break;
+                cnum = i;
             }
         }
 
-        if (cnum == snd_channels)
+        if (cnum < 0)
         {
             // FUCK!  No lower priority.  Sorry, Charlie.
+            ++stat_dropped;
             return -1;
         }
         else
         {
             // Otherwise, kick out lower priority.
             S_StopChannel(cnum);
+            ++stat_taken_over;
         }
     }
 
+    // Find an open channel
+    cnum = free_channels[--num_free_channels];
+
+    if (snd_channels - num_free_channels > stat_peak_channels)
+    {
+        stat_peak_channels = snd_channels - num_free_channels;
+    }
+
     c = &channels[cnum];
 
     // channel is decided to be cnum.
     c->sfxinfo = sfxinfo;
     c->origin = origin;
+    c->volume = volume;
+    S_HashChannel(cnum);
 
     return cnum;
 }
 
+//
+// Remember what a channel's volume and separation were calculated
+//  for.  Returns false if nothing has changed since the last time.
+//
+
+static boolean S_SaveChannelParams(channel_t *c, mobj_t *listener)
+{
+    if (c->listener_x == listener->x
+     && c->listener_y == listener->y
+     && c->listener_angle == listener->angle
+     && c->origin_x == c->origin->x
+     && c->origin_y == c->origin->y
+     && c->sfx_volume == snd_SfxVolume
+     && c->mono == monosfx)
+    {
+        return false;
+    }
+
+    c->listener_x = listener->x;
+    c->listener_y = listener->y;
+    c->listener_angle = listener->angle;
+    c->origin_x = c->origin->x;
+    c->origin_y = c->origin->y;
+    c->sfx_volume = snd_SfxVolume;
+    c->mono = monosfx;
+
+    return true;
+}
+
 //
 // Changes volume and stereo-separation variables
 //  from the norm of a sound effect to be played.
@@ -382,6 +637,13 @@ static int S_AdjustSoundParams(mobj_t *listener, mobj_t *source,
     adx = abs(listener->x - source->x);
     ady = abs(listener->y - source->y);
 
+    // A source out of range along either axis is out of range.
+    if ((gamemap != 8 || gamemode == commercial)
+     && (adx > S_CLIPPING_DIST || ady > S_CLIPPING_DIST))
+    {
+        return 0;
+    }
+
     // From _GG1_ p.428. Appox. eucledian distance fast.
     approx_dist = adx + ady - ((adx < ady ? adx : ady)>>1);
 
@@ -518,6 +780,7 @@ void S_StartSound(void *origin_p, int sfx_id)
 
         if (!rc)
         {
+            ++stat_culled;
             return;
         }
     }
@@ -526,6 +789,8 @@ void S_StartSound(void *origin_p, int sfx_id)
         sep = NORM_SEP;
     }
 
+    ++stat_started;
+
     // hacks to vary the sfx pitches
     if (sfx_id >= sfx_sawup && sfx_id <= sfx_sawhit)
     {
@@ -541,7 +806,7 @@ void S_StartSound(void *origin_p, int sfx_id)
     S_StopSound(origin);
 
     // try to find a channel
-    cnum = S_GetChannel(origin, sfx);
+    cnum = S_GetChannel(origin, sfx, volume);
 
     if (cnum < 0)
     {
@@ -559,6 +824,11 @@ void S_StartSound(void *origin_p, int sfx_id)
         sfx->lumpnum = I_GetSfxLumpNum(sfx);
     }
 
+    if (origin && origin != players[consoleplayer].mo)
+    {
+        S_SaveChannelParams(&channels[cnum], players[consoleplayer].mo);
+    }
+
     channels[cnum].pitch = pitch;
     channels[cnum].handle = I_StartSound(sfx, cnum, volume, sep, channels[cnum].pitch);
 }
@@ -628,9 +898,17 @@ void S_UpdateSounds(mobj_t *listener)
                 }
 
                 // check non-local sounds for distance clipping
-                //  or modify their params
-                if (c->origin && listener != c->origin)
+                //  or modify their params, unless neither they nor
+                //  the listener have moved
+                if (c->origin && listener != c->origin
+                 && !S_SaveChannelParams(c, listener))
+                {
+                    ++stat_unchanged;
+                }
+                else if (c->origin && listener != c->origin)
                 {
+                    ++stat_updated;
+
                     audible = S_AdjustSoundParams(listener,
                                                   c->origin,
                                                   &volume,
@@ -642,6 +920,7 @@ void S_UpdateSounds(mobj_t *listener)
                     }
                     else
                     {
+                        c->volume = volume;
                         I_UpdateSoundParams(c->handle, volume, sep);
                     }
                 }
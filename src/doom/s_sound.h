@@ -48,6 +48,12 @@ void S_Shutdown(void);
 
 void S_Start(void);
 
+//
+// Prepare the sounds of the things in the level, after it is set up.
+//
+
+void S_PrefetchLevelSounds(void);
+
 //
 // Start sound for thing at <origin>
 //  using <sound_id> from sounds.h
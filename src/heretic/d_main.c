@@ -968,6 +968,7 @@ void D_DoomMain(void)
     D_BindVariables();
     M_SetConfigFilenames(/*"heretic.cfg", */PROGRAM_PREFIX "heretic.cfg");
     M_LoadDefaults();
+    I_CheckHiresParm();
 
     I_AtExit(M_SaveDefaults, false);
 
@@ -48,15 +48,15 @@ short openings[MAXOPENINGS], *lastopening;
 // floorclip starts out SCREENHEIGHT
 // ceilingclip starts out -1
 //
-short floorclip[SCREENWIDTH];
-short ceilingclip[SCREENWIDTH];
+short floorclip[MAXWIDTH];
+short ceilingclip[MAXWIDTH];
 
 //
 // spanstart holds the start of a plane span
 // initialized to 0 at start
 //
-int spanstart[SCREENHEIGHT];
-int spanstop[SCREENHEIGHT];
+int spanstart[MAXHEIGHT];
+int spanstop[MAXHEIGHT];
 
 //
 // texture mapping
@@ -64,14 +64,14 @@ int spanstop[SCREENHEIGHT];
 lighttable_t **planezlight;
 fixed_t planeheight;
 
-fixed_t yslope[SCREENHEIGHT];
-fixed_t distscale[SCREENWIDTH];
+fixed_t yslope[MAXHEIGHT];
+fixed_t distscale[MAXWIDTH];
 fixed_t basexscale, baseyscale;
 
-fixed_t cachedheight[SCREENHEIGHT];
-fixed_t cacheddistance[SCREENHEIGHT];
-fixed_t cachedxstep[SCREENHEIGHT];
-fixed_t cachedystep[SCREENHEIGHT];
+fixed_t cachedheight[MAXHEIGHT];
+fixed_t cacheddistance[MAXHEIGHT];
+fixed_t cachedxstep[MAXHEIGHT];
+fixed_t cachedystep[MAXHEIGHT];
 
 
 /*
@@ -410,6 +410,7 @@ static void ShadeLine(int x, int y, int height, int shade)
 {
     byte *dest;
     byte *shades;
+    int i;
 
     x <<= hires;
     y <<= hires;
@@ -419,8 +420,8 @@ static void ShadeLine(int x, int y, int height, int shade)
     dest = I_VideoBuffer + y * SCREENWIDTH + x;
     while (height--)
     {
-        if (hires)
-           *(dest + 1) = *(shades + *dest);
+        for (i = 1; i < (1 << hires); i++)
+           *(dest + i) = *(shades + *dest);
         *(dest) = *(shades + *dest);
         dest += SCREENWIDTH;
     }
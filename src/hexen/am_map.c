@@ -39,8 +39,8 @@ static int grid = 0;
 static int leveljuststarted = 1;        // kluge until AM_LevelInit() is called
 
 boolean automapactive = false;
-static int finit_width = SCREENWIDTH;
-static int finit_height = SCREENHEIGHT - SBARHEIGHT - (3 << hires);
+static int finit_width;
+static int finit_height;
 static int f_x, f_y;            // location of window on screen
 static int f_w, f_h;            // size of window on screen
 static int lightlev;            // used for funky strobing effect
@@ -353,6 +353,10 @@ void AM_LevelInit(void)
 {
     leveljuststarted = 0;
 
+    // Window size depends on the rendering resolution chosen at startup.
+    finit_width = SCREENWIDTH;
+    finit_height = SCREENHEIGHT - SBARHEIGHT - (3 << hires);
+
     f_x = f_y = 0;
     f_w = finit_width;
     f_h = finit_height;
@@ -721,7 +725,7 @@ void AM_clearFB(int color)
     }
 
     //blit the automap background to the screen.
-    j = (mapystart & ~hires) * (finit_width >> hires);
+    j = (mapystart & ~((1 << hires) - 1)) * (finit_width >> hires);
     for (i = 0; i < SCREENHEIGHT - SBARHEIGHT; i++)
     {
         memcpy(I_VideoBuffer + i * finit_width, maplump + j + mapxstart,
@@ -413,6 +413,7 @@ void D_DoomMain(void)
     D_SetDefaultSavePath();
     M_SetConfigFilenames(/*"hexen.cfg", */PROGRAM_PREFIX "hexen.cfg");
     M_LoadDefaults();
+    I_CheckHiresParm();
 
     I_AtExit(M_SaveDefaults, false);
 
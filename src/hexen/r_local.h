@@ -26,9 +26,6 @@
 
 #define BASEYCENTER                     100
 
-#define MAXWIDTH                        1120
-#define MAXHEIGHT                       832
-
 #define PI                                      3.141592657
 
 #define CENTERY                         (SCREENHEIGHT/2)
@@ -205,7 +202,7 @@ typedef byte lighttable_t;      // this could be wider for >8 bit display
 // [JN] MAXVISPLANES увеличено в 8 раз
 #define MAXVISPLANES    160*8
 // [JN] MAXOPENINGS увеличено в 4 раза
-#define MAXOPENINGS             SCREENWIDTH*64*4
+#define MAXOPENINGS             MAXWIDTH*64*4
 
 typedef struct
 {
@@ -215,10 +212,10 @@ typedef struct
     int special;
     int minx, maxx;
     unsigned short pad1;                  // leave pads for [minx-1]/[maxx+1]
-    unsigned short top[SCREENWIDTH];
+    unsigned short top[MAXWIDTH];
     unsigned short pad2;
     unsigned short pad3;
-    unsigned short bottom[SCREENWIDTH];
+    unsigned short bottom[MAXWIDTH];
     unsigned short pad4;
 } visplane_t;
 
@@ -323,7 +320,7 @@ extern player_t *viewplayer;
 extern angle_t clipangle;
 
 extern int viewangletox[FINEANGLES / 2];
-extern angle_t xtoviewangle[SCREENWIDTH + 1];
+extern angle_t xtoviewangle[MAXWIDTH + 1];
 
 extern fixed_t rw_distance;
 extern angle_t rw_normalangle;
@@ -415,11 +412,11 @@ extern int skyflatnum;
 
 extern short openings[MAXOPENINGS], *lastopening;
 
-extern short floorclip[SCREENWIDTH];
-extern short ceilingclip[SCREENWIDTH];
+extern short floorclip[MAXWIDTH];
+extern short ceilingclip[MAXWIDTH];
 
-extern fixed_t yslope[SCREENHEIGHT];
-extern fixed_t distscale[SCREENWIDTH];
+extern fixed_t yslope[MAXHEIGHT];
+extern fixed_t distscale[MAXWIDTH];
 
 void R_InitPlanes(void);
 void R_ClearPlanes(void);
@@ -479,8 +476,8 @@ extern vissprite_t vissprites[MAXVISSPRITES], *vissprite_p;
 extern vissprite_t vsprsortedhead;
 
 // constant arrays used for psprite clipping and initializing clipping
-extern short negonearray[SCREENWIDTH];
-extern short screenheightarray[SCREENWIDTH];
+extern short negonearray[MAXWIDTH];
+extern short screenheightarray[MAXWIDTH];
 
 // vars for R_DrawMaskedColumn
 extern short *mfloorclip;
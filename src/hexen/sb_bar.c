@@ -1182,8 +1182,8 @@ void DrawMainBar(void)
         V_DrawPatch(94, 164, manaVialPatch1);
         for (i = 165; i < 187 - (22 * CPlayer->mana[0]) / MAX_MANA; i++)
         {
-         for (j = 0; j <= hires; j++)
-          for (k = 0; k <= hires; k++)
+         for (j = 0; j < (1 << hires); j++)
+          for (k = 0; k < (1 << hires); k++)
           {
             I_VideoBuffer[((i << hires) + j) * SCREENWIDTH + ((95 << hires) + k)] = 0;
             I_VideoBuffer[((i << hires) + j) * SCREENWIDTH + ((96 << hires) + k)] = 0;
@@ -1193,8 +1193,8 @@ void DrawMainBar(void)
         V_DrawPatch(102, 164, manaVialPatch2);
         for (i = 165; i < 187 - (22 * CPlayer->mana[1]) / MAX_MANA; i++)
         {
-         for (j = 0; j <= hires; j++)
-          for (k = 0; k <= hires; k++)
+         for (j = 0; j < (1 << hires); j++)
+          for (k = 0; k < (1 << hires); k++)
           {
             I_VideoBuffer[((i << hires) + j) * SCREENWIDTH + ((103 << hires) + k)] = 0;
             I_VideoBuffer[((i << hires) + j) * SCREENWIDTH + ((104 << hires) + k)] = 0;
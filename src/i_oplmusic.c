@@ -22,6 +22,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+// For GNU C and POSIX targets, dirent.h should be available. Otherwise, for
+// Visual C++, we need to include the win_opendir module.
+#if defined(_MSC_VER)
+#include <win_opendir.h>
+#elif defined(__GNUC__) || defined(POSIX)
+#include <dirent.h>
+#else
+#error Need an include for dirent.h!
+#endif
+
+#include "SDL.h"
+#include "SDL_mixer.h"
 
 #include "memio.h"
 #include "mus2mid.h"
@@ -29,7 +43,11 @@
 #include "deh_main.h"
 #include "i_sound.h"
 #include "i_swap.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_config.h"
 #include "m_misc.h"
+#include "sha1.h"
 #include "w_wad.h"
 #include "z_zone.h"
 
@@ -1608,24 +1626,25 @@ static boolean IsMid(byte *mem, int len)
     return len > 4 && !memcmp(mem, "MThd", 4);
 }
 
-static boolean ConvertMus(byte *musdata, int len, char *filename)
+// Convert a MUS lump to MIDI in memory, and load it.  MUS lumps are
+// read directly by midifile.c now; this is kept for -oplmustest.
+
+static midi_file_t *ConvertMus(byte *musdata, int len)
 {
     MEMFILE *instream;
     MEMFILE *outstream;
     void *outbuf;
     size_t outbuf_len;
-    int result;
+    midi_file_t *result = NULL;
 
     instream = mem_fopen_read(musdata, len);
     outstream = mem_fopen_write();
 
-    result = mus2mid(instream, outstream);
-
-    if (result == 0)
+    if (mus2mid(instream, outstream) == 0)
     {
         mem_get_buf(outstream, &outbuf, &outbuf_len);
 
-        M_WriteFile(filename, outbuf, outbuf_len);
+        result = MIDI_LoadFileFromMem(outbuf, outbuf_len);
     }
 
     mem_fclose(instream);
@@ -1637,7 +1656,6 @@ static boolean ConvertMus(byte *musdata, int len, char *filename)
 static void *I_OPL_RegisterSong(void *data, int len)
 {
     midi_file_t *result;
-    char *filename;
 
     if (!music_initialized)
     {
@@ -1647,31 +1665,22 @@ static void *I_OPL_RegisterSong(void *data, int len)
     // MUS files begin with "MUS"
     // Reject anything which doesnt have this signature
 
-    filename = M_TempFile("doom.mid");
-
     if (IsMid(data, len) && len < MAXMIDLENGTH)
     {
-        M_WriteFile(filename, data, len);
+        result = MIDI_LoadFileFromMem(data, len);
     }
     else
     {
-        // Assume a MUS file and try to convert
+        // Assume a MUS file, which is read as it plays.
 
-        ConvertMus(data, len, filename);
+        result = MIDI_LoadMusFromMem(data, len);
     }
 
-    result = MIDI_LoadFile(filename);
-
     if (result == NULL)
     {
         fprintf(stderr, "I_OPL_RegisterSong: Failed to load MID.\n");
     }
 
-    // remove file now
-
-    remove(filename);
-    free(filename);
-
     return result;
 }
 
@@ -1795,6 +1804,871 @@ void I_SetOPLDriverVer(opl_driver_ver_t ver)
     opl_drv_ver = ver;
 }
 
+//----------------------------------------------------------------------
+//
+// Offline rendering of music to WAV files, for -oplrender and the
+// music cache below.
+//
+//----------------------------------------------------------------------
+
+// Samples rendered at a time, how long -oplrender carries on after the
+// song has finished so that the last notes can die away, and a limit
+// for songs that never finish.
+
+#define RENDER_CHUNK_SAMPLES 4096
+#define RENDER_TAIL_SECS     2
+#define RENDER_MAX_SECS      (60 * 60)
+
+static void WriteWAVHeader(FILE *wav, uint32_t length, int samplerate)
+{
+    unsigned int i;
+    unsigned short s;
+
+    fwrite("RIFF", 1, 4, wav);
+    i = LONG(36 + length);
+    fwrite(&i, 4, 1, wav);
+    fwrite("WAVE", 1, 4, wav);
+
+    fwrite("fmt ", 1, 4, wav);
+    i = LONG(16);
+    fwrite(&i, 4, 1, wav);           // Length
+    s = SHORT(1);
+    fwrite(&s, 2, 1, wav);           // Format (PCM)
+    s = SHORT(2);
+    fwrite(&s, 2, 1, wav);           // Channels (2=stereo)
+    i = LONG(samplerate);
+    fwrite(&i, 4, 1, wav);           // Sample rate
+    i = LONG(samplerate * 2 * 2);
+    fwrite(&i, 4, 1, wav);           // Byte rate (samplerate * stereo * 16 bit)
+    s = SHORT(2 * 2);
+    fwrite(&s, 2, 1, wav);           // Block align (stereo * 16 bit)
+    s = SHORT(16);
+    fwrite(&s, 2, 1, wav);           // Bits per sample (16 bit)
+
+    fwrite("data", 1, 4, wav);
+    i = LONG(length);
+    fwrite(&i, 4, 1, wav);           // Data length
+}
+
+// Play the song once through the offline driver at full volume, then
+// tail_secs more, and write the output to a WAV file.  Returns the
+// number of samples written, or 0 if the file could not be written or
+// abort was set; the file is removed then.
+
+static uint32_t RenderSong(midi_file_t *file, char *filename, int tail_secs,
+                           SDL_atomic_t *abort)
+{
+    static int16_t buffer[RENDER_CHUNK_SAMPLES * 2];
+    FILE *wav;
+    uint32_t total, tail;
+    unsigned int played, n;
+    unsigned int i;
+
+    wav = fopen(filename, "wb");
+
+    if (wav == NULL)
+    {
+        return 0;
+    }
+
+    // The header is written again with the length once done.
+
+    WriteWAVHeader(wav, 0, snd_samplerate);
+
+    current_music_volume = 127;
+    I_OPL_PlaySong(file, false);
+
+    total = 0;
+    tail = 0;
+
+    while (total < RENDER_MAX_SECS * snd_samplerate)
+    {
+        if (abort != NULL && SDL_AtomicAdd(abort, 0) != 0)
+        {
+            total = 0;
+            break;
+        }
+
+        played = OPL_Render(buffer, RENDER_CHUNK_SAMPLES);
+
+        // Without a tail, stop exactly where the song ends, so that
+        // the file loops like the song.
+
+        n = tail_secs > 0 ? RENDER_CHUNK_SAMPLES : played;
+
+        for (i = 0; i < n * 2; ++i)
+        {
+            buffer[i] = SHORT(buffer[i]);
+        }
+
+        if (fwrite(buffer, 2 * 2, n, wav) < n)
+        {
+            total = 0;
+            break;
+        }
+
+        total += n;
+
+        if (played < RENDER_CHUNK_SAMPLES)
+        {
+            tail += RENDER_CHUNK_SAMPLES - played;
+
+            if (tail >= tail_secs * snd_samplerate)
+            {
+                break;
+            }
+        }
+    }
+
+    I_OPL_StopSong();
+
+    if (total > 0)
+    {
+        rewind(wav);
+        WriteWAVHeader(wav, total * 2 * 2, snd_samplerate);
+    }
+
+    fclose(wav);
+
+    if (total == 0)
+    {
+        remove(filename);
+    }
+
+    return total;
+}
+
+// Play the given music lump once through the OPL emulator, as fast as
+// it will go, write the output to a WAV file and report the speed.
+
+void I_OPL_RenderSong(char *lumpname, char *filename)
+{
+    lumpindex_t lump;
+    void *handle;
+    uint32_t total;
+    int start_time, elapsed;
+
+    lump = W_CheckNumForName(lumpname);
+
+    if (lump < 0)
+    {
+        I_Error("I_OPL_RenderSong: музыкальный ламп %s не найден",
+                lumpname);
+    }
+
+    // Use the offline driver rather than the sound card.
+
+    OPL_SelectDriver("Render");
+
+    if (!I_OPL_InitMusic())
+    {
+        I_Error("I_OPL_RenderSong: ошибка инициализации OPL");
+    }
+
+    handle = I_OPL_RegisterSong(W_CacheLumpNum(lump, PU_STATIC),
+                                W_LumpLength(lump));
+    W_ReleaseLumpNum(lump);
+
+    if (handle == NULL)
+    {
+        I_Error("I_OPL_RenderSong: ошибка загрузки лампа %s", lumpname);
+    }
+
+    start_time = I_GetTimeMS();
+    total = RenderSong(handle, filename, RENDER_TAIL_SECS, NULL);
+    elapsed = I_GetTimeMS() - start_time;
+
+    if (total == 0)
+    {
+        I_Error("I_OPL_RenderSong: ошибка записи файла %s", filename);
+    }
+
+    I_OPL_UnRegisterSong(handle);
+    I_OPL_ShutdownMusic();
+    OPL_SelectDriver(NULL);
+
+    if (elapsed < 1)
+    {
+        elapsed = 1;
+    }
+
+    printf("I_OPL_RenderSong: %s -> %s: %u samples (%.1f s) in %.3f s, "
+           "%.0f samples/s, %.1fx realtime\n",
+           lumpname, filename, total, (double) total / snd_samplerate,
+           elapsed / 1000.0, total * 1000.0 / elapsed,
+           (double) total * 1000.0 / snd_samplerate / elapsed);
+}
+
+// Register writes recorded by -oplmustest.
+
+typedef struct
+{
+    uint64_t time;
+    unsigned int reg_num;
+    unsigned int value;
+} opl_trace_write_t;
+
+typedef struct
+{
+    opl_trace_write_t *writes;
+    unsigned int num_writes;
+    unsigned int max_writes;
+} opl_trace_t;
+
+static opl_trace_t *current_trace;
+
+static void RecordTraceWrite(uint64_t us, unsigned int reg_num,
+                             unsigned int value)
+{
+    opl_trace_write_t *write;
+
+    if (current_trace->num_writes == current_trace->max_writes)
+    {
+        current_trace->max_writes = current_trace->max_writes > 0 ?
+                                    current_trace->max_writes * 2 : 4096;
+        current_trace->writes =
+            realloc(current_trace->writes,
+                    current_trace->max_writes * sizeof(opl_trace_write_t));
+
+        if (current_trace->writes == NULL)
+        {
+            I_Error("I_OPL_MusTest: недостаточно памяти");
+        }
+    }
+
+    write = &current_trace->writes[current_trace->num_writes];
+    write->time = us;
+    write->reg_num = reg_num;
+    write->value = value;
+    ++current_trace->num_writes;
+}
+
+// Play a song once through the offline driver from a fresh start,
+// recording every register write.
+
+static void TraceSong(midi_file_t *file, opl_trace_t *trace)
+{
+    static int16_t buffer[RENDER_CHUNK_SAMPLES * 2];
+    uint32_t total;
+    unsigned int played;
+
+    trace->num_writes = 0;
+    current_trace = trace;
+    OPL_SetRenderTrace(RecordTraceWrite);
+
+    if (!I_OPL_InitMusic())
+    {
+        I_Error("I_OPL_MusTest: ошибка инициализации OPL");
+    }
+
+    current_music_volume = 127;
+    I_OPL_PlaySong(file, false);
+
+    total = 0;
+
+    do
+    {
+        played = OPL_Render(buffer, RENDER_CHUNK_SAMPLES);
+        total += played;
+    } while (played == RENDER_CHUNK_SAMPLES
+          && total < RENDER_MAX_SECS * snd_samplerate);
+
+    I_OPL_StopSong();
+    I_OPL_ShutdownMusic();
+
+    OPL_SetRenderTrace(NULL);
+    current_trace = NULL;
+}
+
+// Compare two traces, returning the index of the first write that
+// differs, or -1 if they are the same.
+
+static int CompareTraces(opl_trace_t *a, opl_trace_t *b)
+{
+    unsigned int i;
+
+    for (i = 0; i < a->num_writes && i < b->num_writes; ++i)
+    {
+        if (a->writes[i].time != b->writes[i].time
+         || a->writes[i].reg_num != b->writes[i].reg_num
+         || a->writes[i].value != b->writes[i].value)
+        {
+            return i;
+        }
+    }
+
+    if (a->num_writes != b->num_writes)
+    {
+        return i;
+    }
+
+    return -1;
+}
+
+// Play every MUS lump through the offline driver twice: read directly,
+// and converted to MIDI by mus2mid first.  Both must write the same
+// registers at the same times.  Exits with the result.
+
+void I_OPL_MusTest(void)
+{
+    opl_trace_t native_trace = { NULL, 0, 0 };
+    opl_trace_t converted_trace = { NULL, 0, 0 };
+    midi_file_t *native, *converted;
+    byte *data;
+    int len;
+    int diff;
+    int tested = 0, failed = 0;
+    unsigned int i;
+
+    OPL_SelectDriver("Render");
+
+    for (i = 0; i < numlumps; ++i)
+    {
+        len = W_LumpLength(i);
+
+        if (len < 4)
+        {
+            continue;
+        }
+
+        data = W_CacheLumpNum(i, PU_STATIC);
+
+        if (memcmp(data, "MUS\x1a", 4) != 0)
+        {
+            W_ReleaseLumpNum(i);
+            continue;
+        }
+
+        native = MIDI_LoadMusFromMem(data, len);
+        converted = ConvertMus(data, len);
+        W_ReleaseLumpNum(i);
+
+        ++tested;
+
+        if (native == NULL || converted == NULL)
+        {
+            // Both must reject the same lumps.
+
+            if (native != NULL || converted != NULL)
+            {
+                printf("%.8s: loaded %s only\n", lumpinfo[i]->name,
+                       native != NULL ? "directly" : "through mus2mid");
+                ++failed;
+            }
+
+            if (native != NULL)
+            {
+                MIDI_FreeFile(native);
+            }
+
+            if (converted != NULL)
+            {
+                MIDI_FreeFile(converted);
+            }
+
+            continue;
+        }
+
+        TraceSong(native, &native_trace);
+        TraceSong(converted, &converted_trace);
+
+        diff = CompareTraces(&native_trace, &converted_trace);
+
+        if (diff >= 0)
+        {
+            printf("%.8s: register writes differ from write %i "
+                   "(%u direct, %u through mus2mid)\n",
+                   lumpinfo[i]->name, diff,
+                   native_trace.num_writes, converted_trace.num_writes);
+            ++failed;
+        }
+
+        MIDI_FreeFile(native);
+        MIDI_FreeFile(converted);
+    }
+
+    OPL_SelectDriver(NULL);
+
+    free(native_trace.writes);
+    free(converted_trace.writes);
+
+    printf("I_OPL_MusTest: %i of %i MUS lumps differ\n", failed, tested);
+
+    exit(failed > 0 ? 1 : 0);
+}
+
+//----------------------------------------------------------------------
+//
+// Music cache: with opl_music_cache set, each song is rendered once
+// through the offline driver on a thread of its own, into a WAV file
+// in the configuration directory, and played back from there by
+// SDL_mixer, so that no FM synthesis is done while playing.  Files are
+// named after a hash of the song, the GENMIDI lump and the settings
+// that change the output.  The song is rendered one time through with
+// nothing after it, so looping the file loops the song.  The oldest
+// files are removed once the cache grows past opl_music_cache_size.
+//
+//----------------------------------------------------------------------
+
+int opl_music_cache = 0;
+int opl_music_cache_size = 512 * 1024 * 1024;
+
+typedef struct
+{
+    midi_file_t *file;
+    char *filename;
+    Mix_Music *music;
+
+    // Set while the song is being rendered, and the flags telling the
+    // thread to give up and telling the game that it's done.
+
+    SDL_Thread *render_thread;
+    SDL_atomic_t render_abort;
+    SDL_atomic_t render_done;
+} opl_cached_song_t;
+
+static char *cache_dir = NULL;
+
+// The voices and the offline driver can only render one song at a
+// time.
+
+static opl_cached_song_t *rendering_song = NULL;
+
+// Song playing, or waiting for its rendering to finish to play.
+
+static opl_cached_song_t *playing_song = NULL;
+static boolean playing_looping;
+static boolean play_pending;
+
+static int CacheRenderThread(void *data)
+{
+    opl_cached_song_t *song = data;
+    char *temp_filename;
+
+    // Render to a temporary file, so that a half-written file is never
+    // picked up from the cache.
+
+    temp_filename = M_StringJoin(song->filename, ".tmp", NULL);
+
+    if (RenderSong(song->file, temp_filename, 0, &song->render_abort) > 0)
+    {
+        remove(song->filename);
+        rename(temp_filename, song->filename);
+    }
+    else if (SDL_AtomicAdd(&song->render_abort, 0) == 0)
+    {
+        fprintf(stderr, "I_OPL_Cache: failed to write %s\n", temp_filename);
+    }
+
+    free(temp_filename);
+    SDL_AtomicSet(&song->render_done, 1);
+
+    return 0;
+}
+
+// Wait for the rendering of the song to finish, if it's being rendered.
+
+static void FinishRendering(opl_cached_song_t *song)
+{
+    if (song->render_thread != NULL)
+    {
+        SDL_WaitThread(song->render_thread, NULL);
+        song->render_thread = NULL;
+        rendering_song = NULL;
+    }
+}
+
+// A file in the cache directory, for PruneCache.
+
+typedef struct
+{
+    char *filename;
+    time_t mtime;
+    off_t size;
+} cache_file_t;
+
+static int CompareCacheFiles(const void *a, const void *b)
+{
+    const cache_file_t *fa = a;
+    const cache_file_t *fb = b;
+
+    if (fa->mtime != fb->mtime)
+    {
+        return fa->mtime < fb->mtime ? -1 : 1;
+    }
+
+    return 0;
+}
+
+// Remove the oldest rendered songs until the cache fits in
+// opl_music_cache_size bytes, sparing the song playing.
+
+static void PruneCache(void)
+{
+    DIR *dir;
+    struct dirent *entry;
+    struct stat st;
+    cache_file_t *files = NULL;
+    int num_files = 0, max_files = 0;
+    double total = 0;
+    size_t len;
+    int i;
+
+    if (opl_music_cache_size <= 0)
+    {
+        return;
+    }
+
+    dir = opendir(cache_dir);
+
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        len = strlen(entry->d_name);
+
+        if (len < 4 || strcmp(entry->d_name + len - 4, ".wav") != 0)
+        {
+            continue;
+        }
+
+        if (num_files == max_files)
+        {
+            cache_file_t *new_files;
+
+            max_files = max_files > 0 ? max_files * 2 : 64;
+            new_files = realloc(files, max_files * sizeof(cache_file_t));
+
+            if (new_files == NULL)
+            {
+                break;
+            }
+
+            files = new_files;
+        }
+
+        files[num_files].filename = M_StringJoin(cache_dir, entry->d_name,
+                                                 NULL);
+
+        if (stat(files[num_files].filename, &st) != 0)
+        {
+            free(files[num_files].filename);
+            continue;
+        }
+
+        files[num_files].mtime = st.st_mtime;
+        files[num_files].size = st.st_size;
+        total += st.st_size;
+        ++num_files;
+    }
+
+    closedir(dir);
+
+    qsort(files, num_files, sizeof(cache_file_t), CompareCacheFiles);
+
+    for (i = 0; i < num_files; ++i)
+    {
+        if (total > opl_music_cache_size
+         && (playing_song == NULL
+          || strcmp(files[i].filename, playing_song->filename) != 0)
+         && remove(files[i].filename) == 0)
+        {
+            total -= files[i].size;
+        }
+
+        free(files[i].filename);
+    }
+
+    free(files);
+}
+
+// Render a song into the cache on a thread of its own.  Only one song
+// can be rendered at a time, so the song being rendered is abandoned;
+// it's rendered again if it is played.
+
+static void StartRendering(opl_cached_song_t *song)
+{
+    if (rendering_song != NULL)
+    {
+        SDL_AtomicSet(&rendering_song->render_abort, 1);
+        FinishRendering(rendering_song);
+    }
+
+    PruneCache();
+
+    SDL_AtomicSet(&song->render_abort, 0);
+    SDL_AtomicSet(&song->render_done, 0);
+    song->render_thread = SDL_CreateThread(CacheRenderThread,
+                                           "OPL render thread", song);
+
+    if (song->render_thread == NULL)
+    {
+        fprintf(stderr, "I_OPL_Cache: failed to start render thread\n");
+        SDL_AtomicSet(&song->render_done, 1);
+    }
+    else
+    {
+        rendering_song = song;
+    }
+}
+
+static void StartCachedSong(void)
+{
+    opl_cached_song_t *song = playing_song;
+
+    play_pending = false;
+    FinishRendering(song);
+
+    if (song->music == NULL)
+    {
+        song->music = Mix_LoadMUS(song->filename);
+
+        if (song->music == NULL)
+        {
+            fprintf(stderr, "I_OPL_Cache: failed to load %s: %s\n",
+                    song->filename, Mix_GetError());
+            return;
+        }
+    }
+
+    Mix_PlayMusic(song->music, playing_looping ? -1 : 1);
+}
+
+static char *CacheFileName(byte *data, int len)
+{
+    sha1_context_t context;
+    sha1_digest_t digest;
+    lumpindex_t genmidi;
+    char hex[sizeof(sha1_digest_t) * 2 + 1];
+    int i;
+
+    genmidi = W_GetNumForName(DEH_String("genmidi"));
+
+    SHA1_Init(&context);
+    SHA1_Update(&context, data, len);
+    SHA1_Update(&context, W_CacheLumpNum(genmidi, PU_STATIC),
+                W_LumpLength(genmidi));
+    SHA1_UpdateInt32(&context, snd_samplerate);
+    SHA1_UpdateInt32(&context, opl_opl3mode);
+    SHA1_UpdateInt32(&context, opl_drv_ver);
+    SHA1_UpdateInt32(&context, opl_stereo_correct);
+    SHA1_Final(digest, &context);
+    W_ReleaseLumpNum(genmidi);
+
+    for (i = 0; i < sizeof(sha1_digest_t); ++i)
+    {
+        M_snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+
+    return M_StringJoin(cache_dir, hex, ".wav", NULL);
+}
+
+static boolean I_OPL_Cache_InitMusic(void)
+{
+    int freq, channels;
+    Uint16 format;
+
+    if (!opl_music_cache)
+    {
+        return false;
+    }
+
+    // Playback goes through SDL_mixer, which must have been set up by
+    // the sound effects code, at the rate we render at.
+
+    if (Mix_QuerySpec(&freq, &format, &channels) == 0
+     || freq != snd_samplerate)
+    {
+        fprintf(stderr, "I_OPL_Cache: SDL_mixer is not open at %i Hz, "
+                        "not caching music.\n", snd_samplerate);
+        return false;
+    }
+
+    OPL_SelectDriver("Render");
+
+    if (!I_OPL_InitMusic())
+    {
+        OPL_SelectDriver(NULL);
+        return false;
+    }
+
+    cache_dir = M_StringJoin(configdir, "oplcache", DIR_SEPARATOR_S, NULL);
+    M_MakeDirectory(cache_dir);
+
+    return true;
+}
+
+static void I_OPL_Cache_StopSong(void)
+{
+    Mix_HaltMusic();
+    playing_song = NULL;
+    play_pending = false;
+}
+
+static void I_OPL_Cache_ShutdownMusic(void)
+{
+    I_OPL_Cache_StopSong();
+
+    if (rendering_song != NULL)
+    {
+        SDL_AtomicSet(&rendering_song->render_abort, 1);
+        FinishRendering(rendering_song);
+    }
+
+    I_OPL_ShutdownMusic();
+    OPL_SelectDriver(NULL);
+
+    free(cache_dir);
+    cache_dir = NULL;
+}
+
+static void I_OPL_Cache_SetMusicVolume(int volume)
+{
+    Mix_VolumeMusic((volume * MIX_MAX_VOLUME) / 127);
+}
+
+static void I_OPL_Cache_PauseSong(void)
+{
+    Mix_PauseMusic();
+}
+
+static void I_OPL_Cache_ResumeSong(void)
+{
+    Mix_ResumeMusic();
+}
+
+static void *I_OPL_Cache_RegisterSong(void *data, int len)
+{
+    opl_cached_song_t *song;
+    midi_file_t *file;
+
+    file = I_OPL_RegisterSong(data, len);
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    song = malloc(sizeof(opl_cached_song_t));
+
+    if (song == NULL)
+    {
+        MIDI_FreeFile(file);
+        return NULL;
+    }
+
+    song->file = file;
+    song->filename = CacheFileName(data, len);
+    song->music = NULL;
+    song->render_thread = NULL;
+    SDL_AtomicSet(&song->render_abort, 0);
+    SDL_AtomicSet(&song->render_done, 1);
+
+    // Start rendering the song straight away, unless that would
+    // abandon the one waiting to play; then it's done once this one
+    // is played.
+
+    if (!M_FileExists(song->filename)
+     && (rendering_song == NULL || rendering_song != playing_song))
+    {
+        StartRendering(song);
+    }
+
+    return song;
+}
+
+static void I_OPL_Cache_UnRegisterSong(void *handle)
+{
+    opl_cached_song_t *song = handle;
+
+    if (song == NULL)
+    {
+        return;
+    }
+
+    if (song == playing_song)
+    {
+        I_OPL_Cache_StopSong();
+    }
+
+    SDL_AtomicSet(&song->render_abort, 1);
+    FinishRendering(song);
+
+    if (song->music != NULL)
+    {
+        Mix_FreeMusic(song->music);
+    }
+
+    MIDI_FreeFile(song->file);
+    free(song->filename);
+    free(song);
+}
+
+static void I_OPL_Cache_PlaySong(void *handle, boolean looping)
+{
+    if (handle == NULL)
+    {
+        return;
+    }
+
+    playing_song = handle;
+    playing_looping = looping;
+
+    // Render the song now if it wasn't when it was registered, or its
+    // rendering was abandoned for another song's.
+
+    if (playing_song->render_thread == NULL && playing_song->music == NULL
+     && !M_FileExists(playing_song->filename))
+    {
+        StartRendering(playing_song);
+    }
+
+    // If the song is still being rendered, it is started by
+    // I_OPL_Cache_Poll once it's done.
+
+    if (SDL_AtomicAdd(&playing_song->render_done, 0) != 0)
+    {
+        StartCachedSong();
+    }
+    else
+    {
+        play_pending = true;
+    }
+}
+
+static boolean I_OPL_Cache_MusicIsPlaying(void)
+{
+    return playing_song != NULL && (play_pending || Mix_PlayingMusic());
+}
+
+static void I_OPL_Cache_Poll(void)
+{
+    if (play_pending && SDL_AtomicAdd(&playing_song->render_done, 0) != 0)
+    {
+        StartCachedSong();
+    }
+}
+
+music_module_t music_opl_cache_module =
+{
+    music_opl_devices,
+    arrlen(music_opl_devices),
+    I_OPL_Cache_InitMusic,
+    I_OPL_Cache_ShutdownMusic,
+    I_OPL_Cache_SetMusicVolume,
+    I_OPL_Cache_PauseSong,
+    I_OPL_Cache_ResumeSong,
+    I_OPL_Cache_RegisterSong,
+    I_OPL_Cache_UnRegisterSong,
+    I_OPL_Cache_PlaySong,
+    I_OPL_Cache_StopSong,
+    I_OPL_Cache_MusicIsPlaying,
+    I_OPL_Cache_Poll,
+};
+
 //----------------------------------------------------------------------
 //
 // Development / debug message generation, to help developing GENMIDI
@@ -44,25 +44,68 @@
 
 #include "doomtype.h"
 
-#define LOW_PASS_FILTER
 //#define DEBUG_DUMP_WAVS
-#define NUM_CHANNELS 16
+#define NUM_CHANNELS 64
+
+// Number of frames mixed at a time.
+
+#define MIX_BLOCK_SIZE 512
 
 typedef struct allocated_sound_s allocated_sound_t;
 
 struct allocated_sound_s
 {
     sfxinfo_t *sfxinfo;
-    Mix_Chunk chunk;
+
+    // Sound data immediately follows this structure.  It is either the
+    // original unsigned 8-bit samples of the lump, or signed 16-bit
+    // samples converted to the mixer rate by libsamplerate.  Either way
+    // it is mono, and resampled and panned as it is mixed.
+
+    byte *data;
+    int length;
+    int bits;
+    int samplerate;
+
+    // If true, this is the original data of a sound that is still
+    // waiting to be converted by libsamplerate on the precache
+    // thread.  It is replaced once the conversion is done.
+
+    boolean unconverted;
+
+    // Gain applied as the sound is mixed, 16.16 fixed point.  Unconverted
+    // sounds get libsamplerate_scale, so that they play as loud as they
+    // will once converted.
+
+    int gain;
+
     int use_count;
-    int pitch;
     allocated_sound_t *prev, *next;
 };
 
+// A sound effect channel, as seen by the mixer.  Position and step
+// are 32.32 fixed point sample offsets into the sound data; volumes
+// are 16.16 fixed point.
+
+typedef struct
+{
+    allocated_sound_t *snd;
+    uint64_t pos;
+    uint64_t step;
+    int left, right;
+} sfx_channel_t;
+
 static boolean sound_initialized = false;
 
 static allocated_sound_t *channels_playing[NUM_CHANNELS];
 
+// Channel state shared with the mixer, which runs on the audio thread.
+// It is only changed with mixer_mutex held.
+
+static sfx_channel_t sfx_channels[NUM_CHANNELS];
+static SDL_mutex *mixer_mutex;
+static int32_t mix_buffer[MIX_BLOCK_SIZE * 2];
+
 static int mixer_freq;
 static Uint16 mixer_format;
 static int mixer_channels;
@@ -72,13 +115,24 @@ static boolean (*ExpandSoundData)(sfxinfo_t *sfxinfo,
                                   int samplerate,
                                   int length) = NULL;
 
-// Doubly-linked list of allocated sounds.
-// When a sound is played, it is moved to the head, so that the oldest
-// sounds not used recently are at the tail.
+// Doubly-linked list of allocated sounds that are not in use, in LRU
+// order.  Sounds are taken off the list while they are playing, and
+// put back at the head when they stop, so that the sounds not used for
+// the longest time are at the tail, ready to be freed.  A cached sound
+// can be found from its sfxinfo_t through driver_data.
 
 static allocated_sound_t *allocated_sounds_head = NULL;
 static allocated_sound_t *allocated_sounds_tail = NULL;
 static int allocated_sounds_size = 0;
+static int allocated_sounds_count = 0;
+
+// Cache statistics, for -sndcachestats.
+
+static unsigned int cache_hits = 0;
+static unsigned int cache_misses = 0;
+static unsigned int cache_evictions = 0;
+static unsigned int cache_prefetched = 0;
+static int allocated_sounds_peak = 0;
 
 int use_libsamplerate = 0;
 
@@ -132,43 +186,53 @@ static void AllocatedSoundUnlink(allocated_sound_t *snd)
     }
 }
 
-static void FreeAllocatedSound(allocated_sound_t *snd)
+// Free the memory used by a sound, which must not be in the linked
+// list.
+
+static void FreeSound(allocated_sound_t *snd)
 {
-    // Unlink from linked list.
+    // The sound may already have been replaced by a converted one.
 
-    AllocatedSoundUnlink(snd);
+    if (snd->sfxinfo->driver_data == snd)
+    {
+        snd->sfxinfo->driver_data = NULL;
+    }
 
     // Keep track of the amount of allocated sound data:
 
-    allocated_sounds_size -= snd->chunk.alen;
+    allocated_sounds_size -= snd->length * (snd->bits / 8);
+    --allocated_sounds_count;
 
     free(snd);
 }
 
-// Search from the tail backwards along the allocated sounds list, find
-// and free a sound that is not in use, to free up memory.  Return true
-// for success.
+// Free a sound that is not in use.
 
-static boolean FindAndFreeSound(void)
+static void FreeAllocatedSound(allocated_sound_t *snd)
 {
-    allocated_sound_t *snd;
+    // Unlink from linked list.
 
-    snd = allocated_sounds_tail;
+    AllocatedSoundUnlink(snd);
+
+    FreeSound(snd);
+}
+
+// Free the least recently used sound that is not in use, to free up
+// memory.  Return true for success.
 
-    while (snd != NULL)
+static boolean FindAndFreeSound(void)
+{
+    if (allocated_sounds_tail == NULL)
     {
-        if (snd->use_count == 0)
-        {
-            FreeAllocatedSound(snd);
-            return true;
-        }
+        // No available sounds to free...
 
-        snd = snd->prev;
+        return false;
     }
 
-    // No available sounds to free...
+    FreeAllocatedSound(allocated_sounds_tail);
+    ++cache_evictions;
 
-    return false;
+    return true;
 }
 
 // Enforce SFX cache size limit.  We are just about to allocate "len"
@@ -196,11 +260,14 @@ static void ReserveCacheSpace(size_t len)
     }
 }
 
-// Allocate a block for a new sound effect.
+// Allocate a block for a new sound effect, of the given number of
+// samples.
 
-static allocated_sound_t *AllocateSound(sfxinfo_t *sfxinfo, size_t len)
+static allocated_sound_t *AllocateSound(sfxinfo_t *sfxinfo, int length,
+                                        int bits, int samplerate)
 {
     allocated_sound_t *snd;
+    size_t len = length * (bits / 8);
 
     // Keep allocated sounds within the cache size.
 
@@ -223,20 +290,28 @@ static allocated_sound_t *AllocateSound(sfxinfo_t *sfxinfo, size_t len)
 
     } while (snd == NULL);
 
-    // Skip past the chunk structure for the audio buffer
+    // Skip past the header for the sound data
 
-    snd->chunk.abuf = (byte *) (snd + 1);
-    snd->chunk.alen = len;
-    snd->chunk.allocated = 1;
-    snd->chunk.volume = MIX_MAX_VOLUME;
-    snd->pitch = NORM_PITCH;
+    snd->data = (byte *) (snd + 1);
+    snd->length = length;
+    snd->bits = bits;
+    snd->samplerate = samplerate;
 
     snd->sfxinfo = sfxinfo;
+    snd->unconverted = false;
+    snd->gain = 0x10000;
     snd->use_count = 0;
+    sfxinfo->driver_data = snd;
 
     // Keep track of how much memory all these cached sounds are using...
 
     allocated_sounds_size += len;
+    ++allocated_sounds_count;
+
+    if (allocated_sounds_size > allocated_sounds_peak)
+    {
+        allocated_sounds_peak = allocated_sounds_size;
+    }
 
     AllocatedSoundLink(snd);
 
@@ -247,17 +322,18 @@ static allocated_sound_t *AllocateSound(sfxinfo_t *sfxinfo, size_t len)
 
 static void LockAllocatedSound(allocated_sound_t *snd)
 {
-    // Increase use count, to stop the sound being freed.
+    // A sound in use is taken off the list, so that it can't be freed.
 
-    ++snd->use_count;
+    if (snd->use_count == 0)
+    {
+        AllocatedSoundUnlink(snd);
+    }
 
-    //printf("++ %s: Use count=%i\n", snd->sfxinfo->name, snd->use_count);
+    // Increase use count.
 
-    // When we use a sound, re-link it into the list at the head, so
-    // that the oldest sounds fall to the end of the list for freeing.
+    ++snd->use_count;
 
-    AllocatedSoundUnlink(snd);
-    AllocatedSoundLink(snd);
+    //printf("++ %s: Use count=%i\n", snd->sfxinfo->name, snd->use_count);
 }
 
 // Unlock a sound to indicate that it may now be freed.
@@ -272,68 +348,31 @@ static void UnlockAllocatedSound(allocated_sound_t *snd)
     --snd->use_count;
 
     //printf("-- %s: Use count=%i\n", snd->sfxinfo->name, snd->use_count);
-}
 
-// Search through the list of allocated sounds and return the one that matches
-// the supplied sfxinfo entry and pitch level.
-
-static allocated_sound_t * GetAllocatedSoundBySfxInfoAndPitch(sfxinfo_t *sfxinfo, int pitch)
-{
-    allocated_sound_t * p = allocated_sounds_head;
+    // When a sound is no longer used, link it back into the list at
+    // the head, so that the oldest sounds fall to the end of the list
+    // for freeing.  If it has been replaced while playing, it is not
+    // needed any more.
 
-    while (p != NULL)
+    if (snd->use_count == 0)
     {
-        if (p->sfxinfo == sfxinfo && p->pitch == pitch)
+        if (snd->sfxinfo->driver_data == snd)
         {
-            return p;
+            AllocatedSoundLink(snd);
+        }
+        else
+        {
+            FreeSound(snd);
         }
-        p = p->next;
     }
-
-    return NULL;
 }
 
-// Allocate a new sound chunk and pitch-shift an existing sound up-or-down
-// into it.
+// Return the cached sound for the supplied sfxinfo entry, if there is
+// one.
 
-static allocated_sound_t * PitchShift(allocated_sound_t *insnd, int pitch)
+static allocated_sound_t * GetAllocatedSoundBySfxInfo(sfxinfo_t *sfxinfo)
 {
-    allocated_sound_t * outsnd;
-    Sint16 *inp, *outp;
-    Sint16 *srcbuf, *dstbuf;
-    Uint32 srclen, dstlen;
-
-    srcbuf = (Sint16 *)insnd->chunk.abuf;
-    srclen = insnd->chunk.alen;
-
-    // determine ratio pitch:NORM_PITCH and apply to srclen, then invert.
-    // This is an approximation of vanilla behaviour based on measurements
-    dstlen = (int)((1 + (1 - (float)pitch / NORM_PITCH)) * srclen);
-
-    // ensure that the new buffer is an even length
-    if ((dstlen % 2) == 0)
-    {
-        dstlen++;
-    }
-
-    outsnd = AllocateSound(insnd->sfxinfo, dstlen);
-
-    if (!outsnd)
-    {
-        return NULL;
-    }
-
-    outsnd->pitch = pitch;
-    dstbuf = (Sint16 *)outsnd->chunk.abuf;
-
-    // loop over output buffer. find corresponding input cell, copy over
-    for (outp = dstbuf; outp < dstbuf + dstlen/2; ++outp)
-    {
-        inp = srcbuf + (int)((float)(outp - dstbuf) / dstlen * srclen);
-        *outp = *inp;
-    }
-
-    return outsnd;
+    return sfxinfo->driver_data;
 }
 
 // When a sound stops, check if it is still playing.  If it is not,
@@ -344,7 +383,9 @@ static void ReleaseSoundOnChannel(int channel)
 {
     allocated_sound_t *snd = channels_playing[channel];
 
-    Mix_HaltChannel(channel);
+    SDL_LockMutex(mixer_mutex);
+    sfx_channels[channel].snd = NULL;
+    SDL_UnlockMutex(mixer_mutex);
 
     if (snd == NULL)
     {
@@ -354,13 +395,6 @@ static void ReleaseSoundOnChannel(int channel)
     channels_playing[channel] = NULL;
 
     UnlockAllocatedSound(snd);
-
-    // if the sound is a pitch-shift and it's not in use, immediately
-    // free it
-    if (snd->pitch != NORM_PITCH && snd->use_count <= 0)
-    {
-        FreeAllocatedSound(snd);
-    }
 }
 
 #ifdef HAVE_LIBSAMPLERATE
@@ -392,37 +426,31 @@ static int SRC_ConversionMode(void)
     }
 }
 
-// libsamplerate-based generic sound expansion function for any sample rate
-//   unsigned 8 bits --> signed 16 bits
-//   mono --> stereo
-//   samplerate --> mixer_freq
-// Returns number of clipped samples.
-// DWF 2008-02-10 with cleanups by Simon Howard.
+// Resample sound data with libsamplerate, from unsigned 8 bits at
+// samplerate to floating point at mixer_freq.  This is the slow part
+// of ExpandSoundData_SRC; it touches nothing but its arguments, so it
+// can also run on the expansion thread.  src_data->data_out must be
+// freed afterwards.
 
-static boolean ExpandSoundData_SRC(sfxinfo_t *sfxinfo,
-                                   byte *data,
-                                   int samplerate,
-                                   int length)
+static void ResampleSound_SRC(SRC_DATA *src_data,
+                              byte *data,
+                              int samplerate,
+                              int length)
 {
-    SRC_DATA src_data;
     float *data_in;
-    uint32_t i, abuf_index=0, clipped=0;
-//    uint32_t alen;
+    int i;
     int retn;
-    int16_t *expanded;
-    allocated_sound_t *snd;
-    Mix_Chunk *chunk;
 
-    src_data.input_frames = length;
+    src_data->input_frames = length;
     data_in = malloc(length * sizeof(float));
-    src_data.data_in = data_in;
-    src_data.src_ratio = (double)mixer_freq / samplerate;
+    src_data->data_in = data_in;
+    src_data->src_ratio = (double)mixer_freq / samplerate;
 
     // We include some extra space here in case of rounding-up.
-    src_data.output_frames = src_data.src_ratio * length + (mixer_freq / 4);
-    src_data.data_out = malloc(src_data.output_frames * sizeof(float));
+    src_data->output_frames = src_data->src_ratio * length + (mixer_freq / 4);
+    src_data->data_out = malloc(src_data->output_frames * sizeof(float));
 
-    assert(src_data.data_in != NULL && src_data.data_out != NULL);
+    assert(src_data->data_in != NULL && src_data->data_out != NULL);
 
     // Convert input data to floats
 
@@ -436,26 +464,36 @@ static boolean ExpandSoundData_SRC(sfxinfo_t *sfxinfo,
 
     // Do the sound conversion
 
-    retn = src_simple(&src_data, SRC_ConversionMode(), 1);
+    retn = src_simple(src_data, SRC_ConversionMode(), 1);
     assert(retn == 0);
 
-    // Allocate the new chunk.
+    free(data_in);
+    src_data->data_in = NULL;
+}
+
+// Store sound data resampled by ResampleSound_SRC in the cache, as
+// signed 16 bits.
+
+static boolean StoreSound_SRC(sfxinfo_t *sfxinfo, SRC_DATA *src_data)
+{
+    uint32_t i, abuf_index=0, clipped=0;
+    int16_t *expanded;
+    allocated_sound_t *snd;
 
-//    alen = src_data.output_frames_gen * 4;
+    // Allocate the new sound.
 
-    snd = AllocateSound(sfxinfo, src_data.output_frames_gen * 4);
+    snd = AllocateSound(sfxinfo, src_data->output_frames_gen, 16, mixer_freq);
 
     if (snd == NULL)
     {
         return false;
     }
 
-    chunk = &snd->chunk;
-    expanded = (int16_t *) chunk->abuf;
+    expanded = (int16_t *) snd->data;
 
     // Convert the result back into 16-bit integers.
 
-    for (i=0; i<src_data.output_frames_gen; ++i)
+    for (i=0; i<src_data->output_frames_gen; ++i)
     {
         // libsamplerate does not limit itself to the -1.0 .. 1.0 range on
         // output, so a multiplier less than INT16_MAX (32767) is required
@@ -479,7 +517,7 @@ static boolean ExpandSoundData_SRC(sfxinfo_t *sfxinfo,
         // artifacts are noticeable during the loudest parts.
 
         float cvtval_f =
-            src_data.data_out[i] * libsamplerate_scale * INT16_MAX;
+            src_data->data_out[i] * libsamplerate_scale * INT16_MAX;
         int32_t cvtval_i = cvtval_f + (cvtval_f < 0 ? -0.5 : 0.5);
 
         // Asymmetrical sound worries me, so we won't use -32768.
@@ -494,62 +532,47 @@ static boolean ExpandSoundData_SRC(sfxinfo_t *sfxinfo,
             ++clipped;
         }
 
-        // Left and right channels
-
-        expanded[abuf_index++] = cvtval_i;
         expanded[abuf_index++] = cvtval_i;
     }
 
-    free(data_in);
-    free(src_data.data_out);
-
     if (clipped > 0)
     {
         fprintf(stderr, "Sound '%s': clipped %u samples (%0.2f %%)\n", 
                         sfxinfo->name, clipped,
-                        400.0 * clipped / chunk->alen);
+                        100.0 * clipped / snd->length);
     }
 
     return true;
 }
 
-#endif
+// libsamplerate-based generic sound expansion function for any sample rate
+//   unsigned 8 bits --> signed 16 bits
+//   samplerate --> mixer_freq
+// DWF 2008-02-10 with cleanups by Simon Howard.
 
-static boolean ConvertibleRatio(int freq1, int freq2)
+static boolean ExpandSoundData_SRC(sfxinfo_t *sfxinfo,
+                                   byte *data,
+                                   int samplerate,
+                                   int length)
 {
-    int ratio;
-
-    if (freq1 > freq2)
-    {
-        return ConvertibleRatio(freq2, freq1);
-    }
-    else if ((freq2 % freq1) != 0)
-    {
-        // Not in a direct ratio
-
-        return false;
-    }
-    else
-    {
-        // Check the ratio is a power of 2
-
-        ratio = freq2 / freq1;
+    SRC_DATA src_data;
+    boolean result;
 
-        while ((ratio & 1) == 0)
-        {
-            ratio = ratio >> 1;
-        }
+    ResampleSound_SRC(&src_data, data, samplerate, length);
+    result = StoreSound_SRC(sfxinfo, &src_data);
+    free(src_data.data_out);
 
-        return ratio == 1;
-    }
+    return result;
 }
 
+#endif
+
 #ifdef DEBUG_DUMP_WAVS
 
-// Debug code to dump resampled sound effects to WAV files for analysis.
+// Debug code to dump sound effects to WAV files for analysis.
 
 static void WriteWAV(char *filename, byte *data,
-                     uint32_t length, int samplerate)
+                     uint32_t length, int bits, int samplerate)
 {
     FILE *wav;
     unsigned int i;
@@ -560,7 +583,7 @@ static void WriteWAV(char *filename, byte *data,
     // Header
 
     fwrite("RIFF", 1, 4, wav);
-    i = LONG(36 + samplerate);
+    i = LONG(36 + length);
     fwrite(&i, 4, 1, wav);
     fwrite("WAVE", 1, 4, wav);
 
@@ -571,16 +594,16 @@ static void WriteWAV(char *filename, byte *data,
     fwrite(&i, 4, 1, wav);           // Length
     s = SHORT(1);
     fwrite(&s, 2, 1, wav);           // Format (PCM)
-    s = SHORT(2);
-    fwrite(&s, 2, 1, wav);           // Channels (2=stereo)
+    s = SHORT(1);
+    fwrite(&s, 2, 1, wav);           // Channels (1=mono)
     i = LONG(samplerate);
     fwrite(&i, 4, 1, wav);           // Sample rate
-    i = LONG(samplerate * 2 * 2);
-    fwrite(&i, 4, 1, wav);           // Byte rate (samplerate * stereo * 16 bit)
-    s = SHORT(2 * 2);
-    fwrite(&s, 2, 1, wav);           // Block align (stereo * 16 bit)
-    s = SHORT(16);
-    fwrite(&s, 2, 1, wav);           // Bits per sample (16 bit)
+    i = LONG(samplerate * (bits / 8));
+    fwrite(&i, 4, 1, wav);           // Byte rate (samplerate * mono * bits)
+    s = SHORT(bits / 8);
+    fwrite(&s, 2, 1, wav);           // Block align (mono * bits)
+    s = SHORT(bits);
+    fwrite(&s, 2, 1, wav);           // Bits per sample
 
     // Data subchunk
 
@@ -594,144 +617,168 @@ static void WriteWAV(char *filename, byte *data,
 
 #endif
 
-// Generic sound expansion function for any sample rate.
-// Returns number of clipped samples (always 0).
+// Sound "expansion" function when libsamplerate is not used: keep the
+// original 8-bit samples, which are resampled as they are mixed.
 
-static boolean ExpandSoundData_SDL(sfxinfo_t *sfxinfo,
+static boolean ExpandSoundData_Raw(sfxinfo_t *sfxinfo,
                                    byte *data,
                                    int samplerate,
                                    int length)
 {
-    SDL_AudioCVT convertor;
     allocated_sound_t *snd;
-    Mix_Chunk *chunk;
-    uint32_t expanded_length;
-
-    // Calculate the length of the expanded version of the sample.
-
-    expanded_length = (uint32_t) ((((uint64_t) length) * mixer_freq) / samplerate);
-
-    // Double up twice: 8 -> 16 bit and mono -> stereo
-
-    expanded_length *= 4;
 
-    // Allocate a chunk in which to expand the sound
-
-    snd = AllocateSound(sfxinfo, expanded_length);
+    snd = AllocateSound(sfxinfo, length, 8, samplerate);
 
     if (snd == NULL)
     {
         return false;
     }
 
-    chunk = &snd->chunk;
+    memcpy(snd->data, data, length);
 
-    // If we can, use the standard / optimized SDL conversion routines.
+    return true;
+}
 
-    if (samplerate <= mixer_freq
-     && ConvertibleRatio(samplerate, mixer_freq)
-     && SDL_BuildAudioCVT(&convertor,
-                          AUDIO_U8, 1, samplerate,
-                          mixer_format, mixer_channels, mixer_freq))
-    {
-        convertor.len = length;
-        convertor.buf = malloc(convertor.len * convertor.len_mult);
-        assert(convertor.buf != NULL);
-        memcpy(convertor.buf, data, length);
+//
+// Mixer
+//
 
-        SDL_ConvertAudio(&convertor);
-        
-        memcpy(chunk->abuf, convertor.buf, chunk->alen);
-        free(convertor.buf);
+// Get a sample from a sound, as signed 16-bit.
+
+static int GetSample(allocated_sound_t *snd, int i)
+{
+    if (snd->bits == 8)
+    {
+        return snd->data[i] * 257 - 32768;
     }
     else
     {
-        Sint16 *expanded = (Sint16 *) chunk->abuf;
-        int expanded_length;
-        int expand_ratio;
-        int i;
+        return ((int16_t *) snd->data)[i];
+    }
+}
 
-        // Generic expansion if conversion does not work:
-        //
-        // SDL's audio conversion only works for rate conversions that are
-        // powers of 2; if the two formats are not in a direct power of 2
-        // ratio, do this naive conversion instead.
+// Add a sound effect channel into the mix buffer, resampling it with
+// linear interpolation as it goes.
 
-        // number of samples in the converted sound
+static void MixChannel(sfx_channel_t *chan, int frames)
+{
+    allocated_sound_t *snd = chan->snd;
+    uint64_t end = (uint64_t) snd->length << 32;
+    int32_t *buf = mix_buffer;
+    int32_t *buf_end = mix_buffer + frames * 2;
+    int left = ((int64_t) chan->left * snd->gain) >> 16;
+    int right = ((int64_t) chan->right * snd->gain) >> 16;
+
+    while (buf < buf_end && chan->pos < end)
+    {
+        int i = chan->pos >> 32;
+        int frac = (chan->pos >> 17) & 0x7fff;
+        int s0, s1, sample;
 
-        expanded_length = ((uint64_t) length * mixer_freq) / samplerate;
-        expand_ratio = (length << 8) / expanded_length;
+        s0 = GetSample(snd, i);
+        s1 = i + 1 < snd->length ? GetSample(snd, i + 1) : s0;
+        sample = s0 + (((s1 - s0) * frac) >> 15);
 
-        for (i=0; i<expanded_length; ++i)
-        {
-            Sint16 sample;
-            int src;
+        *buf++ += (sample * left) >> 16;
+        *buf++ += (sample * right) >> 16;
 
-            src = (i * expand_ratio) >> 8;
+        chan->pos += chan->step;
+    }
 
-            sample = data[src] | (data[src] << 8);
-            sample -= 32768;
+    // When the sound finishes, I_SDL_UpdateSound releases it.
 
-            // expand 8->16 bits, mono->stereo
+    if (chan->pos >= end)
+    {
+        chan->snd = NULL;
+    }
+}
 
-            expanded[i * 2] = expanded[i * 2 + 1] = sample;
-        }
+static Sint16 ClipSample(int32_t sample)
+{
+    if (sample > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    else if (sample < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
 
-#ifdef LOW_PASS_FILTER
-        // Perform a low-pass filter on the upscaled sound to filter
-        // out high-frequency noise from the conversion process.
+    return sample;
+}
 
-        {
-            float rc, dt, alpha;
+// Post-mix callback, invoked by SDL_mixer on the audio thread once it
+// has mixed the music.  All sound effect channels are mixed into a
+// 32-bit buffer, which is then added to the output in one pass.
 
-            // Low-pass filter for cutoff frequency f:
-            //
-            // For sampling rate r, dt = 1 / r
-            // rc = 1 / 2*pi*f
-            // alpha = dt / (rc + dt)
+static void I_SDL_MixSounds(void *udata, Uint8 *stream, int len)
+{
+    Sint16 *out = (Sint16 *) stream;
+    int frames = len / (mixer_channels * sizeof(Sint16));
+    int n, i;
 
-            // Filter to the half sample rate of the original sound effect
-            // (maximum frequency, by nyquist)
+    SDL_LockMutex(mixer_mutex);
 
-            dt = 1.0f / mixer_freq;
-            rc = 1.0f / (3.14f * samplerate);
-            alpha = dt / (rc + dt);
+    while (frames > 0)
+    {
+        n = frames < MIX_BLOCK_SIZE ? frames : MIX_BLOCK_SIZE;
 
-            // Both channels are processed in parallel, hence [i-2]:
+        memset(mix_buffer, 0, n * 2 * sizeof(int32_t));
 
-            for (i=2; i<expanded_length * 2; ++i)
+        for (i = 0; i < NUM_CHANNELS; ++i)
+        {
+            if (sfx_channels[i].snd != NULL)
             {
-                expanded[i] = (Sint16) (alpha * expanded[i]
-                                      + (1 - alpha) * expanded[i-2]);
+                MixChannel(&sfx_channels[i], n);
             }
         }
-#endif /* #ifdef LOW_PASS_FILTER */
-    }
 
-    return true;
-}
+        if (mixer_channels == 2)
+        {
+            for (i = 0; i < n * 2; ++i)
+            {
+                out[i] = ClipSample(out[i] + mix_buffer[i]);
+            }
+        }
+        else if (mixer_channels == 1)
+        {
+            for (i = 0; i < n; ++i)
+            {
+                out[i] = ClipSample(out[i] + (mix_buffer[i * 2]
+                                            + mix_buffer[i * 2 + 1]) / 2);
+            }
+        }
+        else
+        {
+            // Surround: left and right only.
 
-// Load and convert a sound effect
-// Returns true if successful
+            for (i = 0; i < n; ++i)
+            {
+                Sint16 *frame = out + i * mixer_channels;
 
-static boolean CacheSFX(sfxinfo_t *sfxinfo)
-{
-    int lumpnum;
-    unsigned int lumplen;
-    int samplerate;
-    unsigned int length;
-    byte *data;
+                frame[0] = ClipSample(frame[0] + mix_buffer[i * 2]);
+                frame[1] = ClipSample(frame[1] + mix_buffer[i * 2 + 1]);
+            }
+        }
 
-    // need to load the sound
+        out += n * mixer_channels;
+        frames -= n;
+    }
 
-    lumpnum = sfxinfo->lumpnum;
-    data = W_CacheLumpNum(lumpnum, PU_STATIC);
-    lumplen = W_LumpLength(lumpnum);
+    SDL_UnlockMutex(mixer_mutex);
+}
 
+// Check the header of a sound lump, and find the sample data in it.
+// Returns true if this is a valid sound.
+
+static boolean ParseSoundLump(byte *lump, unsigned int lumplen,
+                              byte **data, int *samplerate,
+                              unsigned int *length)
+{
     // Check the header, and ensure this is a valid sound
 
     if (lumplen < 8
-     || data[0] != 0x03 || data[1] != 0x00)
+     || lump[0] != 0x03 || lump[1] != 0x00)
     {
         // Invalid sound
 
@@ -740,8 +787,8 @@ static boolean CacheSFX(sfxinfo_t *sfxinfo)
 
     // 16 bit sample rate field, 32 bit length field
 
-    samplerate = (data[3] << 8) | data[2];
-    length = (data[7] << 24) | (data[6] << 16) | (data[5] << 8) | data[4];
+    *samplerate = (lump[3] << 8) | lump[2];
+    *length = (lump[7] << 24) | (lump[6] << 16) | (lump[5] << 8) | lump[4];
 
     // If the header specifies that the length of the sound is greater than
     // the length of the lump itself, this is an invalid sound lump
@@ -752,7 +799,7 @@ static boolean CacheSFX(sfxinfo_t *sfxinfo)
     // further investigation to better understand the correct
     // behavior.
 
-    if (length > lumplen - 8 || length <= 48)
+    if (*length > lumplen - 8 || *length <= 48)
     {
         return false;
     }
@@ -760,33 +807,64 @@ static boolean CacheSFX(sfxinfo_t *sfxinfo)
     // The DMX sound library seems to skip the first 16 and last 16
     // bytes of the lump - reason unknown.
 
-    data += 16;
-    length -= 32;
+    *data = lump + 16 + 8;
+    *length -= 32;
+
+    return true;
+}
+
+// Load and convert a sound effect.  If unconverted is true, the sound
+// is stored as it is, to be converted later.
+// Returns true if successful
+
+static boolean CacheSFX(sfxinfo_t *sfxinfo, boolean unconverted)
+{
+    int lumpnum;
+    unsigned int lumplen;
+    int samplerate;
+    unsigned int length;
+    byte *lump, *data;
+    boolean result;
+
+    // need to load the sound
+
+    lumpnum = sfxinfo->lumpnum;
+    lump = W_CacheLumpNum(lumpnum, PU_STATIC);
+    lumplen = W_LumpLength(lumpnum);
 
     // Sample rate conversion
 
-    if (!ExpandSoundData(sfxinfo, data + 8, samplerate, length))
+    result = ParseSoundLump(lump, lumplen, &data, &samplerate, &length)
+          && (unconverted ? ExpandSoundData_Raw : ExpandSoundData)
+                 (sfxinfo, data, samplerate, length);
+
+    if (result && unconverted)
     {
-        return false;
+        allocated_sound_t *snd = GetAllocatedSoundBySfxInfo(sfxinfo);
+
+        snd->unconverted = true;
+        snd->gain = libsamplerate_scale * 0x10000;
     }
 
+    // don't need the original lump any more
+
+    W_ReleaseLumpNum(lumpnum);
+
 #ifdef DEBUG_DUMP_WAVS
+    if (result)
     {
         char filename[16];
         allocated_sound_t * snd;
 
         M_snprintf(filename, sizeof(filename), "%s.wav",
                    DEH_String(sfxinfo->name));
-        snd = GetAllocatedSoundBySfxInfoAndPitch(sfxinfo, NORM_PITCH);
-        WriteWAV(filename, snd->chunk.abuf, snd->chunk.alen,mixer_freq);
+        snd = GetAllocatedSoundBySfxInfo(sfxinfo);
+        WriteWAV(filename, snd->data, snd->length * (snd->bits / 8),
+                 snd->bits, snd->samplerate);
     }
 #endif
 
-    // don't need the original lump any more
-  
-    W_ReleaseLumpNum(lumpnum);
-
-    return true;
+    return result;
 }
 
 static void GetSfxLumpName(sfxinfo_t *sfx, char *buf, size_t buf_len)
@@ -813,7 +891,277 @@ static void GetSfxLumpName(sfxinfo_t *sfx, char *buf, size_t buf_len)
 
 #ifdef HAVE_LIBSAMPLERATE
 
-// Preload all the sound effects - stops nasty ingame freezes
+// Sound effects are expanded with libsamplerate in the background,
+// rather than all at startup.  The precache thread only resamples a
+// private copy of the lump data; everything that touches the cache or
+// the WAD is done on the main thread, by UpdatePrecache.
+
+typedef enum
+{
+    PRECACHE_IDLE,      // Waiting for a sound to expand
+    PRECACHE_BUSY,      // Sound being expanded by the thread
+    PRECACHE_DONE,      // Sound expanded, waiting to be stored
+} precache_state_t;
+
+static SDL_Thread *precache_thread = NULL;
+static SDL_sem *precache_sem;
+static SDL_atomic_t precache_state;
+static SDL_atomic_t precache_quit;
+
+// Sounds still to be expanded.
+
+static sfxinfo_t **precache_queue = NULL;
+static int precache_queue_len = 0;
+static int precache_queue_pos = 0;
+
+// The sound being expanded by the thread.
+
+static sfxinfo_t *precache_sfxinfo;
+static byte *precache_data = NULL;
+static int precache_samplerate;
+static unsigned int precache_length;
+static SRC_DATA precache_src;
+
+// Returns true if a sound still has to be expanded: if it isn't in
+// the cache, or only unconverted.
+
+static boolean NeedsPrecache(sfxinfo_t *sfxinfo)
+{
+    allocated_sound_t *snd = GetAllocatedSoundBySfxInfo(sfxinfo);
+
+    return snd == NULL || snd->unconverted;
+}
+
+static int PrecacheThread(void *unused)
+{
+    for (;;)
+    {
+        SDL_SemWait(precache_sem);
+
+        if (SDL_AtomicAdd(&precache_quit, 0))
+        {
+            break;
+        }
+
+        ResampleSound_SRC(&precache_src, precache_data,
+                          precache_samplerate, precache_length);
+
+        SDL_AtomicSet(&precache_state, PRECACHE_DONE);
+    }
+
+    return 0;
+}
+
+// Hand a sound to the precache thread.  Returns false if the sound
+// can't be expanded.
+
+static boolean StartPrecache(sfxinfo_t *sfxinfo)
+{
+    char namebuf[9];
+    int lumpnum;
+    unsigned int lumplen;
+    int samplerate;
+    unsigned int length;
+    byte *lump, *data;
+    size_t expanded_len;
+
+    // Look the lump up again: the game may have reset the lump
+    // numbers set by I_SDL_PrecacheSounds.
+
+    GetSfxLumpName(sfxinfo, namebuf, sizeof(namebuf));
+    lumpnum = W_CheckNumForName(namebuf);
+
+    if (lumpnum < 0)
+    {
+        return false;
+    }
+
+    lump = W_CacheLumpNum(lumpnum, PU_STATIC);
+    lumplen = W_LumpLength(lumpnum);
+
+    if (!ParseSoundLump(lump, lumplen, &data, &samplerate, &length))
+    {
+        W_ReleaseLumpNum(lumpnum);
+        return false;
+    }
+
+    // Sounds are expanded ahead of time only while they fit in the
+    // cache: never evict a sound to make room for one that may not
+    // be played at all.  A sound already played unconverted replaces
+    // itself.
+
+    expanded_len = ((uint64_t) length * mixer_freq / samplerate) * 2;
+
+    if (GetAllocatedSoundBySfxInfo(sfxinfo) == NULL && snd_cachesize > 0
+     && allocated_sounds_size + expanded_len > snd_cachesize)
+    {
+        W_ReleaseLumpNum(lumpnum);
+        return false;
+    }
+
+    precache_data = malloc(length);
+
+    if (precache_data == NULL)
+    {
+        W_ReleaseLumpNum(lumpnum);
+        return false;
+    }
+
+    memcpy(precache_data, data, length);
+    W_ReleaseLumpNum(lumpnum);
+
+    precache_sfxinfo = sfxinfo;
+    precache_samplerate = samplerate;
+    precache_length = length;
+
+    SDL_AtomicSet(&precache_state, PRECACHE_BUSY);
+    SDL_SemPost(precache_sem);
+
+    return true;
+}
+
+// Called periodically to store the sound expanded by the precache
+// thread, and to start it on the next one.
+
+static void UpdatePrecache(void)
+{
+    sfxinfo_t *sfxinfo;
+    allocated_sound_t *snd;
+    int state;
+
+    if (precache_thread == NULL)
+    {
+        return;
+    }
+
+    state = SDL_AtomicAdd(&precache_state, 0);
+
+    if (state == PRECACHE_BUSY)
+    {
+        return;
+    }
+
+    if (state == PRECACHE_DONE)
+    {
+        // The sound may have been played while it was being expanded.
+        // If it was played unconverted, replace it; a copy still
+        // playing is freed when it stops.  Otherwise, other sounds may
+        // have filled the cache in the meantime.
+
+        snd = GetAllocatedSoundBySfxInfo(precache_sfxinfo);
+
+        if (snd != NULL && snd->unconverted)
+        {
+            if (snd->use_count == 0)
+            {
+                FreeAllocatedSound(snd);
+            }
+
+            if (StoreSound_SRC(precache_sfxinfo, &precache_src))
+            {
+                ++cache_prefetched;
+            }
+        }
+        else if (snd == NULL
+              && (snd_cachesize <= 0
+               || allocated_sounds_size + precache_src.output_frames_gen * 2
+                  <= snd_cachesize)
+              && StoreSound_SRC(precache_sfxinfo, &precache_src))
+        {
+            ++cache_prefetched;
+        }
+
+        free(precache_src.data_out);
+        free(precache_data);
+        precache_data = NULL;
+
+        SDL_AtomicSet(&precache_state, PRECACHE_IDLE);
+    }
+
+    while (precache_queue_pos < precache_queue_len)
+    {
+        sfxinfo = precache_queue[precache_queue_pos++];
+
+        if (NeedsPrecache(sfxinfo) && StartPrecache(sfxinfo))
+        {
+            break;
+        }
+    }
+}
+
+static void ShutdownPrecache(void)
+{
+    if (precache_thread == NULL)
+    {
+        return;
+    }
+
+    SDL_AtomicSet(&precache_quit, 1);
+    SDL_SemPost(precache_sem);
+    SDL_WaitThread(precache_thread, NULL);
+    SDL_DestroySemaphore(precache_sem);
+    precache_thread = NULL;
+
+    if (SDL_AtomicAdd(&precache_state, 0) == PRECACHE_DONE)
+    {
+        free(precache_src.data_out);
+    }
+
+    free(precache_data);
+    precache_data = NULL;
+
+    free(precache_queue);
+    precache_queue = NULL;
+    precache_queue_len = 0;
+    precache_queue_pos = 0;
+}
+
+// Put sounds at the front of the precache queue, to be expanded
+// before the rest.  Returns true if they were queued.
+
+static boolean QueuePrecache(sfxinfo_t **sounds, int num_sounds)
+{
+    sfxinfo_t **queue;
+    int pending;
+
+    if (precache_thread == NULL)
+    {
+        return false;
+    }
+
+    pending = precache_queue_len - precache_queue_pos;
+    queue = malloc((num_sounds + pending) * sizeof(*queue));
+
+    if (queue == NULL)
+    {
+        return false;
+    }
+
+    memcpy(queue, sounds, num_sounds * sizeof(*queue));
+    memcpy(queue + num_sounds, precache_queue + precache_queue_pos,
+           pending * sizeof(*queue));
+
+    free(precache_queue);
+    precache_queue = queue;
+    precache_queue_len = num_sounds + pending;
+    precache_queue_pos = 0;
+
+    return true;
+}
+
+// Expand the sounds a level is likely to use first, as soon as it
+// is loaded.
+
+static void I_SDL_PrefetchSounds(sfxinfo_t **sounds, int num_sounds)
+{
+    if (QueuePrecache(sounds, num_sounds))
+    {
+        UpdatePrecache();
+    }
+}
+
+// Queue all the sound effects to be expanded in the background, to
+// stop nasty ingame freezes.
 
 static void I_SDL_PrecacheSounds(sfxinfo_t *sounds, int num_sounds)
 {
@@ -822,59 +1170,112 @@ static void I_SDL_PrecacheSounds(sfxinfo_t *sounds, int num_sounds)
 
     // Don't need to precache the sounds unless we are using libsamplerate.
 
-    if (use_libsamplerate == 0)
+    if (use_libsamplerate == 0 || precache_thread != NULL)
     {
 	return;
     }
 
-    printf("I_SDL_PrecacheSounds: Precaching all sound effects..");
+    precache_queue = malloc(num_sounds * sizeof(*precache_queue));
 
-    for (i=0; i<num_sounds; ++i)
+    if (precache_queue == NULL)
     {
-        if ((i % 6) == 0)
-        {
-            printf(".");
-            fflush(stdout);
-        }
+        return;
+    }
+
+    precache_queue_len = 0;
+    precache_queue_pos = 0;
 
+    for (i=0; i<num_sounds; ++i)
+    {
         GetSfxLumpName(&sounds[i], namebuf, sizeof(namebuf));
 
         sounds[i].lumpnum = W_CheckNumForName(namebuf);
 
         if (sounds[i].lumpnum != -1)
         {
-            CacheSFX(&sounds[i]);
+            precache_queue[precache_queue_len++] = &sounds[i];
         }
     }
 
-    printf("\n");
+    SDL_AtomicSet(&precache_state, PRECACHE_IDLE);
+    SDL_AtomicSet(&precache_quit, 0);
+    precache_sem = SDL_CreateSemaphore(0);
+    precache_thread = SDL_CreateThread(PrecacheThread, "PrecacheSounds",
+                                       NULL);
+
+    if (precache_thread == NULL)
+    {
+        fprintf(stderr, "I_SDL_PrecacheSounds: Failed to start thread: %s\n",
+                        SDL_GetError());
+        SDL_DestroySemaphore(precache_sem);
+        free(precache_queue);
+        precache_queue = NULL;
+        precache_queue_len = 0;
+        return;
+    }
+
+    printf("I_SDL_PrecacheSounds: Precaching %i sound effects "
+           "in the background.\n", precache_queue_len);
+
+    UpdatePrecache();
 }
 
 #else
 
+static boolean QueuePrecache(sfxinfo_t **sounds, int num_sounds)
+{
+    return false;
+}
+
+static void UpdatePrecache(void)
+{
+}
+
+static void ShutdownPrecache(void)
+{
+}
+
 static void I_SDL_PrecacheSounds(sfxinfo_t *sounds, int num_sounds)
 {
     // no-op
 }
 
+static void I_SDL_PrefetchSounds(sfxinfo_t **sounds, int num_sounds)
+{
+    // no-op
+}
+
 #endif
 
-// Load a SFX chunk into memory and ensure that it is locked.
+// Load a SFX into memory and ensure that it is locked.
 
-static boolean LockSound(sfxinfo_t *sfxinfo)
+static allocated_sound_t *LockSound(sfxinfo_t *sfxinfo)
 {
+    allocated_sound_t *snd;
+
     // If the sound isn't loaded, load it now
-    if (GetAllocatedSoundBySfxInfoAndPitch(sfxinfo, NORM_PITCH) == NULL)
+    if (GetAllocatedSoundBySfxInfo(sfxinfo) == NULL)
     {
-        if (!CacheSFX(sfxinfo))
+        ++cache_misses;
+
+        // While the precache thread is running, play the sound
+        // unconverted until the thread has got round to it, rather
+        // than convert it here and hold up the game.
+
+        if (!CacheSFX(sfxinfo, QueuePrecache(&sfxinfo, 1)))
         {
-            return false;
+            return NULL;
         }
     }
+    else
+    {
+        ++cache_hits;
+    }
 
-    LockAllocatedSound(GetAllocatedSoundBySfxInfoAndPitch(sfxinfo, NORM_PITCH));
+    snd = GetAllocatedSoundBySfxInfo(sfxinfo);
+    LockAllocatedSound(snd);
 
-    return true;
+    return snd;
 }
 
 //
@@ -891,15 +1292,12 @@ static int I_SDL_GetSfxLumpNum(sfxinfo_t *sfx)
     return W_GetNumForName(namebuf);
 }
 
-static void I_SDL_UpdateSoundParams(int handle, int vol, int sep)
+// Set the volume of a channel from the volume and separation.
+
+static void SetChannelVolume(sfx_channel_t *chan, int vol, int sep)
 {
     int left, right;
 
-    if (!sound_initialized || handle < 0 || handle >= NUM_CHANNELS)
-    {
-        return;
-    }
-
     left = ((254 - sep) * vol) / 127;
     right = ((sep) * vol) / 127;
 
@@ -908,7 +1306,20 @@ static void I_SDL_UpdateSoundParams(int handle, int vol, int sep)
     if (right < 0) right = 0;
     else if (right > 255) right = 255;
 
-    Mix_SetPanning(handle, left, right);
+    chan->left = (left << 16) / 255;
+    chan->right = (right << 16) / 255;
+}
+
+static void I_SDL_UpdateSoundParams(int handle, int vol, int sep)
+{
+    if (!sound_initialized || handle < 0 || handle >= NUM_CHANNELS)
+    {
+        return;
+    }
+
+    SDL_LockMutex(mixer_mutex);
+    SetChannelVolume(&sfx_channels[handle], vol, sep);
+    SDL_UnlockMutex(mixer_mutex);
 }
 
 //
@@ -921,12 +1332,15 @@ static void I_SDL_UpdateSoundParams(int handle, int vol, int sep)
 // As our sound handling does not handle
 //  priority, it is ignored.
 // Pitching (that is, increased speed of playback)
-//  is set, but currently not used by mixing.
+//  is done by the mixer, by stepping through
+//  the sound data faster or slower.
 //
 
 static int I_SDL_StartSound(sfxinfo_t *sfxinfo, int channel, int vol, int sep, int pitch)
 {
     allocated_sound_t *snd;
+    sfx_channel_t *chan;
+    uint64_t step;
 
     if (!sound_initialized || channel < 0 || channel >= NUM_CHANNELS)
     {
@@ -940,50 +1354,40 @@ static int I_SDL_StartSound(sfxinfo_t *sfxinfo, int channel, int vol, int sep, i
 
     // Get the sound data
 
-    if (!LockSound(sfxinfo))
-    {
-        return -1;
-    }
-
-    snd = GetAllocatedSoundBySfxInfoAndPitch(sfxinfo, pitch);
+    snd = LockSound(sfxinfo);
 
     if (snd == NULL)
     {
-        allocated_sound_t *newsnd;
-        // fetch the base sound effect, un-pitch-shifted
-        snd = GetAllocatedSoundBySfxInfoAndPitch(sfxinfo, NORM_PITCH);
+        return -1;
+    }
 
-        if (snd == NULL)
-        {
-            return -1;
-        }
+    // Step through the sound at its own rate, pitch-shifted up or down.
+    // Playing time is scaled by (2 - pitch / NORM_PITCH): an
+    // approximation of vanilla behaviour based on measurements.
 
-        if (snd_pitchshift)
-        {
-            newsnd = PitchShift(snd, pitch);
+    step = ((uint64_t) snd->samplerate << 32) / mixer_freq;
 
-            if (newsnd)
-            {
-                LockAllocatedSound(newsnd);
-                UnlockAllocatedSound(snd);
-                snd = newsnd;
-            }
-        }
-    }
-    else
+    if (snd_pitchshift)
     {
-        LockAllocatedSound(snd);
+        if (pitch < 0) pitch = 0;
+        else if (pitch > 255) pitch = 255;
+
+        step = step * NORM_PITCH / (2 * NORM_PITCH - pitch);
     }
 
     // play sound
 
-    Mix_PlayChannel(channel, &snd->chunk, 0);
+    SDL_LockMutex(mixer_mutex);
 
-    channels_playing[channel] = snd;
+    chan = &sfx_channels[channel];
+    chan->snd = snd;
+    chan->pos = 0;
+    chan->step = step;
+    SetChannelVolume(chan, vol, sep);
 
-    // set separation, etc.
+    SDL_UnlockMutex(mixer_mutex);
 
-    I_SDL_UpdateSoundParams(channel, vol, sep);
+    channels_playing[channel] = snd;
 
     return channel;
 }
@@ -1004,12 +1408,18 @@ static void I_SDL_StopSound(int handle)
 
 static boolean I_SDL_SoundIsPlaying(int handle)
 {
+    boolean result;
+
     if (!sound_initialized || handle < 0 || handle >= NUM_CHANNELS)
     {
         return false;
     }
 
-    return Mix_Playing(handle);
+    SDL_LockMutex(mixer_mutex);
+    result = sfx_channels[handle].snd != NULL;
+    SDL_UnlockMutex(mixer_mutex);
+
+    return result;
 }
 
 //
@@ -1032,6 +1442,8 @@ static void I_SDL_UpdateSound(void)
             ReleaseSoundOnChannel(i);
         }
     }
+
+    UpdatePrecache();
 }
 
 static void I_SDL_ShutdownSound(void)
@@ -1041,12 +1453,75 @@ static void I_SDL_ShutdownSound(void)
         return;
     }
 
+    ShutdownPrecache();
+
+    Mix_SetPostMix(NULL, NULL);
+    SDL_DestroyMutex(mixer_mutex);
+    mixer_mutex = NULL;
+
     Mix_CloseAudio();
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
 
     sound_initialized = false;
 }
 
+// Write sound cache statistics, and the sounds left in the cache in
+// LRU order, to the file given with -sndcachestats.
+
+static void DumpSoundCacheStats(void)
+{
+    FILE *stream;
+    allocated_sound_t *snd;
+    int i;
+
+    i = M_CheckParmWithArgs("-sndcachestats", 1);
+
+    if (i <= 0)
+    {
+        return;
+    }
+
+    // Allow "-" as output file, for stdout.
+
+    if (strcmp(myargv[i + 1], "-") != 0)
+    {
+        stream = fopen(myargv[i + 1], "w");
+
+        if (stream == NULL)
+        {
+            fprintf(stderr, "DumpSoundCacheStats: Failed to open %s\n",
+                            myargv[i + 1]);
+            return;
+        }
+    }
+    else
+    {
+        stream = stdout;
+    }
+
+    fprintf(stream, "Sound cache: %i bytes in %i sounds, peak %i bytes, "
+                    "limit %i bytes\n",
+                    allocated_sounds_size, allocated_sounds_count,
+                    allocated_sounds_peak, snd_cachesize);
+    fprintf(stream, "Hits: %u, misses: %u, evictions: %u, prefetched: %u\n",
+                    cache_hits, cache_misses, cache_evictions,
+                    cache_prefetched);
+    fprintf(stream, "\n");
+
+    // Sounds still playing are not on the list, and not listed.
+
+    for (snd = allocated_sounds_head; snd != NULL; snd = snd->next)
+    {
+        fprintf(stream, "%-8s %i\n", DEH_String(snd->sfxinfo->name),
+                        snd->length * (snd->bits / 8));
+    }
+
+    if (stream != stdout)
+    {
+        fclose(stream);
+    }
+}
+
 // Calculate slice size, based on snd_maxslicetime_ms.
 // The result must be a power of two.
 
@@ -1085,6 +1560,7 @@ static boolean I_SDL_InitSound(boolean _use_sfx_prefix)
     for (i=0; i<NUM_CHANNELS; ++i)
     {
         channels_playing[i] = NULL;
+        sfx_channels[i].snd = NULL;
     }
 
     if (SDL_Init(SDL_INIT_AUDIO) < 0)
@@ -1099,10 +1575,18 @@ static boolean I_SDL_InitSound(boolean _use_sfx_prefix)
         return false;
     }
 
-    ExpandSoundData = ExpandSoundData_SDL;
+    ExpandSoundData = ExpandSoundData_Raw;
 
     Mix_QuerySpec(&mixer_freq, &mixer_format, &mixer_channels);
 
+    if (mixer_format != AUDIO_S16SYS)
+    {
+        fprintf(stderr, "I_SDL_InitSound: unsupported mixer format %#x\n",
+                        mixer_format);
+        Mix_CloseAudio();
+        return false;
+    }
+
 #ifdef HAVE_LIBSAMPLERATE
     if (use_libsamplerate != 0)
     {
@@ -1123,10 +1607,29 @@ static boolean I_SDL_InitSound(boolean _use_sfx_prefix)
     }
 #endif
 
-    Mix_AllocateChannels(NUM_CHANNELS);
+    // Sound effects are mixed by I_SDL_MixSounds, after SDL_mixer has
+    // mixed the music, so none of its own channels are needed.
+
+    mixer_mutex = SDL_CreateMutex();
+    Mix_AllocateChannels(0);
+    Mix_SetPostMix(I_SDL_MixSounds, NULL);
 
     SDL_PauseAudio(0);
 
+    //!
+    // @arg <filename>
+    //
+    // Write sound effect cache statistics to the specified file on
+    // exit: cache size, hits, misses and evictions, and the sounds
+    // left in the cache, least recently used last.  Use "-" to write
+    // to stdout.
+    //
+
+    if (M_CheckParmWithArgs("-sndcachestats", 1))
+    {
+        I_AtExit(DumpSoundCacheStats, true);
+    }
+
     sound_initialized = true;
 
     return true;
@@ -1155,5 +1658,6 @@ sound_module_t sound_sdl_module =
     I_SDL_StopSound,
     I_SDL_SoundIsPlaying,
     I_SDL_PrecacheSounds,
+    I_SDL_PrefetchSounds,
 };
 
@@ -29,6 +29,7 @@
 
 #include "gusconf.h"
 #include "i_sound.h"
+#include "i_system.h"
 #include "i_video.h"
 #include "m_argv.h"
 #include "m_config.h"
@@ -71,11 +72,14 @@ extern sound_module_t sound_sdl_module;
 extern sound_module_t sound_pcsound_module;
 extern music_module_t music_sdl_module;
 extern music_module_t music_opl_module;
+extern music_module_t music_opl_cache_module;
 
 // For OPL module:
 
 extern opl_driver_ver_t opl_drv_ver;
 extern int opl_io_port;
+extern int opl_music_cache;
+extern int opl_music_cache_size;
 
 // For native music module:
 
@@ -107,6 +111,7 @@ static music_module_t *music_modules[] =
 {
 #ifdef FEATURE_SOUND
     &music_sdl_module,
+    &music_opl_cache_module,
     &music_opl_module,
 #endif
     NULL,
@@ -196,6 +201,9 @@ static void InitMusicModule(void)
 void I_InitSound(boolean use_sfx_prefix)
 {  
     boolean nosound, nosfx, nomusic;
+#ifdef FEATURE_SOUND
+    int i;
+#endif
 
     //!
     // @vanilla
@@ -228,6 +236,38 @@ void I_InitSound(boolean use_sfx_prefix)
 
     monosfx = M_CheckParm("-monosfx") > 0;
 
+#ifdef FEATURE_SOUND
+
+    //!
+    // @arg <lump> <file>
+    //
+    // Play the given music lump through the OPL emulator as fast as
+    // possible, write it to the given WAV file, report the speed and
+    // quit.
+    //
+
+    i = M_CheckParmWithArgs("-oplrender", 2);
+
+    if (i > 0)
+    {
+        I_OPL_RenderSong(myargv[i + 1], myargv[i + 2]);
+        I_Quit();
+    }
+
+    //!
+    //
+    // Play every MUS lump through the OPL emulator, read directly and
+    // converted to MIDI first, check that both write the same OPL
+    // registers at the same times, and quit.
+    //
+
+    if (M_CheckParm("-oplmustest") > 0)
+    {
+        I_OPL_MusTest();
+    }
+
+#endif
+
     // Initialize the sound and music subsystems.
 
     if (!nosound && !screensaver_mode)
@@ -364,6 +404,14 @@ void I_PrecacheSounds(sfxinfo_t *sounds, int num_sounds)
     }
 }
 
+void I_PrefetchSounds(sfxinfo_t **sounds, int num_sounds)
+{
+    if (sound_module != NULL && sound_module->PrefetchSounds != NULL)
+    {
+        sound_module->PrefetchSounds(sounds, num_sounds);
+    }
+}
+
 void I_InitMusic(void)
 {
 }
@@ -463,6 +511,8 @@ void I_BindSoundVariables(void)
     M_BindIntVariable("snd_samplerate",          &snd_samplerate);
     M_BindIntVariable("snd_cachesize",           &snd_cachesize);
     M_BindIntVariable("opl_io_port",             &opl_io_port);
+    M_BindIntVariable("opl_music_cache",         &opl_music_cache);
+    M_BindIntVariable("opl_music_cache_size",    &opl_music_cache_size);
     M_BindIntVariable("snd_pitchshift",          &snd_pitchshift);
 
     M_BindStringVariable("timidity_cfg_path",    &timidity_cfg_path);
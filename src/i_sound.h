@@ -151,6 +151,11 @@ typedef struct
 
     void (*CacheSounds)(sfxinfo_t *sounds, int num_sounds);
 
+    // Called after a level is loaded, with the sound effects that it
+    // is likely to use, to prepare them ahead of time (if necessary)
+
+    void (*PrefetchSounds)(sfxinfo_t **sounds, int num_sounds);
+
 } sound_module_t;
 
 void I_InitSound(boolean use_sfx_prefix);
@@ -162,6 +167,7 @@ int I_StartSound(sfxinfo_t *sfxinfo, int channel, int vol, int sep, int pitch);
 void I_StopSound(int channel);
 boolean I_SoundIsPlaying(int channel);
 void I_PrecacheSounds(sfxinfo_t *sounds, int num_sounds);
+void I_PrefetchSounds(sfxinfo_t **sounds, int num_sounds);
 
 // Interface for music modules
 
@@ -251,5 +257,14 @@ typedef enum {
 
 void I_SetOPLDriverVer(opl_driver_ver_t ver);
 
+// Render a music lump through the OPL emulator to a WAV file.
+
+void I_OPL_RenderSong(char *lumpname, char *filename);
+
+// Check that MUS lumps play the same read directly as converted to
+// MIDI, and exit.
+
+void I_OPL_MusTest(void);
+
 #endif
 
@@ -66,6 +66,11 @@ struct atexit_listentry_s
 
 static atexit_listentry_t *exit_funcs = NULL;
 
+// Thread with an error handler, see I_SetThreadErrorHandler.
+
+static SDL_threadID error_thread;
+static thread_error_handler_t error_thread_handler = NULL;
+
 void I_AtExit(atexit_func_t func, boolean run_on_error)
 {
     atexit_listentry_t *entry;
@@ -272,6 +277,12 @@ void I_Quit (void)
 
 static boolean already_quitting = false;
 
+void I_SetThreadErrorHandler(thread_error_handler_t handler)
+{
+    error_thread = SDL_ThreadID();
+    error_thread_handler = handler;
+}
+
 void I_Error (char *error, ...)
 {
     char msgbuf[512];
@@ -279,6 +290,15 @@ void I_Error (char *error, ...)
     atexit_listentry_t *entry;
     boolean exit_gui_popup;
 
+    if (error_thread_handler != NULL && SDL_ThreadID() == error_thread)
+    {
+        va_start(argptr, error);
+        M_vsnprintf(msgbuf, sizeof(msgbuf), error, argptr);
+        va_end(argptr);
+
+        error_thread_handler(msgbuf);
+    }
+
     if (already_quitting)
     {
         fprintf(stderr, "Внимание: обнаружен рекурсивный вызов в I_Error.\n");
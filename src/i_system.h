@@ -56,6 +56,15 @@ void I_Quit (void);
 
 void I_Error (char *error, ...);
 
+// Only the main thread can shut the program down.  A thread that may
+// hit an error sets a handler, which I_Error calls on that thread with
+// the message instead, and which must not return.  One thread at a
+// time can have a handler; NULL removes it.
+
+typedef void (*thread_error_handler_t)(char *msg);
+
+void I_SetThreadErrorHandler(thread_error_handler_t handler);
+
 void I_Tactile (int on, int off, int total);
 
 boolean I_GetMemoryValue(unsigned int offset, void *value, int size);
@@ -61,6 +61,25 @@ int I_GetTimeMS(void)
     return ticks - basetime;
 }
 
+//
+// Same as I_GetTime, but returns time in microseconds, read from the
+// high resolution counter
+//
+
+static Uint64 basecounter = 0;
+
+uint64_t I_GetTimeUS(void)
+{
+    Uint64 counter;
+
+    counter = SDL_GetPerformanceCounter();
+
+    if (basecounter == 0)
+        basecounter = counter;
+
+    return ((counter - basecounter) * 1000000) / SDL_GetPerformanceFrequency();
+}
+
 // Sleep for a specified number of ms
 
 void I_Sleep(int ms)
@@ -22,6 +22,8 @@
 #ifndef __I_TIMER__
 #define __I_TIMER__
 
+#include "doomtype.h"
+
 #define TICRATE 35
 
 // Called by D_DoomLoop,
@@ -31,6 +33,9 @@ int I_GetTime (void);
 // returns current time in ms
 int I_GetTimeMS (void);
 
+// returns current time in microseconds, for measuring short intervals
+uint64_t I_GetTimeUS (void);
+
 // Pause for a specified number of ms
 void I_Sleep(int ms);
 
@@ -82,8 +82,8 @@ static SDL_Texture *texture_upscaled = NULL;
 static SDL_Rect blit_rect = {
     0,
     0,
-    SCREENWIDTH,
-    SCREENHEIGHT
+    0,
+    0
 };
 
 static uint32_t pixel_format;
@@ -102,6 +102,10 @@ static boolean initialized = false;
 static boolean nomouse = false;
 int usemouse = 1;
 
+// Rendering resolution multiplier (see i_video.h).
+
+int hires = 1;
+
 // Save screenshots in PNG format.
 
 int png_screenshots = 0;
@@ -121,8 +125,8 @@ int video_display = 0;
 
 // Screen width and height, from configuration file.
 
-int window_width = SCREENWIDTH;
-int window_height = SCREENHEIGHT_4_3;
+int window_width = 640;
+int window_height = 480;
 
 // Fullscreen mode, 0x0 for SDL_WINDOW_FULLSCREEN_DESKTOP.
 
@@ -853,6 +857,58 @@ static void SetScaleFactor(int factor)
     fullscreen = false;
 }
 
+//
+// Check the command line for a rendering resolution override and clamp
+// the configured value to what the renderers support. This must run
+// after the config file is loaded and before any renderer or screen
+// buffer is initialized, since SCREENWIDTH and SCREENHEIGHT depend on it.
+//
+
+void I_CheckHiresParm(void)
+{
+    //!
+    // @category video
+    //
+    // Render at the original 320x200 resolution.
+    //
+
+    if (M_CheckParm("-lores"))
+    {
+        hires = 0;
+    }
+
+    //!
+    // @category video
+    //
+    // Render at double the original resolution (640x400).
+    //
+
+    if (M_CheckParm("-hires"))
+    {
+        hires = 1;
+    }
+
+    //!
+    // @category video
+    //
+    // Render at four times the original resolution (1280x800).
+    //
+
+    if (M_CheckParm("-hires4"))
+    {
+        hires = 2;
+    }
+
+    if (hires < 0)
+    {
+        hires = 0;
+    }
+    else if (hires > MAXHIRES)
+    {
+        hires = MAXHIRES;
+    }
+}
+
 void I_GraphicsCheckCommandLine(void)
 {
     int i;
@@ -1306,6 +1362,9 @@ void I_InitGraphics(void)
         fullscreen = true;
     }
 
+    blit_rect.w = SCREENWIDTH;
+    blit_rect.h = SCREENHEIGHT;
+
     if (aspect_ratio_correct)
     {
         actualheight = SCREENHEIGHT_4_3;
@@ -1397,5 +1456,6 @@ void I_BindVideoVariables(void)
     M_BindStringVariable("window_position",        &window_position);
     M_BindIntVariable("usegamma",                  &usegamma);
     M_BindIntVariable("png_screenshots",           &png_screenshots);
+    M_BindIntVariable("hires",                     &hires);
 }
 
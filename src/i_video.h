@@ -26,7 +26,14 @@
 
 // Screen width and height.
 
-#define hires 1
+// Rendering resolution multiplier, as a shift of the original 320x200
+// resolution: 0 renders at 320x200, 1 renders at 640x400 and 2 renders
+// at 1280x800. Read from the config file and command line at startup and
+// constant afterwards.
+
+extern int hires;
+
+#define MAXHIRES 2
 
 #define ORIGWIDTH  320
 #define ORIGHEIGHT 200
@@ -34,6 +41,11 @@
 #define SCREENWIDTH  (ORIGWIDTH << hires)
 #define SCREENHEIGHT (ORIGHEIGHT << hires)
 
+// Largest possible screen size, used to size static renderer arrays.
+
+#define MAXWIDTH  (ORIGWIDTH << MAXHIRES)
+#define MAXHEIGHT (ORIGHEIGHT << MAXHIRES)
+
 #define SCREENWIDTH_4_3 (256 << hires)
 
 // Screen height used when aspect_ratio_correct=true.
@@ -47,6 +59,7 @@ typedef boolean (*grabmouse_callback_t)(void);
 // and sets up the video mode
 void I_InitGraphics (void);
 
+void I_CheckHiresParm(void);
 void I_GraphicsCheckCommandLine(void);
 
 void I_ShutdownGraphics(void);
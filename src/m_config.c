@@ -546,6 +546,24 @@ static default_t extra_defaults_list[] =
 
     CONFIG_VARIABLE_INT(detaillevel),
 
+    //!
+    // @game doom
+    //
+    // If non-zero, the renderer measures its frame time and switches
+    // to low detail while it exceeds auto_detail_budget.
+    //
+
+    CONFIG_VARIABLE_INT(auto_detail),
+
+    //!
+    // @game doom
+    //
+    // Rendering time budget per frame in milliseconds used by
+    // auto_detail.
+    //
+
+    CONFIG_VARIABLE_INT(auto_detail_budget),
+
     //!
     // Number of sounds that will be played simultaneously.
     //
@@ -754,6 +772,13 @@ static default_t extra_defaults_list[] =
 
     CONFIG_VARIABLE_INT(integer_scaling),
 
+    //!
+    // Rendering resolution: 0 renders at the original 320x200,
+    // 1 renders at 640x400 and 2 renders at 1280x800.
+    //
+
+    CONFIG_VARIABLE_INT(hires),
+
     //!
     // Number of milliseconds to wait on startup after the video mode
     // has been set, before the game will start.  This allows the
@@ -875,6 +900,21 @@ static default_t extra_defaults_list[] =
 
     CONFIG_VARIABLE_INT_HEX(opl_io_port),
 
+    //!
+    // If non-zero, OPL music is rendered once into WAV files in the
+    // configuration directory and played back from there, rather than
+    // being synthesized while it plays.
+    //
+
+    CONFIG_VARIABLE_INT(opl_music_cache),
+
+    //!
+    // Size in bytes the OPL music cache may grow to before the oldest
+    // rendered songs are removed, or zero for no limit.
+    //
+
+    CONFIG_VARIABLE_INT(opl_music_cache_size),
+
     //!
     // @game doom heretic strife
     //
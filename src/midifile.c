@@ -29,7 +29,23 @@
 
 #define HEADER_CHUNK_ID "MThd"
 #define TRACK_CHUNK_ID  "MTrk"
-#define MAX_BUFFER_SIZE 0x10000
+
+#define MUS_HEADER_SIZE      14
+#define MUS_PERCUSSION_CHAN  15
+#define MIDI_PERCUSSION_CHAN 9
+#define MUS_TIME_DIVISION    70
+
+// MUS event codes
+
+typedef enum
+{
+    MUS_EVENT_RELEASE_KEY       = 0x00,
+    MUS_EVENT_PRESS_KEY         = 0x10,
+    MUS_EVENT_PITCH_WHEEL       = 0x20,
+    MUS_EVENT_SYSTEM_EVENT      = 0x30,
+    MUS_EVENT_CHANGE_CONTROLLER = 0x40,
+    MUS_EVENT_SCORE_END         = 0x60,
+} mus_event_type_t;
 
 // haleyjd 09/09/10: packing required
 #ifdef _MSC_VER
@@ -57,20 +73,65 @@ typedef struct
 
 typedef struct
 {
-    // Length in bytes:
+    // Track data, from the event after the chunk header up to and
+    // including the end of track event, and its length in bytes:
 
+    byte *data;
     unsigned int data_len;
 
-    // Events in this track:
+    // If true, the track is the score of a MUS file.
 
-    midi_event_t *events;
-    int num_events;
+    boolean mus;
 } midi_track_t;
 
+// Events are decoded from the file data as they are needed, rather
+// than all stored when the file is loaded.  Meta and SysEx event data
+// is not copied: it points into the file data.
+
+typedef struct
+{
+    byte *data;
+    unsigned int len;
+    unsigned int position;
+} midi_stream_t;
+
+// State kept while reading a MUS score, to translate it to the same
+// MIDI events that mus2mid converts it to.
+
+typedef struct
+{
+    // MIDI channel allocated to each MUS channel, or -1:
+
+    int channel_map[MIDI_CHANNELS_PER_TRACK];
+
+    // Last note velocity on each MIDI channel:
+
+    byte velocities[MIDI_CHANNELS_PER_TRACK];
+
+    // Time to the next event:
+
+    unsigned int queued_time;
+
+    // An event held back while a MIDI channel is started with an
+    // "all notes off" event:
+
+    midi_event_t held_event;
+    boolean have_held_event;
+} mus_state_t;
+
 struct midi_track_iter_s
 {
     midi_track_t *track;
-    unsigned int position;
+    midi_stream_t stream;
+    unsigned int last_event_type;
+    mus_state_t mus;
+
+    // The next event, decoded ahead so that its delta time is known,
+    // and the last event returned by MIDI_GetNextEvent.
+
+    midi_event_t next_event;
+    boolean have_next_event;
+    midi_event_t event;
 };
 
 struct midi_file_s
@@ -81,7 +142,7 @@ struct midi_file_s
     midi_track_t *tracks;
     unsigned int num_tracks;
 
-    // Data buffer used to store data read for SysEx or meta events:
+    // The whole file, from which events are read:
     byte *buffer;
     unsigned int buffer_size;
 };
@@ -109,20 +170,17 @@ static boolean CheckChunkHeader(chunk_header_t *chunk,
 
 // Read a single byte.  Returns false on error.
 
-static boolean ReadByte(byte *result, FILE *stream)
+static boolean ReadByte(byte *result, midi_stream_t *stream)
 {
-    int c;
-
-    c = fgetc(stream);
-
-    if (c == EOF)
+    if (stream->position >= stream->len)
     {
         fprintf(stderr, "ReadByte: Unexpected end of file\n");
         return false;
     }
     else
     {
-        *result = (byte) c;
+        *result = stream->data[stream->position];
+        ++stream->position;
 
         return true;
     }
@@ -130,7 +188,7 @@ static boolean ReadByte(byte *result, FILE *stream)
 
 // Read a variable-length value.
 
-static boolean ReadVariableLength(unsigned int *result, FILE *stream)
+static boolean ReadVariableLength(unsigned int *result, midi_stream_t *stream)
 {
     int i;
     byte b = 0;
@@ -164,36 +222,20 @@ static boolean ReadVariableLength(unsigned int *result, FILE *stream)
     return false;
 }
 
-// Read a byte sequence into the data buffer.
+// Skip over a byte sequence, returning a pointer to it in the data.
 
-static void *ReadByteSequence(unsigned int num_bytes, FILE *stream)
+static byte *ReadByteSequence(unsigned int num_bytes, midi_stream_t *stream)
 {
-    unsigned int i;
     byte *result;
 
-    // Allocate a buffer. Allocate one extra byte, as malloc(0) is
-    // non-portable.
-
-    result = malloc(num_bytes + 1);
-
-    if (result == NULL)
+    if (num_bytes > stream->len - stream->position)
     {
-        fprintf(stderr, "ReadByteSequence: Failed to allocate buffer\n");
+        fprintf(stderr, "ReadByteSequence: Unexpected end of file\n");
         return NULL;
     }
 
-    // Read the data:
-
-    for (i=0; i<num_bytes; ++i)
-    {
-        if (!ReadByte(&result[i], stream))
-        {
-            fprintf(stderr, "ReadByteSequence: Error while reading byte %u\n",
-                            i);
-            free(result);
-            return NULL;
-        }
-    }
+    result = stream->data + stream->position;
+    stream->position += num_bytes;
 
     return result;
 }
@@ -204,7 +246,7 @@ static void *ReadByteSequence(unsigned int num_bytes, FILE *stream)
 
 static boolean ReadChannelEvent(midi_event_t *event,
                                 byte event_type, boolean two_param,
-                                FILE *stream)
+                                midi_stream_t *stream)
 {
     byte b = 0;
 
@@ -237,6 +279,10 @@ static boolean ReadChannelEvent(midi_event_t *event,
 
         event->data.channel.param2 = b;
     }
+    else
+    {
+        event->data.channel.param2 = 0;
+    }
 
     return true;
 }
@@ -244,7 +290,7 @@ static boolean ReadChannelEvent(midi_event_t *event,
 // Read sysex event:
 
 static boolean ReadSysExEvent(midi_event_t *event, int event_type,
-                              FILE *stream)
+                              midi_stream_t *stream)
 {
     event->event_type = event_type;
 
@@ -270,7 +316,7 @@ static boolean ReadSysExEvent(midi_event_t *event, int event_type,
 
 // Read meta event:
 
-static boolean ReadMetaEvent(midi_event_t *event, FILE *stream)
+static boolean ReadMetaEvent(midi_event_t *event, midi_stream_t *stream)
 {
     byte b = 0;
 
@@ -309,7 +355,7 @@ static boolean ReadMetaEvent(midi_event_t *event, FILE *stream)
 }
 
 static boolean ReadEvent(midi_event_t *event, unsigned int *last_event_type,
-                         FILE *stream)
+                         midi_stream_t *stream)
 {
     byte event_type = 0;
 
@@ -333,12 +379,7 @@ static boolean ReadEvent(midi_event_t *event, unsigned int *last_event_type,
     if ((event_type & 0x80) == 0)
     {
         event_type = *last_event_type;
-
-        if (fseek(stream, -1, SEEK_CUR) < 0)
-        {
-            fprintf(stderr, "ReadEvent: Unable to seek in stream\n");
-            return false;
-        }
+        --stream->position;
     }
     else
     {
@@ -387,63 +428,280 @@ static boolean ReadEvent(midi_event_t *event, unsigned int *last_event_type,
     return false;
 }
 
-// Free an event:
+// MUS controller numbers to MIDI controllers.
 
-static void FreeEvent(midi_event_t *event)
+static const byte mus_controller_map[] =
 {
-    // Some event types have dynamically allocated buffers assigned
-    // to them that must be freed.
+    0x00, 0x20, 0x01, 0x07, 0x0A, 0x0B, 0x5B, 0x5D,
+    0x40, 0x43, 0x78, 0x7B, 0x7E, 0x7F, 0x79
+};
+
+static void InitMusState(mus_state_t *mus)
+{
+    int i;
 
-    switch (event->event_type)
+    for (i=0; i<MIDI_CHANNELS_PER_TRACK; ++i)
     {
-        case MIDI_EVENT_SYSEX:
-        case MIDI_EVENT_SYSEX_SPLIT:
-            free(event->data.sysex.data);
+        mus->channel_map[i] = -1;
+        mus->velocities[i] = 127;
+    }
+
+    mus->queued_time = 0;
+    mus->have_held_event = false;
+}
+
+// Allocate the MIDI channel after the highest allocated so far,
+// skipping the percussion channel.
+
+static int AllocateMusChannel(mus_state_t *mus)
+{
+    int result;
+    int i;
+
+    result = -1;
+
+    for (i=0; i<MIDI_CHANNELS_PER_TRACK; ++i)
+    {
+        if (mus->channel_map[i] > result)
+        {
+            result = mus->channel_map[i];
+        }
+    }
+
+    ++result;
+
+    if (result == MIDI_PERCUSSION_CHAN)
+    {
+        ++result;
+    }
+
+    return result;
+}
+
+// Read the next MIDI event from a MUS score.  One MUS event is read
+// at a time, and the delay after it added to the time until the next.
+
+static boolean ReadMusEvent(midi_event_t *event, mus_state_t *mus,
+                            midi_stream_t *stream)
+{
+    byte descriptor, key, b;
+    byte controller, value;
+    unsigned int channel;
+    unsigned int delay;
+    boolean new_channel = false;
+
+    if (mus->have_held_event)
+    {
+        *event = mus->held_event;
+        mus->have_held_event = false;
+
+        return true;
+    }
+
+    if (!ReadByte(&descriptor, stream))
+    {
+        fprintf(stderr, "ReadMusEvent: Failed to read event type\n");
+        return false;
+    }
+
+    // MUS channel 15 is the percussion channel.  Other channels are
+    // given MIDI channels in the order they are first used.
+
+    if ((descriptor & 0x0f) == MUS_PERCUSSION_CHAN)
+    {
+        channel = MIDI_PERCUSSION_CHAN;
+    }
+    else
+    {
+        if (mus->channel_map[descriptor & 0x0f] == -1)
+        {
+            mus->channel_map[descriptor & 0x0f] = AllocateMusChannel(mus);
+            new_channel = true;
+        }
+
+        channel = mus->channel_map[descriptor & 0x0f];
+    }
+
+    event->data.channel.channel = channel;
+    event->data.channel.param2 = 0;
+
+    switch (descriptor & 0x70)
+    {
+        case MUS_EVENT_RELEASE_KEY:
+            if (!ReadByte(&key, stream))
+            {
+                return false;
+            }
+
+            event->event_type = MIDI_EVENT_NOTE_OFF;
+            event->data.channel.param1 = key & 0x7f;
             break;
 
-        case MIDI_EVENT_META:
-            free(event->data.meta.data);
+        case MUS_EVENT_PRESS_KEY:
+            if (!ReadByte(&key, stream))
+            {
+                return false;
+            }
+
+            if (key & 0x80)
+            {
+                if (!ReadByte(&b, stream))
+                {
+                    return false;
+                }
+
+                mus->velocities[channel] = b & 0x7f;
+            }
+
+            event->event_type = MIDI_EVENT_NOTE_ON;
+            event->data.channel.param1 = key & 0x7f;
+            event->data.channel.param2 = mus->velocities[channel];
             break;
 
-        default:
-            // Nothing to do.
+        case MUS_EVENT_PITCH_WHEEL:
+            if (!ReadByte(&b, stream))
+            {
+                return false;
+            }
+
+            event->event_type = MIDI_EVENT_PITCH_BEND;
+            event->data.channel.param1 = (b * 64) & 0x7f;
+            event->data.channel.param2 = ((b * 64) >> 7) & 0x7f;
+            break;
+
+        case MUS_EVENT_SYSTEM_EVENT:
+            if (!ReadByte(&controller, stream))
+            {
+                return false;
+            }
+
+            if (controller < 10 || controller > 14)
+            {
+                fprintf(stderr, "ReadMusEvent: Unknown system event: %i\n",
+                                controller);
+                return false;
+            }
+
+            event->event_type = MIDI_EVENT_CONTROLLER;
+            event->data.channel.param1 = mus_controller_map[controller];
             break;
+
+        case MUS_EVENT_CHANGE_CONTROLLER:
+            if (!ReadByte(&controller, stream) || !ReadByte(&value, stream))
+            {
+                return false;
+            }
+
+            if (controller == 0)
+            {
+                event->event_type = MIDI_EVENT_PROGRAM_CHANGE;
+                event->data.channel.param1 = value & 0x7f;
+            }
+            else if (controller <= 9)
+            {
+                // Values should be 7-bit, but vanilla Doom doesn't mask
+                // them; clip them as mus2mid does.
+
+                event->event_type = MIDI_EVENT_CONTROLLER;
+                event->data.channel.param1 = mus_controller_map[controller];
+                event->data.channel.param2 = (value & 0x80) ? 0x7f : value;
+            }
+            else
+            {
+                fprintf(stderr, "ReadMusEvent: Unknown controller: %i\n",
+                                controller);
+                return false;
+            }
+
+            break;
+
+        case MUS_EVENT_SCORE_END:
+            event->event_type = MIDI_EVENT_META;
+            event->data.meta.type = MIDI_META_END_OF_TRACK;
+            event->data.meta.length = 0;
+            event->data.meta.data = NULL;
+            break;
+
+        default:
+            fprintf(stderr, "ReadMusEvent: Unknown MUS event type: 0x%x\n",
+                            descriptor & 0x70);
+            return false;
+    }
+
+    // The first time a channel is used, an "all notes off" event is
+    // sent first.  This fixes "The D_DDTBLU disease" described here:
+    // https://www.doomworld.com/vb/source-ports/66802-the
+
+    if (new_channel)
+    {
+        mus->held_event = *event;
+        mus->held_event.delta_time = 0;
+        mus->have_held_event = true;
+
+        event->event_type = MIDI_EVENT_CONTROLLER;
+        event->data.channel.channel = channel;
+        event->data.channel.param1 = MIDI_CONTROLLER_ALL_NOTES_OFF;
+        event->data.channel.param2 = 0;
+    }
+
+    event->delta_time = mus->queued_time;
+    mus->queued_time = 0;
+
+    // Read the delay after the event:
+
+    if ((descriptor & 0x80) != 0
+     && (descriptor & 0x70) != MUS_EVENT_SCORE_END)
+    {
+        delay = 0;
+
+        do
+        {
+            if (!ReadByte(&b, stream))
+            {
+                fprintf(stderr, "ReadMusEvent: Failed to read delay\n");
+                return false;
+            }
+
+            delay = delay * 128 + (b & 0x7f);
+        } while ((b & 0x80) != 0);
+
+        mus->queued_time += delay;
     }
+
+    return true;
 }
 
 // Read and check the track chunk header
 
-static boolean ReadTrackHeader(midi_track_t *track, FILE *stream)
+static boolean ReadTrackHeader(midi_track_t *track, midi_stream_t *stream)
 {
-    size_t records_read;
     chunk_header_t chunk_header;
 
-    records_read = fread(&chunk_header, sizeof(chunk_header_t), 1, stream);
-
-    if (records_read < 1)
+    if (stream->len - stream->position < sizeof(chunk_header_t))
     {
         return false;
     }
 
+    memcpy(&chunk_header, stream->data + stream->position,
+           sizeof(chunk_header_t));
+    stream->position += sizeof(chunk_header_t);
+
     if (!CheckChunkHeader(&chunk_header, TRACK_CHUNK_ID))
     {
         return false;
     }
 
-    track->data_len = SDL_SwapBE32(chunk_header.chunk_size);
-
     return true;
 }
 
-static boolean ReadTrack(midi_track_t *track, FILE *stream)
+// Find the extent of a track.  Every event is decoded once, to check
+// the track, but none are stored.
+
+static boolean ReadTrack(midi_track_t *track, midi_stream_t *stream)
 {
-    midi_event_t *new_events;
-    midi_event_t *event;
+    midi_event_t event;
     unsigned int last_event_type;
 
-    track->num_events = 0;
-    track->events = NULL;
-
     // Read the header:
 
     if (!ReadTrackHeader(track, stream))
@@ -451,61 +709,36 @@ static boolean ReadTrack(midi_track_t *track, FILE *stream)
         return false;
     }
 
+    track->data = stream->data + stream->position;
+
     // Then the events:
 
     last_event_type = 0;
 
     for (;;)
     {
-        // Resize the track slightly larger to hold another event:
-
-        new_events = realloc(track->events, 
-                             sizeof(midi_event_t) * (track->num_events + 1));
-
-        if (new_events == NULL)
-        {
-            return false;
-        }
-
-        track->events = new_events;
-
         // Read the next event:
 
-        event = &track->events[track->num_events];
-        if (!ReadEvent(event, &last_event_type, stream))
+        if (!ReadEvent(&event, &last_event_type, stream))
         {
             return false;
         }
 
-        ++track->num_events;
-
         // End of track?
 
-        if (event->event_type == MIDI_EVENT_META
-         && event->data.meta.type == MIDI_META_END_OF_TRACK)
+        if (event.event_type == MIDI_EVENT_META
+         && event.data.meta.type == MIDI_META_END_OF_TRACK)
         {
             break;
         }
     }
 
-    return true;
-}
+    track->data_len = stream->data + stream->position - track->data;
 
-// Free a track:
-
-static void FreeTrack(midi_track_t *track)
-{
-    unsigned int i;
-
-    for (i=0; i<track->num_events; ++i)
-    {
-        FreeEvent(&track->events[i]);
-    }
-
-    free(track->events);
+    return true;
 }
 
-static boolean ReadAllTracks(midi_file_t *file, FILE *stream)
+static boolean ReadAllTracks(midi_file_t *file, midi_stream_t *stream)
 {
     unsigned int i;
 
@@ -535,18 +768,19 @@ static boolean ReadAllTracks(midi_file_t *file, FILE *stream)
 
 // Read and check the header chunk.
 
-static boolean ReadFileHeader(midi_file_t *file, FILE *stream)
+static boolean ReadFileHeader(midi_file_t *file, midi_stream_t *stream)
 {
-    size_t records_read;
     unsigned int format_type;
 
-    records_read = fread(&file->header, sizeof(midi_header_t), 1, stream);
-
-    if (records_read < 1)
+    if (stream->len - stream->position < sizeof(midi_header_t))
     {
         return false;
     }
 
+    memcpy(&file->header, stream->data + stream->position,
+           sizeof(midi_header_t));
+    stream->position += sizeof(midi_header_t);
+
     if (!CheckChunkHeader(&file->header.chunk_header, HEADER_CHUNK_ID)
      || SDL_SwapBE32(file->header.chunk_header.chunk_size) != 6)
     {
@@ -572,37 +806,144 @@ static boolean ReadFileHeader(midi_file_t *file, FILE *stream)
 
 void MIDI_FreeFile(midi_file_t *file)
 {
-    int i;
+    free(file->tracks);
+    free(file->buffer);
+    free(file);
+}
+
+// Find the extent of the score of a MUS file, and check it, as
+// ReadTrack does for a MIDI track.
+
+static boolean ReadMusTrack(midi_track_t *track, midi_stream_t *stream)
+{
+    midi_event_t event;
+    mus_state_t mus;
+
+    track->data = stream->data + stream->position;
+    track->mus = true;
+
+    InitMusState(&mus);
 
-    if (file->tracks != NULL)
+    do
     {
-        for (i=0; i<file->num_tracks; ++i)
+        if (!ReadMusEvent(&event, &mus, stream))
         {
-            FreeTrack(&file->tracks[i]);
+            return false;
         }
+    } while (event.event_type != MIDI_EVENT_META);
+
+    track->data_len = stream->data + stream->position - track->data;
+
+    return true;
+}
+
+// Load a MUS file from a buffer, which is freed with the file.  It is
+// read as a type 0 MIDI file of one track.
 
-        free(file->tracks);
+static midi_file_t *LoadMusFromBuffer(byte *buffer, unsigned int buflen)
+{
+    midi_file_t *file;
+    midi_stream_t stream;
+    unsigned int score_start;
+
+    file = malloc(sizeof(midi_file_t));
+
+    if (file == NULL)
+    {
+        free(buffer);
+        return NULL;
     }
 
-    free(file);
+    file->buffer = buffer;
+    file->buffer_size = buflen;
+    file->num_tracks = 1;
+    file->tracks = malloc(sizeof(midi_track_t));
+
+    memcpy(file->header.chunk_header.chunk_id, HEADER_CHUNK_ID, 4);
+    file->header.chunk_header.chunk_size = SDL_SwapBE32(6);
+    file->header.format_type = SDL_SwapBE16(0);
+    file->header.num_tracks = SDL_SwapBE16(1);
+    file->header.time_division = SDL_SwapBE16(MUS_TIME_DIVISION);
+
+    if (file->tracks == NULL || buflen < MUS_HEADER_SIZE)
+    {
+        MIDI_FreeFile(file);
+        return NULL;
+    }
+
+    // Only the start of the score is needed from the header; the
+    // score is read up to the score end event.
+
+    score_start = buffer[6] | (buffer[7] << 8);
+
+    if (score_start >= buflen)
+    {
+        fprintf(stderr, "LoadMusFromBuffer: Invalid MUS header\n");
+        MIDI_FreeFile(file);
+        return NULL;
+    }
+
+    stream.data = buffer;
+    stream.len = buflen;
+    stream.position = score_start;
+
+    if (!ReadMusTrack(&file->tracks[0], &stream))
+    {
+        MIDI_FreeFile(file);
+        return NULL;
+    }
+
+    return file;
 }
 
-midi_file_t *MIDI_LoadFile(char *filename)
+// Load a MIDI file from a buffer, which is freed with the file.
+
+static midi_file_t *LoadFileFromBuffer(byte *buffer, unsigned int buflen)
 {
     midi_file_t *file;
-    FILE *stream;
+    midi_stream_t stream;
 
     file = malloc(sizeof(midi_file_t));
 
     if (file == NULL)
     {
+        free(buffer);
         return NULL;
     }
 
     file->tracks = NULL;
     file->num_tracks = 0;
-    file->buffer = NULL;
-    file->buffer_size = 0;
+    file->buffer = buffer;
+    file->buffer_size = buflen;
+
+    stream.data = buffer;
+    stream.len = buflen;
+    stream.position = 0;
+
+    // Read MIDI file header
+
+    if (!ReadFileHeader(file, &stream))
+    {
+        MIDI_FreeFile(file);
+        return NULL;
+    }
+
+    // Read all tracks:
+
+    if (!ReadAllTracks(file, &stream))
+    {
+        MIDI_FreeFile(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+midi_file_t *MIDI_LoadFile(char *filename)
+{
+    FILE *stream;
+    byte *buffer;
+    long length;
 
     // Open file
 
@@ -611,31 +952,60 @@ midi_file_t *MIDI_LoadFile(char *filename)
     if (stream == NULL)
     {
         fprintf(stderr, "MIDI_LoadFile: Failed to open '%s'\n", filename);
-        MIDI_FreeFile(file);
         return NULL;
     }
 
-    // Read MIDI file header
+    // Read the whole file
+
+    fseek(stream, 0, SEEK_END);
+    length = ftell(stream);
+    fseek(stream, 0, SEEK_SET);
 
-    if (!ReadFileHeader(file, stream))
+    buffer = length > 0 ? malloc(length) : NULL;
+
+    if (buffer == NULL || fread(buffer, 1, length, stream) < length)
     {
+        fprintf(stderr, "MIDI_LoadFile: Failed to read '%s'\n", filename);
+        free(buffer);
         fclose(stream);
-        MIDI_FreeFile(file);
         return NULL;
     }
 
-    // Read all tracks:
+    fclose(stream);
 
-    if (!ReadAllTracks(file, stream))
+    return LoadFileFromBuffer(buffer, length);
+}
+
+midi_file_t *MIDI_LoadFileFromMem(void *buf, size_t buflen)
+{
+    byte *buffer;
+
+    buffer = malloc(buflen);
+
+    if (buffer == NULL)
     {
-        fclose(stream);
-        MIDI_FreeFile(file);
         return NULL;
     }
 
-    fclose(stream);
+    memcpy(buffer, buf, buflen);
 
-    return file;
+    return LoadFileFromBuffer(buffer, buflen);
+}
+
+midi_file_t *MIDI_LoadMusFromMem(void *buf, size_t buflen)
+{
+    byte *buffer;
+
+    buffer = malloc(buflen);
+
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(buffer, buf, buflen);
+
+    return LoadMusFromBuffer(buffer, buflen);
 }
 
 // Get the number of tracks in a MIDI file.
@@ -645,6 +1015,28 @@ unsigned int MIDI_NumTracks(midi_file_t *file)
     return file->num_tracks;
 }
 
+// Decode the next event of a track, if there is one.  The track was
+// checked when the file was loaded, so this can only fail past the
+// end of the track.
+
+static void ReadNextEvent(midi_track_iter_t *iter)
+{
+    if (iter->track->mus)
+    {
+        iter->have_next_event = (iter->mus.have_held_event
+                              || iter->stream.position < iter->stream.len)
+                             && ReadMusEvent(&iter->next_event, &iter->mus,
+                                             &iter->stream);
+    }
+    else
+    {
+        iter->have_next_event = iter->stream.position < iter->stream.len
+                             && ReadEvent(&iter->next_event,
+                                          &iter->last_event_type,
+                                          &iter->stream);
+    }
+}
+
 // Start iterating over the events in a track.
 
 midi_track_iter_t *MIDI_IterateTrack(midi_file_t *file, unsigned int track)
@@ -655,7 +1047,10 @@ midi_track_iter_t *MIDI_IterateTrack(midi_file_t *file, unsigned int track)
 
     iter = malloc(sizeof(*iter));
     iter->track = &file->tracks[track];
-    iter->position = 0;
+    iter->stream.data = iter->track->data;
+    iter->stream.len = iter->track->data_len;
+
+    MIDI_RestartIterator(iter);
 
     return iter;
 }
@@ -669,13 +1064,9 @@ void MIDI_FreeIterator(midi_track_iter_t *iter)
 
 unsigned int MIDI_GetDeltaTime(midi_track_iter_t *iter)
 {
-    if (iter->position < iter->track->num_events)
+    if (iter->have_next_event)
     {
-        midi_event_t *next_event;
-
-        next_event = &iter->track->events[iter->position];
-
-        return next_event->delta_time;
+        return iter->next_event.delta_time;
     }
     else
     {
@@ -687,10 +1078,11 @@ unsigned int MIDI_GetDeltaTime(midi_track_iter_t *iter)
 
 int MIDI_GetNextEvent(midi_track_iter_t *iter, midi_event_t **event)
 {
-    if (iter->position < iter->track->num_events)
+    if (iter->have_next_event)
     {
-        *event = &iter->track->events[iter->position];
-        ++iter->position;
+        iter->event = iter->next_event;
+        *event = &iter->event;
+        ReadNextEvent(iter);
 
         return 1;
     }
@@ -719,7 +1111,10 @@ unsigned int MIDI_GetFileTimeDivision(midi_file_t *file)
 
 void MIDI_RestartIterator(midi_track_iter_t *iter)
 {
-    iter->position = 0;
+    iter->stream.position = 0;
+    iter->last_event_type = 0;
+    InitMusState(&iter->mus);
+    ReadNextEvent(iter);
 }
 
 #ifdef TEST
@@ -754,15 +1149,12 @@ static char *MIDI_EventTypeToString(midi_event_type_t event_type)
     }
 }
 
-void PrintTrack(midi_track_t *track)
+void PrintTrack(midi_track_iter_t *iter)
 {
     midi_event_t *event;
-    unsigned int i;
 
-    for (i=0; i<track->num_events; ++i)
+    while (MIDI_GetNextEvent(iter, &event))
     {
-        event = &track->events[i];
-
         if (event->delta_time > 0)
         {
             printf("Delay: %i ticks\n", event->delta_time);
@@ -802,6 +1194,7 @@ void PrintTrack(midi_track_t *track)
 int main(int argc, char *argv[])
 {
     midi_file_t *file;
+    midi_track_iter_t *iter;
     unsigned int i;
 
     if (argc < 2)
@@ -822,7 +1215,9 @@ int main(int argc, char *argv[])
     {
         printf("\n== Track %i ==\n\n", i);
 
-        PrintTrack(&file->tracks[i]);
+        iter = MIDI_IterateTrack(file, i);
+        PrintTrack(iter);
+        MIDI_FreeIterator(iter);
     }
 
     return 0;
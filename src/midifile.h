@@ -136,6 +136,16 @@ typedef struct
 
 midi_file_t *MIDI_LoadFile(char *filename);
 
+// Load a MIDI file from memory.  The data is copied, so the buffer
+// need not outlive the file.
+
+midi_file_t *MIDI_LoadFileFromMem(void *buf, size_t buflen);
+
+// Load a MUS file from memory.  It is read as a one-track MIDI file,
+// with the same events that mus2mid would convert it to.
+
+midi_file_t *MIDI_LoadMusFromMem(void *buf, size_t buflen);
+
 // Free a MIDI file.
 
 void MIDI_FreeFile(midi_file_t *file);
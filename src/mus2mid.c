@@ -471,13 +471,17 @@ boolean mus2mid(MEMFILE *musinput, MEMFILE *midioutput)
     // Used in building up time delays
     unsigned int timedelay;
 
-    // Initialise channel map to mark all channels as unused.
+    // Initialise channel map to mark all channels as unused, and
+    // forget the velocities and time left from the last song.
 
     for (channel=0; channel<NUM_CHANNELS; ++channel)
     {
         channel_map[channel] = -1;
+        channelvelocities[channel] = 127;
     }
 
+    queuedtime = 0;
+
     // Grab the header
 
     if (!ReadMusHeader(musinput, &musfileheader))
@@ -91,9 +91,11 @@ typedef struct
 
     unsigned int seq;
 
-    // Time the command was generated
+    // Time the command was generated, and whether it has been sent
+    // again since, on request
 
     unsigned int time;
+    boolean resent;
 
     // Ticcmd diff
 
@@ -166,6 +168,14 @@ unsigned int net_local_is_freedoom;
 
 static fixed_t average_latency;
 
+// Round trip time and loss of game data from the server
+
+static net_link_t server_link;
+
+// Hold back received tics to absorb jitter (-jitterbuffer)
+
+static boolean jitter_buffer;
+
 #define NET_CL_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
 
 // Called when we become disconnected from the server
@@ -205,6 +215,12 @@ static void NET_CL_ExpandFullTiccmd(net_full_ticcmd_t *cmd, unsigned int seq,
         latency = -1;
     }
 
+    if (seq != send_queue[seq % BACKUPTICS].seq
+     || !send_queue[seq % BACKUPTICS].resent)
+    {
+        NET_Link_RoundTrip(&server_link, latency);
+    }
+
     if (latency >= 0)
     {
         if (seq <= 20)
@@ -372,15 +388,33 @@ static void NET_CL_SendTics(int start, int end)
 
     // Add the tics.
 
-    for (i=start; i<=end; ++i)
+    if (settings.packed_tics)
     {
-        net_server_send_t *sendobj;
+        net_ticpacker_t packer;
 
-        sendobj = &send_queue[i % BACKUPTICS];
+        NET_InitTicPacker(&packer, packet);
 
-        NET_WriteInt16(packet, average_latency / FRACUNIT);
+        for (i=start; i<=end; ++i)
+        {
+            NET_PackTic(&packer, average_latency / FRACUNIT,
+                        &send_queue[i % BACKUPTICS].cmd,
+                        settings.lowres_turn);
+        }
 
-        NET_WriteTiccmdDiff(packet, &sendobj->cmd, settings.lowres_turn);
+        NET_FinishTicPacker(&packer);
+    }
+    else
+    {
+        for (i=start; i<=end; ++i)
+        {
+            net_server_send_t *sendobj;
+
+            sendobj = &send_queue[i % BACKUPTICS];
+
+            NET_WriteInt16(packet, average_latency / FRACUNIT);
+
+            NET_WriteTiccmdDiff(packet, &sendobj->cmd, settings.lowres_turn);
+        }
     }
     
     // Send the packet
@@ -414,13 +448,15 @@ void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic)
     sendobj->active = true;
     sendobj->seq = maketic;
     sendobj->time = I_GetTimeMS();
+    sendobj->resent = false;
     sendobj->cmd = diff;
 
     last_ticcmd = *ticcmd;
 
-    // Send to server.
+    // Send to server, along with as many earlier tics as the loss
+    // seen on the link calls for.
 
-    starttic = maketic - settings.extratics;
+    starttic = maketic - NET_Link_ExtraTics(&server_link, settings.extratics);
     endtic = maketic;
 
     if (starttic < 0)
@@ -524,6 +560,21 @@ static void NET_CL_ParseGameStart(net_packet_t *packet)
     // Clear the send queue
 
     memset(&send_queue, 0x00, sizeof(send_queue));
+
+    NET_Link_Init(&server_link);
+}
+
+// Number of received tics to hold back before running them, so that
+// late packets do not stall the game.
+
+int NET_CL_JitterTics(void)
+{
+    if (client_state != CLIENT_STATE_IN_GAME || !jitter_buffer)
+    {
+        return 0;
+    }
+
+    return NET_Link_JitterTics(&server_link);
 }
 
 static void NET_CL_SendResendRequest(int start, int end)
@@ -554,6 +605,11 @@ static void NET_CL_SendResendRequest(int start, int end)
         if (index < 0 || index >= BACKUPTICS)
             continue;
 
+        if (recvwindow[index].resend_time == 0)
+        {
+            NET_Link_TicReceived(&server_link, true);
+        }
+
         recvwindow[index].resend_time = nowtime;
     }
 }
@@ -565,8 +621,10 @@ static void NET_CL_CheckResends(void)
     int i;
     int resend_start, resend_end;
     unsigned int nowtime;
+    int timeout;
 
     nowtime = I_GetTimeMS();
+    timeout = NET_Link_ResendTimeout(&server_link);
 
     resend_start = -1;
     resend_end = -1;
@@ -579,11 +637,11 @@ static void NET_CL_CheckResends(void)
         recvobj = &recvwindow[i];
 
         // if need_resend is true, this tic needs another retransmit
-        // request (300ms timeout)
+        // request (timeout follows the round trip time)
 
         need_resend = !recvobj->active
                    && recvobj->resend_time != 0
-                   && nowtime > recvobj->resend_time + 300;
+                   && nowtime > recvobj->resend_time + timeout;
 
         if (need_resend)
         {
@@ -635,6 +693,7 @@ static void NET_CL_CheckResends(void)
 static void NET_CL_ParseGameData(net_packet_t *packet)
 {
     net_server_recv_t *recvobj;
+    net_ticpacker_t packer;
     unsigned int seq, num_tics;
     unsigned int nowtime;
     int resend_start, resend_end;
@@ -664,13 +723,22 @@ static void NET_CL_ParseGameData(net_packet_t *packet)
 
     seq = NET_CL_ExpandTicNum(seq);
 
+    NET_InitTicPacker(&packer, packet);
+
     for (i=0; i<num_tics; ++i)
     {
         net_full_ticcmd_t cmd;
 
         index = seq - recvwindow_start + i;
 
-        if (!NET_ReadFullTiccmd(packet, &cmd, settings.lowres_turn))
+        if (settings.packed_tics)
+        {
+            if (!NET_UnpackFullTiccmd(&packer, &cmd, settings.lowres_turn))
+            {
+                return;
+            }
+        }
+        else if (!NET_ReadFullTiccmd(packet, &cmd, settings.lowres_turn))
         {
             return;
         }
@@ -686,6 +754,11 @@ static void NET_CL_ParseGameData(net_packet_t *packet)
         
         recvobj = &recvwindow[index];
 
+        if (!recvobj->active && recvobj->resend_time == 0)
+        {
+            NET_Link_TicReceived(&server_link, false);
+        }
+
         recvobj->active = true;
         recvobj->cmd = cmd;
     }
@@ -745,6 +818,7 @@ static void NET_CL_ParseResendRequest(net_packet_t *packet)
     static unsigned int start;
     static unsigned int end;
     static unsigned int num_tics;
+    unsigned int i;
 
     if (drone)
     {
@@ -788,6 +862,11 @@ static void NET_CL_ParseResendRequest(net_packet_t *packet)
     {
         //printf("CL: resend %i-%i\n", start, start+num_tics-1);
 
+        for (i=start; i<=end; ++i)
+        {
+            send_queue[i % BACKUPTICS].resent = true;
+        }
+
         NET_CL_SendTics(start, end);
     }
 }
@@ -1096,6 +1175,16 @@ void NET_CL_Init(void)
 
     if (net_player_name == NULL)
         net_player_name = "Player";
+
+    //!
+    // @category net
+    //
+    // Hold back a few received tics, sized from the measured variation
+    // in round trip time, to smooth over late packets on a jittery
+    // link. This adds up to three tics of input latency.
+    //
+
+    jitter_buffer = M_ParmExists("-jitterbuffer");
 }
 
 void NET_Init(void)
@@ -450,6 +450,86 @@ void NET_Conn_Run(net_connection_t *conn)
     }
 }
 
+// Time in ms from nowtime until "nowtime - start > period" holds.
+
+int NET_TimeUntil(unsigned int start, unsigned int period,
+                  unsigned int nowtime)
+{
+    int result;
+
+    result = (int) (start + period + 1 - nowtime);
+
+    return result > 0 ? result : 0;
+}
+
+// Returns the time in ms until NET_Conn_Run next has something to do
+// for this connection, or -1 if it is only waiting for packets.
+
+int NET_Conn_NextEvent(net_connection_t *conn, unsigned int nowtime)
+{
+    int result = -1;
+    int t;
+
+    switch (conn->state)
+    {
+        case NET_CONN_STATE_CONNECTED:
+            result = NET_TimeUntil(conn->keepalive_recv_time,
+                                   CONNECTION_TIMEOUT_LEN * 1000, nowtime);
+
+            t = NET_TimeUntil(conn->keepalive_send_time,
+                              KEEPALIVE_PERIOD * 1000, nowtime);
+
+            if (t < result)
+            {
+                result = t;
+            }
+
+            if (conn->reliable_packets != NULL)
+            {
+                if (conn->reliable_packets->last_send_time < 0)
+                {
+                    result = 0;
+                }
+                else
+                {
+                    t = NET_TimeUntil(conn->reliable_packets->last_send_time,
+                                      1000, nowtime);
+
+                    if (t < result)
+                    {
+                        result = t;
+                    }
+                }
+            }
+            break;
+
+        case NET_CONN_STATE_CONNECTING:
+        case NET_CONN_STATE_WAITING_ACK:
+        case NET_CONN_STATE_DISCONNECTING:
+            if (conn->last_send_time < 0)
+            {
+                result = 0;
+            }
+            else
+            {
+                result = NET_TimeUntil(conn->last_send_time, 1000, nowtime);
+            }
+            break;
+
+        case NET_CONN_STATE_DISCONNECTED_SLEEP:
+            result = NET_TimeUntil(conn->last_send_time, 5000, nowtime);
+            break;
+
+        case NET_CONN_STATE_DISCONNECTED:
+            // Has to be cleaned up by the owner straight away.
+
+            result = 0;
+            break;
+    }
+
+    return result;
+}
+
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type)
 {
     net_packet_t *packet;
@@ -489,6 +569,147 @@ net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type)
     return packet;
 }
 
+// Resend timeout before any round trip has been measured, and the
+// limits of the measured one.
+
+#define DEFAULT_RESEND_TIMEOUT 300
+#define MIN_RESEND_TIMEOUT 50
+#define MAX_RESEND_TIMEOUT 1000
+
+// Most redundant tics sent in a packet, on top of -extratics
+
+#define MAX_LOSS_EXTRATICS 4
+
+// Most tics the client holds back to absorb jitter.  Keep this well
+// below the 8 tics BuildNewTic lets maketic run ahead of gametic.
+
+#define MAX_JITTER_TICS 3
+
+void NET_Link_Init(net_link_t *link)
+{
+    link->measured = false;
+    link->srtt = 0;
+    link->rttvar = 0;
+    link->loss = 0;
+}
+
+// Add a round trip time sample, smoothed as TCP does (RFC 6298).
+// As in TCP (Karn's rule), tics that were sent again because they
+// were requested must not be sampled: the reply may be to either copy.
+
+void NET_Link_RoundTrip(net_link_t *link, int rtt)
+{
+    int delta;
+
+    if (rtt < 0)
+    {
+        return;
+    }
+
+    if (!link->measured)
+    {
+        link->srtt = rtt;
+        link->rttvar = rtt / 2;
+        link->measured = true;
+        return;
+    }
+
+    delta = rtt - link->srtt;
+
+    if (delta < 0)
+    {
+        delta = -delta;
+    }
+
+    link->rttvar += (delta - link->rttvar) / 4;
+    link->srtt += (rtt - link->srtt) / 8;
+}
+
+// Record a tic that arrived, or one that had to be requested again.
+
+void NET_Link_TicReceived(net_link_t *link, boolean lost)
+{
+    link->loss -= link->loss / 32;
+
+    if (lost)
+    {
+        link->loss += NET_LINK_LOSS_ONE / 32;
+    }
+}
+
+// Time to wait for requested tics before asking for them again.
+
+int NET_Link_ResendTimeout(net_link_t *link)
+{
+    int timeout;
+
+    if (!link->measured)
+    {
+        return DEFAULT_RESEND_TIMEOUT;
+    }
+
+    timeout = link->srtt + 4 * link->rttvar;
+
+    if (timeout < MIN_RESEND_TIMEOUT)
+    {
+        timeout = MIN_RESEND_TIMEOUT;
+    }
+    else if (timeout > MAX_RESEND_TIMEOUT)
+    {
+        timeout = MAX_RESEND_TIMEOUT;
+    }
+
+    return timeout;
+}
+
+// Number of earlier tics to send again with each new one.  Both
+// directions of a link usually lose alike, so the loss seen on the
+// incoming tics decides how much to repeat in the outgoing ones: a
+// lost tic then arrives with a later packet, without waiting a round
+// trip for a resend.
+
+int NET_Link_ExtraTics(net_link_t *link, int extratics)
+{
+    if (link->loss >= NET_LINK_LOSS_ONE / 100)
+    {
+        ++extratics;
+    }
+
+    if (link->loss >= NET_LINK_LOSS_ONE / 20)
+    {
+        ++extratics;
+    }
+
+    if (link->loss >= NET_LINK_LOSS_ONE * 3 / 20)
+    {
+        extratics += MAX_LOSS_EXTRATICS - 2;
+    }
+
+    return extratics;
+}
+
+// Number of tics to keep buffered so that tics arriving up to twice
+// the round trip deviation late still play on time.
+
+int NET_Link_JitterTics(net_link_t *link)
+{
+    int tics;
+
+    if (!link->measured)
+    {
+        return 0;
+    }
+
+    tics = (2 * link->rttvar * TICRATE + 999) / 1000;
+
+    if (tics > MAX_JITTER_TICS)
+    {
+        tics = MAX_JITTER_TICS;
+    }
+
+    return tics;
+}
+
 // Used to expand the least significant byte of a tic number into 
 // the full tic number, from the current tic number
 
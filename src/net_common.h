@@ -95,6 +95,30 @@ typedef struct
 } net_connection_t;
 
 
+// Round trip time and loss measured on a game data link.  Used to size
+// the resend timeout, the number of redundant tics sent in each packet
+// and the client's jitter buffer.
+
+typedef struct
+{
+    boolean measured;
+
+    // Smoothed round trip time and its mean deviation, in ms
+
+    int srtt;
+    int rttvar;
+
+    // Smoothed fraction of tics lost, in 1/NET_LINK_LOSS_ONE
+
+    int loss;
+} net_link_t;
+
+// Fixed point scale of net_link_t loss.  It must be fine enough that
+// the decay in NET_Link_TicReceived can take the loss back under the
+// thresholds in NET_Link_ExtraTics.
+
+#define NET_LINK_LOSS_ONE (1 << 16)
+
 void NET_Conn_SendPacket(net_connection_t *conn, net_packet_t *packet);
 void NET_Conn_InitClient(net_connection_t *conn, net_addr_t *addr);
 void NET_Conn_InitServer(net_connection_t *conn, net_addr_t *addr);
@@ -102,8 +126,18 @@ boolean NET_Conn_Packet(net_connection_t *conn, net_packet_t *packet,
                         unsigned int *packet_type);
 void NET_Conn_Disconnect(net_connection_t *conn);
 void NET_Conn_Run(net_connection_t *conn);
+int NET_Conn_NextEvent(net_connection_t *conn, unsigned int nowtime);
+int NET_TimeUntil(unsigned int start, unsigned int period,
+                  unsigned int nowtime);
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type);
 
+void NET_Link_Init(net_link_t *link);
+void NET_Link_RoundTrip(net_link_t *link, int rtt);
+void NET_Link_TicReceived(net_link_t *link, boolean lost);
+int NET_Link_ResendTimeout(net_link_t *link);
+int NET_Link_ExtraTics(net_link_t *link, int extratics);
+int NET_Link_JitterTics(net_link_t *link);
+
 // Other miscellaneous common functions
 
 unsigned int NET_ExpandTicNum(unsigned int relative, unsigned int b);
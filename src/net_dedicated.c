@@ -30,7 +30,9 @@
 
 #include "net_defs.h"
 #include "net_sdl.h"
+#include "net_udp.h"
 #include "net_server.h"
+#include "net_structrw.h"
 
 // 
 // People can become confused about how dedicated servers work.  Game
@@ -65,16 +67,167 @@ static void CheckForClientOptions(void)
 
 void NET_DedicatedServer(void)
 {
+    int max_sessions = 1;
+    int stats_secs = 0;
+    int spectator_delay = 0;
+    char *demo_name = NULL;
+    int p;
+
     CheckForClientOptions();
 
+#ifdef HAVE_NET_UDP
+    //!
+    // @category net
+    //
+    // Measure the packet throughput of the native UDP module over the
+    // loopback interface, then exit.
+    //
+
+    if (M_ParmExists("-udpbenchmark"))
+    {
+        NET_UDP_Benchmark();
+        exit(0);
+    }
+#endif
+
+    //!
+    // @category net
+    //
+    // Compare the size and encoding speed of packed and unpacked
+    // game data, then exit.
+    //
+
+    if (M_ParmExists("-ticpackbenchmark"))
+    {
+        NET_TicPackBenchmark();
+        exit(0);
+    }
+
     NET_SV_Init();
-    NET_SV_AddModule(&net_sdl_module);
+
+    //!
+    // @category net
+    // @arg <n>
+    //
+    // Allow a dedicated server to host up to n games at the same time.
+    // Each game is started by its own controlling player as usual; new
+    // players join a game that is still waiting for players.
+    //
+
+    p = M_CheckParmWithArgs("-sessions", 1);
+
+    if (p > 0)
+    {
+        max_sessions = atoi(myargv[p + 1]);
+    }
+
+    //!
+    // @category net
+    // @arg <n>
+    //
+    // Print the statistics of every game hosted by a dedicated server
+    // every n seconds: packet rates, resends and average latency.
+    //
+
+    p = M_CheckParmWithArgs("-sessionstats", 1);
+
+    if (p > 0)
+    {
+        stats_secs = atoi(myargv[p + 1]);
+    }
+
+    NET_SV_ConfigureSessions(max_sessions, stats_secs);
+
+    //!
+    // @category net
+    // @arg <file>
+    //
+    // Write the metrics of a dedicated server to the given file every
+    // second, in the Prometheus text format: clients, tic rates,
+    // round trip times, resends, send queues and deadlocks.  Point the
+    // textfile collector of a Prometheus node exporter at it.
+    //
+
+    p = M_CheckParmWithArgs("-metrics", 1);
+
+    if (p > 0)
+    {
+        NET_SV_WriteMetricsTo(myargv[p + 1]);
+    }
+
+    //!
+    // @category net
+    // @arg <n>
+    //
+    // Send the game to spectators (drones) n seconds after the players
+    // play it.  Spectators never hold the players back, however slow
+    // they are.
+    //
+
+    p = M_CheckParmWithArgs("-spectatordelay", 1);
+
+    if (p > 0)
+    {
+        spectator_delay = atoi(myargv[p + 1]);
+    }
+
+    //!
+    // @category net
+    // @arg <name>
+    //
+    // Record every Doom game hosted by a dedicated server to a demo,
+    // named <name>-0.lmp, <name>-1.lmp and so on.
+    //
+
+    p = M_CheckParmWithArgs("-svrecord", 1);
+
+    if (p > 0)
+    {
+        demo_name = myargv[p + 1];
+    }
+
+    NET_SV_ConfigureSpectators(spectator_delay, demo_name);
+
+#ifdef HAVE_NET_UDP
+    //!
+    // @category net
+    //
+    // Use SDL_net for the dedicated server rather than the native UDP
+    // module, which batches packets with recvmmsg() and sendmmsg().
+    //
+
+    if (!M_ParmExists("-sdlnet"))
+    {
+        NET_SV_AddModule(&net_udp_module);
+    }
+    else
+#endif
+    {
+        NET_SV_AddModule(&net_sdl_module);
+    }
+    //!
+    // @category net
+    // @arg <address>
+    //
+    // Relay the games of the server at the given address to any number
+    // of spectators, rather than hosting games.  The relay joins that
+    // server as a single drone.  Combine with -spectatordelay to show
+    // the games delayed.
+    //
+
+    p = M_CheckParmWithArgs("-relay", 1);
+
+    if (p > 0)
+    {
+        NET_SV_RelayFrom(myargv[p + 1]);
+    }
+
     NET_SV_RegisterWithMaster();
 
     while (true)
     {
         NET_SV_Run();
-        I_Sleep(10);
+        NET_SV_WaitForEvent(1000);
     }
 }
 
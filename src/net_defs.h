@@ -23,6 +23,8 @@
 
 #include <stdio.h>
 
+#include "SDL_atomic.h"
+
 #include "doomtype.h"
 #include "d_ticcmd.h"
 #include "sha1.h"
@@ -58,6 +60,11 @@ struct _net_packet_s
     size_t len;
     size_t alloced;
     unsigned int pos;
+
+    // Holders of the packet (see NET_PacketRef).  A shared packet is
+    // not written to, and each reader starts from the beginning.
+
+    SDL_atomic_t refcount;
 };
 
 struct _net_module_s
@@ -91,6 +98,16 @@ struct _net_module_s
     // Try to resolve a name to an address
 
     net_addr_t *(*ResolveAddress)(char *addr);
+
+    // Send any packets queued up by SendPacket.  NULL if the module
+    // sends each packet as soon as it is given one.
+
+    void (*FlushPackets)(void);
+
+    // Block for up to timeout ms until a packet can be received.
+    // NULL if the module cannot wait.
+
+    void (*WaitForPacket)(int timeout);
 };
 
 // net_addr_t
@@ -101,9 +118,15 @@ struct _net_addr_s
     void *handle;
 };
 
-// magic number sent when connecting to check this is a valid client
+// magic number sent when connecting to check this is a valid client.
+// It changes with the connect data and game settings layout, so that
+// clients using an older layout are refused rather than misread.
 
-#define NET_MAGIC_NUMBER 3436803284U
+#define NET_MAGIC_NUMBER 3436803285U
+
+// magic number of the layout before packed tics were negotiated
+
+#define NET_OLD_MAGIC_NUMBER 3436803284U
 
 // header field value indicating that the packet is a reliable packet
 
@@ -158,6 +181,10 @@ typedef struct
     sha1_digest_t wad_sha1sum;
     sha1_digest_t deh_sha1sum;
     int player_class;
+
+    // Client understands the packed tic encoding (see net_structrw.c)
+
+    int packed_tics;
 } net_connect_data_t;
 
 // Game settings sent by client to server when initiating game start,
@@ -181,6 +208,11 @@ typedef struct
     int loadgame;
     int random;  // [Strife only]
 
+    // Game data between this client and the server uses the packed
+    // tic encoding, and the server batches new tics into one packet.
+
+    int packed_tics;
+
     // These fields are only used by the server when sending a game
     // start message:
 
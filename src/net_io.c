@@ -22,8 +22,10 @@
 #include <stdio.h>
 
 #include "i_system.h"
+#include "i_timer.h"
 #include "net_defs.h"
 #include "net_io.h"
+#include "net_sim.h"
 #include "z_zone.h"
 
 #define MAX_MODULES 16
@@ -43,6 +45,8 @@ net_context_t *NET_NewContext(void)
     context = Z_Malloc(sizeof(net_context_t), PU_STATIC, 0);
     context->num_modules = 0;
 
+    NET_SIM_Init();
+
     return context;
 }
 
@@ -92,19 +96,73 @@ void NET_SendBroadcast(net_context_t *context, net_packet_t *packet)
     }
 }
 
+void NET_FlushPackets(net_context_t *context)
+{
+    int i;
+
+    for (i=0; i<context->num_modules; ++i)
+    {
+        if (context->modules[i]->FlushPackets != NULL)
+        {
+            context->modules[i]->FlushPackets();
+        }
+    }
+}
+
+// Wait for up to timeout ms for a packet to arrive.  Only a context
+// with a single module that supports it can block; otherwise, just
+// give the CPU away briefly.
+
+void NET_WaitForPacket(net_context_t *context, int timeout)
+{
+    if (net_sim_active)
+    {
+        timeout = NET_SIM_NextRelease(context, timeout);
+    }
+
+    if (timeout <= 0)
+    {
+        return;
+    }
+
+    if (context->num_modules == 1
+     && context->modules[0]->WaitForPacket != NULL)
+    {
+        context->modules[0]->WaitForPacket(timeout);
+    }
+    else
+    {
+        I_Sleep(1);
+    }
+}
+
 boolean NET_RecvPacket(net_context_t *context, 
                        net_addr_t **addr, 
                        net_packet_t **packet)
 {
     int i;
-    
+
+    // Packets held back by the simulator are due first.  A packet
+    // can be shared (see NET_PacketRef), so reading always starts
+    // from the beginning.
+
+    if (net_sim_active && NET_SIM_Release(context, addr, packet))
+    {
+        (*packet)->pos = 0;
+        return true;
+    }
+
     // check all modules for new packets
     
     for (i=0; i<context->num_modules; ++i)
     {
-        if (context->modules[i]->RecvPacket(addr, packet))
+        while (context->modules[i]->RecvPacket(addr, packet))
         {
-            return true;
+            if (!net_sim_active || !NET_SIM_Hold(context, *addr, *packet))
+            {
+                (*packet)->pos = 0;
+                return true;
+            }
         }
     }
 
@@ -123,6 +181,15 @@ char *NET_AddrToString(net_addr_t *addr)
     return buf;
 }
 
+// As NET_AddrToString, into the caller's buffer rather than a static
+// one, for code that runs on the server thread.
+
+void NET_AddrToStringBuffer(net_addr_t *addr, char *buf, int buf_len)
+{
+    addr->module->AddrToString(addr, buf, buf_len - 1);
+    buf[buf_len - 1] = '\0';
+}
+
 void NET_FreeAddress(net_addr_t *addr)
 {
     addr->module->FreeAddress(addr);
@@ -29,9 +29,12 @@ net_context_t *NET_NewContext(void);
 void NET_AddModule(net_context_t *context, net_module_t *module);
 void NET_SendPacket(net_addr_t *addr, net_packet_t *packet);
 void NET_SendBroadcast(net_context_t *context, net_packet_t *packet);
+void NET_FlushPackets(net_context_t *context);
+void NET_WaitForPacket(net_context_t *context, int timeout);
 boolean NET_RecvPacket(net_context_t *context, net_addr_t **addr, 
                        net_packet_t **packet);
 char *NET_AddrToString(net_addr_t *addr);
+void NET_AddrToStringBuffer(net_addr_t *addr, char *buf, int buf_len);
 void NET_FreeAddress(net_addr_t *addr);
 net_addr_t *NET_ResolveAddress(net_context_t *context, char *address);
 
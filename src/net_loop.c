@@ -21,6 +21,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "SDL_atomic.h"
+
 #include "doomtype.h"
 #include "i_system.h"
 #include "m_misc.h"
@@ -28,12 +30,18 @@
 #include "net_loop.h"
 #include "net_packet.h"
 
-#define MAX_QUEUE_SIZE 16
+#define MAX_QUEUE_SIZE 64
+
+// Each queue is a ring with one thread pushing and one popping, which
+// may be different threads.  The pushing end only moves tail and the
+// popping end only moves head, so no lock is needed: setting tail
+// publishes the packet stored before it, and setting head hands the
+// slot back.
 
 typedef struct
 {
     net_packet_t *packets[MAX_QUEUE_SIZE];
-    int head, tail;
+    SDL_atomic_t head, tail;
 } packet_queue_t;
 
 static packet_queue_t client_queue;
@@ -41,45 +49,62 @@ static packet_queue_t server_queue;
 static net_addr_t client_addr;
 static net_addr_t server_addr;
 
-static void QueueInit(packet_queue_t *queue)
+static int QueueIndex(SDL_atomic_t *index)
 {
-    queue->head = queue->tail = 0;
+    return SDL_AtomicAdd(index, 0);
 }
 
 static void QueuePush(packet_queue_t *queue, net_packet_t *packet)
 {
-    int new_tail;
+    int tail, new_tail;
 
-    new_tail = (queue->tail + 1) % MAX_QUEUE_SIZE;
+    tail = QueueIndex(&queue->tail);
+    new_tail = (tail + 1) % MAX_QUEUE_SIZE;
 
-    if (new_tail == queue->head)
+    if (new_tail == QueueIndex(&queue->head))
     {
         // queue is full
         
+        NET_FreePacket(packet);
         return;
     }
 
-    queue->packets[queue->tail] = packet;
-    queue->tail = new_tail;
+    queue->packets[tail] = packet;
+    SDL_AtomicSet(&queue->tail, new_tail);
 }
 
 static net_packet_t *QueuePop(packet_queue_t *queue)
 {
     net_packet_t *packet;
-    
-    if (queue->tail == queue->head)
+    int head;
+
+    head = QueueIndex(&queue->head);
+
+    if (head == QueueIndex(&queue->tail))
     {
         // queue empty
 
         return NULL;
     }
 
-    packet = queue->packets[queue->head];
-    queue->head = (queue->head + 1) % MAX_QUEUE_SIZE;
+    packet = queue->packets[head];
+    SDL_AtomicSet(&queue->head, (head + 1) % MAX_QUEUE_SIZE);
 
     return packet;
 }
 
+static void QueueInit(packet_queue_t *queue)
+{
+    net_packet_t *packet;
+
+    // Free anything left over from a previous game
+
+    while ((packet = QueuePop(queue)) != NULL)
+    {
+        NET_FreePacket(packet);
+    }
+}
+
 //-----------------------------------------------------------------------------
 //
 // Client end code
@@ -101,7 +126,7 @@ static boolean NET_CL_InitServer(void)
 
 static void NET_CL_SendPacket(net_addr_t *addr, net_packet_t *packet)
 {
-    QueuePush(&server_queue, NET_PacketDup(packet));
+    QueuePush(&server_queue, NET_PacketRef(packet));
 }
 
 static boolean NET_CL_RecvPacket(net_addr_t **addr, net_packet_t **packet)
@@ -177,7 +202,7 @@ static boolean NET_SV_InitServer(void)
 
 static void NET_SV_SendPacket(net_addr_t *addr, net_packet_t *packet)
 {
-    QueuePush(&client_queue, NET_PacketDup(packet));
+    QueuePush(&client_queue, NET_PacketRef(packet));
 }
 
 static boolean NET_SV_RecvPacket(net_addr_t **addr, net_packet_t **packet)
@@ -18,30 +18,102 @@
 // Russian Doom (C) 2016-2017 Julian Nechaevsky
 
 
+#include <stdlib.h>
 #include <string.h>
+
+#include "SDL_atomic.h"
+
+#include "i_system.h"
 #include "m_misc.h"
 #include "net_packet.h"
-#include "z_zone.h"
 
-static int total_packet_memory = 0;
+// Packets come from a fixed pool, so that sending and receiving does
+// not allocate.  Only packets made while the whole pool is in use, or
+// data outgrowing POOL_PACKET_SIZE, are allocated.  Packets can be
+// made and freed from more than one thread, so the pool is locked,
+// and allocations use malloc() rather than the zone.
+
+#define PACKET_POOL_SIZE 256
+#define POOL_PACKET_SIZE 1024
+
+static net_packet_t packet_pool[PACKET_POOL_SIZE];
+static byte packet_pool_data[PACKET_POOL_SIZE][POOL_PACKET_SIZE];
+static net_packet_t *free_packets[PACKET_POOL_SIZE];
+static int num_free_packets = -1;
+static SDL_SpinLock pool_lock;
+
+static boolean InPool(net_packet_t *packet)
+{
+    return packet >= packet_pool && packet < packet_pool + PACKET_POOL_SIZE;
+}
+
+static boolean HasPoolData(net_packet_t *packet)
+{
+    return InPool(packet)
+        && packet->data == packet_pool_data[packet - packet_pool];
+}
+
+static void *AllocPacketMemory(size_t size)
+{
+    void *result;
+
+    result = malloc(size);
+
+    if (result == NULL)
+    {
+        I_Error("NET_NewPacket: недостаточно памяти");
+    }
+
+    return result;
+}
 
 net_packet_t *NET_NewPacket(int initial_size)
 {
-    net_packet_t *packet;
+    net_packet_t *packet = NULL;
+    int i;
 
-    packet = (net_packet_t *) Z_Malloc(sizeof(net_packet_t), PU_STATIC, 0);
-    
     if (initial_size == 0)
         initial_size = 256;
 
-    packet->alloced = initial_size;
-    packet->data = Z_Malloc(initial_size, PU_STATIC, 0);
+    if (initial_size <= POOL_PACKET_SIZE)
+    {
+        SDL_AtomicLock(&pool_lock);
+
+        if (num_free_packets < 0)
+        {
+            for (i=0; i<PACKET_POOL_SIZE; ++i)
+            {
+                free_packets[i] = &packet_pool[i];
+            }
+
+            num_free_packets = PACKET_POOL_SIZE;
+        }
+
+        if (num_free_packets > 0)
+        {
+            --num_free_packets;
+            packet = free_packets[num_free_packets];
+        }
+
+        SDL_AtomicUnlock(&pool_lock);
+    }
+
+    if (packet != NULL)
+    {
+        packet->alloced = POOL_PACKET_SIZE;
+        packet->data = packet_pool_data[packet - packet_pool];
+    }
+    else
+    {
+        packet = AllocPacketMemory(sizeof(net_packet_t));
+        packet->alloced = initial_size;
+        packet->data = AllocPacketMemory(initial_size);
+    }
+
     packet->len = 0;
     packet->pos = 0;
+    SDL_AtomicSet(&packet->refcount, 1);
 
-    total_packet_memory += sizeof(net_packet_t) + initial_size;
-
-    //printf("total packet memory: %i bytes\n", total_packet_memory);
     //printf("%p: allocated\n", packet);
 
     return packet;
@@ -60,13 +132,41 @@ net_packet_t *NET_PacketDup(net_packet_t *packet)
     return newpacket;
 }
 
+// Take another hold of a packet, rather than copying it.  It is freed
+// once every holder has called NET_FreePacket.
+
+net_packet_t *NET_PacketRef(net_packet_t *packet)
+{
+    SDL_AtomicIncRef(&packet->refcount);
+
+    return packet;
+}
+
 void NET_FreePacket(net_packet_t *packet)
 {
+    if (!SDL_AtomicDecRef(&packet->refcount))
+    {
+        return;
+    }
+
     //printf("%p: destroyed\n", packet);
-    
-    total_packet_memory -= sizeof(net_packet_t) + packet->alloced;
-    Z_Free(packet->data);
-    Z_Free(packet);
+
+    if (!HasPoolData(packet))
+    {
+        free(packet->data);
+    }
+
+    if (InPool(packet))
+    {
+        SDL_AtomicLock(&pool_lock);
+        free_packets[num_free_packets] = packet;
+        ++num_free_packets;
+        SDL_AtomicUnlock(&pool_lock);
+    }
+    else
+    {
+        free(packet);
+    }
 }
 
 // Read a byte from the packet, returning true if read
@@ -211,18 +311,18 @@ static void NET_IncreasePacket(net_packet_t *packet)
 {
     byte *newdata;
 
-    total_packet_memory -= packet->alloced;
-   
     packet->alloced *= 2;
 
-    newdata = Z_Malloc(packet->alloced, PU_STATIC, 0);
+    newdata = AllocPacketMemory(packet->alloced);
 
     memcpy(newdata, packet->data, packet->len);
 
-    Z_Free(packet->data);
-    packet->data = newdata;
+    if (!HasPoolData(packet))
+    {
+        free(packet->data);
+    }
 
-    total_packet_memory += packet->alloced;
+    packet->data = newdata;
 }
 
 // Write a single byte to the packet
@@ -25,6 +25,7 @@
 
 net_packet_t *NET_NewPacket(int initial_size);
 net_packet_t *NET_PacketDup(net_packet_t *packet);
+net_packet_t *NET_PacketRef(net_packet_t *packet);
 void NET_FreePacket(net_packet_t *packet);
 
 boolean NET_ReadInt8(net_packet_t *packet, unsigned int *data);
@@ -23,6 +23,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "SDL.h"
+
 #include "i_system.h"
 #include "i_timer.h"
 #include "m_misc.h"
@@ -78,8 +80,11 @@ typedef struct
     boolean printed;
 } query_target_t;
 
-static boolean registered_with_master = false;
-static boolean got_master_response = false;
+// Written by NET_Query_MasterResponse, which runs on the server
+// thread if there is one, and read by the game.
+
+static SDL_atomic_t registered_with_master;
+static SDL_atomic_t got_master_response;
 
 static net_context_t *query_context;
 static query_target_t *targets;
@@ -140,11 +145,11 @@ void NET_Query_MasterResponse(net_packet_t *packet)
         {
             // Only show the message once.
 
-            if (!registered_with_master)
+            if (SDL_AtomicAdd(&registered_with_master, 0) == 0)
             {
                 printf("Registered with master server at %s\n",
                        MASTER_SERVER_ADDRESS);
-                registered_with_master = true;
+                SDL_AtomicSet(&registered_with_master, 1);
             }
         }
         else
@@ -155,7 +160,7 @@ void NET_Query_MasterResponse(net_packet_t *packet)
                    MASTER_SERVER_ADDRESS);
         }
 
-        got_master_response = true;
+        SDL_AtomicSet(&got_master_response, 1);
     }
 }
 
@@ -163,12 +168,12 @@ boolean NET_Query_CheckAddedToMaster(boolean *result)
 {
     // Got response from master yet?
 
-    if (!got_master_response)
+    if (SDL_AtomicAdd(&got_master_response, 0) == 0)
     {
         return false;
     }
 
-    *result = registered_with_master;
+    *result = SDL_AtomicAdd(&registered_with_master, 0) != 0;
     return true;
 }
 
@@ -0,0 +1,505 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Relaying of the games of another server to spectators
+//
+//     The relay joins the upstream server as a single drone and feeds
+//     the tics it receives into its own server session, which sends
+//     them on to any number of spectators.  The upstream server only
+//     ever sees one spectator, however many are watching.
+//
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "doomtype.h"
+#include "d_mode.h"
+#include "i_timer.h"
+#include "net_common.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_relay.h"
+#include "net_server.h"
+#include "net_structrw.h"
+
+typedef enum
+{
+    // asking the upstream server what game it is waiting for
+
+    RELAY_QUERYING,
+
+    // sending SYN packets to join as a drone
+
+    RELAY_CONNECTING,
+
+    // connected, waiting for the game to start
+
+    RELAY_WAITING,
+
+    // in a game
+
+    RELAY_IN_GAME,
+} relay_state_t;
+
+typedef struct
+{
+    boolean active;
+    unsigned int resend_time;
+    net_full_ticcmd_t cmd;
+} relay_recv_t;
+
+static net_addr_t *upstream;
+static relay_state_t relay_state;
+static net_connection_t connection;
+static net_connect_data_t connect_data;
+static int last_send_time;
+static int connect_time;
+static net_gamesettings_t settings;
+
+// Tics received from the upstream server, not yet passed on in order
+
+static unsigned int recvwindow_start;
+static relay_recv_t recvwindow[BACKUPTICS];
+
+static net_link_t upstream_link;
+static boolean need_to_acknowledge;
+static unsigned int gamedata_recv_time;
+
+void NET_Relay_Init(net_addr_t *addr)
+{
+    upstream = addr;
+    relay_state = RELAY_QUERYING;
+    last_send_time = -1;
+}
+
+static void NET_Relay_SendQuery(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_QUERY);
+    NET_SendPacket(upstream, packet);
+    NET_FreePacket(packet);
+}
+
+static void NET_Relay_SendSYN(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_SYN);
+    NET_WriteInt32(packet, NET_MAGIC_NUMBER);
+    NET_WriteString(packet, PACKAGE_STRING);
+    NET_WriteConnectData(packet, &connect_data);
+    NET_WriteString(packet, "Relay");
+    NET_Conn_SendPacket(&connection, packet);
+    NET_FreePacket(packet);
+}
+
+static void NET_Relay_SendGameDataACK(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_ACK);
+    NET_WriteInt8(packet, recvwindow_start & 0xff);
+    NET_Conn_SendPacket(&connection, packet);
+    NET_FreePacket(packet);
+
+    need_to_acknowledge = false;
+}
+
+static void NET_Relay_SendResendRequest(int start, int end)
+{
+    net_packet_t *packet;
+    unsigned int nowtime;
+    int i;
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_RESEND);
+    NET_WriteInt32(packet, start);
+    NET_WriteInt8(packet, end - start + 1);
+    NET_Conn_SendPacket(&connection, packet);
+    NET_FreePacket(packet);
+
+    nowtime = I_GetTimeMS();
+
+    for (i=start; i<=end; ++i)
+    {
+        int index;
+
+        index = i - recvwindow_start;
+
+        if (index < 0 || index >= BACKUPTICS)
+            continue;
+
+        if (recvwindow[index].resend_time == 0)
+        {
+            NET_Link_TicReceived(&upstream_link, true);
+        }
+
+        recvwindow[index].resend_time = nowtime;
+    }
+}
+
+// The upstream server is waiting for players: join it as a drone.
+
+static void NET_Relay_ParseQueryResponse(net_packet_t *packet)
+{
+    net_querydata_t querydata;
+
+    if (relay_state != RELAY_QUERYING
+     || !NET_ReadQueryData(packet, &querydata))
+    {
+        return;
+    }
+
+    // The server must know its game and still be waiting for players.
+
+    if (querydata.server_state != 0 || querydata.gamemode == indetermined
+     || !D_ValidGameMode(querydata.gamemission, querydata.gamemode))
+    {
+        return;
+    }
+
+    memset(&connect_data, 0, sizeof(connect_data));
+    connect_data.gamemode = querydata.gamemode;
+    connect_data.gamemission = querydata.gamemission;
+    connect_data.drone = true;
+    connect_data.max_players = NET_MAXPLAYERS;
+    connect_data.packed_tics = true;
+
+    NET_SV_RelayGame(querydata.gamemode, querydata.gamemission);
+
+    NET_Conn_InitClient(&connection, upstream);
+    relay_state = RELAY_CONNECTING;
+    connect_time = I_GetTimeMS();
+    last_send_time = -1;
+}
+
+static void NET_Relay_ParseWaitingData(net_packet_t *packet)
+{
+    net_waitdata_t wait_data;
+
+    if (NET_ReadWaitData(packet, &wait_data))
+    {
+        NET_SV_RelayWaitData(&wait_data);
+    }
+}
+
+// The upstream game was launched: say we are ready, as a game client
+// would once loaded, and launch it for the spectators.
+
+static void NET_Relay_ParseLaunch(net_packet_t *packet)
+{
+    net_gamesettings_t ready;
+    net_packet_t *reply;
+    unsigned int num_players;
+
+    if (relay_state != RELAY_WAITING || !NET_ReadInt8(packet, &num_players))
+    {
+        return;
+    }
+
+    memset(&ready, 0, sizeof(ready));
+    reply = NET_Conn_NewReliable(&connection, NET_PACKET_TYPE_GAMESTART);
+    NET_WriteSettings(reply, &ready);
+
+    NET_SV_RelayLaunch(num_players);
+}
+
+static void NET_Relay_ParseGameStart(net_packet_t *packet)
+{
+    if (relay_state != RELAY_WAITING || !NET_ReadSettings(packet, &settings))
+    {
+        return;
+    }
+
+    if (settings.num_players > NET_MAXPLAYERS || settings.consoleplayer >= 0)
+    {
+        return;
+    }
+
+    relay_state = RELAY_IN_GAME;
+
+    memset(recvwindow, 0, sizeof(recvwindow));
+    recvwindow_start = 0;
+    need_to_acknowledge = false;
+    NET_Link_Init(&upstream_link);
+
+    NET_SV_RelayStart(&settings);
+}
+
+// Store the tics of a game data packet in the receive window, and ask
+// again for any missed before them.
+
+static void NET_Relay_ParseGameData(net_packet_t *packet)
+{
+    net_ticpacker_t packer;
+    unsigned int seq, num_tics;
+    int resend_start, resend_end;
+    unsigned int i;
+    int index;
+
+    if (relay_state != RELAY_IN_GAME
+     || !NET_ReadInt8(packet, &seq)
+     || !NET_ReadInt8(packet, &num_tics))
+    {
+        return;
+    }
+
+    if (!need_to_acknowledge)
+    {
+        need_to_acknowledge = true;
+        gamedata_recv_time = I_GetTimeMS();
+    }
+
+    seq = NET_ExpandTicNum(recvwindow_start, seq);
+
+    NET_InitTicPacker(&packer, packet);
+
+    for (i=0; i<num_tics; ++i)
+    {
+        net_full_ticcmd_t cmd;
+
+        if (settings.packed_tics)
+        {
+            if (!NET_UnpackFullTiccmd(&packer, &cmd, settings.lowres_turn))
+            {
+                return;
+            }
+        }
+        else if (!NET_ReadFullTiccmd(packet, &cmd, settings.lowres_turn))
+        {
+            return;
+        }
+
+        index = seq - recvwindow_start + i;
+
+        if (index < 0 || index >= BACKUPTICS)
+        {
+            continue;
+        }
+
+        if (!recvwindow[index].active && recvwindow[index].resend_time == 0)
+        {
+            NET_Link_TicReceived(&upstream_link, false);
+        }
+
+        recvwindow[index].active = true;
+        recvwindow[index].cmd = cmd;
+    }
+
+    resend_end = seq - recvwindow_start;
+
+    if (resend_end <= 0)
+        return;
+
+    if (resend_end >= BACKUPTICS)
+        resend_end = BACKUPTICS - 1;
+
+    for (resend_start = resend_end; resend_start > 0; --resend_start)
+    {
+        if (recvwindow[resend_start - 1].active
+         || recvwindow[resend_start - 1].resend_time != 0)
+        {
+            break;
+        }
+    }
+
+    if (resend_start < resend_end)
+    {
+        NET_Relay_SendResendRequest(recvwindow_start + resend_start,
+                                    recvwindow_start + resend_end - 1);
+    }
+}
+
+void NET_Relay_Packet(net_packet_t *packet)
+{
+    unsigned int packet_type;
+
+    if (!NET_ReadInt16(packet, &packet_type))
+    {
+        return;
+    }
+
+    if (relay_state == RELAY_QUERYING)
+    {
+        if (packet_type == NET_PACKET_TYPE_QUERY_RESPONSE)
+        {
+            NET_Relay_ParseQueryResponse(packet);
+        }
+    }
+    else if (NET_Conn_Packet(&connection, packet, &packet_type))
+    {
+        // Packet eaten by the common connection code
+    }
+    else
+    {
+        switch (packet_type)
+        {
+            case NET_PACKET_TYPE_WAITING_DATA:
+                NET_Relay_ParseWaitingData(packet);
+                break;
+
+            case NET_PACKET_TYPE_LAUNCH:
+                NET_Relay_ParseLaunch(packet);
+                break;
+
+            case NET_PACKET_TYPE_GAMESTART:
+                NET_Relay_ParseGameStart(packet);
+                break;
+
+            case NET_PACKET_TYPE_GAMEDATA:
+                NET_Relay_ParseGameData(packet);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+// Pass the tics received in order on to the spectators, and ask again
+// for tics whose resend requests have gone unanswered.
+
+static void NET_Relay_RunGame(void)
+{
+    unsigned int nowtime;
+    int timeout;
+    int i;
+
+    while (recvwindow[0].active)
+    {
+        NET_SV_RelayTic(&recvwindow[0].cmd);
+
+        memmove(recvwindow, recvwindow + 1,
+                sizeof(relay_recv_t) * (BACKUPTICS - 1));
+        memset(&recvwindow[BACKUPTICS-1], 0, sizeof(relay_recv_t));
+        ++recvwindow_start;
+    }
+
+    nowtime = I_GetTimeMS();
+    timeout = NET_Link_ResendTimeout(&upstream_link);
+
+    for (i=0; i<BACKUPTICS; ++i)
+    {
+        if (!recvwindow[i].active && recvwindow[i].resend_time != 0
+         && nowtime > recvwindow[i].resend_time + timeout)
+        {
+            NET_Relay_SendResendRequest(recvwindow_start + i,
+                                        recvwindow_start + i);
+        }
+    }
+
+    if (need_to_acknowledge && nowtime - gamedata_recv_time > 200)
+    {
+        NET_Relay_SendGameDataACK();
+    }
+}
+
+void NET_Relay_Run(void)
+{
+    char addr_str[128];
+    int nowtime;
+
+    nowtime = I_GetTimeMS();
+
+    if (relay_state == RELAY_QUERYING)
+    {
+        // Ask once a second, until there is a game to join.
+
+        if (last_send_time < 0 || nowtime - last_send_time > 1000)
+        {
+            NET_Relay_SendQuery();
+            last_send_time = nowtime;
+        }
+
+        return;
+    }
+
+    NET_Conn_Run(&connection);
+
+    if (connection.state == NET_CONN_STATE_CONNECTING)
+    {
+        if (nowtime - connect_time > 5000)
+        {
+            // Give up, and see what the server is doing now.
+
+            connection.state = NET_CONN_STATE_DISCONNECTED;
+        }
+        else if (last_send_time < 0 || nowtime - last_send_time > 1000)
+        {
+            NET_Relay_SendSYN();
+            last_send_time = nowtime;
+        }
+    }
+    else if (connection.state == NET_CONN_STATE_CONNECTED
+          && relay_state == RELAY_CONNECTING)
+    {
+        NET_AddrToStringBuffer(upstream, addr_str, sizeof(addr_str));
+        printf("Relay: connected to %s\n", addr_str);
+        relay_state = RELAY_WAITING;
+    }
+
+    if (connection.state == NET_CONN_STATE_DISCONNECTED
+     || connection.state == NET_CONN_STATE_DISCONNECTED_SLEEP)
+    {
+        if (relay_state != RELAY_CONNECTING)
+        {
+            NET_AddrToStringBuffer(upstream, addr_str, sizeof(addr_str));
+            printf("Relay: disconnected from %s\n", addr_str);
+        }
+
+        NET_SV_RelayEnd();
+
+        relay_state = RELAY_QUERYING;
+        last_send_time = nowtime;
+        return;
+    }
+
+    if (relay_state == RELAY_IN_GAME)
+    {
+        NET_Relay_RunGame();
+    }
+}
+
+// Time until the relay next needs to run without a packet arriving.
+
+int NET_Relay_NextEvent(unsigned int nowtime)
+{
+    int result;
+
+    if (relay_state == RELAY_QUERYING
+     || connection.state == NET_CONN_STATE_CONNECTING)
+    {
+        result = (int) (last_send_time + 1001 - nowtime);
+        return result > 0 ? result : 0;
+    }
+
+    result = NET_Conn_NextEvent(&connection, nowtime);
+
+    if (relay_state == RELAY_IN_GAME && (result < 0 || result > 50))
+    {
+        // Acknowledgments and resend requests are checked often.
+
+        result = 50;
+    }
+
+    return result;
+}
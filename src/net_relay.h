@@ -0,0 +1,30 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Relaying of the games of another server to spectators
+//
+
+
+#ifndef NET_RELAY_H
+#define NET_RELAY_H
+
+#include "net_defs.h"
+
+void NET_Relay_Init(net_addr_t *addr);
+void NET_Relay_Packet(net_packet_t *packet);
+void NET_Relay_Run(void);
+int NET_Relay_NextEvent(unsigned int nowtime);
+
+#endif /* #ifndef NET_RELAY_H */
+
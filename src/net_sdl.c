@@ -30,7 +30,6 @@
 #include "net_io.h"
 #include "net_packet.h"
 #include "net_sdl.h"
-#include "z_zone.h"
 
 //
 // NETWORKING
@@ -60,8 +59,13 @@ static void NET_SDL_InitAddrTable(void)
 {
     addr_table_size = 16;
 
-    addr_table = Z_Malloc(sizeof(addrpair_t *) * addr_table_size,
-                          PU_STATIC, 0);
+    addr_table = malloc(sizeof(addrpair_t *) * addr_table_size);
+
+    if (addr_table == NULL)
+    {
+        I_Error("NET_SDL_InitAddrTable: недостаточно памяти");
+    }
+
     memset(addr_table, 0, sizeof(addrpair_t *) * addr_table_size);
 }
 
@@ -115,19 +119,29 @@ static net_addr_t *NET_SDL_FindAddress(IPaddress *addr)
         // the existing table in.  replace the old table.
 
         new_addr_table_size = addr_table_size * 2;
-        new_addr_table = Z_Malloc(sizeof(addrpair_t *) * new_addr_table_size,
-                                  PU_STATIC, 0);
+        new_addr_table = malloc(sizeof(addrpair_t *) * new_addr_table_size);
+
+        if (new_addr_table == NULL)
+        {
+            I_Error("NET_SDL_FindAddress: недостаточно памяти");
+        }
+
         memset(new_addr_table, 0, sizeof(addrpair_t *) * new_addr_table_size);
         memcpy(new_addr_table, addr_table, 
                sizeof(addrpair_t *) * addr_table_size);
-        Z_Free(addr_table);
+        free(addr_table);
         addr_table = new_addr_table;
         addr_table_size = new_addr_table_size;
     }
 
     // Add a new entry
     
-    new_entry = Z_Malloc(sizeof(addrpair_t), PU_STATIC, 0);
+    new_entry = malloc(sizeof(addrpair_t));
+
+    if (new_entry == NULL)
+    {
+        I_Error("NET_SDL_FindAddress: недостаточно памяти");
+    }
 
     new_entry->sdl_addr = *addr;
     new_entry->net_addr.handle = &new_entry->sdl_addr;
@@ -146,7 +160,7 @@ static void NET_SDL_FreeAddress(net_addr_t *addr)
     {
         if (addr == &addr_table[i]->net_addr)
         {
-            Z_Free(addr_table[i]);
+            free(addr_table[i]);
             addr_table[i] = NULL;
             return;
         }
@@ -185,10 +199,6 @@ static boolean NET_SDL_InitClient(void)
     
     recvpacket = SDLNet_AllocPacket(1500);
 
-#ifdef DROP_PACKETS
-    srand(time(NULL));
-#endif
-
     initted = true;
 
     return true;
@@ -215,9 +225,6 @@ static boolean NET_SDL_InitServer(void)
     }
 
     recvpacket = SDLNet_AllocPacket(1500);
-#ifdef DROP_PACKETS
-    srand(time(NULL));
-#endif
 
     initted = true;
 
@@ -255,11 +262,6 @@ static void NET_SDL_SendPacket(net_addr_t *addr, net_packet_t *packet)
     }
 #endif
 
-#ifdef DROP_PACKETS
-    if ((rand() % 4) == 0)
-        return;
-#endif
-
     sdl_packet.channel = 0;
     sdl_packet.data = packet->data;
     sdl_packet.len = packet->len;
@@ -302,6 +304,19 @@ static boolean NET_SDL_RecvPacket(net_addr_t **addr, net_packet_t **packet)
     return true;
 }
 
+static void NET_SDL_WaitForPacket(int timeout)
+{
+    static SDLNet_SocketSet socketset = NULL;
+
+    if (socketset == NULL)
+    {
+        socketset = SDLNet_AllocSocketSet(1);
+        SDLNet_UDP_AddSocket(socketset, udpsocket);
+    }
+
+    SDLNet_CheckSockets(socketset, timeout);
+}
+
 void NET_SDL_AddrToString(net_addr_t *addr, char *buffer, int buffer_len)
 {
     IPaddress *ip;
@@ -380,5 +395,7 @@ net_module_t net_sdl_module =
     NET_SDL_AddrToString,
     NET_SDL_FreeAddress,
     NET_SDL_ResolveAddress,
+    NULL,
+    NET_SDL_WaitForPacket,
 };
 
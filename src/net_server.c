@@ -19,12 +19,16 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <setjmp.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "SDL.h"
+
 #include "config.h"
 
 #include "doomtype.h"
+#include "d_event.h"
 #include "d_mode.h"
 #include "i_system.h"
 #include "i_timer.h"
@@ -38,6 +42,7 @@
 #include "net_loop.h"
 #include "net_packet.h"
 #include "net_query.h"
+#include "net_relay.h"
 #include "net_server.h"
 #include "net_sdl.h"
 #include "net_structrw.h"
@@ -50,6 +55,19 @@
 
 #define MASTER_RESOLVE_PERIOD 8 * 60 * 60 /* 8 hours */
 
+// Most new tics sent to a packed-tics client in one packet, keeping
+// a full packet (with extratics) well under a typical MTU.
+
+#define MAX_BATCH_TICS 16
+
+// Most tics sent to a spectator ahead of its acknowledgments.
+
+#define MAX_SPECTATOR_TICS 40
+
+// How often to write the metrics file, in seconds.
+
+#define METRICS_PERIOD 1
+
 typedef enum
 {
     // waiting for the game to be "launched" (key player to press the start
@@ -67,7 +85,10 @@ typedef enum
     SERVER_IN_GAME,
 } net_server_state_t;
 
-typedef struct
+typedef struct net_session_s net_session_t;
+typedef struct net_client_s net_client_t;
+
+struct net_client_s
 {
     boolean active;
     int player_number;
@@ -94,6 +115,19 @@ typedef struct
 
     boolean recording_lowres;
 
+    // Game data uses the packed tic encoding, and newly completed tics
+    // are sent together in one packet.
+
+    boolean packed_tics;
+
+    // Round trip time and loss of game data from this client, the
+    // time each tic in sendqueue was first sent, and whether it has
+    // been sent again since, on request
+
+    net_link_t link;
+    unsigned int sendtime[BACKUPTICS];
+    boolean sendresent[BACKUPTICS];
+
     // send queue: items to send to the client
     // this is a circular buffer
 
@@ -112,6 +146,12 @@ typedef struct
 
     boolean drone;
 
+    // Resend requests sent to this client, and how many of them were
+    // to break a possible deadlock (see NET_SV_CheckDeadlock)
+
+    unsigned int resend_requests;
+    unsigned int deadlocks;
+
     // SHA1 hash sums of the client's WAD directory and dehacked data
 
     sha1_digest_t wad_sha1sum;
@@ -125,7 +165,13 @@ typedef struct
 
     int player_class;
 
-} net_client_t;
+    // Session the client belongs to, and the next client in the same
+    // chain of the address hash table.
+
+    net_session_t *session;
+    net_client_t *hash_next;
+
+};
 
 // structure used for the recv window
 
@@ -148,14 +194,127 @@ typedef struct
     net_ticdiff_t diff;
 } net_client_recv_t;
 
-static net_server_state_t server_state;
+typedef struct
+{
+    // Packets received from clients
+
+    unsigned int packets_received;
+
+    // Game data packets sent to clients
+
+    unsigned int gamedata_sent;
+
+    // Resend requests sent to clients for tics we did not receive,
+    // and tics resent to clients on request
+
+    unsigned int resend_requests;
+    unsigned int tics_resent;
+
+    // Sum of the latencies reported by clients, in ms, and the number
+    // of reports
+
+    unsigned int latency_total;
+    unsigned int latency_samples;
+
+    // Tics the game has advanced, and resend requests sent because a
+    // player sent nothing for a long time
+
+    unsigned int tics;
+    unsigned int deadlocks;
+} net_session_stats_t;
+
+// A game hosted by the server.  Normally there is only one, but a
+// dedicated server can host several at once over the same socket.
+
+struct net_session_s
+{
+    int id;
+    net_server_state_t state;
+    net_client_t clients[MAXNETNODES];
+    net_client_t *players[NET_MAXPLAYERS];
+    unsigned int gamemode;
+    unsigned int gamemission;
+    net_gamesettings_t settings;
+
+    // receive window
+
+    unsigned int recvwindow_start;
+    net_client_recv_t recvwindow[BACKUPTICS][NET_MAXPLAYERS];
+
+    // Statistics, running totals since the session was created.
+
+    net_session_stats_t stats;
+
+    // Totals at the time of the last statistics dump, for the rates.
+
+    net_session_stats_t last_stats;
+    unsigned int last_stats_time;
+
+    // Tics at the time the metrics were last written, for the tic rate.
+
+    unsigned int metrics_tics;
+
+    // Tics every player has acknowledged, kept for the spectators
+    // (drones) and the demo: tic seq is history[seq % history_size],
+    // added at history_time[seq % history_size].
+
+    net_full_ticcmd_t *history;
+    unsigned int *history_time;
+    unsigned int history_size;
+    unsigned int history_end;
+
+    // Demo being recorded, and the last ticcmd of each player that
+    // the diffs in the history apply to.
+
+    FILE *demo;
+    ticcmd_t demo_cmds[NET_MAXPLAYERS];
+
+    // Spectators are sent the same tics from the history, so the last
+    // game data packet built for one is kept and sent as it is to the
+    // others that need the same tics.
+
+    net_packet_t *spectator_packet;
+    unsigned int spectator_start, spectator_end;
+    boolean spectator_packed;
+
+    // Relay session: the tics come from an upstream server rather
+    // than from players (see net_relay.c).  relay_started is set once
+    // the upstream game settings arrive, relay_ended once the upstream
+    // game is over.
+
+    boolean relay;
+    boolean relay_started;
+    boolean relay_ended;
+    net_waitdata_t relay_wait_data;
+};
+
 static boolean server_initialized = false;
-static net_client_t clients[MAXNETNODES];
-static net_client_t *sv_players[NET_MAXPLAYERS];
 static net_context_t *server_context;
-static unsigned int sv_gamemode;
-static unsigned int sv_gamemission;
-static net_gamesettings_t sv_settings;
+
+// All sessions, and the one currently being worked on.
+
+static net_session_t **sessions = NULL;
+static int num_sessions = 0;
+static int max_sessions = 1;
+static net_session_t *sv;
+
+// How often to print session statistics, in seconds (0 = never).
+
+static int stats_period = 0;
+
+// Spectators see the game this many ms after the players, and each
+// game is recorded to a demo named after record_name if it is set.
+
+static int spectator_delay = 0;
+static char *record_name = NULL;
+static int record_count = 0;
+
+// Active clients of all sessions, hashed by address.
+
+#define CLIENT_HASH_SIZE 64
+
+static net_client_t *client_hash[CLIENT_HASH_SIZE];
+
 
 // For registration with master server:
 
@@ -163,12 +322,30 @@ static net_addr_t *master_server = NULL;
 static unsigned int master_refresh_time;
 static unsigned int master_resolve_time;
 
-// receive window
+// File the metrics are written to, if any, and when they last were.
+
+static char *metrics_file = NULL;
+static unsigned int metrics_time;
+
+// Upstream server the games are relayed from, if relaying.
+
+static net_addr_t *relay_server = NULL;
+
+// Thread the server runs on when started with NET_SV_StartThread, and
+// the flag telling it to stop.  It shares with the game the packets
+// passed through the loopback queues (net_loop.c) and the master
+// server registration result (net_query.c).  An error on the thread
+// ends it, and is raised by NET_SV_Run on the game's thread.
+
+#define SERVER_THREAD_MAX_WAIT 10
 
-static unsigned int recvwindow_start;
-static net_client_recv_t recvwindow[BACKUPTICS][NET_MAXPLAYERS];
+static SDL_Thread *server_thread = NULL;
+static SDL_atomic_t server_thread_stop;
+static SDL_atomic_t server_thread_failed;
+static jmp_buf server_thread_error_jmp;
+static char server_thread_error[512];
 
-#define NET_SV_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
+#define NET_SV_ExpandTicNum(b) NET_ExpandTicNum(sv->recvwindow_start, (b))
 
 static void NET_SV_DisconnectClient(net_client_t *client)
 {
@@ -219,9 +396,9 @@ static void NET_SV_BroadcastMessage(char *s, ...)
     
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            NET_SV_SendConsoleMessage(&clients[i], buf);
+            NET_SV_SendConsoleMessage(&sv->clients[i], buf);
         }
     }
 
@@ -240,24 +417,24 @@ static void NET_SV_AssignPlayers(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            if (!clients[i].drone)
+            if (!sv->clients[i].drone)
             {
-                sv_players[pl] = &clients[i];
-                sv_players[pl]->player_number = pl;
+                sv->players[pl] = &sv->clients[i];
+                sv->players[pl]->player_number = pl;
                 ++pl;
             }
             else
             {
-                clients[i].player_number = -1;
+                sv->clients[i].player_number = -1;
             }
         }
     }
 
     for (; pl<NET_MAXPLAYERS; ++pl)
     {
-        sv_players[pl] = NULL;
+        sv->players[pl] = NULL;
     }
 }
 
@@ -272,7 +449,7 @@ static int NET_SV_NumPlayers(void)
 
     for (i=0; i<NET_MAXPLAYERS; ++i)
     {
-        if (sv_players[i] != NULL && ClientConnected(sv_players[i]))
+        if (sv->players[i] != NULL && ClientConnected(sv->players[i]))
         {
             result += 1;
         }
@@ -290,8 +467,8 @@ static int NET_SV_NumReadyPlayers(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i])
-         && !clients[i].drone && clients[i].ready)
+        if (ClientConnected(&sv->clients[i])
+         && !sv->clients[i].drone && sv->clients[i].ready)
         {
             ++result;
         }
@@ -308,9 +485,9 @@ static int NET_SV_MaxPlayers(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            return clients[i].max_players;
+            return sv->clients[i].max_players;
         }
     }
 
@@ -328,7 +505,7 @@ static int NET_SV_NumDrones(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]) && clients[i].drone)
+        if (ClientConnected(&sv->clients[i]) && sv->clients[i].drone)
         {
             result += 1;
         }
@@ -348,7 +525,7 @@ static int NET_SV_NumClients(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
             ++count;
         }
@@ -372,14 +549,14 @@ static net_client_t *NET_SV_Controller(void)
     {
         // Can't be controller?
 
-        if (!ClientConnected(&clients[i]) || clients[i].drone)
+        if (!ClientConnected(&sv->clients[i]) || sv->clients[i].drone)
         {
             continue;
         }
 
-        if (best == NULL || clients[i].connect_time < best->connect_time)
+        if (best == NULL || sv->clients[i].connect_time < best->connect_time)
         {
-            best = &clients[i];
+            best = &sv->clients[i];
         }
     }
 
@@ -424,11 +601,20 @@ static void NET_SV_SendWaitingData(net_client_t *client)
     for (i = 0; i < wait_data.num_players; ++i)
     {
         M_StringCopy(wait_data.player_names[i],
-                     sv_players[i]->name,
-                     MAXPLAYERNAME);
-        M_StringCopy(wait_data.player_addrs[i],
-                     NET_AddrToString(sv_players[i]->addr),
+                     sv->players[i]->name,
                      MAXPLAYERNAME);
+        NET_AddrToStringBuffer(sv->players[i]->addr,
+                               wait_data.player_addrs[i], MAXPLAYERNAME);
+    }
+
+    // A relay has no players of its own; pass on what the upstream
+    // server says about its game.
+
+    if (sv->relay)
+    {
+        wait_data = sv->relay_wait_data;
+        wait_data.is_controller = false;
+        wait_data.consoleplayer = -1;
     }
 
     // Construct packet:
@@ -444,7 +630,8 @@ static void NET_SV_SendWaitingData(net_client_t *client)
 }
 
 // Find the latest tic which has been acknowledged as received by
-// all clients.
+// all players.  Drones are fed from the history instead, so a slow
+// spectator never holds the players back.
 
 static unsigned int NET_SV_LatestAcknowledged(void)
 {
@@ -453,11 +640,11 @@ static unsigned int NET_SV_LatestAcknowledged(void)
 
     for (i=0; i<MAXNETNODES; ++i) 
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]) && !sv->clients[i].drone)
         {
-            if (clients[i].acknowledged < lowtic)
+            if (sv->clients[i].acknowledged < lowtic)
             {
-                lowtic = clients[i].acknowledged;
+                lowtic = sv->clients[i].acknowledged;
             }
         }
     }
@@ -466,11 +653,233 @@ static unsigned int NET_SV_LatestAcknowledged(void)
 }
 
 
+// Open the demo for the game just started, if recording.  Only Doom
+// games of up to four players can be written in the demo format.
+
+static void NET_SV_StartDemo(void)
+{
+    char filename[256];
+    net_gamesettings_t *settings = &sv->settings;
+    int version;
+    int i;
+
+    if (record_name == NULL)
+    {
+        return;
+    }
+
+    if (sv->gamemission == heretic || sv->gamemission == hexen
+     || sv->gamemission == strife)
+    {
+        printf("SV: demos can only be recorded for Doom games\n");
+        return;
+    }
+
+    if (settings->num_players > 4 || settings->loadgame >= 0
+     || settings->gameversion == exe_doom_1_2)
+    {
+        printf("SV: this game can not be recorded to a demo\n");
+        return;
+    }
+
+    // Same version codes as G_BeginRecording: "Doom 1.91" longtics
+    // unless the players turn at low resolution.
+
+    switch (settings->gameversion)
+    {
+        case exe_doom_1_666:
+            version = 106;
+            break;
+        case exe_doom_1_7:
+            version = 107;
+            break;
+        case exe_doom_1_8:
+            version = 108;
+            break;
+        default:
+            version = 109;
+            break;
+    }
+
+    if (!settings->lowres_turn)
+    {
+        version = 111;
+    }
+
+    M_snprintf(filename, sizeof(filename), "%s-%i.lmp",
+               record_name, record_count);
+    ++record_count;
+
+    sv->demo = fopen(filename, "wb");
+
+    if (sv->demo == NULL)
+    {
+        printf("SV: failed to open %s for recording\n", filename);
+        return;
+    }
+
+    printf("SV: session %i: recording %s\n", sv->id, filename);
+
+    fputc(version, sv->demo);
+    fputc(settings->skill, sv->demo);
+    fputc(settings->episode, sv->demo);
+    fputc(settings->map, sv->demo);
+    fputc(settings->deathmatch, sv->demo);
+    fputc(settings->respawn_monsters, sv->demo);
+    fputc(settings->fast_monsters, sv->demo);
+    fputc(settings->nomonsters, sv->demo);
+    fputc(0, sv->demo);
+
+    for (i=0; i<4; ++i)
+    {
+        fputc(i < settings->num_players, sv->demo);
+    }
+
+    memset(sv->demo_cmds, 0, sizeof(sv->demo_cmds));
+}
+
+// Write a tic to the demo, once for every tic the games run it.
+// Players who have left are written as standing still.
+
+static void NET_SV_WriteDemoTic(net_full_ticcmd_t *cmd)
+{
+    ticcmd_t ticcmd;
+    int dup;
+    int i;
+
+    for (i=0; i<sv->settings.num_players; ++i)
+    {
+        if (cmd->playeringame[i])
+        {
+            NET_TiccmdPatch(&sv->demo_cmds[i], &cmd->cmds[i],
+                            &sv->demo_cmds[i]);
+        }
+    }
+
+    for (dup=0; dup<sv->settings.ticdup; ++dup)
+    {
+        for (i=0; i<sv->settings.num_players; ++i)
+        {
+            if (cmd->playeringame[i])
+            {
+                ticcmd = sv->demo_cmds[i];
+            }
+            else
+            {
+                memset(&ticcmd, 0, sizeof(ticcmd));
+            }
+
+            // As in TicdupSquash: the copies do not repeat special
+            // buttons.
+
+            if (dup > 0 && (ticcmd.buttons & BT_SPECIAL) != 0)
+            {
+                ticcmd.buttons = 0;
+            }
+
+            fputc(ticcmd.forwardmove, sv->demo);
+            fputc(ticcmd.sidemove, sv->demo);
+
+            if (sv->settings.lowres_turn)
+            {
+                fputc(ticcmd.angleturn >> 8, sv->demo);
+            }
+            else
+            {
+                fputc(ticcmd.angleturn & 0xff, sv->demo);
+                fputc((ticcmd.angleturn >> 8) & 0xff, sv->demo);
+            }
+
+            fputc(ticcmd.buttons, sv->demo);
+        }
+    }
+}
+
+static void NET_SV_EndDemo(void)
+{
+    if (sv->demo != NULL)
+    {
+        fputc(0x80, sv->demo);
+        fclose(sv->demo);
+        sv->demo = NULL;
+    }
+}
+
+static void NET_SV_ForgetSpectatorPacket(void)
+{
+    if (sv->spectator_packet != NULL)
+    {
+        NET_FreePacket(sv->spectator_packet);
+        sv->spectator_packet = NULL;
+    }
+}
+
+// Set up the history for a game being started.  It holds enough tics
+// for the spectator delay, with room to spare for slow spectators.
+
+static void NET_SV_InitHistory(void)
+{
+    sv->history_size = spectator_delay * TICRATE / 1000 + 2 * BACKUPTICS;
+    sv->history = realloc(sv->history,
+                          sv->history_size * sizeof(*sv->history));
+    sv->history_time = realloc(sv->history_time,
+                               sv->history_size * sizeof(*sv->history_time));
+
+    if (sv->history == NULL || sv->history_time == NULL)
+    {
+        I_Error("NET_SV_InitHistory: недостаточно памяти");
+    }
+
+    sv->history_end = 0;
+
+    NET_SV_ForgetSpectatorPacket();
+    NET_SV_StartDemo();
+}
+
+// Add the next tic of the game to the history and the demo.
+
+static void NET_SV_AppendTic(net_full_ticcmd_t *cmd)
+{
+    unsigned int index;
+
+    index = sv->history_end % sv->history_size;
+
+    sv->history[index] = *cmd;
+    sv->history[index].seq = sv->history_end;
+    sv->history_time[index] = I_GetTimeMS();
+    ++sv->history_end;
+    ++sv->stats.tics;
+
+    if (sv->demo != NULL)
+    {
+        NET_SV_WriteDemoTic(cmd);
+    }
+}
+
+// Returns true if any spectator has yet to receive the whole game.
+
+static boolean NET_SV_SpectatorsPending(void)
+{
+    int i;
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        if (ClientConnected(&sv->clients[i]) && sv->clients[i].drone
+         && sv->clients[i].acknowledged < sv->history_end)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 // Possibly advance the recv window if all connected clients have
 // used the data in the window
 
 static void NET_SV_AdvanceWindow(void)
 {
+    net_full_ticcmd_t cmd;
     unsigned int lowtic;
     int i;
 
@@ -483,7 +892,7 @@ static void NET_SV_AdvanceWindow(void)
 
     // Advance the recv window until it catches up with lowtic
 
-    while (recvwindow_start < lowtic)
+    while (sv->recvwindow_start < lowtic)
     {    
         boolean should_advance;
 
@@ -494,12 +903,12 @@ static void NET_SV_AdvanceWindow(void)
 
         for (i=0; i<NET_MAXPLAYERS; ++i)
         {
-            if (sv_players[i] == NULL || !ClientConnected(sv_players[i]))
+            if (sv->players[i] == NULL || !ClientConnected(sv->players[i]))
             {
                 continue;
             }
 
-            if (!recvwindow[0][i].active)
+            if (!sv->recvwindow[0][i].active)
             {
                 should_advance = false;
                 break;
@@ -514,31 +923,88 @@ static void NET_SV_AdvanceWindow(void)
 
             break;
         }
-        
+
+        // Every player has this tic now; keep it for the spectators.
+
+        cmd.latency = 0;
+
+        for (i=0; i<NET_MAXPLAYERS; ++i)
+        {
+            cmd.playeringame[i] = sv->players[i] != NULL
+                               && sv->recvwindow[0][i].active;
+
+            if (cmd.playeringame[i])
+            {
+                cmd.cmds[i] = sv->recvwindow[0][i].diff;
+
+                if (sv->recvwindow[0][i].latency > cmd.latency)
+                {
+                    cmd.latency = sv->recvwindow[0][i].latency;
+                }
+            }
+        }
+
+        NET_SV_AppendTic(&cmd);
+
         // Advance the window
 
-        memmove(recvwindow, recvwindow + 1,
-                sizeof(*recvwindow) * (BACKUPTICS - 1));
-        memset(&recvwindow[BACKUPTICS-1], 0, sizeof(*recvwindow));
-        ++recvwindow_start;
+        memmove(sv->recvwindow, sv->recvwindow + 1,
+                sizeof(*sv->recvwindow) * (BACKUPTICS - 1));
+        memset(&sv->recvwindow[BACKUPTICS-1], 0, sizeof(*sv->recvwindow));
+        ++sv->recvwindow_start;
+
+        //printf("SV: advanced to %i\n", sv->recvwindow_start);
+    }
+}
+
+// Clients of all sessions are kept in a hash table keyed on their
+// address, so that packets can be routed to the right session.
+
+static unsigned int ClientHash(net_addr_t *addr)
+{
+    return (unsigned int) (((uintptr_t) addr) >> 4) % CLIENT_HASH_SIZE;
+}
+
+static void NET_SV_HashClient(net_client_t *client)
+{
+    unsigned int hash;
+
+    hash = ClientHash(client->addr);
+    client->hash_next = client_hash[hash];
+    client_hash[hash] = client;
+}
+
+static void NET_SV_UnhashClient(net_client_t *client)
+{
+    net_client_t **entry;
+
+    entry = &client_hash[ClientHash(client->addr)];
 
-        //printf("SV: advanced to %i\n", recvwindow_start);
+    for (; *entry != NULL; entry = &(*entry)->hash_next)
+    {
+        if (*entry == client)
+        {
+            *entry = client->hash_next;
+            client->hash_next = NULL;
+            return;
+        }
     }
 }
 
-// Given an address, find the corresponding client
+// Given an address, find the corresponding client in any session
 
 static net_client_t *NET_SV_FindClient(net_addr_t *addr)
 {
-    int i;
+    net_client_t *client;
 
-    for (i=0; i<MAXNETNODES; ++i) 
+    for (client = client_hash[ClientHash(addr)]; client != NULL;
+         client = client->hash_next)
     {
-        if (clients[i].active && clients[i].addr == addr)
+        if (client->active && client->addr == addr)
         {
             // found the client
 
-            return &clients[i];
+            return client;
         }
     }
 
@@ -566,6 +1032,8 @@ static void NET_SV_InitNewClient(net_client_t *client,
     client->connect_time = I_GetTimeMS();
     NET_Conn_InitServer(&client->connection, addr);
     client->addr = addr;
+    client->session = sv;
+    NET_SV_HashClient(client);
     client->last_send_time = -1;
     client->name = M_StringDuplicate(player_name);
 
@@ -575,57 +1043,169 @@ static void NET_SV_InitNewClient(net_client_t *client,
     client->acknowledged = 0;
     client->drone = false;
     client->ready = false;
+    client->resend_requests = 0;
+    client->deadlocks = 0;
 
     client->last_gamedata_time = 0;
 
     memset(client->sendqueue, 0xff, sizeof(client->sendqueue));
+    NET_Link_Init(&client->link);
 }
 
-// parse a SYN from a client(initiating a connection)
+// Create a new session, waiting for players.
 
-static void NET_SV_ParseSYN(net_packet_t *packet, 
-                            net_client_t *client,
-                            net_addr_t *addr)
+static net_session_t *NET_SV_NewSession(void)
 {
-    unsigned int magic;
-    net_connect_data_t data;
-    char *player_name;
-    char *client_version;
+    net_session_t *session;
     int i;
 
-    // read the magic number
+    session = calloc(1, sizeof(net_session_t));
 
-    if (!NET_ReadInt32(packet, &magic))
+    if (session == NULL)
     {
-        return;
+        I_Error("NET_SV_NewSession: недостаточно памяти");
     }
 
-    if (magic != NET_MAGIC_NUMBER)
+    session->id = num_sessions;
+    session->state = SERVER_WAITING_LAUNCH;
+    session->gamemode = indetermined;
+    session->last_stats_time = I_GetTimeMS();
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
     {
-        // invalid magic number
+        session->players[i] = NULL;
+    }
 
-        return;
+    sessions = realloc(sessions, (num_sessions + 1) * sizeof(*sessions));
+
+    if (sessions == NULL)
+    {
+        I_Error("NET_SV_NewSession: недостаточно памяти");
     }
 
-    // Check the client version is the same as the server
+    sessions[num_sessions] = session;
+    ++num_sessions;
 
-    client_version = NET_ReadString(packet);
+    return session;
+}
 
-    if (client_version == NULL)
+// Find the session a newly connecting client should join: one already
+// waiting for players of the same game, else an empty one, creating it
+// if allowed.  If the client is given as NULL (a query), any session
+// waiting for players will do.  If there is no room anywhere, the first
+// session is returned and turns the client away.
+
+static net_session_t *NET_SV_OpenSession(net_connect_data_t *data)
+{
+    net_session_t *empty = NULL;
+    net_session_t *result = NULL;
+    int i;
+
+    // A relay has the one session it relays into.
+
+    if (relay_server != NULL)
     {
-        return;
+        return sessions[0];
     }
 
-    if (strcmp(client_version, PACKAGE_STRING) != 0)
+    for (i=0; i<num_sessions && result == NULL; ++i)
     {
-        //!
-        // @category net
-        //
-        // When running a netgame server, ignore version mismatches between
-        // the server and the client. Using this option may cause game
-        // desyncs to occur, or differences in protocol may mean the netgame
-        // will simply not function at all.
-        //
+        sv = sessions[i];
+
+        if (sv->state != SERVER_WAITING_LAUNCH)
+        {
+            continue;
+        }
+
+        NET_SV_AssignPlayers();
+
+        if (NET_SV_NumClients() == 0)
+        {
+            if (empty == NULL)
+            {
+                empty = sv;
+            }
+        }
+        else if (NET_SV_NumClients() < MAXNETNODES
+              && (data == NULL
+               || (data->gamemode == sv->gamemode
+                && data->gamemission == sv->gamemission
+                && (data->drone
+                 || NET_SV_NumPlayers() < NET_SV_MaxPlayers()))))
+        {
+            result = sv;
+        }
+    }
+
+    if (result == NULL)
+    {
+        result = empty;
+    }
+
+    if (result == NULL)
+    {
+        result = num_sessions < max_sessions ? NET_SV_NewSession()
+                                             : sessions[0];
+    }
+
+    return result;
+}
+
+// parse a SYN from a client(initiating a connection)
+
+static void NET_SV_ParseSYN(net_packet_t *packet, 
+                            net_client_t *client,
+                            net_addr_t *addr)
+{
+    unsigned int magic;
+    net_connect_data_t data;
+    char *player_name;
+    char *client_version;
+    int i;
+
+    // read the magic number
+
+    if (!NET_ReadInt32(packet, &magic))
+    {
+        return;
+    }
+
+    if (magic != NET_MAGIC_NUMBER)
+    {
+        // A client from before packed tics sends its SYN in a layout we
+        // cannot read; tell it why rather than dropping it silently.
+
+        if (magic == NET_OLD_MAGIC_NUMBER)
+        {
+            NET_SV_SendReject(addr,
+                "Different " PACKAGE_NAME " versions cannot play a net game!\n"
+                "Version mismatch: server version is: " PACKAGE_STRING);
+        }
+
+        // invalid magic number
+
+        return;
+    }
+
+    // Check the client version is the same as the server
+
+    client_version = NET_ReadString(packet);
+
+    if (client_version == NULL)
+    {
+        return;
+    }
+
+    if (strcmp(client_version, PACKAGE_STRING) != 0)
+    {
+        //!
+        // @category net
+        //
+        // When running a netgame server, ignore version mismatches between
+        // the server and the client. Using this option may cause game
+        // desyncs to occur, or differences in protocol may mean the netgame
+        // will simply not function at all.
+        //
 
         if (M_CheckParm("-ignoreversion") == 0)
         {
@@ -666,14 +1246,29 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
 
     // received a valid SYN
 
+    // A new client joins a session that is waiting for players.
+
+    if (client == NULL)
+    {
+        sv = NET_SV_OpenSession(&data);
+    }
+
     // not accepting new connections?
 
-    if (server_state != SERVER_WAITING_LAUNCH)
+    if (sv->state != SERVER_WAITING_LAUNCH)
     {
         NET_SV_SendReject(addr, "Server is not currently accepting connections");
         return;
     }
 
+    // A relay only takes spectators, once it knows the upstream game.
+
+    if (sv->relay && (!data.drone || sv->gamemode == indetermined))
+    {
+        NET_SV_SendReject(addr, "This server only relays games to spectators");
+        return;
+    }
+
     // allocate a client slot if there isn't one already
 
     if (client == NULL)
@@ -682,9 +1277,9 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
 
         for (i=0; i<MAXNETNODES; ++i)
         {
-            if (!clients[i].active)
+            if (!sv->clients[i].active)
             {
-                client = &clients[i];
+                client = &sv->clients[i];
                 break;
             }
         }
@@ -701,6 +1296,7 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
 
         if (client->connection.state == NET_CONN_STATE_DISCONNECTED)
         {
+            NET_SV_UnhashClient(client);
             client->active = false;
         }
     }
@@ -732,8 +1328,8 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
 
         if (num_players == 0 && !data.drone)
         {
-            sv_gamemode = data.gamemode;
-            sv_gamemission = data.gamemission;
+            sv->gamemode = data.gamemode;
+            sv->gamemission = data.gamemission;
         }
 
         // Save the SHA1 checksums
@@ -746,7 +1342,7 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
         // Check the connecting client is playing the same game as all
         // the other clients
 
-        if (data.gamemode != sv_gamemode || data.gamemission != sv_gamemission)
+        if (data.gamemode != sv->gamemode || data.gamemission != sv->gamemission)
         {
             NET_SV_SendReject(addr, "You are playing the wrong game!");
             return;
@@ -759,6 +1355,7 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
         client->recording_lowres = data.lowres_turn;
         client->drone = data.drone;
         client->player_class = data.player_class;
+        client->packed_tics = data.packed_tics != 0;
     }
 
     if (client->connection.state == NET_CONN_STATE_WAITING_ACK)
@@ -786,7 +1383,7 @@ static void NET_SV_ParseLaunch(net_packet_t *packet, net_client_t *client)
 
     // Can only launch when we are in the waiting state.
 
-    if (server_state != SERVER_WAITING_LAUNCH)
+    if (sv->state != SERVER_WAITING_LAUNCH)
     {
         return;
     }
@@ -798,17 +1395,17 @@ static void NET_SV_ParseLaunch(net_packet_t *packet, net_client_t *client)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (!ClientConnected(&clients[i]))
+        if (!ClientConnected(&sv->clients[i]))
             continue;
 
-        launchpacket = NET_Conn_NewReliable(&clients[i].connection,
+        launchpacket = NET_Conn_NewReliable(&sv->clients[i].connection,
                                             NET_PACKET_TYPE_LAUNCH);
         NET_WriteInt8(launchpacket, num_players);
     }
 
     // Now in launch state.
 
-    server_state = SERVER_WAITING_START;
+    sv->state = SERVER_WAITING_START;
 }
 
 // Transition to the in-game state and send all players the start game
@@ -825,31 +1422,36 @@ static void StartGame(void)
 
     NET_SV_AssignPlayers();
 
-    // Check if anyone is recording a demo and set lowres_turn if so.
+    // A relay passes the upstream settings on as they are.
 
-    sv_settings.lowres_turn = false;
-
-    for (i = 0; i < NET_MAXPLAYERS; ++i)
+    if (!sv->relay)
     {
-        if (sv_players[i] != NULL && sv_players[i]->recording_lowres)
+        // Check if anyone is recording a demo and set lowres_turn if so.
+
+        sv->settings.lowres_turn = false;
+
+        for (i = 0; i < NET_MAXPLAYERS; ++i)
         {
-            sv_settings.lowres_turn = true;
+            if (sv->players[i] != NULL && sv->players[i]->recording_lowres)
+            {
+                sv->settings.lowres_turn = true;
+            }
         }
-    }
 
-    sv_settings.num_players = NET_SV_NumPlayers();
+        sv->settings.num_players = NET_SV_NumPlayers();
 
-    // Copy player classes:
+        // Copy player classes:
 
-    for (i = 0; i < NET_MAXPLAYERS; ++i)
-    {
-        if (sv_players[i] != NULL)
-        {
-            sv_settings.player_classes[i] = sv_players[i]->player_class;
-        }
-        else
+        for (i = 0; i < NET_MAXPLAYERS; ++i)
         {
-            sv_settings.player_classes[i] = 0;
+            if (sv->players[i] != NULL)
+            {
+                sv->settings.player_classes[i] = sv->players[i]->player_class;
+            }
+            else
+            {
+                sv->settings.player_classes[i] = 0;
+            }
         }
     }
 
@@ -859,25 +1461,28 @@ static void StartGame(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (!ClientConnected(&clients[i]))
+        if (!ClientConnected(&sv->clients[i]))
             continue;
 
-        clients[i].last_gamedata_time = nowtime;
+        sv->clients[i].last_gamedata_time = nowtime;
 
-        startpacket = NET_Conn_NewReliable(&clients[i].connection,
+        startpacket = NET_Conn_NewReliable(&sv->clients[i].connection,
                                            NET_PACKET_TYPE_GAMESTART);
 
-        sv_settings.consoleplayer = clients[i].player_number;
+        sv->settings.consoleplayer = sv->clients[i].player_number;
+        sv->settings.packed_tics = sv->clients[i].packed_tics;
 
-        NET_WriteSettings(startpacket, &sv_settings);
+        NET_WriteSettings(startpacket, &sv->settings);
     }
 
     // Change server state
 
-    server_state = SERVER_IN_GAME;
+    sv->state = SERVER_IN_GAME;
+
+    memset(sv->recvwindow, 0, sizeof(sv->recvwindow));
+    sv->recvwindow_start = 0;
 
-    memset(recvwindow, 0, sizeof(recvwindow));
-    recvwindow_start = 0;
+    NET_SV_InitHistory();
 }
 
 // Returns true when all nodes have indicated readiness to start the game.
@@ -888,7 +1493,7 @@ static boolean AllNodesReady(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]) && !clients[i].ready)
+        if (ClientConnected(&sv->clients[i]) && !sv->clients[i].ready)
         {
             return false;
         }
@@ -901,6 +1506,13 @@ static boolean AllNodesReady(void)
 
 static void CheckStartGame(void)
 {
+    // A relay also waits for the upstream game to start.
+
+    if (sv->relay && !sv->relay_started)
+    {
+        return;
+    }
+
     if (AllNodesReady())
     {
         StartGame();
@@ -916,9 +1528,9 @@ static void SendAllWaitingData(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]) && clients[i].ready)
+        if (ClientConnected(&sv->clients[i]) && sv->clients[i].ready)
         {
-            NET_SV_SendWaitingData(&clients[i]);
+            NET_SV_SendWaitingData(&sv->clients[i]);
         }
     }
 }
@@ -931,7 +1543,7 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
 
     // Can only start a game if we are in the waiting start state.
 
-    if (server_state != SERVER_WAITING_START)
+    if (sv->state != SERVER_WAITING_START)
     {
         return;
     }
@@ -947,12 +1559,12 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
 
         // Check the game settings are valid
 
-        if (!NET_ValidGameSettings(sv_gamemode, sv_gamemission, &settings))
+        if (!NET_ValidGameSettings(sv->gamemode, sv->gamemission, &settings))
         {
             return;
         }
 
-        sv_settings = settings;
+        sv->settings = settings;
     }
 
     client->ready = true;
@@ -987,13 +1599,16 @@ static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
     NET_Conn_SendPacket(&client->connection, packet);
     NET_FreePacket(packet);
 
+    ++sv->stats.resend_requests;
+    ++client->resend_requests;
+
     // Store the time we send the resend request
 
     nowtime = I_GetTimeMS();
 
     for (i=start; i<=end; ++i)
     {
-        index = i - recvwindow_start;
+        index = i - sv->recvwindow_start;
 
         if (index >= BACKUPTICS)
         {
@@ -1002,7 +1617,12 @@ static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
             continue;
         }
         
-        recvobj = &recvwindow[index][client->player_number];
+        recvobj = &sv->recvwindow[index][client->player_number];
+
+        if (recvobj->resend_time == 0)
+        {
+            NET_Link_TicReceived(&client->link, true);
+        }
 
         recvobj->resend_time = nowtime;
     }
@@ -1016,8 +1636,10 @@ static void NET_SV_CheckResends(net_client_t *client)
     int player;
     int resend_start, resend_end;
     unsigned int nowtime;
+    int timeout;
 
     nowtime = I_GetTimeMS();
+    timeout = NET_Link_ResendTimeout(&client->link);
 
     player = client->player_number;
     resend_start = -1;
@@ -1028,14 +1650,14 @@ static void NET_SV_CheckResends(net_client_t *client)
         net_client_recv_t *recvobj;
         boolean need_resend;
 
-        recvobj = &recvwindow[i][player];
+        recvobj = &sv->recvwindow[i][player];
 
         // if need_resend is true, this tic needs another retransmit
-        // request (300ms timeout)
+        // request (timeout follows the round trip time)
 
         need_resend = !recvobj->active
                    && recvobj->resend_time != 0
-                   && nowtime > recvobj->resend_time + 300;
+                   && nowtime > recvobj->resend_time + timeout;
 
         if (need_resend)
         {
@@ -1056,8 +1678,8 @@ static void NET_SV_CheckResends(net_client_t *client)
 
                 //printf("SV: resend request timed out: %i-%i\n", resend_start, resend_end);
                 NET_SV_SendResendRequest(client, 
-                                         recvwindow_start + resend_start,
-                                         recvwindow_start + resend_end);
+                                         sv->recvwindow_start + resend_start,
+                                         sv->recvwindow_start + resend_end);
 
                 resend_start = -1;
             }
@@ -1067,9 +1689,30 @@ static void NET_SV_CheckResends(net_client_t *client)
     if (resend_start >= 0)
     {
         NET_SV_SendResendRequest(client, 
-                                 recvwindow_start + resend_start,
-                                 recvwindow_start + resend_end);
+                                 sv->recvwindow_start + resend_start,
+                                 sv->recvwindow_start + resend_end);
+    }
+}
+
+// Move the acknowledgement point of a client forward, timing the
+// round trip of the last tic acknowledged.
+
+static void NET_SV_Acknowledge(net_client_t *client, unsigned int ackseq)
+{
+    if (ackseq <= client->acknowledged)
+    {
+        return;
+    }
+
+    if (ackseq <= client->sendseq
+     && client->sendqueue[(ackseq - 1) % BACKUPTICS].seq == ackseq - 1
+     && !client->sendresent[(ackseq - 1) % BACKUPTICS])
+    {
+        NET_Link_RoundTrip(&client->link, I_GetTimeMS()
+                         - client->sendtime[(ackseq - 1) % BACKUPTICS]);
     }
+
+    client->acknowledged = ackseq;
 }
 
 // Process game data from a client
@@ -1077,6 +1720,7 @@ static void NET_SV_CheckResends(net_client_t *client)
 static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
 {
     net_client_recv_t *recvobj;
+    net_ticpacker_t packer;
     unsigned int seq;
     unsigned int ackseq;
     unsigned int num_tics;
@@ -1086,7 +1730,7 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     int resend_start, resend_end;
     int index;
 
-    if (server_state != SERVER_IN_GAME)
+    if (sv->state != SERVER_IN_GAME)
     {
         return;
     }
@@ -1119,18 +1763,28 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
 
     // Sanity checks
 
+    NET_InitTicPacker(&packer, packet);
+
     for (i=0; i<num_tics; ++i)
     {
         net_ticdiff_t diff;
         signed int latency;
 
-        if (!NET_ReadSInt16(packet, &latency)
-         || !NET_ReadTiccmdDiff(packet, &diff, sv_settings.lowres_turn))
+        if (client->packed_tics)
+        {
+            if (!NET_UnpackTic(&packer, &latency, &diff,
+                               sv->settings.lowres_turn))
+            {
+                return;
+            }
+        }
+        else if (!NET_ReadSInt16(packet, &latency)
+              || !NET_ReadTiccmdDiff(packet, &diff, sv->settings.lowres_turn))
         {
             return;
         }
 
-        index = seq + i - recvwindow_start;
+        index = seq + i - sv->recvwindow_start;
 
         if (index < 0 || index >= BACKUPTICS)
         {
@@ -1139,20 +1793,29 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
             continue;
         }
 
-        recvobj = &recvwindow[index][player];
+        recvobj = &sv->recvwindow[index][player];
+
+        if (!recvobj->active && recvobj->resend_time == 0)
+        {
+            NET_Link_TicReceived(&client->link, false);
+        }
+
         recvobj->active = true;
         recvobj->diff = diff;
         recvobj->latency = latency;
 
+        if (latency >= 0)
+        {
+            sv->stats.latency_total += latency;
+            ++sv->stats.latency_samples;
+        }
+
         client->last_gamedata_time = nowtime;
     }
 
     // Higher acknowledgement point?
 
-    if (ackseq > client->acknowledged)
-    {
-        client->acknowledged = ackseq;
-    }
+    NET_SV_Acknowledge(client, ackseq);
 
     // Has this been received out of sequence, ie. have we not received
     // all tics before the first tic in this packet?  If so, send a 
@@ -1160,7 +1823,7 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
 
     //printf("SV: %p: %i\n", client, seq);
 
-    resend_end = seq - recvwindow_start;
+    resend_end = seq - sv->recvwindow_start;
 
     if (resend_end <= 0)
         return;
@@ -1173,7 +1836,7 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     
     while (index >= 0)
     {
-        recvobj = &recvwindow[index][player];
+        recvobj = &sv->recvwindow[index][player];
 
         if (recvobj->active)
         {
@@ -1199,13 +1862,13 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     {
             /*
         printf("missed %i-%i before %i, send resend\n",
-                        recvwindow_start + resend_start,
-                        recvwindow_start + resend_end - 1,
+                        sv->recvwindow_start + resend_start,
+                        sv->recvwindow_start + resend_end - 1,
                         seq);
                         */
         NET_SV_SendResendRequest(client, 
-                                 recvwindow_start + resend_start, 
-                                 recvwindow_start + resend_end - 1);
+                                 sv->recvwindow_start + resend_start, 
+                                 sv->recvwindow_start + resend_end - 1);
     }
 }
 
@@ -1213,7 +1876,7 @@ static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
 {
     unsigned int ackseq;
 
-    if (server_state != SERVER_IN_GAME)
+    if (sv->state != SERVER_IN_GAME)
     {
         return;
     }
@@ -1225,24 +1888,39 @@ static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
         return;
     }
 
-    // Expand 8-bit values to the full sequence number
+    // Expand 8-bit values to the full sequence number.  Spectators
+    // can be far behind the receive window.
 
-    ackseq = NET_SV_ExpandTicNum(ackseq);
+    if (client->drone)
+    {
+        ackseq = NET_ExpandTicNum(client->acknowledged, ackseq);
+    }
+    else
+    {
+        ackseq = NET_SV_ExpandTicNum(ackseq);
+    }
 
     // Higher acknowledgement point than we already have?
 
-    if (ackseq > client->acknowledged)
-    {
-        client->acknowledged = ackseq;
-    }
+    NET_SV_Acknowledge(client, ackseq);
 }
 
 static void NET_SV_SendTics(net_client_t *client, 
                             unsigned int start, unsigned int end)
 {
+    net_ticpacker_t packer;
     net_packet_t *packet;
     unsigned int i;
 
+    if (client->drone && sv->spectator_packet != NULL
+     && sv->spectator_start == start && sv->spectator_end == end
+     && sv->spectator_packed == client->packed_tics)
+    {
+        NET_Conn_SendPacket(&client->connection, sv->spectator_packet);
+        ++sv->stats.gamedata_sent;
+        return;
+    }
+
     packet = NET_NewPacket(500);
 
     NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA);
@@ -1254,6 +1932,8 @@ static void NET_SV_SendTics(net_client_t *client,
 
     // Write the tics
 
+    NET_InitTicPacker(&packer, packet);
+
     for (i=start; i<=end; ++i)
     {
         net_full_ticcmd_t *cmd;
@@ -1266,15 +1946,35 @@ static void NET_SV_SendTics(net_client_t *client,
         }
 
         // Add command
-       
-        NET_WriteFullTiccmd(packet, cmd, sv_settings.lowres_turn);
+
+        if (client->packed_tics)
+        {
+            NET_PackFullTiccmd(&packer, cmd, sv->settings.lowres_turn);
+        }
+        else
+        {
+            NET_WriteFullTiccmd(packet, cmd, sv->settings.lowres_turn);
+        }
     }
-    
+
+    NET_FinishTicPacker(&packer);
+
     // Send packet
 
     NET_Conn_SendPacket(&client->connection, packet);
-    
+
+    if (client->drone)
+    {
+        NET_SV_ForgetSpectatorPacket();
+        sv->spectator_packet = NET_PacketRef(packet);
+        sv->spectator_start = start;
+        sv->spectator_end = end;
+        sv->spectator_packed = client->packed_tics;
+    }
+
     NET_FreePacket(packet);
+
+    ++sv->stats.gamedata_sent;
 }
 
 // Parse a retransmission request from a client
@@ -1316,9 +2016,16 @@ static void NET_SV_ParseResendRequest(net_packet_t *packet, net_client_t *client
         }
     }
 
-    // Resend those tics
+    // Resend those tics.  Their acknowledgments no longer time the
+    // round trip.
+
+    for (i=start; i<=last; ++i)
+    {
+        client->sendresent[i % BACKUPTICS] = true;
+    }
 
     NET_SV_SendTics(client, start, last);
+    sv->stats.tics_resent += num_tics;
 }
 
 // Send a response back to the client
@@ -1335,7 +2042,7 @@ void NET_SV_SendQueryResponse(net_addr_t *addr)
 
     // Server state
 
-    querydata.server_state = server_state;
+    querydata.server_state = sv->state;
 
     // Number of players/maximum players
 
@@ -1344,8 +2051,8 @@ void NET_SV_SendQueryResponse(net_addr_t *addr)
 
     // Game mode/mission
 
-    querydata.gamemode = sv_gamemode;
-    querydata.gamemission = sv_gamemission;
+    querydata.gamemode = sv->gamemode;
+    querydata.gamemission = sv->gamemission;
 
     //!
     // @category net
@@ -1389,10 +2096,25 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
         return;
     }
 
-    // Find which client this packet came from
+    // From the server we are relaying?
+
+    if (addr != NULL && addr == relay_server)
+    {
+        NET_Relay_Packet(packet);
+        return;
+    }
+
+    // Find which client this packet came from, and so which session
+    // it is for
 
     client = NET_SV_FindClient(addr);
 
+    if (client != NULL)
+    {
+        sv = client->session;
+        ++sv->stats.packets_received;
+    }
+
     // Read the packet type
 
     if (!NET_ReadInt16(packet, &packet_type))
@@ -1408,6 +2130,13 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
     }
     else if (packet_type == NET_PACKET_TYPE_QUERY)
     {
+        // Describe the session a new client would join.
+
+        if (client == NULL)
+        {
+            sv = NET_SV_OpenSession(NULL);
+        }
+
         NET_SV_SendQueryResponse(addr);
     }
     else if (client == NULL)
@@ -1456,56 +2185,55 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
 }
 
 
-static void NET_SV_PumpSendQueue(net_client_t *client)
+static boolean NET_SV_PumpSendQueue(net_client_t *client)
 {
     net_full_ticcmd_t cmd;
     int recv_index;
     int num_players;
     int i;
-    int starttic, endtic;
 
     // If a client has not sent any acknowledgments for a while,
     // wait until they catch up.
 
     if (client->sendseq - NET_SV_LatestAcknowledged() > 40)
     {
-        return;
+        return false;
     }
     
     // Work out the index into the receive window
    
-    recv_index = client->sendseq - recvwindow_start;
+    recv_index = client->sendseq - sv->recvwindow_start;
 
     if (recv_index < 0 || recv_index >= BACKUPTICS)
     {
-        return;
+        return false;
     }
 
     // Check if we can generate a new entry for the send queue
-    // using the data in recvwindow.
+    // using the data in sv->recvwindow.
 
     num_players = 0;
 
     for (i=0; i<NET_MAXPLAYERS; ++i)
     {
-        if (sv_players[i] == client)
+        if (sv->players[i] == client)
         {
             // Client does not rely on itself for data
 
             continue;
         }
 
-        if (sv_players[i] == NULL || !ClientConnected(sv_players[i]))
+        if (sv->players[i] == NULL || !ClientConnected(sv->players[i]))
         {
             continue;
         }
 
-        if (!recvwindow[recv_index][i].active)
+        if (!sv->recvwindow[recv_index][i].active)
         {
             // We do not have this player's ticcmd, so we cannot
             // generate a complete command yet.
 
-            return;
+            return false;
         }
 
         ++num_players;
@@ -1517,9 +2245,9 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     // and never stopping. Don't let the server get too far ahead
     // of the client.
 
-    if (num_players == 0 && client->sendseq > recvwindow_start + 10)
+    if (num_players == 0 && client->sendseq > sv->recvwindow_start + 10)
     {
-        return;
+        return false;
     }
 
     //printf("SV: have complete ticcmd for %i\n", client->sendseq);
@@ -1536,7 +2264,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     {
         net_client_recv_t *recvobj;
 
-        if (sv_players[i] == client)
+        if (sv->players[i] == client)
         {
             // Not the player we are sending to
 
@@ -1544,7 +2272,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
             continue;
         }
         
-        if (sv_players[i] == NULL || !recvwindow[recv_index][i].active)
+        if (sv->players[i] == NULL || !sv->recvwindow[recv_index][i].active)
         {
             cmd.playeringame[i] = false;
             continue;
@@ -1552,7 +2280,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
         cmd.playeringame[i] = true;
 
-        recvobj = &recvwindow[recv_index][i];
+        recvobj = &sv->recvwindow[recv_index][i];
 
         cmd.cmds[i] = recvobj->diff;
 
@@ -1565,18 +2293,60 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     // Add into the queue
 
     client->sendqueue[client->sendseq % BACKUPTICS] = cmd;
+    client->sendtime[client->sendseq % BACKUPTICS] = I_GetTimeMS();
+    client->sendresent[client->sendseq % BACKUPTICS] = false;
+
+    ++client->sendseq;
+
+    return true;
+}
 
-    // Transmit the new tic to the client
+// Queue the next tic of the history for a spectator, once it is old
+// enough and the spectator is keeping up with its acknowledgments.
 
-    starttic = client->sendseq - sv_settings.extratics;
-    endtic = client->sendseq;
+static boolean NET_SV_PumpSpectator(net_client_t *client)
+{
+    unsigned int index;
+    unsigned int nowtime;
 
-    if (starttic < 0)
-        starttic = 0;
+    if (client->sendseq >= sv->history_end
+     || client->sendseq - client->acknowledged > MAX_SPECTATOR_TICS)
+    {
+        return false;
+    }
 
-    NET_SV_SendTics(client, starttic, endtic);
+    index = client->sendseq % sv->history_size;
+    nowtime = I_GetTimeMS();
+
+    if (nowtime - sv->history_time[index] < (unsigned int) spectator_delay)
+    {
+        return false;
+    }
+
+    client->sendqueue[client->sendseq % BACKUPTICS] = sv->history[index];
+    client->sendtime[client->sendseq % BACKUPTICS] = nowtime;
+    client->sendresent[client->sendseq % BACKUPTICS] = false;
 
     ++client->sendseq;
+
+    return true;
+}
+
+// Transmit newly generated tics to the client, along with the
+// extratics before them and any more the loss on the link calls for.
+
+static void NET_SV_SendNewTics(net_client_t *client,
+                               unsigned int first, unsigned int last)
+{
+    int starttic;
+
+    starttic = first - NET_Link_ExtraTics(&client->link,
+                                          sv->settings.extratics);
+
+    if (starttic < 0)
+        starttic = 0;
+
+    NET_SV_SendTics(client, starttic, last);
 }
 
 // Prevent against deadlock: resend requests are usually only
@@ -1609,20 +2379,26 @@ void NET_SV_CheckDeadlock(net_client_t *client)
 
         for (i=0; i<BACKUPTICS; ++i)
         {
-            if (!recvwindow[client->player_number][i].active)
+            if (!sv->recvwindow[i][client->player_number].active)
             {
                 //printf("Possible deadlock: Sending resend request\n");
 
                 // Found a tic we haven't received.  Send a resend request.
 
-                NET_SV_SendResendRequest(client,
-                                         recvwindow_start + i,
-                                         recvwindow_start + i + 5);
+                ++sv->stats.deadlocks;
+                ++client->deadlocks;
 
-                client->last_gamedata_time = nowtime;
+                NET_SV_SendResendRequest(client,
+                                         sv->recvwindow_start + i,
+                                         sv->recvwindow_start + i + 5);
                 break;
             }
         }
+
+        // Check again in another second, whether or not a request
+        // was sent.
+
+        client->last_gamedata_time = nowtime;
     }
 }
 
@@ -1633,14 +2409,25 @@ static void NET_SV_GameEnded(void)
 {
     int i;
 
-    server_state = SERVER_WAITING_LAUNCH;
-    sv_gamemode = indetermined;
+    NET_SV_EndDemo();
+    NET_SV_ForgetSpectatorPacket();
+
+    // A relay stays set to the game of the upstream server.
+
+    if (!sv->relay)
+    {
+        sv->gamemode = indetermined;
+    }
+
+    sv->state = SERVER_WAITING_LAUNCH;
+    sv->relay_started = false;
+    sv->relay_ended = false;
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (clients[i].active)
+        if (sv->clients[i].active)
         {
-            NET_SV_DisconnectClient(&clients[i]);
+            NET_SV_DisconnectClient(&sv->clients[i]);
         }
     }
 }
@@ -1664,12 +2451,13 @@ static void NET_SV_RunClient(net_client_t *client)
 
     if (client->connection.state == NET_CONN_STATE_DISCONNECTED)
     {
+        NET_SV_UnhashClient(client);
         client->active = false;
 
         // If we were about to start a game, any player disconnecting
         // should cause an abort.
 
-        if (server_state == SERVER_WAITING_START && !client->drone)
+        if (sv->state == SERVER_WAITING_START && !client->drone)
         {
             NET_SV_BroadcastMessage("Game startup aborted because "
                                     "player '%s' disconnected.",
@@ -1683,9 +2471,11 @@ static void NET_SV_RunClient(net_client_t *client)
         // Are there any clients left connected?  If not, return the
         // server to the waiting-for-players state.
         //
-	// Disconnect any drones still connected.
+	// Disconnect any drones still connected.  A game in progress
+	// ends in NET_SV_RunSession, once the spectators have seen it.
 
-        if (NET_SV_NumPlayers() <= 0)
+        if (!sv->relay && sv->state != SERVER_IN_GAME
+         && NET_SV_NumPlayers() <= 0)
         {
             NET_SV_GameEnded();
         }
@@ -1698,7 +2488,7 @@ static void NET_SV_RunClient(net_client_t *client)
         return;
     }
 
-    if (server_state == SERVER_WAITING_LAUNCH)
+    if (sv->state == SERVER_WAITING_LAUNCH)
     {
         // Waiting for the game to start
 
@@ -1712,13 +2502,62 @@ static void NET_SV_RunClient(net_client_t *client)
         }
     }
 
-    if (server_state == SERVER_IN_GAME)
+    if (sv->state == SERVER_IN_GAME)
     {
-        NET_SV_PumpSendQueue(client);
+        // Send every tic that is complete now, rather than one per run:
+        // the server may not run again until the next packet arrives.
+        // Clients using packed tics get them in batches, other clients
+        // one packet per tic.
+
+        unsigned int first = client->sendseq;
+
+        // A spectator too far behind to be sent the game from the
+        // history any more is dropped.
+
+        if (client->drone
+         && sv->history_end - client->sendseq > sv->history_size)
+        {
+            NET_SV_BroadcastMessage("Spectator '%s' fell behind the game "
+                                    "and was disconnected", client->name);
+            NET_SV_DisconnectClient(client);
+            return;
+        }
+
+        while (client->drone ? NET_SV_PumpSpectator(client)
+                             : NET_SV_PumpSendQueue(client))
+        {
+            if (!client->packed_tics
+             || client->sendseq - first >= MAX_BATCH_TICS)
+            {
+                NET_SV_SendNewTics(client, first, client->sendseq - 1);
+                first = client->sendseq;
+            }
+        }
+
+        if (client->sendseq != first)
+        {
+            NET_SV_SendNewTics(client, first, client->sendseq - 1);
+        }
+
         NET_SV_CheckDeadlock(client);
     }
 }
 
+// Returns true when the game in progress is over: all the players
+// have left, or the upstream game of a relay has ended.
+
+static boolean NET_SV_GameOver(void)
+{
+    if (sv->relay)
+    {
+        return sv->relay_ended;
+    }
+    else
+    {
+        return NET_SV_NumPlayers() <= 0;
+    }
+}
+
 // Add a network module to the server context
 
 void NET_SV_AddModule(net_module_t *module)
@@ -1737,23 +2576,518 @@ void NET_SV_Init(void)
 
     server_context = NET_NewContext();
 
-    // no clients yet
-   
-    for (i=0; i<MAXNETNODES; ++i) 
+    // no sessions or clients yet
+
+    for (i=0; i<num_sessions; ++i)
     {
-        clients[i].active = false;
+        sv = sessions[i];
+        NET_SV_ForgetSpectatorPacket();
+        free(sv->history);
+        free(sv->history_time);
+        free(sessions[i]);
     }
 
-    NET_SV_AssignPlayers();
+    num_sessions = 0;
+    memset(client_hash, 0, sizeof(client_hash));
 
-    server_state = SERVER_WAITING_LAUNCH;
-    sv_gamemode = indetermined;
+    sv = NET_SV_NewSession();
     server_initialized = true;
 }
 
-static void UpdateMasterServer(void)
+void NET_SV_ConfigureSessions(int sessions_limit, int stats_secs)
 {
-    unsigned int now;
+    max_sessions = sessions_limit < 1 ? 1 : sessions_limit;
+    stats_period = stats_secs < 0 ? 0 : stats_secs;
+}
+
+void NET_SV_WriteMetricsTo(char *filename)
+{
+    metrics_file = filename;
+    metrics_time = I_GetTimeMS();
+}
+
+void NET_SV_ConfigureSpectators(int delay_secs, char *demo_name)
+{
+    spectator_delay = delay_secs < 0 ? 0 : delay_secs * 1000;
+    record_name = demo_name;
+}
+
+// Relay the games of another server to spectators, rather than
+// hosting games.
+
+void NET_SV_RelayFrom(char *address)
+{
+    relay_server = NET_ResolveAddress(server_context, address);
+
+    if (relay_server == NULL)
+    {
+        I_Error("Не удалось разрешить адрес сервера '%s'", address);
+    }
+
+    max_sessions = 1;
+    sessions[0]->relay = true;
+
+    NET_Relay_Init(relay_server);
+}
+
+// The relay is connecting to the upstream server, which is waiting
+// for players of the given game.
+
+void NET_SV_RelayGame(unsigned int gamemode, unsigned int gamemission)
+{
+    sessions[0]->gamemode = gamemode;
+    sessions[0]->gamemission = gamemission;
+}
+
+void NET_SV_RelayWaitData(net_waitdata_t *wait_data)
+{
+    sessions[0]->relay_wait_data = *wait_data;
+}
+
+// The upstream game has been launched: launch it for the spectators.
+
+void NET_SV_RelayLaunch(int num_players)
+{
+    net_packet_t *launchpacket;
+    int i;
+
+    sv = sessions[0];
+
+    if (sv->state != SERVER_WAITING_LAUNCH)
+    {
+        return;
+    }
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        if (!ClientConnected(&sv->clients[i]))
+            continue;
+
+        launchpacket = NET_Conn_NewReliable(&sv->clients[i].connection,
+                                            NET_PACKET_TYPE_LAUNCH);
+        NET_WriteInt8(launchpacket, num_players);
+    }
+
+    sv->state = SERVER_WAITING_START;
+}
+
+// The upstream game has started with the given settings.
+
+void NET_SV_RelayStart(net_gamesettings_t *settings)
+{
+    sv = sessions[0];
+
+    if (sv->state != SERVER_WAITING_START)
+    {
+        return;
+    }
+
+    sv->settings = *settings;
+    sv->relay_started = true;
+
+    CheckStartGame();
+}
+
+// Next tic of the upstream game, in order.
+
+void NET_SV_RelayTic(net_full_ticcmd_t *cmd)
+{
+    sv = sessions[0];
+
+    if (sv->state == SERVER_IN_GAME)
+    {
+        NET_SV_AppendTic(cmd);
+    }
+}
+
+// The upstream game is over, or the connection to it was lost.
+
+void NET_SV_RelayEnd(void)
+{
+    sv = sessions[0];
+
+    if (sv->state == SERVER_IN_GAME)
+    {
+        sv->relay_ended = true;
+    }
+    else if (sv->state == SERVER_WAITING_START)
+    {
+        NET_SV_GameEnded();
+    }
+}
+
+// Print the statistics of every session that has seen any traffic
+// since the last time they were printed.
+
+static void NET_SV_PrintStats(void)
+{
+    net_session_stats_t *stats, *last;
+    unsigned int nowtime;
+    unsigned int elapsed;
+    unsigned int latency_samples;
+    int latency;
+    int i;
+
+    nowtime = I_GetTimeMS();
+
+    for (i=0; i<num_sessions; ++i)
+    {
+        sv = sessions[i];
+        elapsed = nowtime - sv->last_stats_time;
+
+        if (elapsed < (unsigned int) stats_period * 1000)
+        {
+            continue;
+        }
+
+        stats = &sv->stats;
+        last = &sv->last_stats;
+
+        if (stats->packets_received != last->packets_received)
+        {
+            latency_samples = stats->latency_samples - last->latency_samples;
+
+            if (latency_samples > 0)
+            {
+                latency = (stats->latency_total - last->latency_total)
+                        / latency_samples;
+            }
+            else
+            {
+                latency = 0;
+            }
+
+            if (sv->state == SERVER_WAITING_LAUNCH)
+            {
+                NET_SV_AssignPlayers();
+            }
+
+            printf("SV: session %i: %s, %i players, %i drones, "
+                   "%.1f packets/s in, %.1f gamedata/s out, "
+                   "%.1f resend requests/s, %.1f tics resent/s, "
+                   "latency %i ms\n",
+                   sv->id,
+                   sv->state == SERVER_IN_GAME ? "in game" : "waiting",
+                   NET_SV_NumPlayers(), NET_SV_NumDrones(),
+                   (stats->packets_received - last->packets_received)
+                       * 1000.0 / elapsed,
+                   (stats->gamedata_sent - last->gamedata_sent)
+                       * 1000.0 / elapsed,
+                   (stats->resend_requests - last->resend_requests)
+                       * 1000.0 / elapsed,
+                   (stats->tics_resent - last->tics_resent)
+                       * 1000.0 / elapsed,
+                   latency);
+        }
+
+        sv->last_stats = sv->stats;
+        sv->last_stats_time = nowtime;
+    }
+}
+
+// Metrics of the sessions and their clients, written out in the
+// Prometheus text format.
+
+typedef enum
+{
+    METRIC_IN_GAME,
+    METRIC_CLIENTS,
+    METRIC_PLAYERS,
+    METRIC_DRONES,
+    METRIC_TIC_RATE,
+    METRIC_TICS,
+    METRIC_PACKETS_RECEIVED,
+    METRIC_GAMEDATA_SENT,
+    METRIC_RESEND_REQUESTS,
+    METRIC_TICS_RESENT,
+    METRIC_DEADLOCKS,
+    NUM_SESSION_METRICS
+} session_metric_t;
+
+typedef enum
+{
+    METRIC_CLIENT_RTT,
+    METRIC_CLIENT_LOSS,
+    METRIC_CLIENT_SEND_QUEUE,
+    METRIC_CLIENT_RESEND_REQUESTS,
+    METRIC_CLIENT_DEADLOCKS,
+    NUM_CLIENT_METRICS
+} client_metric_t;
+
+typedef struct
+{
+    char *name;
+    char *type;
+    char *help;
+} metric_t;
+
+static metric_t session_metrics[NUM_SESSION_METRICS] =
+{
+    { "in_game", "gauge", "Whether the game is in progress." },
+    { "clients", "gauge", "Connected clients." },
+    { "players", "gauge", "Connected players." },
+    { "drones", "gauge", "Connected spectators." },
+    { "tic_rate", "gauge", "Tics per second the game is advancing." },
+    { "tics_total", "counter", "Tics the game has advanced." },
+    { "packets_received_total", "counter", "Packets received." },
+    { "gamedata_sent_total", "counter", "Game data packets sent." },
+    { "resend_requests_total", "counter",
+      "Resend requests sent to players." },
+    { "tics_resent_total", "counter",
+      "Tics resent on request." },
+    { "deadlocks_total", "counter",
+      "Resend requests sent to players who sent nothing for a second." },
+};
+
+static metric_t client_metrics[NUM_CLIENT_METRICS] =
+{
+    { "rtt_ms", "gauge", "Smoothed round trip time of game data." },
+    { "loss_ratio", "gauge", "Smoothed fraction of game data lost." },
+    { "send_queue", "gauge", "Tics sent and not yet acknowledged." },
+    { "resend_requests_total", "counter",
+      "Resend requests sent to the client." },
+    { "deadlocks_total", "counter",
+      "Resend requests sent because the client sent nothing for a second." },
+};
+
+static double NET_SV_SessionMetric(session_metric_t metric,
+                                   unsigned int elapsed)
+{
+    switch (metric)
+    {
+        case METRIC_IN_GAME:
+            return sv->state == SERVER_IN_GAME;
+        case METRIC_CLIENTS:
+            return NET_SV_NumClients();
+        case METRIC_PLAYERS:
+            return NET_SV_NumPlayers();
+        case METRIC_DRONES:
+            return NET_SV_NumDrones();
+        case METRIC_TIC_RATE:
+            return (sv->stats.tics - sv->metrics_tics) * 1000.0 / elapsed;
+        case METRIC_TICS:
+            return sv->stats.tics;
+        case METRIC_PACKETS_RECEIVED:
+            return sv->stats.packets_received;
+        case METRIC_GAMEDATA_SENT:
+            return sv->stats.gamedata_sent;
+        case METRIC_RESEND_REQUESTS:
+            return sv->stats.resend_requests;
+        case METRIC_TICS_RESENT:
+            return sv->stats.tics_resent;
+        case METRIC_DEADLOCKS:
+            return sv->stats.deadlocks;
+        default:
+            return 0;
+    }
+}
+
+// Returns false if the client has no value for the metric (yet).
+
+static boolean NET_SV_ClientMetric(net_client_t *client,
+                                   client_metric_t metric, double *value)
+{
+    switch (metric)
+    {
+        case METRIC_CLIENT_RTT:
+            *value = client->link.srtt;
+            return client->link.measured;
+        case METRIC_CLIENT_LOSS:
+            *value = (double) client->link.loss / NET_LINK_LOSS_ONE;
+            return client->link.measured;
+        case METRIC_CLIENT_SEND_QUEUE:
+            *value = client->sendseq - client->acknowledged;
+            return sv->state == SERVER_IN_GAME;
+        case METRIC_CLIENT_RESEND_REQUESTS:
+            *value = client->resend_requests;
+            return true;
+        case METRIC_CLIENT_DEADLOCKS:
+            *value = client->deadlocks;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Write a label value, escaped as the text format requires; player
+// names come from the clients.
+
+static void WriteLabelValue(FILE *stream, char *value)
+{
+    for (; *value != '\0'; ++value)
+    {
+        if (*value == '\\' || *value == '"')
+        {
+            fputc('\\', stream);
+            fputc(*value, stream);
+        }
+        else if (*value == '\n')
+        {
+            fputs("\\n", stream);
+        }
+        else
+        {
+            fputc(*value, stream);
+        }
+    }
+}
+
+// Write a sample value.  Counters are whole numbers that grow without
+// bound, and are written in full so that rates taken from them stay
+// exact; gauges are written with all the precision of a double.
+
+static void WriteMetricValue(FILE *stream, metric_t *metric, double value)
+{
+    if (!strcmp(metric->type, "counter"))
+    {
+        fprintf(stream, " %u\n", (unsigned int) value);
+    }
+    else
+    {
+        fprintf(stream, " %.17g\n", value);
+    }
+}
+
+// Write all metrics to a temporary file and rename it over the old
+// one, so that a scraper never sees a partly written file.  The file
+// is small, and nothing here waits on anything but the local disk.
+
+static void NET_SV_WriteMetrics(void)
+{
+    char tempfile[256];
+    char addr_str[128];
+    FILE *stream;
+    net_client_t *client;
+    unsigned int nowtime;
+    unsigned int elapsed;
+    double value;
+    int m, i, j;
+
+    nowtime = I_GetTimeMS();
+    elapsed = nowtime - metrics_time;
+
+    if (elapsed == 0)
+    {
+        elapsed = 1;
+    }
+
+    for (i=0; i<num_sessions; ++i)
+    {
+        sv = sessions[i];
+
+        if (sv->state == SERVER_WAITING_LAUNCH)
+        {
+            NET_SV_AssignPlayers();
+        }
+    }
+
+    M_snprintf(tempfile, sizeof(tempfile), "%s.tmp", metrics_file);
+
+    stream = fopen(tempfile, "w");
+
+    if (stream == NULL)
+    {
+        return;
+    }
+
+    fprintf(stream, "# HELP doom_server_sessions Games being hosted.\n"
+                    "# TYPE doom_server_sessions gauge\n"
+                    "doom_server_sessions %i\n", num_sessions);
+
+    for (m=0; m<NUM_SESSION_METRICS; ++m)
+    {
+        fprintf(stream, "# HELP doom_server_session_%s %s\n"
+                        "# TYPE doom_server_session_%s %s\n",
+                session_metrics[m].name, session_metrics[m].help,
+                session_metrics[m].name, session_metrics[m].type);
+
+        for (i=0; i<num_sessions; ++i)
+        {
+            sv = sessions[i];
+            fprintf(stream, "doom_server_session_%s{session=\"%i\"}",
+                    session_metrics[m].name, sv->id);
+            WriteMetricValue(stream, &session_metrics[m],
+                             NET_SV_SessionMetric(m, elapsed));
+        }
+    }
+
+    for (m=0; m<NUM_CLIENT_METRICS; ++m)
+    {
+        fprintf(stream, "# HELP doom_server_client_%s %s\n"
+                        "# TYPE doom_server_client_%s %s\n",
+                client_metrics[m].name, client_metrics[m].help,
+                client_metrics[m].name, client_metrics[m].type);
+
+        for (i=0; i<num_sessions; ++i)
+        {
+            sv = sessions[i];
+
+            for (j=0; j<MAXNETNODES; ++j)
+            {
+                client = &sv->clients[j];
+
+                if (!ClientConnected(client)
+                 || !NET_SV_ClientMetric(client, m, &value))
+                {
+                    continue;
+                }
+
+                fprintf(stream, "doom_server_client_%s{session=\"%i\","
+                                "player=\"%i\",name=\"",
+                        client_metrics[m].name, sv->id,
+                        client->player_number);
+                WriteLabelValue(stream, client->name);
+                fprintf(stream, "\",address=\"");
+                NET_AddrToStringBuffer(client->addr, addr_str,
+                                       sizeof(addr_str));
+                WriteLabelValue(stream, addr_str);
+                fprintf(stream, "\"}");
+                WriteMetricValue(stream, &client_metrics[m], value);
+            }
+        }
+    }
+
+    // If anything could not be written (a full disk, say), keep the
+    // old file rather than replacing it with a truncated one, and keep
+    // the rates running from the last good write.
+
+    if (ferror(stream))
+    {
+        fclose(stream);
+        remove(tempfile);
+        return;
+    }
+
+    if (fclose(stream) != 0)
+    {
+        remove(tempfile);
+        return;
+    }
+
+    // rename() replaces the old file in one step on POSIX systems, but
+    // fails on Windows if it exists.
+
+#ifdef _WIN32
+    remove(metrics_file);
+#endif
+
+    if (rename(tempfile, metrics_file) != 0)
+    {
+        remove(tempfile);
+        return;
+    }
+
+    for (i=0; i<num_sessions; ++i)
+    {
+        sessions[i]->metrics_tics = sessions[i]->stats.tics;
+    }
+
+    metrics_time = nowtime;
+}
+
+static void UpdateMasterServer(void)
+{
+    unsigned int now;
 
     now = I_GetTimeMS();
 
@@ -1814,20 +3148,61 @@ void NET_SV_RegisterWithMaster(void)
     }
 }
 
+// Run the clients of the current session
+
+static void NET_SV_RunSession(void)
+{
+    int i;
+
+    // "Run" any clients that may have things to do, independent of responses
+    // to received packets
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        if (sv->clients[i].active)
+        {
+            NET_SV_RunClient(&sv->clients[i]);
+        }
+    }
+
+    switch (sv->state)
+    {
+        case SERVER_WAITING_LAUNCH:
+            break;
+
+        case SERVER_WAITING_START:
+            CheckStartGame();
+            break;
+
+        case SERVER_IN_GAME:
+            if (NET_SV_GameOver() && !NET_SV_SpectatorsPending())
+            {
+                NET_SV_GameEnded();
+                break;
+            }
+
+            NET_SV_AdvanceWindow();
+
+            for (i = 0; i < NET_MAXPLAYERS; ++i)
+            {
+                if (sv->players[i] != NULL && ClientConnected(sv->players[i]))
+                {
+                    NET_SV_CheckResends(sv->players[i]);
+                }
+            }
+            break;
+    }
+}
+
 // Run server code to check for new packets/send packets as the server
 // requires
 
-void NET_SV_Run(void)
+static void NET_SV_RunServer(void)
 {
     net_addr_t *addr;
     net_packet_t *packet;
     int i;
 
-    if (!server_initialized)
-    {
-        return;
-    }
-
     while (NET_RecvPacket(server_context, &addr, &packet))
     {
         NET_SV_Packet(packet, addr);
@@ -1839,43 +3214,281 @@ void NET_SV_Run(void)
         UpdateMasterServer();
     }
 
-    // "Run" any clients that may have things to do, independent of responses
-    // to received packets
+    if (relay_server != NULL)
+    {
+        NET_Relay_Run();
+    }
+
+    for (i=0; i<num_sessions; ++i)
+    {
+        sv = sessions[i];
+        NET_SV_RunSession();
+    }
+
+    if (stats_period > 0)
+    {
+        NET_SV_PrintStats();
+    }
+
+    if (metrics_file != NULL
+     && I_GetTimeMS() - metrics_time >= METRICS_PERIOD * 1000)
+    {
+        NET_SV_WriteMetrics();
+    }
+
+    // Send everything that was queued up while running the clients.
+
+    NET_FlushPackets(server_context);
+}
+
+void NET_SV_Run(void)
+{
+    // Nothing to do here if the server thread is running it, unless it
+    // has stopped with an error.
+
+    if (server_thread != NULL
+     && SDL_AtomicAdd(&server_thread_failed, 0) != 0)
+    {
+        SDL_WaitThread(server_thread, NULL);
+        server_thread = NULL;
+
+        I_Error("%s", server_thread_error);
+    }
+
+    if (!server_initialized || server_thread != NULL)
+    {
+        return;
+    }
+
+    NET_SV_RunServer();
+}
+
+// Returns the time in ms until the earlier of a and b, where -1 means
+// no deadline.
+
+static int EarliestEvent(int a, int b)
+{
+    if (a < 0)
+    {
+        return b;
+    }
+    else if (b < 0 || a < b)
+    {
+        return a;
+    }
+    else
+    {
+        return b;
+    }
+}
+
+// Time until something in the current session next needs to be done
+// without a packet arriving first: resend requests and deadlock checks
+// (see NET_SV_CheckResends and NET_SV_CheckDeadlock), waiting data,
+// and the keepalives and retries of the connections.
+
+static int NET_SV_SessionNextEvent(unsigned int nowtime)
+{
+    net_client_t *client;
+    net_client_recv_t *recvobj;
+    int result = -1;
+    int i, j;
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (clients[i].active)
+        client = &sv->clients[i];
+
+        if (!client->active)
         {
-            NET_SV_RunClient(&clients[i]);
+            continue;
+        }
+
+        result = EarliestEvent(result,
+            NET_Conn_NextEvent(&client->connection, nowtime));
+
+        if (!ClientConnected(client))
+        {
+            continue;
+        }
+
+        if (sv->state == SERVER_WAITING_LAUNCH)
+        {
+            if (client->last_send_time < 0)
+            {
+                return 0;
+            }
+
+            result = EarliestEvent(result,
+                NET_TimeUntil(client->last_send_time, 1000, nowtime));
+        }
+        else if (sv->state == SERVER_IN_GAME && !client->drone)
+        {
+            result = EarliestEvent(result,
+                NET_TimeUntil(client->last_gamedata_time, 1000, nowtime));
+        }
+        else if (sv->state == SERVER_IN_GAME
+              && client->sendseq < sv->history_end
+              && client->sendseq - client->acknowledged
+                     <= MAX_SPECTATOR_TICS)
+        {
+            result = EarliestEvent(result,
+                NET_TimeUntil(sv->history_time[client->sendseq
+                                               % sv->history_size],
+                              spectator_delay, nowtime));
         }
     }
 
-    switch (server_state)
+    if (sv->state != SERVER_IN_GAME)
     {
-        case SERVER_WAITING_LAUNCH:
-            break;
+        return result;
+    }
 
-        case SERVER_WAITING_START:
-            CheckStartGame();
-            break;
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        if (sv->players[i] == NULL || !ClientConnected(sv->players[i]))
+        {
+            continue;
+        }
 
-        case SERVER_IN_GAME:
-            NET_SV_AdvanceWindow();
+        for (j=0; j<BACKUPTICS; ++j)
+        {
+            recvobj = &sv->recvwindow[j][i];
 
-            for (i = 0; i < NET_MAXPLAYERS; ++i)
+            if (!recvobj->active && recvobj->resend_time != 0)
             {
-                if (sv_players[i] != NULL && ClientConnected(sv_players[i]))
-                {
-                    NET_SV_CheckResends(sv_players[i]);
-                }
+                result = EarliestEvent(result,
+                    NET_TimeUntil(recvobj->resend_time,
+                                  NET_Link_ResendTimeout(&sv->players[i]->link),
+                                  nowtime));
             }
-            break;
+        }
     }
+
+    return result;
 }
 
-void NET_SV_Shutdown(void)
+// Block until a packet arrives or until something needs to be done,
+// for at most max_wait ms.  Used by the dedicated server in place of
+// sleeping between runs.
+
+void NET_SV_WaitForEvent(int max_wait)
 {
+    unsigned int nowtime;
+    int timeout;
     int i;
+
+    if (!server_initialized)
+    {
+        return;
+    }
+
+    nowtime = I_GetTimeMS();
+    timeout = max_wait;
+
+    for (i=0; i<num_sessions && timeout > 0; ++i)
+    {
+        sv = sessions[i];
+        timeout = EarliestEvent(timeout, NET_SV_SessionNextEvent(nowtime));
+    }
+
+    if (relay_server != NULL)
+    {
+        timeout = EarliestEvent(timeout, NET_Relay_NextEvent(nowtime));
+    }
+
+    if (master_server != NULL)
+    {
+        timeout = EarliestEvent(timeout,
+            NET_TimeUntil(master_refresh_time, MASTER_REFRESH_PERIOD * 1000,
+                          nowtime));
+        timeout = EarliestEvent(timeout,
+            NET_TimeUntil(master_resolve_time, MASTER_RESOLVE_PERIOD * 1000,
+                          nowtime));
+    }
+
+    if (metrics_file != NULL)
+    {
+        timeout = EarliestEvent(timeout,
+            NET_TimeUntil(metrics_time, METRICS_PERIOD * 1000 - 1, nowtime));
+    }
+
+    if (stats_period > 0)
+    {
+        for (i=0; i<num_sessions; ++i)
+        {
+            timeout = EarliestEvent(timeout,
+                NET_TimeUntil(sessions[i]->last_stats_time,
+                              stats_period * 1000 - 1, nowtime));
+        }
+    }
+
+    NET_WaitForPacket(server_context, timeout);
+}
+
+static void ServerThreadError(char *msg)
+{
+    M_StringCopy(server_thread_error, msg, sizeof(server_thread_error));
+    longjmp(server_thread_error_jmp, 1);
+}
+
+static int ServerThread(void *unused)
+{
+    I_SetThreadErrorHandler(ServerThreadError);
+
+    if (setjmp(server_thread_error_jmp) != 0)
+    {
+        I_SetThreadErrorHandler(NULL);
+        SDL_AtomicSet(&server_thread_failed, 1);
+        return 0;
+    }
+
+    while (SDL_AtomicAdd(&server_thread_stop, 0) == 0)
+    {
+        NET_SV_RunServer();
+        NET_SV_WaitForEvent(SERVER_THREAD_MAX_WAIT);
+    }
+
+    I_SetThreadErrorHandler(NULL);
+
+    return 0;
+}
+
+void NET_SV_StartThread(void)
+{
+    if (!server_initialized || server_thread != NULL)
+    {
+        return;
+    }
+
+    SDL_AtomicSet(&server_thread_stop, 0);
+    SDL_AtomicSet(&server_thread_failed, 0);
+    server_thread = SDL_CreateThread(ServerThread, "Server thread", NULL);
+
+    // Without a thread the server is just run from the game loop,
+    // as usual.
+
+    if (server_thread == NULL)
+    {
+        fprintf(stderr, "SV: Failed to start server thread: %s\n",
+                SDL_GetError());
+    }
+}
+
+static void NET_SV_StopThread(void)
+{
+    if (server_thread == NULL)
+    {
+        return;
+    }
+
+    SDL_AtomicSet(&server_thread_stop, 1);
+    SDL_WaitThread(server_thread, NULL);
+    server_thread = NULL;
+}
+
+void NET_SV_Shutdown(void)
+{
+    int i, s;
     boolean running;
     int start_time;
 
@@ -1883,16 +3496,27 @@ void NET_SV_Shutdown(void)
     {
         return;
     }
-    
+
+    // Take the server back, so that the clients are disconnected
+    // from here below.
+
+    NET_SV_StopThread();
+
     fprintf(stderr, "SV: Shutting down server...\n");
 
     // Disconnect all clients
     
-    for (i=0; i<MAXNETNODES; ++i)
+    for (s=0; s<num_sessions; ++s)
     {
-        if (clients[i].active)
+        sv = sessions[s];
+        NET_SV_EndDemo();
+
+        for (i=0; i<MAXNETNODES; ++i)
         {
-            NET_SV_DisconnectClient(&clients[i]);
+            if (sessions[s]->clients[i].active)
+            {
+                NET_SV_DisconnectClient(&sessions[s]->clients[i]);
+            }
         }
     }
 
@@ -1907,11 +3531,14 @@ void NET_SV_Shutdown(void)
 
         running = false;
 
-        for (i=0; i<MAXNETNODES; ++i)
+        for (s=0; s<num_sessions; ++s)
         {
-            if (clients[i].active)
+            for (i=0; i<MAXNETNODES; ++i)
             {
-                running = true;
+                if (sessions[s]->clients[i].active)
+                {
+                    running = true;
+                }
             }
         }
 
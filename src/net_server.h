@@ -28,11 +28,49 @@ void NET_SV_Init(void);
 
 void NET_SV_Run(void);
 
+// Wait until a packet arrives or the server has something to do,
+// for at most max_wait ms
+
+void NET_SV_WaitForEvent(int max_wait);
+
+// Run the server on a thread of its own from now on, rather than from
+// NET_SV_Run; for a server hosted by the game
+
+void NET_SV_StartThread(void);
+
 // Shut down the server
 // Blocks until all clients disconnect, or until a 5 second timeout
 
 void NET_SV_Shutdown(void);
 
+// Allow up to sessions_limit games to be hosted at once, and print
+// statistics for each of them every stats_secs seconds (0 = never)
+
+void NET_SV_ConfigureSessions(int sessions_limit, int stats_secs);
+
+// Write the metrics of the server to the given file every second,
+// in the Prometheus text format
+
+void NET_SV_WriteMetricsTo(char *filename);
+
+// Send the games to spectators delay_secs seconds behind the players,
+// and record each game to a demo named after demo_name (NULL = don't)
+
+void NET_SV_ConfigureSpectators(int delay_secs, char *demo_name);
+
+// Relay the games of the server at the given address to spectators
+
+void NET_SV_RelayFrom(char *address);
+
+// Called by the relay (net_relay.c) as the upstream game progresses
+
+void NET_SV_RelayGame(unsigned int gamemode, unsigned int gamemission);
+void NET_SV_RelayWaitData(net_waitdata_t *wait_data);
+void NET_SV_RelayLaunch(int num_players);
+void NET_SV_RelayStart(net_gamesettings_t *settings);
+void NET_SV_RelayTic(net_full_ticcmd_t *cmd);
+void NET_SV_RelayEnd(void);
+
 // Add a network module to the context used by the server
 
 void NET_SV_AddModule(net_module_t *module);
@@ -0,0 +1,248 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Simulation of packet loss and latency, for testing
+//
+//     Packets received by any module are dropped or held back here
+//     before NET_RecvPacket returns them, so a bad link can be tried
+//     out locally, with any module and on either end.
+//
+
+
+#include <stdlib.h>
+
+#include "SDL_atomic.h"
+
+#include "doomtype.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "net_defs.h"
+#include "net_packet.h"
+#include "net_sim.h"
+
+// Packets held back at once; any more are dropped, as by a router
+// with a full queue.
+
+#define MAX_HELD_PACKETS 256
+
+typedef struct
+{
+    net_context_t *context;
+    net_addr_t *addr;
+    net_packet_t *packet;
+    unsigned int release_time;
+} held_packet_t;
+
+boolean net_sim_active = false;
+
+static boolean initted = false;
+static int loss_percent;
+static int latency;
+static int jitter;
+
+// The server may run on its own thread (see NET_SV_StartThread), so
+// the held packets of both ends are guarded by a lock.
+
+static held_packet_t held[MAX_HELD_PACKETS];
+static int num_held;
+static SDL_SpinLock held_lock;
+
+void NET_SIM_Init(void)
+{
+    int p;
+
+    if (initted)
+    {
+        return;
+    }
+
+    initted = true;
+
+    //!
+    // @arg <percent>
+    // @category net
+    //
+    // Drop the given percentage of received packets, to test play
+    // over a lossy link.
+    //
+
+    p = M_CheckParmWithArgs("-simloss", 1);
+
+    if (p > 0)
+    {
+        loss_percent = atoi(myargv[p + 1]);
+    }
+
+    //!
+    // @arg <ms>
+    // @category net
+    //
+    // Hold back every received packet for the given time, to test
+    // play over a slow link.
+    //
+
+    p = M_CheckParmWithArgs("-simlatency", 1);
+
+    if (p > 0)
+    {
+        latency = atoi(myargv[p + 1]);
+    }
+
+    //!
+    // @arg <ms>
+    // @category net
+    //
+    // Hold back each received packet for a random extra time of up to
+    // the given value, which also reorders packets.
+    //
+
+    p = M_CheckParmWithArgs("-simjitter", 1);
+
+    if (p > 0)
+    {
+        jitter = atoi(myargv[p + 1]);
+    }
+
+    net_sim_active = loss_percent > 0 || latency > 0 || jitter > 0;
+}
+
+// Called for each packet a module receives.  Returns false if the
+// packet should be delivered now, or true if it has been dropped or
+// held back.  Addresses of dropped packets are left to the module,
+// which keeps them like those of any other packet.
+
+boolean NET_SIM_Hold(net_context_t *context, net_addr_t *addr,
+                     net_packet_t *packet)
+{
+    held_packet_t *h;
+
+    if (loss_percent > 0 && rand() % 100 < loss_percent)
+    {
+        NET_FreePacket(packet);
+        return true;
+    }
+
+    if (latency <= 0 && jitter <= 0)
+    {
+        return false;
+    }
+
+    SDL_AtomicLock(&held_lock);
+
+    if (num_held >= MAX_HELD_PACKETS)
+    {
+        SDL_AtomicUnlock(&held_lock);
+        NET_FreePacket(packet);
+        return true;
+    }
+
+    h = &held[num_held];
+    ++num_held;
+
+    h->context = context;
+    h->addr = addr;
+    h->packet = packet;
+    h->release_time = I_GetTimeMS() + latency;
+
+    if (jitter > 0)
+    {
+        h->release_time += rand() % (jitter + 1);
+    }
+
+    SDL_AtomicUnlock(&held_lock);
+
+    return true;
+}
+
+// Return the held packet for the given context that is due soonest,
+// if it is due now.
+
+boolean NET_SIM_Release(net_context_t *context, net_addr_t **addr,
+                        net_packet_t **packet)
+{
+    unsigned int nowtime;
+    int best;
+    int i;
+
+    nowtime = I_GetTimeMS();
+    best = -1;
+
+    SDL_AtomicLock(&held_lock);
+
+    for (i = 0; i < num_held; ++i)
+    {
+        if (held[i].context == context
+         && (int) (nowtime - held[i].release_time) >= 0
+         && (best < 0
+          || (int) (held[i].release_time - held[best].release_time) < 0))
+        {
+            best = i;
+        }
+    }
+
+    if (best < 0)
+    {
+        SDL_AtomicUnlock(&held_lock);
+        return false;
+    }
+
+    *addr = held[best].addr;
+    *packet = held[best].packet;
+
+    --num_held;
+    held[best] = held[num_held];
+
+    SDL_AtomicUnlock(&held_lock);
+
+    return true;
+}
+
+// Shorten a wait for packets so that it ends when the next held packet
+// for the context is due.
+
+int NET_SIM_NextRelease(net_context_t *context, int timeout)
+{
+    unsigned int nowtime;
+    int remaining;
+    int i;
+
+    nowtime = I_GetTimeMS();
+
+    SDL_AtomicLock(&held_lock);
+
+    for (i = 0; i < num_held; ++i)
+    {
+        if (held[i].context != context)
+        {
+            continue;
+        }
+
+        remaining = (int) (held[i].release_time - nowtime);
+
+        if (remaining < 0)
+        {
+            remaining = 0;
+        }
+
+        if (remaining < timeout)
+        {
+            timeout = remaining;
+        }
+    }
+
+    SDL_AtomicUnlock(&held_lock);
+
+    return timeout;
+}
+
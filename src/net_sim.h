@@ -0,0 +1,34 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Simulation of packet loss and latency, for testing
+//
+
+
+#ifndef NET_SIM_H
+#define NET_SIM_H
+
+#include "net_defs.h"
+
+extern boolean net_sim_active;
+
+void NET_SIM_Init(void);
+boolean NET_SIM_Hold(net_context_t *context, net_addr_t *addr,
+                     net_packet_t *packet);
+boolean NET_SIM_Release(net_context_t *context, net_addr_t **addr,
+                        net_packet_t **packet);
+int NET_SIM_NextRelease(net_context_t *context, int timeout);
+
+#endif /* #ifndef NET_SIM_H */
+
@@ -23,6 +23,8 @@
 #include <ctype.h>
 
 #include "doomtype.h"
+#include "i_system.h"
+#include "i_timer.h"
 #include "m_misc.h"
 #include "net_packet.h"
 #include "net_structrw.h"
@@ -38,6 +40,7 @@ void NET_WriteConnectData(net_packet_t *packet, net_connect_data_t *data)
     NET_WriteSHA1Sum(packet, data->wad_sha1sum);
     NET_WriteSHA1Sum(packet, data->deh_sha1sum);
     NET_WriteInt8(packet, data->player_class);
+    NET_WriteInt8(packet, data->packed_tics);
 }
 
 boolean NET_ReadConnectData(net_packet_t *packet, net_connect_data_t *data)
@@ -50,7 +53,8 @@ boolean NET_ReadConnectData(net_packet_t *packet, net_connect_data_t *data)
         && NET_ReadInt8(packet, (unsigned int *) &data->is_freedoom)
         && NET_ReadSHA1Sum(packet, data->wad_sha1sum)
         && NET_ReadSHA1Sum(packet, data->deh_sha1sum)
-        && NET_ReadInt8(packet, (unsigned int *) &data->player_class);
+        && NET_ReadInt8(packet, (unsigned int *) &data->player_class)
+        && NET_ReadInt8(packet, (unsigned int *) &data->packed_tics);
 }
 
 void NET_WriteSettings(net_packet_t *packet, net_gamesettings_t *settings)
@@ -72,6 +76,7 @@ void NET_WriteSettings(net_packet_t *packet, net_gamesettings_t *settings)
     NET_WriteInt32(packet, settings->timelimit);
     NET_WriteInt8(packet, settings->loadgame);
     NET_WriteInt8(packet, settings->random);
+    NET_WriteInt8(packet, settings->packed_tics);
     NET_WriteInt8(packet, settings->num_players);
     NET_WriteInt8(packet, settings->consoleplayer);
 
@@ -101,6 +106,7 @@ boolean NET_ReadSettings(net_packet_t *packet, net_gamesettings_t *settings)
            && NET_ReadInt32(packet, (unsigned int *) &settings->timelimit)
            && NET_ReadSInt8(packet, (signed int *) &settings->loadgame)
            && NET_ReadInt8(packet, (unsigned int *) &settings->random)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->packed_tics)
            && NET_ReadInt8(packet, (unsigned int *) &settings->num_players)
            && NET_ReadSInt8(packet, (signed int *) &settings->consoleplayer);
 
@@ -443,6 +449,396 @@ void NET_WriteFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean l
     }
 }
 
+//
+// Packed tic encoding.
+//
+// Used instead of NET_WriteTiccmdDiff/NET_WriteFullTiccmd when both
+// ends agree to it at connect time.  The tics of a packet are written
+// as one bit stream, each tic coded relative to the one before it in
+// the same packet:
+//
+//  * latency: 1 bit if unchanged, else a zigzag varint.
+//  * player bitfield: 1 bit if unchanged, else 8 bits.
+//  * diff flags: 1 bit if the same as this player's previous ones,
+//    else 8 bits.
+//  * angleturn: zigzag varint of the change from this player's last
+//    sent angleturn; mouse turning changes smoothly, so this is mostly
+//    one or two 6-bit groups instead of 16 bits.
+//  * other fields: their natural width in bits.
+//
+// Varints are written in groups of 5 bits, each followed by a
+// continuation bit.
+//
+
+#define VARINT_GROUP_BITS 5
+
+void NET_InitTicPacker(net_ticpacker_t *packer, net_packet_t *packet)
+{
+    memset(packer, 0, sizeof(*packer));
+    packer->packet = packet;
+}
+
+static void PutBits(net_ticpacker_t *packer, unsigned int value, int bits)
+{
+    packer->bitbuf |= (value & ((1U << bits) - 1)) << packer->bitcount;
+    packer->bitcount += bits;
+
+    while (packer->bitcount >= 8)
+    {
+        NET_WriteInt8(packer->packet, packer->bitbuf & 0xff);
+        packer->bitbuf >>= 8;
+        packer->bitcount -= 8;
+    }
+}
+
+static boolean GetBits(net_ticpacker_t *packer, unsigned int *value, int bits)
+{
+    unsigned int b;
+
+    while (packer->bitcount < bits)
+    {
+        if (!NET_ReadInt8(packer->packet, &b))
+        {
+            return false;
+        }
+
+        packer->bitbuf |= b << packer->bitcount;
+        packer->bitcount += 8;
+    }
+
+    *value = packer->bitbuf & ((1U << bits) - 1);
+    packer->bitbuf >>= bits;
+    packer->bitcount -= bits;
+
+    return true;
+}
+
+static void PutVarint(net_ticpacker_t *packer, signed int value)
+{
+    unsigned int zigzag;
+
+    zigzag = value < 0 ? ((unsigned int) -(value + 1) << 1) | 1
+                       : (unsigned int) value << 1;
+
+    while (zigzag >= (1U << VARINT_GROUP_BITS))
+    {
+        PutBits(packer, zigzag | (1U << VARINT_GROUP_BITS),
+                VARINT_GROUP_BITS + 1);
+        zigzag >>= VARINT_GROUP_BITS;
+    }
+
+    PutBits(packer, zigzag, VARINT_GROUP_BITS + 1);
+}
+
+static boolean GetVarint(net_ticpacker_t *packer, signed int *value)
+{
+    unsigned int zigzag = 0;
+    unsigned int group;
+    int shift = 0;
+
+    do
+    {
+        if (shift >= 32 || !GetBits(packer, &group, VARINT_GROUP_BITS + 1))
+        {
+            return false;
+        }
+
+        zigzag |= (group & ((1U << VARINT_GROUP_BITS) - 1)) << shift;
+        shift += VARINT_GROUP_BITS;
+    } while (group & (1U << VARINT_GROUP_BITS));
+
+    *value = (zigzag & 1) ? -(signed int) (zigzag >> 1) - 1
+                          : (signed int) (zigzag >> 1);
+
+    return true;
+}
+
+// Write out any bits still buffered.  Must be called once all tics
+// have been packed.
+
+void NET_FinishTicPacker(net_ticpacker_t *packer)
+{
+    if (packer->bitcount > 0)
+    {
+        NET_WriteInt8(packer->packet, packer->bitbuf & 0xff);
+    }
+
+    packer->bitbuf = 0;
+    packer->bitcount = 0;
+}
+
+static void PackTiccmdDiff(net_ticpacker_t *packer, int player,
+                           net_ticdiff_t *diff, boolean lowres_turn)
+{
+    if (diff->diff == packer->flags[player])
+    {
+        PutBits(packer, 1, 1);
+    }
+    else
+    {
+        PutBits(packer, 0, 1);
+        PutBits(packer, diff->diff, 8);
+        packer->flags[player] = diff->diff;
+    }
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+        PutBits(packer, (byte) diff->cmd.forwardmove, 8);
+    if (diff->diff & NET_TICDIFF_SIDE)
+        PutBits(packer, (byte) diff->cmd.sidemove, 8);
+    if (diff->diff & NET_TICDIFF_TURN)
+    {
+        if (lowres_turn)
+        {
+            PutBits(packer, (byte) (diff->cmd.angleturn / 256), 8);
+        }
+        else
+        {
+            PutVarint(packer, (short) (diff->cmd.angleturn
+                                     - packer->angleturn[player]));
+            packer->angleturn[player] = diff->cmd.angleturn;
+        }
+    }
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+        PutBits(packer, diff->cmd.buttons, 8);
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+        PutBits(packer, diff->cmd.consistancy, 8);
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+        PutBits(packer, diff->cmd.chatchar, 8);
+    if (diff->diff & NET_TICDIFF_RAVEN)
+    {
+        PutBits(packer, diff->cmd.lookfly, 8);
+        PutBits(packer, diff->cmd.arti, 8);
+    }
+    if (diff->diff & NET_TICDIFF_STRIFE)
+    {
+        PutBits(packer, diff->cmd.buttons2, 8);
+        PutBits(packer, diff->cmd.inventory, 16);
+    }
+}
+
+static boolean UnpackTiccmdDiff(net_ticpacker_t *packer, int player,
+                                net_ticdiff_t *diff, boolean lowres_turn)
+{
+    unsigned int val;
+    signed int sval;
+
+    if (!GetBits(packer, &val, 1))
+        return false;
+
+    if (val)
+    {
+        diff->diff = packer->flags[player];
+    }
+    else
+    {
+        if (!GetBits(packer, &diff->diff, 8))
+            return false;
+        packer->flags[player] = diff->diff;
+    }
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+    {
+        if (!GetBits(packer, &val, 8))
+            return false;
+        diff->cmd.forwardmove = (signed char) val;
+    }
+
+    if (diff->diff & NET_TICDIFF_SIDE)
+    {
+        if (!GetBits(packer, &val, 8))
+            return false;
+        diff->cmd.sidemove = (signed char) val;
+    }
+
+    if (diff->diff & NET_TICDIFF_TURN)
+    {
+        if (lowres_turn)
+        {
+            if (!GetBits(packer, &val, 8))
+                return false;
+            diff->cmd.angleturn = ((signed char) val) * 256;
+        }
+        else
+        {
+            if (!GetVarint(packer, &sval))
+                return false;
+            diff->cmd.angleturn = (short) (packer->angleturn[player] + sval);
+            packer->angleturn[player] = diff->cmd.angleturn;
+        }
+    }
+
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+    {
+        if (!GetBits(packer, &val, 8))
+            return false;
+        diff->cmd.buttons = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+    {
+        if (!GetBits(packer, &val, 8))
+            return false;
+        diff->cmd.consistancy = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+    {
+        if (!GetBits(packer, &val, 8))
+            return false;
+        diff->cmd.chatchar = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_RAVEN)
+    {
+        if (!GetBits(packer, &val, 8))
+            return false;
+        diff->cmd.lookfly = val;
+
+        if (!GetBits(packer, &val, 8))
+            return false;
+        diff->cmd.arti = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_STRIFE)
+    {
+        if (!GetBits(packer, &val, 8))
+            return false;
+        diff->cmd.buttons2 = val;
+
+        if (!GetBits(packer, &val, 16))
+            return false;
+        diff->cmd.inventory = val;
+    }
+
+    return true;
+}
+
+static void PackLatency(net_ticpacker_t *packer, signed int latency)
+{
+    if (latency == packer->latency)
+    {
+        PutBits(packer, 1, 1);
+    }
+    else
+    {
+        PutBits(packer, 0, 1);
+        PutVarint(packer, latency);
+        packer->latency = latency;
+    }
+}
+
+static boolean UnpackLatency(net_ticpacker_t *packer, signed int *latency)
+{
+    unsigned int same;
+
+    if (!GetBits(packer, &same, 1))
+    {
+        return false;
+    }
+
+    if (!same)
+    {
+        if (!GetVarint(packer, &packer->latency))
+        {
+            return false;
+        }
+    }
+
+    *latency = packer->latency;
+
+    return true;
+}
+
+// A tic sent from a client to the server: latency and one diff.
+
+void NET_PackTic(net_ticpacker_t *packer, signed int latency,
+                 net_ticdiff_t *diff, boolean lowres_turn)
+{
+    PackLatency(packer, latency);
+    PackTiccmdDiff(packer, 0, diff, lowres_turn);
+}
+
+boolean NET_UnpackTic(net_ticpacker_t *packer, signed int *latency,
+                      net_ticdiff_t *diff, boolean lowres_turn)
+{
+    return UnpackLatency(packer, latency)
+        && UnpackTiccmdDiff(packer, 0, diff, lowres_turn);
+}
+
+// A complete tic sent from the server to a client.
+
+void NET_PackFullTiccmd(net_ticpacker_t *packer, net_full_ticcmd_t *cmd,
+                        boolean lowres_turn)
+{
+    unsigned int bitfield;
+    int i;
+
+    PackLatency(packer, cmd->latency);
+
+    bitfield = 0;
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        if (cmd->playeringame[i])
+        {
+            bitfield |= 1 << i;
+        }
+    }
+
+    if (bitfield == packer->playeringame)
+    {
+        PutBits(packer, 1, 1);
+    }
+    else
+    {
+        PutBits(packer, 0, 1);
+        PutBits(packer, bitfield, NET_MAXPLAYERS);
+        packer->playeringame = bitfield;
+    }
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        if (cmd->playeringame[i])
+        {
+            PackTiccmdDiff(packer, i, &cmd->cmds[i], lowres_turn);
+        }
+    }
+}
+
+boolean NET_UnpackFullTiccmd(net_ticpacker_t *packer, net_full_ticcmd_t *cmd,
+                             boolean lowres_turn)
+{
+    unsigned int same;
+    int i;
+
+    if (!UnpackLatency(packer, &cmd->latency)
+     || !GetBits(packer, &same, 1))
+    {
+        return false;
+    }
+
+    if (!same)
+    {
+        if (!GetBits(packer, &packer->playeringame, NET_MAXPLAYERS))
+        {
+            return false;
+        }
+    }
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        cmd->playeringame[i] = (packer->playeringame & (1 << i)) != 0;
+
+        if (cmd->playeringame[i]
+         && !UnpackTiccmdDiff(packer, i, &cmd->cmds[i], lowres_turn))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void NET_WriteWaitData(net_packet_t *packet, net_waitdata_t *data)
 {
     int i;
@@ -573,3 +969,189 @@ void NET_SafePuts(char *s)
 
     putchar('\n');
 }
+
+//
+// Compare the packed tic encoding with the unpacked one: encode a run
+// of synthetic eight player tics both ways, check that the packed tics
+// decode back unchanged, and report bytes per tic and encoding speed.
+//
+
+#define BENCHMARK_TICS       35
+#define BENCHMARK_ROUNDS     2000
+
+static void BenchmarkTics(net_full_ticcmd_t *tics)
+{
+    ticcmd_t *cmd;
+    int i, p;
+
+    for (i=0; i<BENCHMARK_TICS; ++i)
+    {
+        tics[i].latency = 40 + (i / 10);
+        tics[i].seq = i;
+
+        for (p=0; p<NET_MAXPLAYERS; ++p)
+        {
+            cmd = &tics[i].cmds[p].cmd;
+
+            // Players running and strafing while turning with the
+            // mouse: speeds change now and then, the turn every tic but
+            // only a little from one tic to the next.
+
+            tics[i].playeringame[p] = true;
+            tics[i].cmds[p].diff = NET_TICDIFF_TURN | NET_TICDIFF_CONSISTANCY;
+
+            memset(cmd, 0, sizeof(*cmd));
+            cmd->forwardmove = ((i / 16) & 1) ? 25 : 50;
+            cmd->sidemove = ((i / 8 + p) & 1) ? 40 : -40;
+            cmd->angleturn = (short) ((p - 4) * 96 + (i % 12) * 24);
+            cmd->consistancy = (byte) (i * 7 + p);
+
+            if (i % 16 == 0)
+            {
+                tics[i].cmds[p].diff |= NET_TICDIFF_FORWARD;
+            }
+
+            if (i % 8 == 0)
+            {
+                tics[i].cmds[p].diff |= NET_TICDIFF_SIDE;
+            }
+
+            if ((i + p) % 12 == 0)
+            {
+                tics[i].cmds[p].diff |= NET_TICDIFF_BUTTONS;
+                cmd->buttons = 1;
+            }
+        }
+    }
+}
+
+static boolean SameTic(net_full_ticcmd_t *a, net_full_ticcmd_t *b)
+{
+    ticcmd_t *x, *y;
+    int p;
+
+    if (a->latency != b->latency)
+    {
+        return false;
+    }
+
+    for (p=0; p<NET_MAXPLAYERS; ++p)
+    {
+        if (a->playeringame[p] != b->playeringame[p])
+        {
+            return false;
+        }
+
+        if (!a->playeringame[p])
+        {
+            continue;
+        }
+
+        x = &a->cmds[p].cmd;
+        y = &b->cmds[p].cmd;
+
+        if (a->cmds[p].diff != b->cmds[p].diff
+         || ((a->cmds[p].diff & NET_TICDIFF_FORWARD)
+          && x->forwardmove != y->forwardmove)
+         || ((a->cmds[p].diff & NET_TICDIFF_SIDE)
+          && x->sidemove != y->sidemove)
+         || ((a->cmds[p].diff & NET_TICDIFF_TURN)
+          && x->angleturn != y->angleturn)
+         || ((a->cmds[p].diff & NET_TICDIFF_BUTTONS)
+          && x->buttons != y->buttons)
+         || ((a->cmds[p].diff & NET_TICDIFF_CONSISTANCY)
+          && x->consistancy != y->consistancy))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int BenchmarkEncode(net_full_ticcmd_t *tics, boolean packed,
+                           int *elapsed)
+{
+    net_ticpacker_t packer;
+    net_packet_t *packet;
+    int starttime;
+    int round, i;
+    int len = 0;
+
+    starttime = I_GetTimeMS();
+
+    for (round=0; round<BENCHMARK_ROUNDS; ++round)
+    {
+        packet = NET_NewPacket(1500);
+        NET_InitTicPacker(&packer, packet);
+
+        for (i=0; i<BENCHMARK_TICS; ++i)
+        {
+            if (packed)
+            {
+                NET_PackFullTiccmd(&packer, &tics[i], false);
+            }
+            else
+            {
+                NET_WriteFullTiccmd(packet, &tics[i], false);
+            }
+        }
+
+        NET_FinishTicPacker(&packer);
+
+        len = packet->len;
+        NET_FreePacket(packet);
+    }
+
+    *elapsed = I_GetTimeMS() - starttime;
+
+    return len;
+}
+
+void NET_TicPackBenchmark(void)
+{
+    static net_full_ticcmd_t tics[BENCHMARK_TICS];
+    net_full_ticcmd_t decoded;
+    net_ticpacker_t packer;
+    net_packet_t *packet;
+    int plain_len, packed_len;
+    int plain_time, packed_time;
+    int i;
+
+    BenchmarkTics(tics);
+
+    // Round trip first: a mismatch here is a bug, not a slow result.
+
+    packet = NET_NewPacket(1500);
+    NET_InitTicPacker(&packer, packet);
+
+    for (i=0; i<BENCHMARK_TICS; ++i)
+    {
+        NET_PackFullTiccmd(&packer, &tics[i], false);
+    }
+
+    NET_FinishTicPacker(&packer);
+    NET_InitTicPacker(&packer, packet);
+
+    for (i=0; i<BENCHMARK_TICS; ++i)
+    {
+        if (!NET_UnpackFullTiccmd(&packer, &decoded, false)
+         || !SameTic(&tics[i], &decoded))
+        {
+            I_Error("NET_TicPackBenchmark: тик %i не совпадает после "
+                    "распаковки!", i);
+        }
+    }
+
+    NET_FreePacket(packet);
+
+    plain_len = BenchmarkEncode(tics, false, &plain_time);
+    packed_len = BenchmarkEncode(tics, true, &packed_time);
+
+    printf("NET_TicPackBenchmark: %i тиков, %i игроков, %i повторов\n",
+           BENCHMARK_TICS, NET_MAXPLAYERS, BENCHMARK_ROUNDS);
+    printf("  без упаковки: %i байт/тик, %i мс\n",
+           plain_len / BENCHMARK_TICS, plain_time);
+    printf("  с упаковкой:  %i байт/тик, %i мс\n",
+           packed_len / BENCHMARK_TICS, packed_time);
+}
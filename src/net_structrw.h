@@ -40,6 +40,34 @@ extern void NET_TiccmdPatch(ticcmd_t *src, net_ticdiff_t *diff, ticcmd_t *dest);
 boolean NET_ReadFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean lowres_turn);
 void NET_WriteFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean lowres_turn);
 
+// State of the packed tic encoding while a packet is written or read.
+
+typedef struct
+{
+    net_packet_t *packet;
+    unsigned int bitbuf;
+    int bitcount;
+
+    // Values of the previous tic, which the next one is coded against
+
+    signed int latency;
+    unsigned int playeringame;
+    unsigned int flags[NET_MAXPLAYERS];
+    short angleturn[NET_MAXPLAYERS];
+} net_ticpacker_t;
+
+void NET_InitTicPacker(net_ticpacker_t *packer, net_packet_t *packet);
+void NET_FinishTicPacker(net_ticpacker_t *packer);
+void NET_PackTic(net_ticpacker_t *packer, signed int latency,
+                 net_ticdiff_t *diff, boolean lowres_turn);
+boolean NET_UnpackTic(net_ticpacker_t *packer, signed int *latency,
+                      net_ticdiff_t *diff, boolean lowres_turn);
+void NET_PackFullTiccmd(net_ticpacker_t *packer, net_full_ticcmd_t *cmd,
+                        boolean lowres_turn);
+boolean NET_UnpackFullTiccmd(net_ticpacker_t *packer, net_full_ticcmd_t *cmd,
+                             boolean lowres_turn);
+void NET_TicPackBenchmark(void);
+
 boolean NET_ReadSHA1Sum(net_packet_t *packet, sha1_digest_t digest);
 void NET_WriteSHA1Sum(net_packet_t *packet, sha1_digest_t digest);
 
@@ -0,0 +1,653 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Networking module which uses native UDP sockets.
+//
+//     Packets are received and sent in batches with recvmmsg() and
+//     sendmmsg(), so that a busy server makes one system call for
+//     many packets instead of one per packet.  Outgoing packets are
+//     queued until FlushPackets is called or the queue is full.
+//
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "net_udp.h"
+
+#ifdef HAVE_NET_UDP
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+
+#define DEFAULT_PORT 2342
+
+// Largest number of packets handled by one system call, and the size
+// of the buffer for each received packet.
+
+#define MAX_BATCH 64
+#define MAX_PACKET_LEN 1500
+
+#define ADDR_HASH_SIZE 256
+
+static boolean initted = false;
+static int port = DEFAULT_PORT;
+static int udpsocket = -1;
+
+// Number of packets actually handled per system call; the benchmark
+// lowers this to 1 to measure the unbatched path.
+
+static int batch_size = MAX_BATCH;
+
+typedef struct addrpair_s addrpair_t;
+
+struct addrpair_s
+{
+    net_addr_t net_addr;
+    struct sockaddr_in sin;
+    addrpair_t *next;
+};
+
+// Known addresses, hashed by IP address and port.
+
+static addrpair_t *addr_table[ADDR_HASH_SIZE];
+
+// Received packets not yet collected by RecvPacket.
+
+static struct mmsghdr recv_msgs[MAX_BATCH];
+static struct iovec recv_iovecs[MAX_BATCH];
+static struct sockaddr_in recv_addrs[MAX_BATCH];
+static byte recv_buffers[MAX_BATCH][MAX_PACKET_LEN];
+static int recv_count = 0;
+static int recv_next = 0;
+
+// Packets waiting to be sent.  They are held (see NET_PacketRef) and
+// sent straight from their own data, rather than copied.
+
+static struct mmsghdr send_msgs[MAX_BATCH];
+static struct iovec send_iovecs[MAX_BATCH];
+static struct sockaddr_in send_addrs[MAX_BATCH];
+static net_packet_t *send_packets[MAX_BATCH];
+static int send_count = 0;
+
+static unsigned int AddressHash(struct sockaddr_in *sin)
+{
+    uint32_t hash;
+
+    hash = sin->sin_addr.s_addr ^ ((uint32_t) sin->sin_port << 16)
+         ^ sin->sin_port;
+    hash ^= hash >> 16;
+    hash ^= hash >> 8;
+
+    return hash % ADDR_HASH_SIZE;
+}
+
+// Finds an address in the table.  If the address is not found, it is
+// added to the table.
+
+static net_addr_t *NET_UDP_FindAddress(struct sockaddr_in *sin)
+{
+    addrpair_t *entry;
+    unsigned int hash;
+
+    hash = AddressHash(sin);
+
+    for (entry = addr_table[hash]; entry != NULL; entry = entry->next)
+    {
+        if (entry->sin.sin_addr.s_addr == sin->sin_addr.s_addr
+         && entry->sin.sin_port == sin->sin_port)
+        {
+            return &entry->net_addr;
+        }
+    }
+
+    entry = malloc(sizeof(addrpair_t));
+
+    if (entry == NULL)
+    {
+        I_Error("NET_UDP_FindAddress: недостаточно памяти");
+    }
+
+    memset(&entry->sin, 0, sizeof(entry->sin));
+    entry->sin.sin_family = AF_INET;
+    entry->sin.sin_addr = sin->sin_addr;
+    entry->sin.sin_port = sin->sin_port;
+    entry->net_addr.handle = &entry->sin;
+    entry->net_addr.module = &net_udp_module;
+
+    entry->next = addr_table[hash];
+    addr_table[hash] = entry;
+
+    return &entry->net_addr;
+}
+
+static void NET_UDP_FreeAddress(net_addr_t *addr)
+{
+    addrpair_t **entry;
+    addrpair_t *next;
+
+    entry = &addr_table[AddressHash((struct sockaddr_in *) addr->handle)];
+
+    for (; *entry != NULL; entry = &(*entry)->next)
+    {
+        if (addr == &(*entry)->net_addr)
+        {
+            next = (*entry)->next;
+            free(*entry);
+            *entry = next;
+            return;
+        }
+    }
+
+    I_Error("NET_UDP_FreeAddress: попытка удаления неиспользованного адреса!");
+}
+
+static void NET_UDP_InitBuffers(void)
+{
+    int i;
+
+    for (i = 0; i < MAX_BATCH; ++i)
+    {
+        recv_iovecs[i].iov_base = recv_buffers[i];
+        recv_iovecs[i].iov_len = MAX_PACKET_LEN;
+        recv_msgs[i].msg_hdr.msg_iov = &recv_iovecs[i];
+        recv_msgs[i].msg_hdr.msg_iovlen = 1;
+
+        send_msgs[i].msg_hdr.msg_iov = &send_iovecs[i];
+        send_msgs[i].msg_hdr.msg_iovlen = 1;
+        send_msgs[i].msg_hdr.msg_name = &send_addrs[i];
+        send_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+}
+
+static int OpenSocket(int bind_port)
+{
+    struct sockaddr_in sin;
+    int broadcast = 1;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_ANY);
+    sin.sin_port = htons(bind_port);
+
+    if (bind(fd, (struct sockaddr *) &sin, sizeof(sin)) < 0
+     || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+
+    return fd;
+}
+
+static void NET_UDP_CheckPortParm(void)
+{
+    int p;
+
+    p = M_CheckParmWithArgs("-port", 1);
+    if (p > 0)
+        port = atoi(myargv[p+1]);
+}
+
+static boolean NET_UDP_InitClient(void)
+{
+    if (initted)
+        return true;
+
+    NET_UDP_CheckPortParm();
+    NET_UDP_InitBuffers();
+
+    udpsocket = OpenSocket(0);
+
+    if (udpsocket < 0)
+    {
+        I_Error("NET_UDP_InitClient: невозможно открыть сокет!");
+    }
+
+    initted = true;
+
+    return true;
+}
+
+static boolean NET_UDP_InitServer(void)
+{
+    if (initted)
+        return true;
+
+    NET_UDP_CheckPortParm();
+    NET_UDP_InitBuffers();
+
+    udpsocket = OpenSocket(port);
+
+    if (udpsocket < 0)
+    {
+        I_Error("NET_UDP_InitServer: невозможно назначить порт %i", port);
+    }
+
+    initted = true;
+
+    return true;
+}
+
+static void NET_UDP_FlushPackets(void)
+{
+    int sent = 0;
+    int count;
+    int result;
+
+    while (sent < send_count)
+    {
+        count = send_count - sent;
+
+        if (count > batch_size)
+        {
+            count = batch_size;
+        }
+
+        result = sendmmsg(udpsocket, send_msgs + sent, count, 0);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // A full socket buffer or an unreachable host just loses
+            // the packet, as it would anywhere else on the way.
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK
+             || errno == ECONNREFUSED || errno == EHOSTUNREACH
+             || errno == ENETUNREACH)
+            {
+                ++sent;
+                continue;
+            }
+
+            I_Error("NET_UDP_FlushPackets: ошибка передачи пакета: %s",
+                    strerror(errno));
+        }
+
+        sent += result;
+    }
+
+    for (sent = 0; sent < send_count; ++sent)
+    {
+        NET_FreePacket(send_packets[sent]);
+    }
+
+    send_count = 0;
+}
+
+static void NET_UDP_SendPacket(net_addr_t *addr, net_packet_t *packet)
+{
+    struct sockaddr_in *sin;
+
+    if (packet->len > MAX_PACKET_LEN)
+    {
+        I_Error("NET_UDP_SendPacket: пакет слишком велик (%i байт)",
+                (int) packet->len);
+    }
+
+    if (send_count >= batch_size)
+    {
+        NET_UDP_FlushPackets();
+    }
+
+    sin = &send_addrs[send_count];
+
+    if (addr == &net_broadcast_addr)
+    {
+        memset(sin, 0, sizeof(*sin));
+        sin->sin_family = AF_INET;
+        sin->sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        sin->sin_port = htons(port);
+    }
+    else
+    {
+        *sin = *((struct sockaddr_in *) addr->handle);
+    }
+
+    send_packets[send_count] = NET_PacketRef(packet);
+    send_iovecs[send_count].iov_base = packet->data;
+    send_iovecs[send_count].iov_len = packet->len;
+    ++send_count;
+}
+
+static boolean NET_UDP_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+{
+    struct mmsghdr *msg;
+    int result;
+    int i;
+
+    if (recv_next >= recv_count)
+    {
+        // The kernel overwrites the address lengths, so they have to
+        // be reset before every call.
+
+        for (i = 0; i < batch_size; ++i)
+        {
+            recv_msgs[i].msg_hdr.msg_name = &recv_addrs[i];
+            recv_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+
+        recv_next = 0;
+        recv_count = 0;
+
+        do
+        {
+            result = recvmmsg(udpsocket, recv_msgs, batch_size,
+                              MSG_DONTWAIT, NULL);
+        } while (result < 0 && errno == EINTR);
+
+        if (result < 0)
+        {
+            // ICMP port unreachable messages for earlier packets are
+            // reported here; they are not an error for the server.
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK
+             || errno == ECONNREFUSED)
+            {
+                return false;
+            }
+
+            I_Error("NET_UDP_RecvPacket: ошибка получения пакета: %s",
+                    strerror(errno));
+        }
+
+        recv_count = result;
+    }
+
+    // no packets received
+
+    if (recv_next >= recv_count)
+        return false;
+
+    msg = &recv_msgs[recv_next];
+
+    // Put the data into a new packet structure
+
+    *packet = NET_NewPacket(msg->msg_len);
+    memcpy((*packet)->data, recv_buffers[recv_next], msg->msg_len);
+    (*packet)->len = msg->msg_len;
+
+    // Address
+
+    *addr = NET_UDP_FindAddress(&recv_addrs[recv_next]);
+
+    ++recv_next;
+
+    return true;
+}
+
+// With a single socket, poll() does as well as epoll would.
+
+static void NET_UDP_WaitForPacket(int timeout)
+{
+    struct pollfd pfd;
+
+    if (recv_next < recv_count)
+    {
+        return;
+    }
+
+    pfd.fd = udpsocket;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    poll(&pfd, 1, timeout);
+}
+
+void NET_UDP_AddrToString(net_addr_t *addr, char *buffer, int buffer_len)
+{
+    struct sockaddr_in *sin;
+    uint32_t host;
+    uint16_t addr_port;
+
+    sin = (struct sockaddr_in *) addr->handle;
+    host = ntohl(sin->sin_addr.s_addr);
+    addr_port = ntohs(sin->sin_port);
+
+    M_snprintf(buffer, buffer_len, "%i.%i.%i.%i",
+               (host >> 24) & 0xff, (host >> 16) & 0xff,
+               (host >> 8) & 0xff, host & 0xff);
+
+    // As with the SDL_net module, only a non-default port is shown.
+    if (addr_port != DEFAULT_PORT)
+    {
+        char portbuf[10];
+        M_snprintf(portbuf, sizeof(portbuf), ":%i", addr_port);
+        M_StringConcat(buffer, portbuf, buffer_len);
+    }
+}
+
+net_addr_t *NET_UDP_ResolveAddress(char *address)
+{
+    struct addrinfo hints, *result;
+    struct sockaddr_in sin;
+    char *addr_hostname;
+    int addr_port;
+    char *colon;
+    int error;
+
+    colon = strchr(address, ':');
+
+    addr_hostname = M_StringDuplicate(address);
+
+    if (colon != NULL)
+    {
+        addr_hostname[colon - address] = '\0';
+        addr_port = atoi(colon + 1);
+    }
+    else
+    {
+        addr_port = port;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    error = getaddrinfo(addr_hostname, NULL, &hints, &result);
+
+    free(addr_hostname);
+
+    if (error != 0 || result == NULL)
+    {
+        // unable to resolve
+
+        return NULL;
+    }
+
+    memcpy(&sin, result->ai_addr, sizeof(sin));
+    sin.sin_port = htons(addr_port);
+    freeaddrinfo(result);
+
+    return NET_UDP_FindAddress(&sin);
+}
+
+// Loopback throughput benchmark.  A second socket sends bursts of
+// packets to the module, which echoes every one of them back, first
+// one system call per packet and then in batches.  The sending side
+// always uses batches, so that the difference is down to the module.
+
+#define BENCHMARK_PACKETS 500000
+#define BENCHMARK_BURST MAX_BATCH
+
+static int BenchmarkRun(int client, int size)
+{
+    static byte buf[BENCHMARK_BURST][64];
+    struct mmsghdr msgs[BENCHMARK_BURST];
+    struct iovec iovecs[BENCHMARK_BURST];
+    struct sockaddr_in sin;
+    net_packet_t *packet;
+    net_addr_t *addr;
+    int sent, received;
+    int starttime, elapsed;
+    int count, result;
+    int i;
+
+    batch_size = size;
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin.sin_port = htons(port);
+
+    memset(msgs, 0, sizeof(msgs));
+
+    for (i = 0; i < BENCHMARK_BURST; ++i)
+    {
+        iovecs[i].iov_base = buf[i];
+        iovecs[i].iov_len = sizeof(buf[i]);
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &sin;
+        msgs[i].msg_hdr.msg_namelen = sizeof(sin);
+    }
+
+    sent = received = 0;
+    starttime = I_GetTimeMS();
+
+    while (received < BENCHMARK_PACKETS)
+    {
+        // Keep a few bursts in flight so the socket buffers never
+        // overflow.
+
+        count = BENCHMARK_PACKETS - sent;
+
+        if (count > BENCHMARK_BURST)
+        {
+            count = BENCHMARK_BURST;
+        }
+
+        if (count > 0 && sent - received < BENCHMARK_BURST * 4)
+        {
+            result = sendmmsg(client, msgs, count, 0);
+
+            if (result > 0)
+            {
+                sent += result;
+            }
+        }
+
+        while (NET_UDP_RecvPacket(&addr, &packet))
+        {
+            NET_UDP_SendPacket(addr, packet);
+            NET_FreePacket(packet);
+        }
+
+        NET_UDP_FlushPackets();
+
+        do
+        {
+            result = recvmmsg(client, msgs, BENCHMARK_BURST,
+                              MSG_DONTWAIT, NULL);
+
+            if (result > 0)
+            {
+                received += result;
+            }
+        } while (result == BENCHMARK_BURST);
+
+        // Packets lost on the way would otherwise stall the loop.
+
+        if (I_GetTimeMS() - starttime > 30000)
+        {
+            break;
+        }
+    }
+
+    elapsed = I_GetTimeMS() - starttime;
+
+    if (elapsed < 1)
+    {
+        elapsed = 1;
+    }
+
+    return (int) ((int64_t) received * 1000 / elapsed);
+}
+
+void NET_UDP_Benchmark(void)
+{
+    int client;
+    int single, batched;
+
+    NET_UDP_InitServer();
+
+    client = OpenSocket(0);
+
+    if (client < 0)
+    {
+        I_Error("NET_UDP_Benchmark: невозможно открыть сокет!");
+    }
+
+    single = BenchmarkRun(client, 1);
+    batched = BenchmarkRun(client, MAX_BATCH);
+
+    printf("NET_UDP_Benchmark: %i пакетов через 127.0.0.1:%i\n",
+           BENCHMARK_PACKETS, port);
+    printf("  по одному пакету:   %i пакетов/с\n", single);
+    printf("  пакетами по %i:     %i пакетов/с\n", MAX_BATCH, batched);
+
+    close(client);
+    batch_size = MAX_BATCH;
+}
+
+// Complete module
+
+net_module_t net_udp_module =
+{
+    NET_UDP_InitClient,
+    NET_UDP_InitServer,
+    NET_UDP_SendPacket,
+    NET_UDP_RecvPacket,
+    NET_UDP_AddrToString,
+    NET_UDP_FreeAddress,
+    NET_UDP_ResolveAddress,
+    NET_UDP_FlushPackets,
+    NET_UDP_WaitForPacket,
+};
+
+#endif /* #ifdef HAVE_NET_UDP */
+
@@ -73,6 +73,7 @@ static int smoothing = 0;
 static int disable_screen_wiping = 0;
 static int vga_porch_flash = 0;
 static int integer_scaling = 0;
+static int hires = 1;
 static int force_software_renderer = 0;
 static int fullscreen = 1;
 static int fullscreen_width = 0, fullscreen_height = 0;
@@ -281,6 +282,7 @@ void BindDisplayVariables(void)
     M_BindIntVariable("disable_screen_wiping",     &disable_screen_wiping);
     M_BindIntVariable("vga_porch_flash",           &vga_porch_flash);
     M_BindIntVariable("integer_scaling",           &integer_scaling);
+    M_BindIntVariable("hires",                     &hires);
     M_BindIntVariable("fullscreen",                &fullscreen);
     M_BindIntVariable("fullscreen_width",          &fullscreen_width);
     M_BindIntVariable("fullscreen_height",         &fullscreen_height);
@@ -51,6 +51,8 @@ int snd_sfxdevice = SNDDEVICE_SB;
 int snd_musicdevice = SNDDEVICE_SB;
 int snd_samplerate = 44100;
 int opl_io_port = 0x388;
+int opl_music_cache = 0;
+int opl_music_cache_size = 512 * 1024 * 1024;
 int snd_cachesize = 64 * 1024 * 1024;
 int snd_maxslicetime_ms = 28;
 char *snd_musiccmd = "";
@@ -219,6 +221,8 @@ void BindSoundVariables(void)
 
     M_BindIntVariable("snd_cachesize",            &snd_cachesize);
     M_BindIntVariable("opl_io_port",              &opl_io_port);
+    M_BindIntVariable("opl_music_cache",          &opl_music_cache);
+    M_BindIntVariable("opl_music_cache_size",     &opl_music_cache_size);
 
     M_BindIntVariable("snd_pitchshift",           &snd_pitchshift);
 
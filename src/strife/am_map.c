@@ -178,8 +178,8 @@ static int 	cheating = 0;
 static int 	leveljuststarted = 1; 	// kluge until AM_LevelInit() is called
 
 boolean    	automapactive = false;
-static int 	finit_width = SCREENWIDTH;
-static int 	finit_height = SCREENHEIGHT - (32 << hires);
+static int 	finit_width;
+static int 	finit_height;
 
 // location of window on screen
 static int 	f_x;
@@ -502,6 +502,10 @@ void AM_LevelInit(void)
 {
     leveljuststarted = 0;
 
+    // Window size depends on the rendering resolution chosen at startup.
+    finit_width = SCREENWIDTH;
+    finit_height = SCREENHEIGHT - (32 << hires);
+
     f_x = f_y = 0;
     f_w = finit_width;
     f_h = finit_height;
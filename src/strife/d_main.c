@@ -1575,6 +1575,7 @@ void D_DoomMain (void)
     M_SetConfigFilenames(/*"strife.cfg", */PROGRAM_PREFIX "strife.cfg");
     D_BindVariables();
     M_LoadDefaults();
+    I_CheckHiresParm();
 
     if (!graphical_startup)
     {
@@ -37,10 +37,6 @@
 #include "doomstat.h"
 
 
-// ?
-#define MAXWIDTH			1120
-#define MAXHEIGHT			832
-
 // status bar height at bottom of screen
 // haleyjd 08/31/10: Verified unmodified.
 #define SBARHEIGHT              (32 << hires)
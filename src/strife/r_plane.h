@@ -36,11 +36,11 @@ typedef void (*planefunction_t) (int top, int bottom);
 extern planefunction_t	floorfunc;
 extern planefunction_t	ceilingfunc_t;
 
-extern short		floorclip[SCREENWIDTH];
-extern short		ceilingclip[SCREENWIDTH];
+extern short		floorclip[MAXWIDTH];
+extern short		ceilingclip[MAXWIDTH];
 
-extern fixed_t		yslope[SCREENHEIGHT];
-extern fixed_t		distscale[SCREENWIDTH];
+extern fixed_t		yslope[MAXHEIGHT];
+extern fixed_t		distscale[MAXWIDTH];
 
 void R_InitPlanes (void);
 void R_ClearPlanes (void);
@@ -979,11 +979,12 @@ void ST_drawLine(int x, int y, int len, int color)
     byte putcolor = (byte)(color);
     byte *drawpos = I_VideoBuffer + (y << hires) * SCREENWIDTH + (x << hires);
     int i = 0;
+    int j;
 
     while(i < (len << hires))
     {
-        if (hires)
-            *(drawpos + SCREENWIDTH) = putcolor;
+        for (j = 1; j < (1 << hires); j++)
+            *(drawpos + j * SCREENWIDTH) = putcolor;
         *drawpos++ = putcolor;
         ++i;
     }
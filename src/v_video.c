@@ -159,7 +159,7 @@ void V_DrawPatch(int x, int y, patch_t *patch)
     byte *desttop;
     byte *dest;
     byte *source;
-    int w, f;
+    int w, f, r;
 
     y -= SHORT(patch->topoffset);
     x -= SHORT(patch->leftoffset);
@@ -195,10 +195,10 @@ void V_DrawPatch(int x, int y, patch_t *patch)
         // step through the posts in a column
         while (column->topdelta != 0xff)
         {
-            for (f = 0; f <= hires; f++)
+            for (f = 0; f < (1 << hires); f++)
             {
             source = (byte *)column + 3;
-            dest = desttop + column->topdelta*(SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta*(SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 
             // [crispy] prevent framebuffer overflows
@@ -241,7 +241,7 @@ void V_DrawPatch(int x, int y, patch_t *patch)
 
             while (count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest = *source;
                     dest += SCREENWIDTH;
@@ -269,7 +269,7 @@ void V_DrawPatchFlipped(int x, int y, patch_t *patch)
     byte *desttop;
     byte *dest;
     byte *source; 
-    int w, f; 
+    int w, f, r;
  
     y -= SHORT(patch->topoffset); 
     x -= SHORT(patch->leftoffset); 
@@ -305,15 +305,15 @@ void V_DrawPatchFlipped(int x, int y, patch_t *patch)
         // step through the posts in a column
         while (column->topdelta != 0xff )
         {
-            for (f = 0; f <= hires; f++)
+            for (f = 0; f < (1 << hires); f++)
             {
             source = (byte *)column + 3;
-            dest = desttop + column->topdelta*(SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta*(SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 
             while (count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest = *source;
                     dest += SCREENWIDTH;
@@ -350,7 +350,7 @@ void V_DrawTLPatch(int x, int y, patch_t * patch)
     int count, col;
     column_t *column;
     byte *desttop, *dest, *source;
-    int w, f;
+    int w, f, r;
 
     y -= SHORT(patch->topoffset);
     x -= SHORT(patch->leftoffset);
@@ -375,15 +375,15 @@ void V_DrawTLPatch(int x, int y, patch_t * patch)
 
         while (column->topdelta != 0xff)
         {
-            for (f = 0; f <= hires; f++)
+            for (f = 0; f < (1 << hires); f++)
             {
             source = (byte *) column + 3;
-            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 
             while (count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest = tinttable[((*dest) << 8) + *source];
                     dest += SCREENWIDTH;
@@ -408,7 +408,7 @@ void V_DrawXlaPatch(int x, int y, patch_t * patch)
     int count, col;
     column_t *column;
     byte *desttop, *dest, *source;
-    int w, f;
+    int w, f, r;
 
     y -= SHORT(patch->topoffset);
     x -= SHORT(patch->leftoffset);
@@ -431,15 +431,15 @@ void V_DrawXlaPatch(int x, int y, patch_t * patch)
 
         while(column->topdelta != 0xff)
         {
-            for (f = 0; f <= hires; f++)
+            for (f = 0; f < (1 << hires); f++)
             {
             source = (byte *) column + 3;
-            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 
             while(count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest = xlatab[*dest + ((*source) << 8)];
                     dest += SCREENWIDTH;
@@ -465,7 +465,7 @@ void V_DrawAltTLPatch(int x, int y, patch_t * patch)
     int count, col;
     column_t *column;
     byte *desttop, *dest, *source;
-    int w, f;
+    int w, f, r;
 
     y -= SHORT(patch->topoffset);
     x -= SHORT(patch->leftoffset);
@@ -490,15 +490,15 @@ void V_DrawAltTLPatch(int x, int y, patch_t * patch)
 
         while (column->topdelta != 0xff)
         {
-            for (f = 0; f <= hires; f++)
+            for (f = 0; f < (1 << hires); f++)
             {
             source = (byte *) column + 3;
-            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 
             while (count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest = tinttable[((*dest) << 8) + *source];
                     dest += SCREENWIDTH;
@@ -524,7 +524,7 @@ void V_DrawShadowedPatch(int x, int y, patch_t *patch)
     column_t *column;
     byte *desttop, *dest, *source;
     byte *desttop2, *dest2;
-    int w, f;
+    int w, f, r;
 
     y -= SHORT(patch->topoffset);
     x -= SHORT(patch->leftoffset);
@@ -550,16 +550,16 @@ void V_DrawShadowedPatch(int x, int y, patch_t *patch)
 
         while (column->topdelta != 0xff)
         {
-            for (f = 0; f <= hires; f++)
+            for (f = 0; f < (1 << hires); f++)
             {
             source = (byte *) column + 3;
-            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
-            dest2 = desttop2 + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
+            dest2 = desttop2 + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 
             while (count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest2 = tinttable[((*dest2) << 8)];
                     dest2 += SCREENWIDTH;
@@ -589,7 +589,7 @@ void V_DrawShadowedPatchDoom(int x, int y, patch_t *patch)
     column_t *column;
     byte *desttop, *dest, *source;
     byte *desttop2, *dest2;
-    int w, f;
+    int w, f, r;
 
     tinttable = W_CacheLumpName("TINTMAP", PU_STATIC);
 
@@ -624,14 +624,14 @@ void V_DrawShadowedPatchDoom(int x, int y, patch_t *patch)
         // step through the posts in a column
         while (column->topdelta != 0xff)
         {
-            for (f = 0; f <= hires; f++)
+            for (f = 0; f < (1 << hires); f++)
             {
                 source = (byte *) column + 3;
-                dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
+                dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
 
                 if (draw_shadowed_text && !vanillaparm)
                 {
-                    dest2 = desttop2 + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
+                    dest2 = desttop2 + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
                 }
                 else 
                 {
@@ -642,7 +642,7 @@ void V_DrawShadowedPatchDoom(int x, int y, patch_t *patch)
 
                 while (count--)
                 {
-                    if (hires)
+                    for (r = 1; r < (1 << hires); r++)
                     {
                         if (draw_shadowed_text && !vanillaparm)
                         {
@@ -679,7 +679,7 @@ void V_DrawShadowedPatchRaven(int x, int y, patch_t *patch)
     column_t *column;
     byte *desttop, *dest, *source;
     byte *desttop2, *dest2;
-    int w, f;
+    int w, f, r;
 
     tinttable = W_CacheLumpName("TINTTAB", PU_STATIC);
 
@@ -707,16 +707,16 @@ void V_DrawShadowedPatchRaven(int x, int y, patch_t *patch)
 
         while (column->topdelta != 0xff)
         {
-          for (f = 0; f <= hires; f++)
+          for (f = 0; f < (1 << hires); f++)
           {
             source = (byte *) column + 3;
-            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
-            dest2 = desttop2 + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
+            dest2 = desttop2 + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 
             while (count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest2 = tinttable[((*dest2) << 8)];
                     dest2 += SCREENWIDTH;
@@ -747,7 +747,7 @@ void V_DrawShadowedPatchStrife(int x, int y, patch_t *patch)
     column_t *column;
     byte *desttop, *dest, *source;
     byte *desttop2, *dest2;
-    int w, f;
+    int w, f, r;
 
     tinttable = W_CacheLumpName("XLATAB", PU_STATIC);
 
@@ -775,16 +775,16 @@ void V_DrawShadowedPatchStrife(int x, int y, patch_t *patch)
 
         while (column->topdelta != 0xff)
         {
-          for (f = 0; f <= hires; f++)
+          for (f = 0; f < (1 << hires); f++)
           {
             source = (byte *) column + 3;
-            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
-            dest2 = desttop2 + column->topdelta * (SCREENWIDTH << hires) + (x * hires) + f;
+            dest = desttop + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
+            dest2 = desttop2 + column->topdelta * (SCREENWIDTH << hires) + (x * ((1 << hires) - 1)) + f;
             count = column->length;
 
             while (count--)
             {
-                if (hires)
+                for (r = 1; r < (1 << hires); r++)
                 {
                     *dest2 = tinttable[((*dest2) << 8)];
                     dest2 += SCREENWIDTH;
@@ -956,11 +956,11 @@ void V_CopyScaledBuffer(byte *dest, byte *src, size_t size)
 
     while (size--)
     {
-        for (i = 0; i <= hires; i++)
+        for (i = 0; i < (1 << hires); i++)
         {
-            for (j = 0; j <= hires; j++)
+            for (j = 0; j < (1 << hires); j++)
             {
-                *(dest + (size << hires) + (hires * (int) (size / ORIGWIDTH) + i) * SCREENWIDTH + j) = *(src + size);
+                *(dest + (size << hires) + (((1 << hires) - 1) * (int) (size / ORIGWIDTH) + i) * SCREENWIDTH + j) = *(src + size);
             }
         }
     }